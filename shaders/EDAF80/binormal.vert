@@ -1,12 +1,16 @@
 #version 410
 
 layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 normal;
+layout (location = 3) in vec3 tangent;
 layout (location = 4) in vec3 binormal;
 
 uniform mat4 vertex_model_to_world;
 uniform mat4 normal_model_to_world;
 uniform mat4 vertex_world_to_clip;
 
+#include "../common/vertex_decoding.glsl"
+
 out VS_OUT {
 	vec3 binormal;
 } vs_out;
@@ -14,7 +18,12 @@ out VS_OUT {
 
 void main()
 {
-	vs_out.binormal = normalize(vec3(normal_model_to_world * vec4(binormal, 0.0)));
+	vec3 position = decode_position(vertex);
+	vec3 model_binormal = binormal;
+	if (has_octahedral_normals)
+		model_binormal = tangent.z * cross(decode_octahedral(normal.xy), decode_octahedral(tangent.xy));
+
+	vs_out.binormal = normalize(vec3(normal_model_to_world * vec4(model_binormal, 0.0)));
 
-	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(vertex, 1.0);
+	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(position, 1.0);
 }
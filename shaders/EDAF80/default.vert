@@ -6,6 +6,8 @@ layout (location = 2) in vec3 texcoord;
 uniform mat4 vertex_model_to_world;
 uniform mat4 vertex_world_to_clip;
 
+#include "../common/vertex_decoding.glsl"
+
 out VS_OUT {
 	vec2 texcoord;
 } vs_out;
@@ -13,7 +15,9 @@ out VS_OUT {
 
 void main()
 {
+	vec3 position = decode_position(vertex);
+
 	vs_out.texcoord = texcoord.xy;
 
-	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(vertex, 1.0);
+	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(position, 1.0);
 }
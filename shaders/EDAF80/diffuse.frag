@@ -2,6 +2,8 @@
 
 uniform vec3 light_position;
 
+#include "../common/material_constants.glsl"
+
 in VS_OUT {
 	vec3 vertex;
 	vec3 normal;
@@ -16,6 +16,8 @@ uniform mat4 vertex_model_to_world;
 uniform mat4 normal_model_to_world;
 uniform mat4 vertex_world_to_clip;
 
+#include "../common/vertex_decoding.glsl"
+
 // This is the custom output of this shader. If you want to retrieve this data
 // from another shader further down the pipeline, you need to declare the exact
 // same structure as in (for input), with matching name for the structure
@@ -29,10 +31,13 @@ out VS_OUT {
 
 void main()
 {
-	vs_out.vertex = vec3(vertex_model_to_world * vec4(vertex, 1.0));
-	vs_out.normal = vec3(normal_model_to_world * vec4(normal, 0.0));
+	vec3 position = decode_position(vertex);
+	vec3 model_normal = has_octahedral_normals ? decode_octahedral(normal.xy) : normal;
+
+	vs_out.vertex = vec3(vertex_model_to_world * vec4(position, 1.0));
+	vs_out.normal = vec3(normal_model_to_world * vec4(model_normal, 0.0));
 
-	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(vertex, 1.0);
+	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(position, 1.0);
 }
 
 
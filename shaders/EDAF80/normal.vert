@@ -7,6 +7,8 @@ uniform mat4 vertex_model_to_world;
 uniform mat4 normal_model_to_world;
 uniform mat4 vertex_world_to_clip;
 
+#include "../common/vertex_decoding.glsl"
+
 out VS_OUT {
 	vec3 normal;
 } vs_out;
@@ -14,9 +16,12 @@ out VS_OUT {
 
 void main()
 {
-	vs_out.normal = normalize(vec3(normal_model_to_world * vec4(normal, 0.0)));
+	vec3 position = decode_position(vertex);
+	vec3 model_normal = has_octahedral_normals ? decode_octahedral(normal.xy) : normal;
+
+	vs_out.normal = normalize(vec3(normal_model_to_world * vec4(model_normal, 0.0)));
 
-	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(vertex, 1.0);
+	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(position, 1.0);
 }
 
 
@@ -7,6 +7,8 @@ uniform mat4 vertex_model_to_world;
 uniform mat4 normal_model_to_world;
 uniform mat4 vertex_world_to_clip;
 
+#include "../common/vertex_decoding.glsl"
+
 out VS_OUT {
 	vec3 tangent;
 } vs_out;
@@ -14,7 +16,10 @@ out VS_OUT {
 
 void main()
 {
-	vs_out.tangent = normalize(vec3(normal_model_to_world * vec4(tangent, 0.0)));
+	vec3 position = decode_position(vertex);
+	vec3 model_tangent = has_octahedral_normals ? decode_octahedral(tangent.xy) : tangent;
+
+	vs_out.tangent = normalize(vec3(normal_model_to_world * vec4(model_tangent, 0.0)));
 
-	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(vertex, 1.0);
+	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(position, 1.0);
 }
@@ -10,6 +10,8 @@ uniform sampler2D normals_texture;
 uniform sampler2D opacity_texture;
 uniform mat4 normal_model_to_world;
 
+#include "../common/material_constants.glsl"
+
 in VS_OUT {
 	vec3 normal;
 	vec2 texcoord;
@@ -38,5 +40,7 @@ void main()
 		geometry_specular = texture(specular_texture, fs_in.texcoord);
 
 	// Worldspace normal
+	// Compressed normal maps only store x and y, with z always read as 1;
+	// once x and y are remapped to [-1, 1], z is sqrt(1 - x² - y²).
 	geometry_normal.xyz = vec3(0.0);
 }
@@ -13,6 +13,8 @@ layout (std140) uniform CameraViewProjTransforms
 
 uniform mat4 vertex_model_to_world;
 
+#include "../common/vertex_decoding.glsl"
+
 layout (location = 0) in vec3 vertex;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec3 texcoord;
@@ -28,10 +30,18 @@ out VS_OUT {
 
 
 void main() {
-	vs_out.normal   = normalize(normal);
+	vec3 position = decode_position(vertex);
+
+	if (has_octahedral_normals) {
+		vs_out.normal   = decode_octahedral(normal.xy);
+		vs_out.tangent  = decode_octahedral(tangent.xy);
+		vs_out.binormal = tangent.z * cross(vs_out.normal, vs_out.tangent);
+	} else {
+		vs_out.normal   = normalize(normal);
+		vs_out.tangent  = normalize(tangent);
+		vs_out.binormal = normalize(binormal);
+	}
 	vs_out.texcoord = texcoord.xy;
-	vs_out.tangent  = normalize(tangent);
-	vs_out.binormal = normalize(binormal);
 
-	gl_Position = camera.view_projection * vertex_model_to_world * vec4(vertex, 1.0);
+	gl_Position = camera.view_projection * vertex_model_to_world * vec4(position, 1.0);
 }
@@ -14,6 +14,8 @@ layout (std140) uniform LightViewProjTransforms
 uniform int light_index;
 uniform mat4 vertex_model_to_world;
 
+#include "../common/vertex_decoding.glsl"
+
 layout (location = 0) in vec3 vertex;
 layout (location = 2) in vec3 texcoord;
 
@@ -23,7 +25,9 @@ out VS_OUT {
 
 void main()
 {
+	vec3 position = decode_position(vertex);
+
 	vs_out.texcoord = texcoord.xy;
 
-	gl_Position = lights[light_index].view_projection * vertex_model_to_world * vec4(vertex, 1.0);
+	gl_Position = lights[light_index].view_projection * vertex_model_to_world * vec4(position, 1.0);
 }
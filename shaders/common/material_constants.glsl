@@ -0,0 +1,10 @@
+// Constants of the material being drawn, bound by
+// `bonobo::bindMaterialConstants()`.
+// Must match bonobo::material_constants_block, in src/core/helpers.hpp.
+// As it is std140, the block stays active even if no member is read.
+layout (std140) uniform MaterialConstants {
+	vec3 diffuse_colour;  float shininess_value;
+	vec3 specular_colour; float index_of_refraction_value;
+	vec3 ambient_colour;  float opacity_value;
+	vec3 emissive_colour;
+};
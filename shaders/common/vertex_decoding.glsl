@@ -0,0 +1,24 @@
+// Uniforms and functions shared by the vertex shaders of meshes loaded
+// through `bonobo::loadObjects()`, whose attributes may be compressed;
+// include this file after the #version line.
+
+// Quantised positions are normalised within the bounding box of the mesh.
+uniform bool has_quantised_positions;
+uniform vec3 vertex_dequantisation_scale;
+uniform vec3 vertex_dequantisation_offset;
+// Octahedral-encoded normals and tangents; binormals are then given by the
+// sign stored in the third component of the tangents.
+uniform bool has_octahedral_normals;
+
+vec3 decode_position(vec3 v)
+{
+	return has_quantised_positions ? vertex_dequantisation_offset + vertex_dequantisation_scale * v : v;
+}
+
+vec3 decode_octahedral(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
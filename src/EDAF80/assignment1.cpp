@@ -142,17 +142,17 @@ int main()
 	//
 	// Load all textures.
 	//
-	GLuint const sun_texture = bonobo::loadTexture2D(config::resources_path("planets/2k_sun.jpg"));
-	GLuint const mercury_texture = bonobo::loadTexture2D(config::resources_path("planets/2k_mercury.jpg"));
-	GLuint const venus_texture = bonobo::loadTexture2D(config::resources_path("planets/2k_venus_atmosphere.jpg"));
-	GLuint const earth_texture = bonobo::loadTexture2D(config::resources_path("planets/2k_earth_daymap.jpg"));
-	GLuint const moon_texture = bonobo::loadTexture2D(config::resources_path("planets/2k_moon.jpg"));
-	GLuint const mars_texture = bonobo::loadTexture2D(config::resources_path("planets/2k_mars.jpg"));
-	GLuint const jupiter_texture = bonobo::loadTexture2D(config::resources_path("planets/2k_jupiter.jpg"));
-	GLuint const saturn_texture = bonobo::loadTexture2D(config::resources_path("planets/2k_saturn.jpg"));
-	GLuint const saturn_ring_texture = bonobo::loadTexture2D(config::resources_path("planets/2k_saturn_ring_alpha.png"));
-	GLuint const uranus_texture = bonobo::loadTexture2D(config::resources_path("planets/2k_uranus.jpg"));
-	GLuint const neptune_texture = bonobo::loadTexture2D(config::resources_path("planets/2k_neptune.jpg"));
+	GLuint const sun_texture = bonobo::acquireTexture2D(config::resources_path("planets/2k_sun.jpg"));
+	GLuint const mercury_texture = bonobo::acquireTexture2D(config::resources_path("planets/2k_mercury.jpg"));
+	GLuint const venus_texture = bonobo::acquireTexture2D(config::resources_path("planets/2k_venus_atmosphere.jpg"));
+	GLuint const earth_texture = bonobo::acquireTexture2D(config::resources_path("planets/2k_earth_daymap.jpg"));
+	GLuint const moon_texture = bonobo::acquireTexture2D(config::resources_path("planets/2k_moon.jpg"));
+	GLuint const mars_texture = bonobo::acquireTexture2D(config::resources_path("planets/2k_mars.jpg"));
+	GLuint const jupiter_texture = bonobo::acquireTexture2D(config::resources_path("planets/2k_jupiter.jpg"));
+	GLuint const saturn_texture = bonobo::acquireTexture2D(config::resources_path("planets/2k_saturn.jpg"));
+	GLuint const saturn_ring_texture = bonobo::acquireTexture2D(config::resources_path("planets/2k_saturn_ring_alpha.png"));
+	GLuint const uranus_texture = bonobo::acquireTexture2D(config::resources_path("planets/2k_uranus.jpg"));
+	GLuint const neptune_texture = bonobo::acquireTexture2D(config::resources_path("planets/2k_neptune.jpg"));
 
 
 	//
@@ -281,17 +281,17 @@ int main()
 		glfwSwapBuffers(window);
 	}
 
-	glDeleteTextures(1, &neptune_texture);
-	glDeleteTextures(1, &uranus_texture);
-	glDeleteTextures(1, &saturn_ring_texture);
-	glDeleteTextures(1, &saturn_texture);
-	glDeleteTextures(1, &jupiter_texture);
-	glDeleteTextures(1, &mars_texture);
-	glDeleteTextures(1, &moon_texture);
-	glDeleteTextures(1, &earth_texture);
-	glDeleteTextures(1, &venus_texture);
-	glDeleteTextures(1, &mars_texture);
-	glDeleteTextures(1, &sun_texture);
+	bonobo::releaseTexture(neptune_texture);
+	bonobo::releaseTexture(uranus_texture);
+	bonobo::releaseTexture(saturn_ring_texture);
+	bonobo::releaseTexture(saturn_texture);
+	bonobo::releaseTexture(jupiter_texture);
+	bonobo::releaseTexture(mars_texture);
+	bonobo::releaseTexture(moon_texture);
+	bonobo::releaseTexture(earth_texture);
+	bonobo::releaseTexture(venus_texture);
+	bonobo::releaseTexture(mercury_texture);
+	bonobo::releaseTexture(sun_texture);
 
 	bonobo::deinit();
 
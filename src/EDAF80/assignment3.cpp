@@ -4,8 +4,11 @@
 
 #include "config.hpp"
 #include "core/Bonobo.h"
+#include "core/culling.hpp"
+#include "core/FlatSceneGraph.hpp"
 #include "core/FPSCamera.h"
 #include "core/node.hpp"
+#include "core/RenderQueue.hpp"
 #include "core/ShaderProgramManager.hpp"
 
 #include <imgui.h>
@@ -127,6 +130,13 @@ edaf80::Assignment3::run()
 	demo_sphere.set_material_constants(demo_material);
 	demo_sphere.set_program(&fallback_shader, phong_set_uniforms);
 
+	// The nodes keep their own transforms, which the graph copies in every
+	// frame, only recomputing the matrices of those which moved.
+	FlatSceneGraph scene_graph;
+	scene_graph.AddHierarchy(skybox);
+	scene_graph.AddHierarchy(demo_sphere);
+	RenderQueue render_queue;
+
 
 	glClearDepthf(1.0f);
 	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -199,8 +209,12 @@ edaf80::Assignment3::run()
 		bonobo::changePolygonMode(polygon_mode);
 
 
-		skybox.render(mCamera.GetWorldToClipMatrix());
-		demo_sphere.render(mCamera.GetWorldToClipMatrix());
+		bonobo::culling::resetStatistics();
+		GLStateTracker::GetShared().ResetStats();
+		scene_graph.SyncFromNodes();
+		scene_graph.UpdateTransforms();
+		scene_graph.Submit(render_queue, mCamera.GetWorldToClipMatrix());
+		render_queue.Flush();
 
 
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
@@ -238,8 +252,13 @@ edaf80::Assignment3::run()
 			bonobo::renderBasis(basis_thickness_scale, basis_length_scale, mCamera.GetWorldToClipMatrix());
 
 		opened = ImGui::Begin("Render Time", nullptr, ImGuiWindowFlags_None);
-		if (opened)
+		if (opened) {
 			ImGui::Text("%.3f ms", std::chrono::duration<float, std::milli>(deltaTimeUs).count());
+			auto const& culling_statistics = bonobo::culling::getStatistics();
+			ImGui::Text("Nodes drawn: %zu, culled: %zu", culling_statistics.visible_nb, culling_statistics.culled_nb);
+			auto const& gl_state_stats = GLStateTracker::GetShared().GetStats();
+			ImGui::Text("Draw calls: %u, state changes: %u", gl_state_stats.draw_calls_nb, gl_state_stats.GetStateChangesNb());
+		}
 		ImGui::End();
 
 		if (show_logs)
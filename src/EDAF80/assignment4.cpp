@@ -68,6 +68,10 @@ edaf80::Assignment4::run()
 	//
 	// Todo: Load your geometry
 	//
+	// Nodes are culled against their undisplaced geometry: give the water
+	// node a bounds margin matching the wave amplitudes, see
+	// `Node::set_bounds_margin()`, or disable its culling.
+	//
 
 	glClearDepthf(1.0f);
 	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
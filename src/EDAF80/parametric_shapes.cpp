@@ -1,7 +1,9 @@
 #include "parametric_shapes.hpp"
 #include "core/Log.h"
+#include "core/mesh_optimisation.hpp"
 
 #include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <array>
 #include <cassert>
@@ -114,6 +116,12 @@ parametric_shapes::createQuad(float const width, float const height,
 
 	data.indices_nb = /*! \todo how many indices do we have? */0u;
 
+	// Bounds used for culling the quad.
+	data.bounds_min = vertices[0];
+	data.bounds_max = vertices[2];
+	data.bounds_centre = 0.5f * (data.bounds_min + data.bounds_max);
+	data.bounds_radius = 0.5f * glm::length(data.bounds_max - data.bounds_min);
+
 	// All the data has been recorded, we can unbind them.
 	glBindVertexArray(0u);
 	glBindBuffer(GL_ARRAY_BUFFER, 0u);
@@ -146,7 +154,9 @@ bonobo::mesh_data
 parametric_shapes::createCircleRing(float const radius,
                                     float const spread_length,
                                     unsigned int const circle_split_count,
-                                    unsigned int const spread_split_count)
+                                    unsigned int const spread_split_count,
+                                    bonobo::vertex_layout_options const& vertex_layout,
+                                    bonobo::mesh_processing_options const& processing)
 {
 	auto const circle_slice_edges_count = circle_split_count + 1u;
 	auto const spread_slice_edges_count = spread_split_count + 1u;
@@ -223,59 +233,54 @@ parametric_shapes::createCircleRing(float const radius,
 		}
 	}
 
+	bonobo::mesh_streams streams;
+	streams.name = "Circle ring";
+	streams.vertices_nb = static_cast<std::uint32_t>(vertices_nb);
+	streams.indices_nb = static_cast<std::uint32_t>(index_sets.size() * 3u);
+	streams.vertices = glm::value_ptr(vertices.front());
+	streams.normals = glm::value_ptr(normals.front());
+	streams.texcoords = glm::value_ptr(texcoords.front());
+	streams.tangents = glm::value_ptr(tangents.front());
+	streams.binormals = glm::value_ptr(binormals.front());
+	streams.indices = glm::value_ptr(index_sets.front());
+
+	std::vector<std::vector<std::uint8_t>> processed_data;
+	bonobo::mesh_optimisation::vertex_weld_statistics weld_statistics;
+	if (bonobo::mesh_optimisation::weldVertices(streams, processed_data, processing, weld_statistics))
+		LogTrivia("Welded circle ring vertices: %zu → %zu vertices, %zu → %zu bytes",
+		          weld_statistics.vertices_nb_before, weld_statistics.vertices_nb_after,
+		          weld_statistics.bytes_before, weld_statistics.bytes_after);
+	bonobo::mesh_optimisation::vertex_cache_statistics cache_before, cache_after;
+	if (bonobo::mesh_optimisation::optimiseMesh(streams, processed_data, processing, cache_before, cache_after))
+		LogTrivia("Optimised circle ring: ACMR %.3f → %.3f, ATVR %.3f → %.3f",
+		          cache_before.acmr, cache_after.acmr, cache_before.atvr, cache_after.atvr);
+
 	bonobo::mesh_data data;
 	glGenVertexArrays(1, &data.vao);
 	assert(data.vao != 0u);
 	glBindVertexArray(data.vao);
 
-	auto const vertices_offset = 0u;
-	auto const vertices_size = static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3));
-	auto const normals_offset = vertices_size;
-	auto const normals_size = static_cast<GLsizeiptr>(normals.size() * sizeof(glm::vec3));
-	auto const texcoords_offset = normals_offset + normals_size;
-	auto const texcoords_size = static_cast<GLsizeiptr>(texcoords.size() * sizeof(glm::vec3));
-	auto const tangents_offset = texcoords_offset + texcoords_size;
-	auto const tangents_size = static_cast<GLsizeiptr>(tangents.size() * sizeof(glm::vec3));
-	auto const binormals_offset = tangents_offset + tangents_size;
-	auto const binormals_size = static_cast<GLsizeiptr>(binormals.size() * sizeof(glm::vec3));
-	auto const bo_size = static_cast<GLsizeiptr>(vertices_size
-	                                            +normals_size
-	                                            +texcoords_size
-	                                            +tangents_size
-	                                            +binormals_size
-	                                            );
+	auto const layout = bonobo::describeVertexLayout(vertex_layout, streams);
+
 	glGenBuffers(1, &data.bo);
 	assert(data.bo != 0u);
 	glBindBuffer(GL_ARRAY_BUFFER, data.bo);
-	glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
-
-	glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const*>(vertices.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
-
-	glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const*>(normals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const*>(texcoords.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const*>(tangents.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const*>(binormals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
+	bonobo::uploadVertices(layout, streams);
+	bonobo::setupVertexAttributes(layout);
+	data.encoding = bonobo::getVertexEncoding(layout, streams);
+	bonobo::computeMeshBounds(streams, data);
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0u);
 
-	data.indices_nb = static_cast<GLsizei>(index_sets.size() * 3u);
+	data.vertices_nb = static_cast<GLsizei>(streams.vertices_nb);
+	data.indices_nb = static_cast<GLsizei>(streams.indices_nb);
+	data.index_type = bonobo::getIndexType(streams.vertices_nb);
+	auto packed_indices = std::vector<std::uint8_t>(streams.indices_nb * bonobo::getIndexSize(data.index_type));
+	bonobo::packIndices(streams.indices, streams.indices_nb, data.index_type, packed_indices.data());
 	glGenBuffers(1, &data.ibo);
 	assert(data.ibo != 0u);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(index_sets.size() * sizeof(glm::uvec3)), reinterpret_cast<GLvoid const*>(index_sets.data()), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(packed_indices.size()), reinterpret_cast<GLvoid const*>(packed_indices.data()), GL_STATIC_DRAW);
 
 	glBindVertexArray(0u);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
@@ -93,10 +93,17 @@ namespace parametric_shapes
 	//!                           single edge spanning the full spread,
 	//!                           with 1 you get two edges (each spanning
 	//!                           half the spread).
+	//! @param vertex_layout how to arrange the vertex attributes in the
+	//!                      buffer object.
+	//! @param processing welding and optimisations to run on the
+	//!                   generated vertices, for example to merge the
+	//!                   vertices duplicated along the seam.
 	//! @return wrapper around OpenGL objects' name containing the geometry
 	//!         data
 	bonobo::mesh_data createCircleRing(float const radius,
 	                                   float const spread_length,
 	                                   unsigned int const circle_split_count,
-	                                   unsigned int const spread_split_count);
+	                                   unsigned int const spread_split_count,
+	                                   bonobo::vertex_layout_options const& vertex_layout = bonobo::vertex_layout_options(),
+	                                   bonobo::mesh_processing_options const& processing = bonobo::mesh_processing_options());
 }
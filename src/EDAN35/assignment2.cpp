@@ -6,11 +6,17 @@
 
 #include "config.hpp"
 #include "core/Bonobo.h"
+#include "core/culling.hpp"
+#include "core/FlatSceneGraph.hpp"
 #include "core/FPSCamera.h"
 #include "core/helpers.hpp"
+#include "core/mipmaps.hpp"
 #include "core/node.hpp"
 #include "core/opengl.hpp"
+#include "core/RenderQueue.hpp"
 #include "core/ShaderProgramManager.hpp"
+#include "core/ThreadPool.hpp"
+#include "core/various.hpp"
 
 #include <imgui.h>
 #include <glm/glm.hpp>
@@ -18,9 +24,14 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <tinyfiledialogs.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <clocale>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
 #include <stdexcept>
 
 namespace constant
@@ -33,6 +44,18 @@ namespace constant
 	constexpr size_t lights_nb           = 4;
 	constexpr float  light_intensity     = 72.0f * (scale_lengths * scale_lengths);
 	constexpr float  light_angle_falloff = glm::radians(37.0f);
+
+	constexpr uint32_t benchmark_warmup_frames_nb   = 8;
+	constexpr uint32_t benchmark_measured_frames_nb = 128;
+
+	constexpr uint32_t mipmap_benchmark_size           = 2048;
+	constexpr uint32_t mipmap_benchmark_repetitions_nb = 4;
+
+	constexpr uint32_t scene_import_benchmark_repetitions_nb = 3;
+
+	constexpr size_t   scene_graph_benchmark_nodes_nb       = 100000;
+	constexpr float    scene_graph_benchmark_moving_ratio   = 0.01f;
+	constexpr uint32_t scene_graph_benchmark_repetitions_nb = 8;
 }
 
 namespace
@@ -103,14 +126,6 @@ namespace
 		glm::mat4 view_projection_inverse = glm::mat4(1.0f);
 	};
 
-	struct GeometryTextureData
-	{
-		GLuint diffuse_texture_id{ 0u };
-		GLuint specular_texture_id{ 0u };
-		GLuint normals_texture_id{ 0u };
-		GLuint opacity_texture_id{ 0u };
-	};
-
 	struct GBufferShaderLocations
 	{
 		GLuint ubo_CameraViewProjTransforms{ 0u };
@@ -124,6 +139,11 @@ namespace
 		GLuint has_specular_texture{ 0u };
 		GLuint has_normals_texture{ 0u };
 		GLuint has_opacity_texture{ 0u };
+		GLuint has_quantised_positions{ 0u };
+		GLuint vertex_dequantisation_scale{ 0u };
+		GLuint vertex_dequantisation_offset{ 0u };
+		GLuint has_octahedral_normals{ 0u };
+		GLuint ubo_MaterialConstants{ 0u };
 	};
 	void fillGBufferShaderLocations(GLuint gbuffer_shader, GBufferShaderLocations& locations);
 
@@ -134,6 +154,9 @@ namespace
 		GLuint vertex_model_to_world{ 0u };
 		GLuint opacity_texture{ 0u };
 		GLuint has_opacity_texture{ 0u };
+		GLuint has_quantised_positions{ 0u };
+		GLuint vertex_dequantisation_scale{ 0u };
+		GLuint vertex_dequantisation_offset{ 0u };
 	};
 	void fillShadowmapShaderLocations(GLuint shadowmap_shader, FillShadowmapShaderLocations& locations);
 
@@ -159,6 +182,128 @@ namespace
 	void fillAccumulateLightsShaderLocations(GLuint accumulate_lights_shader, AccumulateLightsShaderLocations& locations);
 
 	bonobo::mesh_data loadCone();
+
+	struct VertexLayout
+	{
+		char const* name;
+		bonobo::vertex_layout_options options;
+	};
+	constexpr std::size_t vertex_layouts_nb = 5;
+	std::array<VertexLayout, vertex_layouts_nb> const vertex_layouts = {
+		VertexLayout{ "Planar",                                 { bonobo::vertex_layout_t::planar,      bonobo::all_vertex_attributes, 3, 0, false, false } },
+		VertexLayout{ "Interleaved",                            { bonobo::vertex_layout_t::interleaved, bonobo::all_vertex_attributes, 3, 0, false, false } },
+		VertexLayout{ "Interleaved, vec2 tex. coords",          { bonobo::vertex_layout_t::interleaved, bonobo::all_vertex_attributes, 2, 0, false, false } },
+		VertexLayout{ "Interleaved, quantised",                 { bonobo::vertex_layout_t::interleaved, bonobo::all_vertex_attributes, 2, 0, true,  false } },
+		VertexLayout{ "Interleaved, quantised incl. positions", { bonobo::vertex_layout_t::interleaved, bonobo::all_vertex_attributes, 2, 0, true,  true  } }
+	};
+
+	// Sponza is drawn many times per frame (G-buffer and shadow maps), so its
+	// meshes are welded, as its OBJ file is not indexed, and optimised for
+	// the vertex cache when first imported.
+	bonobo::mesh_processing_options const sponza_processing = [](){
+		bonobo::mesh_processing_options options;
+		options.weld_vertices = true;
+		options.optimise_vertex_cache = true;
+		options.optimise_overdraw = true;
+		options.optimise_vertex_fetch = true;
+		return options;
+	}();
+
+	//! \brief Render the G-buffer pass with each vertex layout in turn, and
+	//!        record its average GPU time, alongside the size of the vertex
+	//!        buffer.
+	struct VertexLayoutBenchmark
+	{
+		bool is_running{ false };
+		std::size_t layout_index{ 0u };
+		uint32_t frames_nb{ 0u };
+		GLuint64 accumulated_gbuffer_time{ 0u };
+		std::array<float, vertex_layouts_nb> gbuffer_durations_ms{}; // Negative until measured
+		std::array<float, vertex_layouts_nb> vertex_buffer_sizes_mib{}; // Negative until loaded
+	};
+
+	//! \brief Generate and upload the mipmap hierarchy of a colour image,
+	//!        once via `glGenerateMipmap()` and once on the CPU with each
+	//!        filter of `bonobo::mipmaps`, and return the throughput of each,
+	//!        in millions of texels of the first level per second.
+	//!
+	//! The driver filters colours as they are stored, whereas the CPU path
+	//! filters them in linear space.
+	std::array<float, 4> runMipmapBenchmark()
+	{
+		std::vector<std::uint8_t> texels(static_cast<std::size_t>(constant::mipmap_benchmark_size) * constant::mipmap_benchmark_size * 4u);
+		std::minstd_rand random_engine;
+		std::uniform_int_distribution<int> distribution(0, 255);
+		for (auto& texel : texels)
+			texel = static_cast<std::uint8_t>(distribution(random_engine));
+
+		ThreadPool workers;
+		GLuint texture = 0u;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+
+		auto const measure = [](std::function<void ()> const& generate_and_upload){
+			glFinish();
+			auto const start_time = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < constant::mipmap_benchmark_repetitions_nb; ++i)
+				generate_and_upload();
+			glFinish();
+			auto const end_time = std::chrono::high_resolution_clock::now();
+
+			auto const texels_nb = static_cast<float>(constant::mipmap_benchmark_size) * static_cast<float>(constant::mipmap_benchmark_size)
+			                     * static_cast<float>(constant::mipmap_benchmark_repetitions_nb);
+			return texels_nb / (1.0e6f * std::chrono::duration<float>(end_time - start_time).count());
+		};
+
+		std::array<float, 4> throughputs;
+		throughputs[0] = measure([&texels](){
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+			             static_cast<GLsizei>(constant::mipmap_benchmark_size), static_cast<GLsizei>(constant::mipmap_benchmark_size), 0,
+			             GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+			glGenerateMipmap(GL_TEXTURE_2D);
+		});
+		LogInfo("Mipmap generation via the driver: %.1f Mtexels/s", throughputs[0]);
+		for (auto const filter : { bonobo::mipmaps::filter_t::box, bonobo::mipmaps::filter_t::kaiser, bonobo::mipmaps::filter_t::lanczos }) {
+			auto& throughput = throughputs[static_cast<std::size_t>(filter) + 1u];
+			throughput = measure([&texels, &workers, filter](){
+				utils::byte_buffer source(texels.size());
+				std::memcpy(source.data(), texels.data(), texels.size());
+				auto const levels = bonobo::mipmaps::generate(std::move(source), constant::mipmap_benchmark_size, constant::mipmap_benchmark_size,
+				                                              filter, bonobo::mipmaps::content_t::colour, &workers);
+				bonobo::mipmaps::upload(GL_TEXTURE_2D, levels);
+			});
+			LogInfo("Mipmap generation on %zu threads with a %s filter: %.1f Mtexels/s",
+			        workers.GetThreadsNb(), bonobo::mipmaps::getFilterName(filter), throughput);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0u);
+		glDeleteTextures(1, &texture);
+
+		return throughputs;
+	}
+
+	//! \brief Import Sponza with assimp and with the native OBJ loader,
+	//!        keeping the fastest of a few imports for each.
+	std::array<bonobo::scene_import_stats, 2> runSceneImportBenchmark()
+	{
+		std::array<bonobo::scene_import_stats, 2> results;
+		for (auto const importer : { bonobo::scene_importer_t::assimp, bonobo::scene_importer_t::native_obj }) {
+			auto& result = results[static_cast<std::size_t>(importer)];
+			for (uint32_t i = 0; i < constant::scene_import_benchmark_repetitions_nb; ++i) {
+				auto const stats = bonobo::benchmarkSceneImport(config::resources_path("sponza/sponza.obj"), importer);
+				if (!stats.is_successful)
+					break;
+				if (!result.is_successful || stats.duration_ms < result.duration_ms)
+					result = stats;
+			}
+			if (result.is_successful)
+				LogInfo("Sponza imported via %s in %.3f ms: %zu meshes, %zu vertices, %zu indices",
+				        importer == bonobo::scene_importer_t::assimp ? "assimp" : "the native OBJ loader",
+				        result.duration_ms, result.meshes_nb, result.vertices_nb, result.indices_nb);
+		}
+
+		return results;
+	}
 } // namespace
 
 edan35::Assignment2::Assignment2(WindowManager& windowManager) :
@@ -185,39 +330,59 @@ edan35::Assignment2::~Assignment2()
 void
 edan35::Assignment2::run()
 {
-	// Load the geometry of Sponza
-	auto const sponza_geometry = bonobo::loadObjects(config::resources_path("sponza/sponza.obj"));
-	if (sponza_geometry.empty()) {
-		LogError("Failed to load the Sponza model");
-		return;
-	}
-	std::vector<GeometryTextureData> sponza_geometry_texture_data;
-	sponza_geometry_texture_data.reserve(sponza_geometry.size());
-	for (auto const& geometry : sponza_geometry) {
-		auto const diffuse_texture = geometry.bindings.find("diffuse_texture");
-		auto const specular_texture = geometry.bindings.find("specular_texture");
-		auto const normals_texture = geometry.bindings.find("normals_texture");
-		auto const opacity_texture = geometry.bindings.find("opacity_texture");
-
-		GeometryTextureData data;
-		if (diffuse_texture != geometry.bindings.end())
-		{
-			data.diffuse_texture_id = diffuse_texture->second;
-		}
-		if (specular_texture != geometry.bindings.end())
-		{
-			data.specular_texture_id = specular_texture->second;
-		}
-		if (normals_texture != geometry.bindings.end())
-		{
-			data.normals_texture_id = normals_texture->second;
-		}
-		if (opacity_texture != geometry.bindings.end())
-		{
-			data.opacity_texture_id = opacity_texture->second;
+	// Stream the geometry of Sponza in, so that the first frames show up
+	// without waiting for it.
+	int vertex_layout_index = 0;
+	std::shared_ptr<bonobo::async_objects> sponza;
+	std::size_t sponza_layout_index = 0u;
+	bonobo::culling::box_set sponza_bounding_boxes;
+	std::vector<RenderQueue::Packet> sponza_packets, sponza_packets_scratch;
+	bonobo::upload_budget sponza_upload_budget;
+	bool compress_sponza_textures = true;
+	auto sponza_texture_streaming = bonobo::getTextureStreamingOptions();
+	VertexLayoutBenchmark vertex_layout_benchmark;
+	vertex_layout_benchmark.gbuffer_durations_ms.fill(-1.0f);
+	vertex_layout_benchmark.vertex_buffer_sizes_mib.fill(-1.0f);
+	std::array<float, 4> mipmap_throughputs;
+	mipmap_throughputs.fill(-1.0f);
+	std::array<bonobo::scene_import_stats, 2> scene_import_results;
+	bonobo::scene_graph_benchmark_stats scene_graph_results;
+	auto const load_sponza = [&sponza, &sponza_layout_index, &sponza_bounding_boxes, &compress_sponza_textures](std::size_t layout_index){
+		// Release the previous version first, rather than keeping both in
+		// memory while the new one streams in.
+		sponza.reset();
+		bonobo::culling::clear(sponza_bounding_boxes);
+		sponza = bonobo::loadObjectsAsync(config::resources_path("sponza/sponza.obj"), vertex_layouts[layout_index].options,
+		                                  sponza_processing, compress_sponza_textures);
+		sponza_layout_index = layout_index;
+	};
+	// Gather the bounding boxes of the meshes, in the same order as the
+	// meshes: Sponza is drawn untransformed, so they are already in world
+	// space.
+	auto const update_sponza_bounds = [&sponza_bounding_boxes](std::vector<bonobo::mesh_data> const& sponza_geometry){
+		bonobo::culling::clear(sponza_bounding_boxes);
+		for (auto const& geometry : sponza_geometry)
+			bonobo::culling::addBox(sponza_bounding_boxes, geometry);
+	};
+	// Sort the meshes left visible by the last culling by program, then
+	// material and vertex array, and front to back last, so that textures
+	// only get rebound when the material changes.
+	auto const sort_sponza_draws = [&sponza_packets, &sponza_packets_scratch](std::vector<bonobo::mesh_data> const& sponza_geometry,
+	                                                                          std::vector<std::uint8_t> const& visibility,
+	                                                                          GLuint program, glm::mat4 const& world_to_clip){
+		sponza_packets.clear();
+		for (std::size_t i = 0u; i < visibility.size(); ++i) {
+			if (visibility[i] == 0u)
+				continue;
+
+			auto const& geometry = sponza_geometry[i];
+			auto const depth = RenderQueue::GetDepth(world_to_clip, geometry.bounds_centre);
+			sponza_packets.push_back({ RenderQueue::MakeKey(0u, program, geometry.material, geometry.vao, depth),
+			                           static_cast<std::uint32_t>(i) });
 		}
-		sponza_geometry_texture_data.emplace_back(std::move(data));
-	}
+		RenderQueue::SortPackets(sponza_packets, sponza_packets_scratch);
+	};
+	load_sponza(static_cast<std::size_t>(vertex_layout_index));
 
 	auto const cone_geometry = loadCone();
 	Node cone;
@@ -377,6 +542,10 @@ edan35::Assignment2::run()
 	bool copy_elapsed_times = true;
 	bool first_frame = true;
 	bool show_basis = false;
+	std::vector<std::uint8_t> sponza_visibility;
+	std::size_t gbuffer_visible_nb = 0u;
+	std::array<std::size_t, constant::lights_nb> shadowmap_visible_nbs;
+	shadowmap_visible_nbs.fill(0u);
 	float basis_thickness_scale = 40.0f;
 	float basis_length_scale = 400.0f;
 
@@ -422,13 +591,57 @@ edan35::Assignment2::run()
 
 		mWindowManager.NewImGuiFrame();
 
-		if (!first_frame && show_gui && copy_elapsed_times) {
+		if (!first_frame && ((show_gui && copy_elapsed_times) || vertex_layout_benchmark.is_running)) {
 			// Copy all timings back from the GPU to the CPU.
 			for (GLuint i = 0; i < pass_elapsed_times.size(); ++i) {
 				glGetQueryObjectui64v(elapsed_time_queries[i], GL_QUERY_RESULT, pass_elapsed_times.data() + i);
 			}
 		}
 
+		if (!first_frame && vertex_layout_benchmark.is_running && bonobo::getObjectsAsyncProgress(*sponza).is_complete) {
+			// The first frames after switching layout still report timings
+			// from the previous one, and let the driver settle.
+			auto& benchmark = vertex_layout_benchmark;
+			if (benchmark.frames_nb >= constant::benchmark_warmup_frames_nb)
+				benchmark.accumulated_gbuffer_time += pass_elapsed_times[toU(ElapsedTimeQuery::GbufferGeneration)];
+
+			if (++benchmark.frames_nb == constant::benchmark_warmup_frames_nb + constant::benchmark_measured_frames_nb) {
+				auto const duration_ms = static_cast<float>(benchmark.accumulated_gbuffer_time) / (1000000.0f * static_cast<float>(constant::benchmark_measured_frames_nb));
+				benchmark.gbuffer_durations_ms[benchmark.layout_index] = duration_ms;
+				LogInfo("G-buffer pass with the \"%s\" vertex layout: %.3f ms on average over %u frames",
+				        vertex_layouts[benchmark.layout_index].name, duration_ms, constant::benchmark_measured_frames_nb);
+
+				benchmark.frames_nb = 0u;
+				benchmark.accumulated_gbuffer_time = 0u;
+				if (++benchmark.layout_index == vertex_layouts.size()) {
+					benchmark.is_running = false;
+					load_sponza(static_cast<std::size_t>(vertex_layout_index));
+				} else {
+					load_sponza(benchmark.layout_index);
+				}
+			}
+		}
+
+		if (bonobo::updateObjectsAsync(*sponza, sponza_upload_budget))
+			update_sponza_bounds(bonobo::getObjectsAsync(*sponza));
+		auto const& sponza_geometry = bonobo::getObjectsAsync(*sponza);
+		auto const sponza_progress = bonobo::getObjectsAsyncProgress(*sponza);
+
+		// All meshes share the vertex buffer of the geometry arena.
+		if (vertex_layout_benchmark.vertex_buffer_sizes_mib[sponza_layout_index] < 0.0f && !sponza_geometry.empty()) {
+			GLint vertex_buffer_size = 0;
+			glBindBuffer(GL_ARRAY_BUFFER, sponza_geometry.front().bo);
+			glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &vertex_buffer_size);
+			glBindBuffer(GL_ARRAY_BUFFER, 0u);
+			vertex_layout_benchmark.vertex_buffer_sizes_mib[sponza_layout_index] = static_cast<float>(vertex_buffer_size) / (1024.0f * 1024.0f);
+		}
+
+		// Sponza is drawn untransformed, so its model-to-clip transform is
+		// the camera's world-to-clip one.
+		for (auto const& geometry : sponza_geometry)
+			bonobo::requestTextureLevels(geometry, camera_view_proj_transforms.view_projection, static_cast<float>(framebuffer_height));
+		bonobo::updateTextureStreaming(sponza_upload_budget);
+
 
 		for (size_t i = 0; i < static_cast<size_t>(lights_nb); ++i) {
 			auto& lightTransform = lightTransforms[i];
@@ -453,6 +666,7 @@ edan35::Assignment2::run()
 		glBindBuffer(GL_UNIFORM_BUFFER, 0u);
 
 
+		GLStateTracker::GetShared().ResetStats();
 		if (!shader_reload_failed) {
 			//
 			// Pass 1: Render scene into the g-buffer
@@ -465,59 +679,75 @@ edan35::Assignment2::run()
 			glClear(GL_DEPTH_BUFFER_BIT);
 			// XXX: Is any other clearing needed?
 
-			glUseProgram(fill_gbuffer_shader);
+			auto& gl_state = GLStateTracker::GetShared();
+			gl_state.Invalidate();
+			gl_state.UseProgram(fill_gbuffer_shader);
 			glUniform1i(fill_gbuffer_shader_locations.diffuse_texture, 0);
 			glUniform1i(fill_gbuffer_shader_locations.specular_texture, 1);
 			glUniform1i(fill_gbuffer_shader_locations.normals_texture, 2);
 			glUniform1i(fill_gbuffer_shader_locations.opacity_texture, 3);
-			for (std::size_t i = 0; i < sponza_geometry.size(); ++i)
+			std::array<GLuint, bonobo::material_texture_slots_nb> const has_texture_locations = {
+				fill_gbuffer_shader_locations.has_diffuse_texture,
+				fill_gbuffer_shader_locations.has_specular_texture,
+				fill_gbuffer_shader_locations.has_normals_texture,
+				fill_gbuffer_shader_locations.has_opacity_texture
+			};
+			auto const& material_table = bonobo::getMaterialTable();
+			bool is_material_bound = false;
+			bonobo::material_id bound_material = bonobo::invalid_material_id;
+			gbuffer_visible_nb = bonobo::culling::cullBoxes(bonobo::culling::extractFrustum(view_projection),
+			                                                sponza_bounding_boxes, sponza_visibility);
+			sort_sponza_draws(sponza_geometry, sponza_visibility, fill_gbuffer_shader, view_projection);
+
+			// All meshes are drawn untransformed.
+			auto const vertex_model_to_world = glm::mat4(1.0f);
+			auto const normal_model_to_world = glm::mat4(1.0f);
+			glUniformMatrix4fv(fill_gbuffer_shader_locations.vertex_model_to_world, 1, GL_FALSE, glm::value_ptr(vertex_model_to_world));
+			glUniformMatrix4fv(fill_gbuffer_shader_locations.normal_model_to_world, 1, GL_FALSE, glm::value_ptr(normal_model_to_world));
+			for (auto const& packet : sponza_packets)
 			{
-				auto const& geometry = sponza_geometry[i];
-				auto const& texture_data = sponza_geometry_texture_data[i];
+				auto const& geometry = sponza_geometry[packet.index];
 
 				utils::opengl::debug::beginDebugGroup(geometry.name);
 
-				auto const vertex_model_to_world = glm::mat4(1.0f);
-				auto const normal_model_to_world = glm::mat4(1.0f);
-
-				glUniformMatrix4fv(fill_gbuffer_shader_locations.vertex_model_to_world, 1, GL_FALSE, glm::value_ptr(vertex_model_to_world));
-				glUniformMatrix4fv(fill_gbuffer_shader_locations.normal_model_to_world, 1, GL_FALSE, glm::value_ptr(normal_model_to_world));
-
 				auto const default_sampler = samplers[toU(Sampler::Nearest)];
 				auto const mipmap_sampler = samplers[toU(Sampler::Mipmaps)];
 
-				glUniform1i(fill_gbuffer_shader_locations.has_diffuse_texture, texture_data.diffuse_texture_id != 0u ? 1 : 0);
-				glBindSampler(0u, texture_data.diffuse_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, texture_data.diffuse_texture_id != 0u ? texture_data.diffuse_texture_id : debug_texture_id);
-
-				glUniform1i(fill_gbuffer_shader_locations.has_specular_texture, texture_data.specular_texture_id != 0u ? 1 : 0);
-				glBindSampler(1u, texture_data.specular_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, texture_data.specular_texture_id != 0u ? texture_data.specular_texture_id : debug_texture_id);
-
-				glUniform1i(fill_gbuffer_shader_locations.has_normals_texture, texture_data.normals_texture_id != 0u ? 1 : 0);
-				glBindSampler(2u, texture_data.normals_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE2);
-				glBindTexture(GL_TEXTURE_2D, texture_data.normals_texture_id != 0u ? texture_data.normals_texture_id : debug_texture_id);
+				if (!is_material_bound || geometry.material != bound_material) {
+					std::array<GLuint, bonobo::material_texture_slots_nb> textures{};
+					if (geometry.material < material_table.materials.size()) {
+						textures = material_table.materials[geometry.material].textures;
+						gl_state.BindMaterialConstants(geometry.material);
+					} else {
+						gl_state.BindMaterialConstants(bonobo::material_data());
+					}
+					for (std::size_t slot = 0; slot < textures.size(); ++slot) {
+						glUniform1i(has_texture_locations[slot], textures[slot] != 0u ? 1 : 0);
+						gl_state.BindSampler(static_cast<GLuint>(slot), textures[slot] != 0u ? mipmap_sampler : default_sampler);
+						gl_state.BindTexture(static_cast<GLuint>(slot), GL_TEXTURE_2D, textures[slot] != 0u ? textures[slot] : debug_texture_id);
+					}
+					is_material_bound = true;
+					bound_material = geometry.material;
+				}
 
-				glUniform1i(fill_gbuffer_shader_locations.has_opacity_texture, texture_data.opacity_texture_id != 0u ? 1 : 0);
-				glBindSampler(3u, texture_data.opacity_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE3);
-				glBindTexture(GL_TEXTURE_2D, texture_data.opacity_texture_id != 0u ? texture_data.opacity_texture_id : debug_texture_id);
+				glUniform1i(fill_gbuffer_shader_locations.has_quantised_positions, geometry.encoding.has_quantised_positions ? 1 : 0);
+				glUniform3fv(fill_gbuffer_shader_locations.vertex_dequantisation_scale, 1, glm::value_ptr(geometry.encoding.dequantisation_scale));
+				glUniform3fv(fill_gbuffer_shader_locations.vertex_dequantisation_offset, 1, glm::value_ptr(geometry.encoding.dequantisation_offset));
+				glUniform1i(fill_gbuffer_shader_locations.has_octahedral_normals, geometry.encoding.has_octahedral_normals ? 1 : 0);
 
-				glBindVertexArray(geometry.vao);
+				// Meshes sharing a geometry arena do not need to rebind it.
+				gl_state.BindVertexArray(geometry.vao);
 				if (geometry.ibo != 0u)
-					glDrawElements(geometry.drawing_mode, geometry.indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
+					glDrawElementsBaseVertex(geometry.drawing_mode, geometry.indices_nb, geometry.index_type,
+					                         bonobo::getIndicesOffset(geometry), geometry.base_vertex);
 				else
-					glDrawArrays(geometry.drawing_mode, 0, geometry.vertices_nb);
+					glDrawArrays(geometry.drawing_mode, geometry.base_vertex, geometry.vertices_nb);
+				gl_state.CountDrawCall();
 
 
 				utils::opengl::debug::endDebugGroup();
 			}
-			glBindTexture(GL_TEXTURE_2D, 0);
-			glBindVertexArray(0u);
-			glUseProgram(0u);
+			gl_state.RestoreDefaults();
 
 			glEndQuery(GL_TIME_ELAPSED);
 			utils::opengl::debug::endDebugGroup();
@@ -546,36 +776,54 @@ edan35::Assignment2::run()
 				glViewport(0, 0, constant::shadowmap_res_x, constant::shadowmap_res_y);
 				// XXX: Is any clearing needed?
 
-				glUseProgram(fill_shadowmap_shader);
+				auto& gl_state = GLStateTracker::GetShared();
+				gl_state.Invalidate();
+				gl_state.UseProgram(fill_shadowmap_shader);
 				glUniform1i(fill_shadowmap_shader_locations.light_index, static_cast<int>(i));
 				glUniform1i(fill_shadowmap_shader_locations.opacity_texture, 0);
-				for (std::size_t i = 0; i < sponza_geometry.size(); ++i)
+				auto const& material_table = bonobo::getMaterialTable();
+				bool is_material_bound = false;
+				bonobo::material_id bound_material = bonobo::invalid_material_id;
+				shadowmap_visible_nbs[i] = bonobo::culling::cullBoxes(bonobo::culling::extractFrustum(light_world_to_clip_matrix),
+				                                                      sponza_bounding_boxes, sponza_visibility);
+				sort_sponza_draws(sponza_geometry, sponza_visibility, fill_shadowmap_shader, light_world_to_clip_matrix);
+
+				auto const vertex_model_to_world = glm::mat4(1.0f);
+				glUniformMatrix4fv(fill_shadowmap_shader_locations.vertex_model_to_world, 1, GL_FALSE, glm::value_ptr(vertex_model_to_world));
+				for (auto const& packet : sponza_packets)
 				{
-					auto const& geometry = sponza_geometry[i];
-					auto const& texture_data = sponza_geometry_texture_data[i];
+					auto const& geometry = sponza_geometry[packet.index];
 
 					utils::opengl::debug::beginDebugGroup(geometry.name);
 
-					auto const vertex_model_to_world = glm::mat4(1.0f);
-					glUniformMatrix4fv(fill_shadowmap_shader_locations.vertex_model_to_world, 1, GL_FALSE, glm::value_ptr(vertex_model_to_world));
-
-					glUniform1i(fill_shadowmap_shader_locations.has_opacity_texture, texture_data.opacity_texture_id != 0u ? 1 : 0);
-					glBindSampler(0u, texture_data.opacity_texture_id != 0u ? samplers[toU(Sampler::Mipmaps)] : samplers[toU(Sampler::Nearest)]);
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, texture_data.opacity_texture_id != 0u ? texture_data.opacity_texture_id : debug_texture_id);
-
-					glBindVertexArray(geometry.vao);
+					if (!is_material_bound || geometry.material != bound_material) {
+						GLuint opacity_texture = 0u;
+						if (geometry.material < material_table.materials.size())
+							opacity_texture = material_table.materials[geometry.material].textures[static_cast<std::size_t>(bonobo::material_texture_slot_t::opacity)];
+						glUniform1i(fill_shadowmap_shader_locations.has_opacity_texture, opacity_texture != 0u ? 1 : 0);
+						gl_state.BindSampler(0u, opacity_texture != 0u ? samplers[toU(Sampler::Mipmaps)] : samplers[toU(Sampler::Nearest)]);
+						gl_state.BindTexture(0u, GL_TEXTURE_2D, opacity_texture != 0u ? opacity_texture : debug_texture_id);
+						is_material_bound = true;
+						bound_material = geometry.material;
+					}
+
+					glUniform1i(fill_shadowmap_shader_locations.has_quantised_positions, geometry.encoding.has_quantised_positions ? 1 : 0);
+					glUniform3fv(fill_shadowmap_shader_locations.vertex_dequantisation_scale, 1, glm::value_ptr(geometry.encoding.dequantisation_scale));
+					glUniform3fv(fill_shadowmap_shader_locations.vertex_dequantisation_offset, 1, glm::value_ptr(geometry.encoding.dequantisation_offset));
+
+					// Meshes sharing a geometry arena do not need to rebind it.
+					gl_state.BindVertexArray(geometry.vao);
 					if (geometry.ibo != 0u)
-						glDrawElements(geometry.drawing_mode, geometry.indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
+						glDrawElementsBaseVertex(geometry.drawing_mode, geometry.indices_nb, geometry.index_type,
+						                         bonobo::getIndicesOffset(geometry), geometry.base_vertex);
 					else
-						glDrawArrays(geometry.drawing_mode, 0, geometry.vertices_nb);
+						glDrawArrays(geometry.drawing_mode, geometry.base_vertex, geometry.vertices_nb);
+					gl_state.CountDrawCall();
 
 
 					utils::opengl::debug::endDebugGroup();
 				}
-				glBindTexture(GL_TEXTURE_2D, 0);
-				glBindVertexArray(0u);
-				glUseProgram(0u);
+				gl_state.RestoreDefaults();
 
 				glEndQuery(GL_TIME_ELAPSED);
 				utils::opengl::debug::endDebugGroup();
@@ -789,6 +1037,178 @@ edan35::Assignment2::run()
 
 				ImGui::EndTable();
 			}
+
+			ImGui::Separator();
+			if (ImGui::BeginTable("Frustum culling", 3, ImGuiTableFlags_SizingFixedFit))
+			{
+				ImGui::TableSetupColumn("Sponza meshes");
+				ImGui::TableSetupColumn("Visible");
+				ImGui::TableSetupColumn("Culled");
+				ImGui::TableHeadersRow();
+
+				auto const sponza_meshes_nb = sponza_bounding_boxes.centres_x.size();
+				ImGui::TableNextColumn();
+				ImGui::Text("Gbuffer gen.");
+				ImGui::TableNextColumn();
+				ImGui::Text("%zu", gbuffer_visible_nb);
+				ImGui::TableNextColumn();
+				ImGui::Text("%zu", sponza_meshes_nb - gbuffer_visible_nb);
+
+				for (std::size_t i = 0; i < static_cast<std::size_t>(lights_nb); ++i) {
+					ImGui::TableNextColumn();
+					ImGui::Text("Light %zu shadow map", i);
+					ImGui::TableNextColumn();
+					ImGui::Text("%zu", shadowmap_visible_nbs[i]);
+					ImGui::TableNextColumn();
+					ImGui::Text("%zu", sponza_meshes_nb - shadowmap_visible_nbs[i]);
+				}
+
+				ImGui::EndTable();
+			}
+
+			// Only the scene passes and nodes go through the state tracker.
+			auto const& gl_state_stats = GLStateTracker::GetShared().GetStats();
+			ImGui::Text("Draw calls: %u", gl_state_stats.draw_calls_nb);
+			ImGui::Text("State changes: %u (%u programs, %u vertex arrays, %u textures, %u samplers, %u materials)",
+			            gl_state_stats.GetStateChangesNb(), gl_state_stats.program_changes_nb,
+			            gl_state_stats.vertex_array_changes_nb, gl_state_stats.texture_changes_nb,
+			            gl_state_stats.sampler_changes_nb, gl_state_stats.material_changes_nb);
+			ImGui::Text("Redundant changes skipped: %u", gl_state_stats.redundant_changes_nb);
+
+			ImGui::Separator();
+			if (vertex_layout_benchmark.is_running) {
+				ImGui::Text("Benchmarking vertex layout \"%s\"…", vertex_layouts[vertex_layout_benchmark.layout_index].name);
+			} else if (ImGui::Button("Benchmark vertex layouts")) {
+				vertex_layout_benchmark.is_running = true;
+				vertex_layout_benchmark.layout_index = 0u;
+				vertex_layout_benchmark.frames_nb = 0u;
+				vertex_layout_benchmark.accumulated_gbuffer_time = 0u;
+				load_sponza(vertex_layout_benchmark.layout_index);
+			}
+			if (ImGui::BeginTable("Vertex layouts", 3, ImGuiTableFlags_SizingFixedFit))
+			{
+				ImGui::TableSetupColumn("Vertex layout");
+				ImGui::TableSetupColumn("Vertices [MiB]");
+				ImGui::TableSetupColumn("Gbuffer gen. [ms]");
+				ImGui::TableHeadersRow();
+
+				for (std::size_t i = 0; i < vertex_layouts.size(); ++i) {
+					ImGui::TableNextColumn();
+					ImGui::Text("%s", vertex_layouts[i].name);
+					ImGui::TableNextColumn();
+					if (vertex_layout_benchmark.vertex_buffer_sizes_mib[i] < 0.0f)
+						ImGui::Text("-");
+					else
+						ImGui::Text("%.2f", vertex_layout_benchmark.vertex_buffer_sizes_mib[i]);
+					ImGui::TableNextColumn();
+					if (vertex_layout_benchmark.gbuffer_durations_ms[i] < 0.0f)
+						ImGui::Text("-");
+					else
+						ImGui::Text("%.3f", vertex_layout_benchmark.gbuffer_durations_ms[i]);
+				}
+
+				ImGui::EndTable();
+			}
+
+			ImGui::Separator();
+			if (ImGui::Button("Benchmark mipmap generation"))
+				mipmap_throughputs = runMipmapBenchmark();
+			if (ImGui::BeginTable("Mipmap generation", 2, ImGuiTableFlags_SizingFixedFit))
+			{
+				ImGui::TableSetupColumn("Mipmap generation");
+				ImGui::TableSetupColumn("Throughput [Mtexel/s]");
+				ImGui::TableHeadersRow();
+
+				std::array<char const*, 4> const mipmap_paths = { "Driver", "CPU, box", "CPU, Kaiser", "CPU, Lanczos" };
+				for (std::size_t i = 0; i < mipmap_paths.size(); ++i) {
+					ImGui::TableNextColumn();
+					ImGui::Text("%s", mipmap_paths[i]);
+					ImGui::TableNextColumn();
+					if (mipmap_throughputs[i] < 0.0f)
+						ImGui::Text("-");
+					else
+						ImGui::Text("%.1f", mipmap_throughputs[i]);
+				}
+
+				ImGui::EndTable();
+			}
+
+			ImGui::Separator();
+			if (ImGui::Button("Benchmark Sponza import"))
+				scene_import_results = runSceneImportBenchmark();
+			if (ImGui::BeginTable("Scene import", 4, ImGuiTableFlags_SizingFixedFit))
+			{
+				ImGui::TableSetupColumn("Importer");
+				ImGui::TableSetupColumn("Import [ms]");
+				ImGui::TableSetupColumn("Meshes");
+				ImGui::TableSetupColumn("Vertices");
+				ImGui::TableHeadersRow();
+
+				std::array<char const*, 2> const importer_names = { "assimp", "Native OBJ" };
+				for (std::size_t i = 0; i < importer_names.size(); ++i) {
+					auto const& result = scene_import_results[i];
+					ImGui::TableNextColumn();
+					ImGui::Text("%s", importer_names[i]);
+					if (!result.is_successful) {
+						ImGui::TableNextColumn();
+						ImGui::Text("-");
+						ImGui::TableNextColumn();
+						ImGui::Text("-");
+						ImGui::TableNextColumn();
+						ImGui::Text("-");
+						continue;
+					}
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f", result.duration_ms);
+					ImGui::TableNextColumn();
+					ImGui::Text("%zu", result.meshes_nb);
+					ImGui::TableNextColumn();
+					ImGui::Text("%zu", result.vertices_nb);
+				}
+
+				ImGui::EndTable();
+			}
+
+			ImGui::Separator();
+			if (ImGui::Button("Benchmark scene graph update")) {
+				scene_graph_results = bonobo::benchmarkSceneGraph(constant::scene_graph_benchmark_nodes_nb,
+				                                                  constant::scene_graph_benchmark_moving_ratio,
+				                                                  constant::scene_graph_benchmark_repetitions_nb);
+				LogInfo("Scene graph of %zu nodes updated in %.3f ms by traversing nodes, %.3f ms when flattened, and %.3f ms when flattened with %zu moving nodes (%zu updated)",
+				        scene_graph_results.nodes_nb, scene_graph_results.node_traversal_ms,
+				        scene_graph_results.flat_full_update_ms, scene_graph_results.flat_partial_update_ms,
+				        scene_graph_results.moving_nodes_nb, scene_graph_results.updated_nodes_nb);
+			}
+			if (scene_graph_results.nodes_nb != 0u && ImGui::BeginTable("Scene graph update", 3, ImGuiTableFlags_SizingFixedFit))
+			{
+				ImGui::TableSetupColumn("Method");
+				ImGui::TableSetupColumn("Update [ms]");
+				ImGui::TableSetupColumn("Nodes updated");
+				ImGui::TableHeadersRow();
+
+				ImGui::TableNextColumn();
+				ImGui::Text("Node traversal");
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", scene_graph_results.node_traversal_ms);
+				ImGui::TableNextColumn();
+				ImGui::Text("%zu", scene_graph_results.nodes_nb);
+
+				ImGui::TableNextColumn();
+				ImGui::Text("Flattened, all dirty");
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", scene_graph_results.flat_full_update_ms);
+				ImGui::TableNextColumn();
+				ImGui::Text("%zu", scene_graph_results.nodes_nb);
+
+				ImGui::TableNextColumn();
+				ImGui::Text("Flattened, %zu moving", scene_graph_results.moving_nodes_nb);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", scene_graph_results.flat_partial_update_ms);
+				ImGui::TableNextColumn();
+				ImGui::Text("%zu", scene_graph_results.updated_nodes_nb);
+
+				ImGui::EndTable();
+			}
 		}
 		ImGui::End();
 
@@ -798,6 +1218,13 @@ edan35::Assignment2::run()
 			ImGui::SliderInt("Number of lights", &lights_nb, 1, static_cast<int>(constant::lights_nb));
 			ImGui::Checkbox("Show textures", &show_textures);
 			ImGui::Checkbox("Show light cones wireframe", &show_cone_wireframe);
+			auto const get_vertex_layout_name = [](void* /*data*/, int index, char const** name){
+				*name = vertex_layouts[static_cast<std::size_t>(index)].name;
+				return true;
+			};
+			if (ImGui::Combo("Vertex layout", &vertex_layout_index, get_vertex_layout_name, nullptr, static_cast<int>(vertex_layouts.size()))
+			 && !vertex_layout_benchmark.is_running)
+				load_sponza(static_cast<std::size_t>(vertex_layout_index));
 			ImGui::Separator();
 			ImGui::Checkbox("Show basis", &show_basis);
 			ImGui::SliderFloat("Basis thickness scale", &basis_thickness_scale, 0.0f, 100.0f);
@@ -805,6 +1232,78 @@ edan35::Assignment2::run()
 		}
 		ImGui::End();
 
+		opened = ImGui::Begin("Scene Loading", nullptr, ImGuiWindowFlags_None);
+		if (opened) {
+			if (sponza_progress.has_failed) {
+				ImGui::Text("Failed to load Sponza");
+			} else if (!sponza_progress.is_geometry_read) {
+				ImGui::Text("Reading geometry… %.1f s", sponza_progress.elapsed_s);
+			} else {
+				auto const meshes_ratio = sponza_progress.meshes_nb != 0u ? static_cast<float>(sponza_progress.meshes_uploaded_nb) / static_cast<float>(sponza_progress.meshes_nb) : 1.0f;
+				auto const textures_ratio = sponza_progress.textures_nb != 0u ? static_cast<float>(sponza_progress.textures_uploaded_nb) / static_cast<float>(sponza_progress.textures_nb) : 1.0f;
+				ImGui::Text("Meshes: %zu / %zu", sponza_progress.meshes_uploaded_nb, sponza_progress.meshes_nb);
+				ImGui::ProgressBar(meshes_ratio);
+				ImGui::Text("Textures: %zu / %zu uploaded, %zu decoded", sponza_progress.textures_uploaded_nb, sponza_progress.textures_nb, sponza_progress.textures_decoded_nb);
+				ImGui::ProgressBar(textures_ratio);
+				ImGui::Text("%.3f MiB uploaded over %u frames, in %.3f s%s",
+				            static_cast<float>(sponza_progress.bytes_uploaded) / (1024.0f * 1024.0f),
+				            sponza_progress.frames_nb, sponza_progress.elapsed_s,
+				            sponza_progress.is_complete ? "" : "…");
+			}
+			auto const texture_stats = bonobo::getTextureRegistryStats();
+			ImGui::Text("Texture memory: %.3f MiB, saving %.3f MiB through compression",
+			            static_cast<float>(texture_stats.bytes_allocated) / (1024.0f * 1024.0f),
+			            static_cast<float>(texture_stats.bytes_uncompressed - texture_stats.bytes_allocated) / (1024.0f * 1024.0f));
+			auto const upload_stats = bonobo::getUploadStats();
+			auto const to_mb_per_s = [](std::uint64_t bytes, float duration_ms){
+				return duration_ms > 0.0f ? static_cast<float>(bytes) / (duration_ms * 1000.0f) : 0.0f;
+			};
+			if (upload_stats.is_staging_supported)
+				ImGui::Text("Staging ring: %.3f MiB at %.1f MB/s, %u fallbacks, %u stalls (%.3f ms)",
+				            static_cast<float>(upload_stats.bytes_staged) / (1024.0f * 1024.0f),
+				            to_mb_per_s(upload_stats.bytes_staged, upload_stats.staged_duration_ms),
+				            upload_stats.staging_failures_nb, upload_stats.stalls_nb, upload_stats.stall_duration_ms);
+			else
+				ImGui::Text("Staging ring: unavailable without buffer storage");
+			ImGui::Text("Client memory: %.3f MiB at %.1f MB/s",
+			            static_cast<float>(upload_stats.bytes_direct) / (1024.0f * 1024.0f),
+			            to_mb_per_s(upload_stats.bytes_direct, upload_stats.direct_duration_ms));
+			ImGui::Separator();
+			if (ImGui::Checkbox("Compress textures", &compress_sponza_textures) && !vertex_layout_benchmark.is_running)
+				load_sponza(sponza_layout_index);
+			if (ImGui::Checkbox("Stream textures", &sponza_texture_streaming.enabled)) {
+				bonobo::setTextureStreamingOptions(sponza_texture_streaming);
+				if (!vertex_layout_benchmark.is_running)
+					load_sponza(sponza_layout_index);
+			}
+			int streaming_budget_mib = static_cast<int>(sponza_texture_streaming.budget_bytes / (1024u * 1024u));
+			if (ImGui::SliderInt("Streaming budget [MiB]", &streaming_budget_mib, 1, 1024)) {
+				sponza_texture_streaming.budget_bytes = static_cast<std::uint64_t>(streaming_budget_mib) * 1024u * 1024u;
+				bonobo::setTextureStreamingOptions(sponza_texture_streaming);
+			}
+			if (sponza_texture_streaming.enabled) {
+				auto const streaming_stats = bonobo::getTextureStreamingStats();
+				ImGui::Text("Streamed textures: %zu, with %zu / %zu levels resident and %zu requested",
+				            streaming_stats.textures_nb, streaming_stats.resident_levels_nb, streaming_stats.levels_nb,
+				            streaming_stats.requested_levels_nb);
+				ImGui::Text("Resident: %.3f MiB out of %.3f MiB, budget %.3f MiB",
+				            static_cast<float>(streaming_stats.resident_bytes) / (1024.0f * 1024.0f),
+				            static_cast<float>(streaming_stats.full_bytes) / (1024.0f * 1024.0f),
+				            static_cast<float>(streaming_stats.budget_bytes) / (1024.0f * 1024.0f));
+				ImGui::ProgressBar(streaming_stats.budget_bytes != 0u ? std::min(static_cast<float>(streaming_stats.resident_bytes) / static_cast<float>(streaming_stats.budget_bytes), 1.0f) : 0.0f);
+				ImGui::Text("Streamed in %u levels (%.3f MiB), evicted %u (%.3f MiB)",
+				            streaming_stats.levels_streamed_in_nb,
+				            static_cast<float>(streaming_stats.bytes_streamed_in) / (1024.0f * 1024.0f),
+				            streaming_stats.levels_evicted_nb,
+				            static_cast<float>(streaming_stats.bytes_evicted) / (1024.0f * 1024.0f));
+			}
+			ImGui::SliderFloat("Upload budget [ms/frame]", &sponza_upload_budget.duration_ms, 0.1f, 16.0f);
+			int upload_budget_mib = static_cast<int>(sponza_upload_budget.bytes / (1024u * 1024u));
+			if (ImGui::SliderInt("Upload budget [MiB/frame]", &upload_budget_mib, 1, 64))
+				sponza_upload_budget.bytes = static_cast<std::uint64_t>(upload_budget_mib) * 1024u * 1024u;
+		}
+		ImGui::End();
+
 		if (show_logs)
 			Log::View::Render();
 		mWindowManager.RenderImGuiFrame(show_gui);
@@ -831,6 +1330,8 @@ edan35::Assignment2::run()
 		first_frame = false;
 	}
 
+	sponza.reset();
+
 	glDeleteBuffers(static_cast<GLsizei>(ubos.size()), ubos.data());
 	glDeleteQueries(static_cast<GLsizei>(elapsed_time_queries.size()), elapsed_time_queries.data());
 	glDeleteSamplers(static_cast<GLsizei>(samplers.size()), samplers.data());
@@ -1068,8 +1569,16 @@ void fillGBufferShaderLocations(GLuint gbuffer_shader, GBufferShaderLocations& l
 	locations.has_specular_texture = glGetUniformLocation(gbuffer_shader, "has_specular_texture");
 	locations.has_normals_texture = glGetUniformLocation(gbuffer_shader, "has_normals_texture");
 	locations.has_opacity_texture = glGetUniformLocation(gbuffer_shader, "has_opacity_texture");
+	locations.has_quantised_positions = glGetUniformLocation(gbuffer_shader, "has_quantised_positions");
+	locations.vertex_dequantisation_scale = glGetUniformLocation(gbuffer_shader, "vertex_dequantisation_scale");
+	locations.vertex_dequantisation_offset = glGetUniformLocation(gbuffer_shader, "vertex_dequantisation_offset");
+	locations.has_octahedral_normals = glGetUniformLocation(gbuffer_shader, "has_octahedral_normals");
+
+	locations.ubo_MaterialConstants = glGetUniformBlockIndex(gbuffer_shader, "MaterialConstants");
 
 	glUniformBlockBinding(gbuffer_shader, locations.ubo_CameraViewProjTransforms, toU(UBO::CameraViewProjTransforms));
+	if (locations.ubo_MaterialConstants != GL_INVALID_INDEX)
+		glUniformBlockBinding(gbuffer_shader, locations.ubo_MaterialConstants, bonobo::material_constants_binding);
 
 }
 
@@ -1080,6 +1589,9 @@ void fillShadowmapShaderLocations(GLuint shadowmap_shader, FillShadowmapShaderLo
 	locations.vertex_model_to_world = glGetUniformLocation(shadowmap_shader, "vertex_model_to_world");
 	locations.opacity_texture = glGetUniformLocation(shadowmap_shader, "opacity_texture");
 	locations.has_opacity_texture = glGetUniformLocation(shadowmap_shader, "has_opacity_texture");
+	locations.has_quantised_positions = glGetUniformLocation(shadowmap_shader, "has_quantised_positions");
+	locations.vertex_dequantisation_scale = glGetUniformLocation(shadowmap_shader, "vertex_dequantisation_scale");
+	locations.vertex_dequantisation_offset = glGetUniformLocation(shadowmap_shader, "vertex_dequantisation_offset");
 
 	glUniformBlockBinding(shadowmap_shader, locations.ubo_LightViewProjTransforms, toU(UBO::LightViewProjTransforms));
 }
@@ -1,11 +1,25 @@
 #include "Bonobo.h"
 #include "Log.h"
 
+#include "config.hpp"
+#include "core/various.hpp"
+
+#include <string>
+
 Bonobo::Bonobo() {
+	// Deployments can ship shaders and resources packed in a single
+	// archive, in the current or the root directory; loose files keep
+	// taking precedence over it. Paths built by `config::shaders_path()`
+	// and `config::resources_path()` start with either directory.
+	for (char const* directory : { ".", config::root_dir })
+		if (utils::mount_archive(std::string(directory) + "/" + config::archive_name, config::root_dir))
+			break;
+
 	LogInfo("Framework initialisation done.");
 }
 
 Bonobo::~Bonobo() {
+	utils::unmount_archives();
 	LogInfo("Framework shutting down.");
 }
 
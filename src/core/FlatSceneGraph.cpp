@@ -0,0 +1,373 @@
+#include "FlatSceneGraph.hpp"
+
+#include "node.hpp"
+#include "ThreadPool.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <utility>
+
+constexpr FlatSceneGraph::NodeIndex FlatSceneGraph::InvalidNode;
+
+void FlatSceneGraph::Reserve(std::size_t nodes_nb)
+{
+	mLocalTransforms.reserve(nodes_nb);
+	mWorldMatrices.reserve(nodes_nb);
+	mNormalMatrices.reserve(nodes_nb);
+	mParents.reserve(nodes_nb);
+	mFlags.reserve(nodes_nb);
+	mNodes.reserve(nodes_nb);
+}
+
+void FlatSceneGraph::Clear()
+{
+	mLocalTransforms.clear();
+	mWorldMatrices.clear();
+	mNormalMatrices.clear();
+	mParents.clear();
+	mFlags.clear();
+	mNodes.clear();
+	mNodesByDepth.clear();
+	mDepthOffsets.clear();
+	mIsDepthSortOutdated = true;
+}
+
+FlatSceneGraph::NodeIndex FlatSceneGraph::AddNode(NodeIndex parent, TRSTransformf const& transform)
+{
+	assert(parent == InvalidNode || parent < mParents.size());
+	assert(mParents.size() < InvalidNode);
+
+	auto const node = static_cast<NodeIndex>(mParents.size());
+	mLocalTransforms.push_back(transform);
+	mWorldMatrices.emplace_back(1.0f);
+	mNormalMatrices.emplace_back(1.0f);
+	mParents.push_back(parent);
+	mFlags.push_back(LocalDirty);
+	mNodes.push_back(nullptr);
+	mIsDepthSortOutdated = true;
+
+	return node;
+}
+
+FlatSceneGraph::NodeIndex FlatSceneGraph::AddHierarchy(Node const& root, NodeIndex parent)
+{
+	// Children are pushed in reverse so that they get added in order.
+	std::vector<std::pair<Node const*, NodeIndex>> stack;
+	stack.emplace_back(&root, parent);
+	NodeIndex const root_index = static_cast<NodeIndex>(mParents.size());
+	while (!stack.empty()) {
+		auto const entry = stack.back();
+		stack.pop_back();
+
+		auto const node = AddNode(entry.second, entry.first->get_transform());
+		mNodes[node] = entry.first;
+
+		for (auto i = entry.first->get_children_nb(); i > 0u; --i)
+			stack.emplace_back(entry.first->get_child(i - 1u), node);
+	}
+
+	return root_index;
+}
+
+std::size_t FlatSceneGraph::GetNodesNb() const
+{
+	return mParents.size();
+}
+
+FlatSceneGraph::NodeIndex FlatSceneGraph::GetParent(NodeIndex node) const
+{
+	return mParents[node];
+}
+
+TRSTransformf const& FlatSceneGraph::GetLocalTransform(NodeIndex node) const
+{
+	return mLocalTransforms[node];
+}
+
+TRSTransformf& FlatSceneGraph::EditLocalTransform(NodeIndex node)
+{
+	mFlags[node] |= LocalDirty;
+	return mLocalTransforms[node];
+}
+
+void FlatSceneGraph::SetLocalTransform(NodeIndex node, TRSTransformf const& transform)
+{
+	mLocalTransforms[node] = transform;
+	mFlags[node] |= LocalDirty;
+}
+
+void FlatSceneGraph::MarkDirty(NodeIndex node)
+{
+	mFlags[node] |= LocalDirty;
+}
+
+void FlatSceneGraph::SyncFromNodes()
+{
+	// A transform only holds floats, so comparing bytes tells whether it
+	// changed without building its matrix.
+	for (std::size_t i = 0u; i < mNodes.size(); ++i) {
+		if (mNodes[i] == nullptr)
+			continue;
+
+		auto const& transform = mNodes[i]->get_transform();
+		if (std::memcmp(&transform, &mLocalTransforms[i], sizeof(TRSTransformf)) != 0) {
+			mLocalTransforms[i] = transform;
+			mFlags[i] |= LocalDirty;
+		}
+	}
+}
+
+bool FlatSceneGraph::UpdateNode(NodeIndex node)
+{
+	auto const parent = mParents[node];
+	bool const has_parent_changed = parent != InvalidNode && (mFlags[parent] & WorldChanged) != 0u;
+	if ((mFlags[node] & LocalDirty) == 0u && !has_parent_changed) {
+		mFlags[node] = 0u;
+		return false;
+	}
+
+	auto const local = mLocalTransforms[node].GetMatrix();
+	mWorldMatrices[node] = parent != InvalidNode ? mWorldMatrices[parent] * local : local;
+	// Normals are never translated, so only the upper 3×3 part needs
+	// inverting.
+	mNormalMatrices[node] = glm::mat4(glm::transpose(glm::inverse(glm::mat3(mWorldMatrices[node]))));
+	mFlags[node] = WorldChanged;
+	return true;
+}
+
+std::size_t FlatSceneGraph::UpdateTransforms()
+{
+	// Parents come before their children, so by the time a node is
+	// reached, its parent's flags already tell whether it moved during
+	// this update.
+	std::size_t updated_nodes_nb = 0u;
+	for (std::size_t i = 0u; i < mParents.size(); ++i)
+		if (UpdateNode(static_cast<NodeIndex>(i)))
+			++updated_nodes_nb;
+
+	return updated_nodes_nb;
+}
+
+void FlatSceneGraph::SortByDepth()
+{
+	// Depths are computed in a single pass thanks to the topological
+	// order, then nodes are bucketed by depth, keeping them in index order
+	// within each depth.
+	std::vector<std::uint32_t> depths(mParents.size(), 0u);
+	std::uint32_t max_depth = 0u;
+	for (std::size_t i = 0u; i < mParents.size(); ++i) {
+		if (mParents[i] != InvalidNode)
+			depths[i] = depths[mParents[i]] + 1u;
+		max_depth = std::max(max_depth, depths[i]);
+	}
+
+	mDepthOffsets.assign(mParents.empty() ? 1u : max_depth + 2u, 0u);
+	for (auto const depth : depths)
+		++mDepthOffsets[depth + 1u];
+	for (std::size_t depth = 1u; depth < mDepthOffsets.size(); ++depth)
+		mDepthOffsets[depth] += mDepthOffsets[depth - 1u];
+
+	mNodesByDepth.resize(mParents.size());
+	auto next_offsets = mDepthOffsets;
+	for (std::size_t i = 0u; i < mParents.size(); ++i)
+		mNodesByDepth[next_offsets[depths[i]]++] = static_cast<NodeIndex>(i);
+
+	mIsDepthSortOutdated = false;
+}
+
+std::size_t FlatSceneGraph::UpdateTransforms(ThreadPool& pool)
+{
+	// Large enough for the work of a chunk to dwarf the cost of claiming
+	// it, small enough for threads to balance out uneven chunks.
+	constexpr std::size_t chunk_size = 512u;
+
+	if (mIsDepthSortOutdated)
+		SortByDepth();
+
+	std::atomic<std::size_t> updated_nodes_nb(0u);
+	std::vector<std::future<void>> workers;
+	for (std::size_t depth = 0u; depth + 1u < mDepthOffsets.size(); ++depth) {
+		auto const begin = mDepthOffsets[depth];
+		auto const end = mDepthOffsets[depth + 1u];
+		auto const chunks_nb = (end - begin + chunk_size - 1u) / chunk_size;
+
+		std::atomic<std::size_t> next_chunk(0u);
+		auto const process_chunks = [this, begin, end, chunks_nb, &next_chunk, &updated_nodes_nb](){
+			std::size_t chunk_updated_nodes_nb = 0u;
+			for (auto chunk = next_chunk++; chunk < chunks_nb; chunk = next_chunk++) {
+				auto const chunk_end = std::min(begin + (chunk + 1u) * chunk_size, end);
+				for (auto i = begin + chunk * chunk_size; i < chunk_end; ++i)
+					if (UpdateNode(mNodesByDepth[i]))
+						++chunk_updated_nodes_nb;
+			}
+			updated_nodes_nb += chunk_updated_nodes_nb;
+		};
+
+		if (chunks_nb <= 1u) {
+			process_chunks();
+			continue;
+		}
+
+		// All nodes of this depth must be done before the next one starts,
+		// as its nodes read their parents' matrices and flags.
+		workers.clear();
+		for (std::size_t i = 0u; i < std::min(pool.GetThreadsNb(), chunks_nb); ++i)
+			workers.push_back(pool.Enqueue(process_chunks));
+		for (auto& worker : workers)
+			worker.get();
+	}
+
+	return updated_nodes_nb;
+}
+
+glm::mat4 const& FlatSceneGraph::GetWorldMatrix(NodeIndex node) const
+{
+	return mWorldMatrices[node];
+}
+
+glm::mat4 const& FlatSceneGraph::GetNormalMatrix(NodeIndex node) const
+{
+	return mNormalMatrices[node];
+}
+
+void FlatSceneGraph::Render(glm::mat4 const& view_projection) const
+{
+	for (std::size_t i = 0u; i < mNodes.size(); ++i)
+		if (mNodes[i] != nullptr)
+			mNodes[i]->render(view_projection, mWorldMatrices[i], mNormalMatrices[i]);
+}
+
+void FlatSceneGraph::Submit(RenderQueue& queue, glm::mat4 const& view_projection, std::uint32_t pass) const
+{
+	for (std::size_t i = 0u; i < mNodes.size(); ++i)
+		if (mNodes[i] != nullptr)
+			mNodes[i]->submit(queue, view_projection, mWorldMatrices[i], mNormalMatrices[i], pass);
+}
+
+bonobo::scene_graph_benchmark_stats
+bonobo::benchmarkSceneGraph(std::size_t nodes_nb, float moving_ratio, unsigned int repetitions_nb, ThreadPool* pool)
+{
+	scene_graph_benchmark_stats stats;
+	if (nodes_nb == 0u)
+		return stats;
+
+	// Each node gets a random earlier node as parent, which yields a
+	// hierarchy of logarithmic depth, with a random local transform.
+	std::mt19937 generator(1234u);
+	std::uniform_real_distribution<float> offset_distribution(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> angle_distribution(0.0f, glm::two_pi<float>());
+	std::uniform_real_distribution<float> scale_distribution(0.5f, 1.5f);
+	std::vector<Node> nodes(nodes_nb);
+	for (std::size_t i = 0u; i < nodes_nb; ++i) {
+		auto& transform = nodes[i].get_transform();
+		transform.SetTranslate(glm::vec3(offset_distribution(generator), offset_distribution(generator), offset_distribution(generator)));
+		transform.SetRotateY(angle_distribution(generator));
+		transform.SetScale(scale_distribution(generator));
+		if (i > 0u)
+			nodes[std::uniform_int_distribution<std::size_t>(0u, i - 1u)(generator)].add_child(&nodes[i]);
+	}
+
+	FlatSceneGraph graph;
+	graph.Reserve(nodes_nb);
+	graph.AddHierarchy(nodes.front());
+
+	stats.nodes_nb = nodes_nb;
+	stats.moving_nodes_nb = std::min(nodes_nb, static_cast<std::size_t>(static_cast<float>(nodes_nb) * std::max(moving_ratio, 0.0f)));
+	std::vector<FlatSceneGraph::NodeIndex> moving_nodes(nodes_nb);
+	for (std::size_t i = 0u; i < nodes_nb; ++i)
+		moving_nodes[i] = static_cast<FlatSceneGraph::NodeIndex>(i);
+	std::shuffle(moving_nodes.begin(), moving_nodes.end(), generator);
+	moving_nodes.resize(stats.moving_nodes_nb);
+
+	auto const time = [repetitions_nb](std::function<void ()> const& prepare, std::function<void ()> const& run){
+		auto best_ms = std::numeric_limits<float>::max();
+		for (unsigned int i = 0u; i < std::max(repetitions_nb, 1u); ++i) {
+			prepare();
+			auto const start_time = std::chrono::high_resolution_clock::now();
+			run();
+			auto const duration = std::chrono::high_resolution_clock::now() - start_time;
+			best_ms = std::min(best_ms, std::chrono::duration<float, std::milli>(duration).count());
+		}
+		return best_ms;
+	};
+
+	// Accumulate some of the results, so that the computations can not be
+	// optimised away.
+	volatile float sink = 0.0f;
+
+	std::vector<std::pair<Node const*, glm::mat4>> stack;
+	stats.node_traversal_ms = time([](){}, [&](){
+		float sum = 0.0f;
+		stack.emplace_back(&nodes.front(), glm::mat4(1.0f));
+		while (!stack.empty()) {
+			auto const entry = stack.back();
+			stack.pop_back();
+
+			auto const world = entry.second * entry.first->get_transform().GetMatrix();
+			auto const normal_model_to_world = glm::transpose(glm::inverse(world));
+			sum += world[3][0] + normal_model_to_world[0][0];
+
+			for (std::size_t i = 0u; i < entry.first->get_children_nb(); ++i)
+				stack.emplace_back(entry.first->get_child(i), world);
+		}
+		sink = sink + sum;
+	});
+
+	stats.flat_full_update_ms = time([&graph](){
+		for (std::size_t i = 0u; i < graph.GetNodesNb(); ++i)
+			graph.MarkDirty(static_cast<FlatSceneGraph::NodeIndex>(i));
+	}, [&graph, &sink](){
+		graph.UpdateTransforms();
+		sink = sink + graph.GetWorldMatrix(0u)[3][0];
+	});
+
+	stats.flat_partial_update_ms = time([](){}, [&](){
+		for (auto const node : moving_nodes)
+			graph.EditLocalTransform(node).RotateY(0.01f);
+		stats.updated_nodes_nb = graph.UpdateTransforms();
+		sink = sink + graph.GetWorldMatrix(0u)[3][0];
+	});
+
+	if (pool == nullptr)
+		return stats;
+
+	// The first update sorts the nodes by depth, outside of the timings.
+	FlatSceneGraph parallel_graph;
+	parallel_graph.Reserve(nodes_nb);
+	parallel_graph.AddHierarchy(nodes.front());
+	parallel_graph.UpdateTransforms(*pool);
+	stats.threads_nb = pool->GetThreadsNb();
+
+	stats.parallel_full_update_ms = time([&parallel_graph](){
+		for (std::size_t i = 0u; i < parallel_graph.GetNodesNb(); ++i)
+			parallel_graph.MarkDirty(static_cast<FlatSceneGraph::NodeIndex>(i));
+	}, [&parallel_graph, &sink, pool](){
+		parallel_graph.UpdateTransforms(*pool);
+		sink = sink + parallel_graph.GetWorldMatrix(0u)[3][0];
+	});
+
+	stats.parallel_partial_update_ms = time([](){}, [&](){
+		for (auto const node : moving_nodes)
+			parallel_graph.EditLocalTransform(node).RotateY(0.01f);
+		parallel_graph.UpdateTransforms(*pool);
+		sink = sink + parallel_graph.GetWorldMatrix(0u)[3][0];
+	});
+
+	// Both graphs went through the same edits, so their matrices should
+	// match bit for bit.
+	stats.is_parallel_identical = true;
+	for (std::size_t i = 0u; i < nodes_nb && stats.is_parallel_identical; ++i) {
+		auto const node = static_cast<FlatSceneGraph::NodeIndex>(i);
+		stats.is_parallel_identical = std::memcmp(&graph.GetWorldMatrix(node), &parallel_graph.GetWorldMatrix(node), sizeof(glm::mat4)) == 0
+		                           && std::memcmp(&graph.GetNormalMatrix(node), &parallel_graph.GetNormalMatrix(node), sizeof(glm::mat4)) == 0;
+	}
+
+	return stats;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "TRSTransform.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+class Node;
+class RenderQueue;
+class ThreadPool;
+
+//! \brief A scene graph stored as flat arrays, one entry per node, rather
+//!        than as nodes pointing to their children.
+//!
+//! Nodes are kept in topological order, parents always coming before their
+//! children, with their local transform, world and normal matrices, parent
+//! index and dirty flags each in an array of their own. `UpdateTransforms()`
+//! then walks the arrays once, front to back, and only recomputes the
+//! matrices of nodes whose local transform changed, or whose parent's world
+//! matrix did: nodes that never move cost a flag check per update, rather
+//! than a matrix product and inversion per traversal.
+//!
+//! Large hierarchies can be updated on a thread pool, one depth level at a
+//! time, as nodes of the same depth never depend on each other.
+//!
+//! Existing `Node` hierarchies can be added via `AddHierarchy()`: their
+//! local transforms are copied in by `SyncFromNodes()`, and `Render()` draws
+//! them with the matrices computed here.
+class FlatSceneGraph
+{
+public:
+	using NodeIndex = std::uint32_t;
+	static constexpr NodeIndex InvalidNode = std::numeric_limits<NodeIndex>::max();
+
+	//! \brief Reserve space for |nodes_nb| nodes.
+	void Reserve(std::size_t nodes_nb);
+
+	//! \brief Remove all nodes.
+	void Clear();
+
+	//! \brief Add a node, marked as dirty.
+	//!
+	//! @param [in] parent index of an existing node, or `InvalidNode` for
+	//!             a root
+	//! @param [in] transform local transform of the node, relative to its
+	//!             parent
+	//! @return the index of the node, greater than that of its parent
+	NodeIndex AddNode(NodeIndex parent = InvalidNode, TRSTransformf const& transform = TRSTransformf());
+
+	//! \brief Add |root| and all its descendants, in depth-first order.
+	//!
+	//! The nodes are referenced rather than copied, so they must outlive
+	//! the graph, or at least the next call to `Clear()`; a node reachable
+	//! through several parents is added once per path.
+	//!
+	//! @param [in] root the `Node` to add
+	//! @param [in] parent index of an existing node, or `InvalidNode`
+	//! @return the index of |root| in the graph
+	NodeIndex AddHierarchy(Node const& root, NodeIndex parent = InvalidNode);
+
+	std::size_t GetNodesNb() const;
+	NodeIndex GetParent(NodeIndex node) const;
+
+	TRSTransformf const& GetLocalTransform(NodeIndex node) const;
+
+	//! \brief Return the local transform of a node for modification,
+	//!        marking the node as dirty.
+	TRSTransformf& EditLocalTransform(NodeIndex node);
+
+	void SetLocalTransform(NodeIndex node, TRSTransformf const& transform);
+
+	//! \brief Mark a node as dirty, so that its matrices and those of its
+	//!        descendants get recomputed by the next update.
+	void MarkDirty(NodeIndex node);
+
+	//! \brief Copy the local transforms of the nodes added via
+	//!        `AddHierarchy()`, marking those that changed as dirty.
+	void SyncFromNodes();
+
+	//! \brief Recompute the world and normal matrices of dirty nodes and
+	//!        their descendants, in a single pass over all nodes.
+	//!
+	//! @return how many nodes were recomputed
+	std::size_t UpdateTransforms();
+
+	//! \brief Recompute the world and normal matrices of dirty nodes and
+	//!        their descendants on the threads of |pool|, giving the exact
+	//!        same results as `UpdateTransforms()`.
+	//!
+	//! Nodes are grouped by depth, and each level is split into chunks
+	//! which the worker threads claim until none is left, so that threads
+	//! finishing early take over the remaining work; levels too small to
+	//! be worth splitting are processed on the calling thread, which must
+	//! not be one of the pool's.
+	//!
+	//! @param [in] pool the threads to update the nodes on
+	//! @return how many nodes were recomputed
+	std::size_t UpdateTransforms(ThreadPool& pool);
+
+	//! \brief Return the matrix transforming from the model space of a
+	//!        node to world space, as of the last update.
+	glm::mat4 const& GetWorldMatrix(NodeIndex node) const;
+
+	//! \brief Return the matrix transforming normals from the model space
+	//!        of a node to world space, as of the last update.
+	glm::mat4 const& GetNormalMatrix(NodeIndex node) const;
+
+	//! \brief Render the nodes added via `AddHierarchy()`, using the
+	//!        matrices from the last update.
+	//!
+	//! @param [in] view_projection Matrix transforming from world-space to
+	//!             clip-space
+	void Render(glm::mat4 const& view_projection) const;
+
+	//! \brief Add draws of the nodes added via `AddHierarchy()` to
+	//!        |queue|, using the matrices from the last update.
+	//!
+	//! @param [in] queue the queue to add the draws to
+	//! @param [in] view_projection Matrix transforming from world-space to
+	//!             clip-space
+	//! @param [in] pass the pass the draws belong to
+	void Submit(RenderQueue& queue, glm::mat4 const& view_projection, std::uint32_t pass = 0u) const;
+
+private:
+	enum Flag : std::uint8_t {
+		LocalDirty   = 1u << 0, //!< The local transform changed since the last update
+		WorldChanged = 1u << 1  //!< The world matrix was recomputed by the last update
+	};
+
+	//! \brief Recompute the matrices of |node| if it or its parent moved,
+	//!        and return whether it did.
+	bool UpdateNode(NodeIndex node);
+
+	//! \brief Sort the nodes by depth, for `UpdateTransforms(ThreadPool&)`.
+	void SortByDepth();
+
+	std::vector<TRSTransformf> mLocalTransforms;
+	std::vector<glm::mat4> mWorldMatrices;
+	std::vector<glm::mat4> mNormalMatrices;
+	std::vector<NodeIndex> mParents;
+	std::vector<std::uint8_t> mFlags;
+	std::vector<Node const*> mNodes; //!< The `Node` each entry was added from, if any
+
+	// All node indices sorted by depth, with where each depth starts; only
+	// rebuilt after nodes got added.
+	std::vector<NodeIndex> mNodesByDepth;
+	std::vector<std::size_t> mDepthOffsets;
+	bool mIsDepthSortOutdated{ true };
+};
+
+namespace bonobo
+{
+	//! \brief Outcome of `benchmarkSceneGraph()`; durations are the fastest
+	//!        of all repetitions, in milliseconds.
+	struct scene_graph_benchmark_stats {
+		std::size_t nodes_nb{ 0u };                //!< Nodes in the generated hierarchy
+		std::size_t moving_nodes_nb{ 0u };         //!< Nodes whose local transform changes every update
+		std::size_t updated_nodes_nb{ 0u };        //!< Nodes recomputed when only the moving ones changed, including their descendants
+		float node_traversal_ms{ 0.0f };           //!< Traversing `Node` children pointers, recomputing all matrices
+		float flat_full_update_ms{ 0.0f };         //!< `FlatSceneGraph::UpdateTransforms()` with all nodes dirty
+		float flat_partial_update_ms{ 0.0f };      //!< `FlatSceneGraph::UpdateTransforms()` with only the moving nodes dirty
+		std::size_t threads_nb{ 0u };              //!< Worker threads used by the parallel updates, or 0 if they were not run
+		float parallel_full_update_ms{ 0.0f };     //!< `FlatSceneGraph::UpdateTransforms(ThreadPool&)` with all nodes dirty
+		float parallel_partial_update_ms{ 0.0f };  //!< `FlatSceneGraph::UpdateTransforms(ThreadPool&)` with only the moving nodes dirty
+		bool is_parallel_identical{ false };       //!< Whether the parallel updates gave bit-identical matrices to the serial ones
+	};
+
+	//! \brief Generate a random hierarchy of `Node`s, and time computing
+	//!        the world and normal matrices of all of them by traversing
+	//!        it, and by updating a `FlatSceneGraph` built from it.
+	//!
+	//! No OpenGL call is made.
+	//!
+	//! @param [in] nodes_nb how many nodes to generate
+	//! @param [in] moving_ratio fraction of the nodes moving every update
+	//! @param [in] repetitions_nb how many times each method is timed
+	//! @param [in] pool if not null, the parallel updates are timed on its
+	//!             threads as well, and their results compared to the
+	//!             serial ones
+	scene_graph_benchmark_stats benchmarkSceneGraph(std::size_t nodes_nb, float moving_ratio,
+	                                                unsigned int repetitions_nb, ThreadPool* pool = nullptr);
+}
@@ -21,6 +21,7 @@ void (* textout_func)(Type, const char *) = nullptr;
 std::unordered_map<size_t, size_t> once_map;
 size_t output_targets = LOG_OUT_STD | LOG_OUT_CUSTOM | LOG_OUT_FILE;
 std::mutex fileMutex;
+std::mutex reportMutex; // Reports can be issued from worker threads.
 char log_result_string[RESULT_MAX_STRING_LENGTH];
 bool logIncludeThreadID = false;
 
@@ -131,6 +132,8 @@ void Report(
 		return;
 #endif
 
+	std::lock_guard<std::mutex> lock(reportMutex);
+
 	size_t len;
 	va_list args;
 	va_start(args, str);
@@ -3,6 +3,8 @@
 #include "Log.h"
 #include "LogView.h"
 
+#include <mutex>
+
 #ifdef _WIN32
 #pragma warning (disable : 4996) // This function or variable may be unsafe
 #endif
@@ -15,6 +17,7 @@ int Log::View::mBufferPtr = 0;
 bool Log::View::mAutoScroll = true;
 bool Log::View::mScrollToBottom = true;
 static ImVec4 logViewTypeColor[Log::N_TYPES];
+static std::mutex logViewMutex; // Feed() is called from worker threads too.
 
 void Log::View::Init()
 {
@@ -48,7 +51,7 @@ void Log::View::Render()
 	}
 
 	bool const copyToClipboard = ImGui::SmallButton("Copy"); ImGui::SameLine();
-	mScrollToBottom = mScrollToBottom || ImGui::SmallButton("Scroll to bottom"); ImGui::SameLine();
+	bool const scrollToBottom = ImGui::SmallButton("Scroll to bottom"); ImGui::SameLine();
 	if (ImGui::SmallButton("Clear")) ClearLog();
 
 	ImGui::Separator();
@@ -78,6 +81,8 @@ void Log::View::Render()
 	if (copyToClipboard)
 		ImGui::LogToClipboard();
 
+	std::unique_lock<std::mutex> lock(logViewMutex);
+	mScrollToBottom = mScrollToBottom || scrollToBottom;
 	for (int i = 0; i < BUFFER_ROWS; i++) {
 		int pos = (BUFFER_ROWS + (mBufferPtr + i)) % BUFFER_ROWS;
 		if (mLen[pos] == 0 || !filter.PassFilter(mBuffer[pos]))
@@ -92,6 +97,7 @@ void Log::View::Render()
 	if (mScrollToBottom || (mAutoScroll && ImGui::GetScrollY() >= ImGui::GetScrollMaxY()))
             ImGui::SetScrollHereY(1.0f);
 	mScrollToBottom = false;
+	lock.unlock();
 
 	ImGui::PopStyleVar();
 	ImGui::EndChild();
@@ -101,6 +107,7 @@ void Log::View::Render()
 
 void Log::View::Feed(Log::Type type, const char *msg)
 {
+	std::lock_guard<std::mutex> lock(logViewMutex);
 	strncpy(mBuffer[mBufferPtr], msg, BUFFER_WIDTH - 1);
 	mLen[mBufferPtr] = (int) strlen(msg);
 	mType[mBufferPtr] = type;
@@ -111,6 +118,7 @@ void Log::View::Feed(Log::Type type, const char *msg)
 
 void Log::View::ClearLog()
 {
+	std::lock_guard<std::mutex> lock(logViewMutex);
 	for (int& length : mLen)
 		length = 0;
 	mBufferPtr = 0;
@@ -0,0 +1,250 @@
+#include "RenderQueue.hpp"
+
+#include "node.hpp"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace
+{
+	constexpr unsigned int depth_bits = 20u;
+	constexpr unsigned int vertex_array_bits = 12u;
+	constexpr unsigned int material_bits = 16u;
+	constexpr unsigned int program_bits = 12u;
+	constexpr unsigned int pass_bits = 4u;
+	static_assert(depth_bits + vertex_array_bits + material_bits + program_bits + pass_bits == 64u,
+	              "Sort key fields should fill 64 bits.");
+
+	std::uint64_t maskField(std::uint64_t value, unsigned int bits)
+	{
+		return value & ((std::uint64_t(1) << bits) - 1u);
+	}
+}
+
+constexpr GLuint GLStateTracker::Unknown;
+
+std::uint32_t GLStateTracker::Stats::GetStateChangesNb() const
+{
+	return program_changes_nb + vertex_array_changes_nb + texture_changes_nb
+	     + sampler_changes_nb + material_changes_nb;
+}
+
+GLStateTracker::GLStateTracker()
+{
+	Invalidate();
+}
+
+GLStateTracker& GLStateTracker::GetShared()
+{
+	static GLStateTracker tracker;
+	return tracker;
+}
+
+void GLStateTracker::Invalidate()
+{
+	mProgram = Unknown;
+	mVertexArray = Unknown;
+	mActiveUnit = Unknown;
+	mTextures.assign(mTextures.size(), TextureBinding());
+	mSamplers.assign(mSamplers.size(), Unknown);
+	mMaterial = bonobo::invalid_material_id;
+}
+
+void GLStateTracker::UseProgram(GLuint program)
+{
+	if (program == mProgram) {
+		++mStats.redundant_changes_nb;
+		return;
+	}
+
+	glUseProgram(program);
+	mProgram = program;
+	++mStats.program_changes_nb;
+}
+
+void GLStateTracker::BindVertexArray(GLuint vertex_array)
+{
+	if (vertex_array == mVertexArray) {
+		++mStats.redundant_changes_nb;
+		return;
+	}
+
+	glBindVertexArray(vertex_array);
+	mVertexArray = vertex_array;
+	++mStats.vertex_array_changes_nb;
+}
+
+void GLStateTracker::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (unit >= mTextures.size())
+		mTextures.resize(unit + 1u);
+
+	// Only one target per unit is tracked: binding another target leaves
+	// the previous one bound, but it will be rebound when needed again.
+	auto& binding = mTextures[unit];
+	if (binding.target == target && binding.texture == texture) {
+		++mStats.redundant_changes_nb;
+		return;
+	}
+
+	ActivateUnit(unit);
+	glBindTexture(target, texture);
+	binding.target = target;
+	binding.texture = texture;
+	++mStats.texture_changes_nb;
+}
+
+void GLStateTracker::BindSampler(GLuint unit, GLuint sampler)
+{
+	if (unit >= mSamplers.size())
+		mSamplers.resize(unit + 1u, Unknown);
+
+	if (mSamplers[unit] == sampler) {
+		++mStats.redundant_changes_nb;
+		return;
+	}
+
+	glBindSampler(unit, sampler);
+	mSamplers[unit] = sampler;
+	++mStats.sampler_changes_nb;
+}
+
+void GLStateTracker::BindMaterialConstants(bonobo::material_id material)
+{
+	if (material == mMaterial) {
+		++mStats.redundant_changes_nb;
+		return;
+	}
+
+	bonobo::bindMaterialConstants(material);
+	mMaterial = material;
+	++mStats.material_changes_nb;
+}
+
+void GLStateTracker::BindMaterialConstants(bonobo::material_data const& constants)
+{
+	bonobo::bindMaterialConstants(constants);
+	mMaterial = bonobo::invalid_material_id;
+	++mStats.material_changes_nb;
+}
+
+void GLStateTracker::RestoreDefaults()
+{
+	BindVertexArray(0u);
+	UseProgram(0u);
+	ActivateUnit(0u);
+}
+
+void GLStateTracker::CountDrawCall()
+{
+	++mStats.draw_calls_nb;
+}
+
+GLStateTracker::Stats const& GLStateTracker::GetStats() const
+{
+	return mStats;
+}
+
+void GLStateTracker::ResetStats()
+{
+	mStats = Stats();
+}
+
+void GLStateTracker::ActivateUnit(GLuint unit)
+{
+	if (unit == mActiveUnit)
+		return;
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	mActiveUnit = unit;
+}
+
+std::uint64_t RenderQueue::MakeKey(std::uint32_t pass, GLuint program, bonobo::material_id material,
+                                   GLuint vertex_array, float depth)
+{
+	auto const max_depth = static_cast<float>((1u << depth_bits) - 1u);
+	auto const quantised_depth = static_cast<std::uint64_t>(glm::clamp(depth, 0.0f, 1.0f) * max_depth);
+
+	auto key = maskField(pass, pass_bits);
+	key = (key << program_bits) | maskField(program, program_bits);
+	key = (key << material_bits) | maskField(material, material_bits);
+	key = (key << vertex_array_bits) | maskField(vertex_array, vertex_array_bits);
+	key = (key << depth_bits) | quantised_depth;
+
+	return key;
+}
+
+float RenderQueue::GetDepth(glm::mat4 const& model_to_clip, glm::vec3 const& point)
+{
+	// Points behind the camera are only drawn when their bounds straddle
+	// the near plane, so consider them as close as can be.
+	auto const clip = model_to_clip * glm::vec4(point, 1.0f);
+	if (clip.w <= 0.0f)
+		return 0.0f;
+
+	return 0.5f * clip.z / clip.w + 0.5f;
+}
+
+void RenderQueue::SortPackets(std::vector<Packet>& packets, std::vector<Packet>& scratch)
+{
+	constexpr std::size_t digits_nb = sizeof(std::uint64_t);
+	constexpr std::size_t buckets_nb = 256u;
+	auto const packets_nb = packets.size();
+	if (packets_nb < 2u)
+		return;
+
+	// The histograms of all digits are gathered in a single pass.
+	std::array<std::array<std::size_t, buckets_nb>, digits_nb> histograms{};
+	for (auto const& packet : packets)
+		for (std::size_t digit = 0u; digit < digits_nb; ++digit)
+			++histograms[digit][(packet.key >> (8u * digit)) & 0xFFu];
+
+	scratch.resize(packets_nb);
+	for (std::size_t digit = 0u; digit < digits_nb; ++digit) {
+		auto& histogram = histograms[digit];
+		auto const first_byte = (packets.front().key >> (8u * digit)) & 0xFFu;
+		if (histogram[first_byte] == packets_nb)
+			continue;
+
+		std::size_t offset = 0u;
+		for (auto& count : histogram)
+			offset += std::exchange(count, offset);
+
+		for (auto const& packet : packets)
+			scratch[histogram[(packet.key >> (8u * digit)) & 0xFFu]++] = packet;
+		packets.swap(scratch);
+	}
+}
+
+void RenderQueue::Clear()
+{
+	mPackets.clear();
+	mDraws.clear();
+}
+
+void RenderQueue::Submit(std::uint64_t key, Node const& node, glm::mat4 const& view_projection,
+                         glm::mat4 const& world, glm::mat4 const& normal_model_to_world)
+{
+	mPackets.push_back({ key, static_cast<std::uint32_t>(mDraws.size()) });
+	mDraws.push_back({ &node, view_projection, world, normal_model_to_world });
+}
+
+std::size_t RenderQueue::GetPacketsNb() const
+{
+	return mPackets.size();
+}
+
+void RenderQueue::Flush(GLStateTracker& state)
+{
+	SortPackets(mPackets, mScratch);
+
+	state.Invalidate();
+	for (auto const& packet : mPackets) {
+		auto const& draw = mDraws[packet.index];
+		draw.node->draw(draw.view_projection, draw.world, draw.normal_model_to_world, state);
+	}
+	state.RestoreDefaults();
+
+	Clear();
+}
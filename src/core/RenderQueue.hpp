@@ -0,0 +1,172 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+class Node;
+
+//! \brief Shadow copy of the OpenGL bindings changed while drawing, so
+//!        that binding what is already bound is skipped rather than sent to
+//!        the driver.
+//!
+//! The tracker only knows about bindings made through it: after any other
+//! code changed them, `Invalidate()` has to be called, after which the next
+//! binding of each kind is always issued.
+class GLStateTracker
+{
+public:
+	//! \brief Running totals since the last call to `ResetStats()`.
+	struct Stats {
+		std::uint32_t draw_calls_nb{ 0u };             //!< Draw calls reported via `CountDrawCall()`
+		std::uint32_t program_changes_nb{ 0u };        //!< `glUseProgram()` calls issued
+		std::uint32_t vertex_array_changes_nb{ 0u };   //!< `glBindVertexArray()` calls issued
+		std::uint32_t texture_changes_nb{ 0u };        //!< `glBindTexture()` calls issued
+		std::uint32_t sampler_changes_nb{ 0u };        //!< `glBindSampler()` calls issued
+		std::uint32_t material_changes_nb{ 0u };       //!< Material constants bound
+		std::uint32_t redundant_changes_nb{ 0u };      //!< Bindings skipped as already in place
+
+		//! \brief Return how many bindings were issued, of any kind.
+		std::uint32_t GetStateChangesNb() const;
+	};
+
+	GLStateTracker();
+
+	//! \brief Return the tracker used by `Node::render()` and
+	//!        `RenderQueue::Flush()` by default, whose statistics
+	//!        applications can reset and display once per frame.
+	static GLStateTracker& GetShared();
+
+	//! \brief Forget all bindings, for example after code bypassing the
+	//!        tracker changed them; statistics are kept.
+	void Invalidate();
+
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vertex_array);
+
+	//! \brief Bind |texture| to |target| of texture unit |unit|, making
+	//!        that unit active if it is not already.
+	void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+	void BindSampler(GLuint unit, GLuint sampler);
+
+	//! \brief Bind the constants of a material of the material table to
+	//!        the `MaterialConstants` block, see
+	//!        `bonobo::bindMaterialConstants()`.
+	void BindMaterialConstants(bonobo::material_id material);
+
+	//! \brief Bind constants not belonging to the material table; this is
+	//!        always issued, as their content may have changed.
+	void BindMaterialConstants(bonobo::material_data const& constants);
+
+	//! \brief Unbind the program and vertex array, and make the first
+	//!        texture unit active, as expected by code not using the
+	//!        tracker.
+	void RestoreDefaults();
+
+	void CountDrawCall();
+
+	Stats const& GetStats() const;
+	void ResetStats();
+
+private:
+	static constexpr GLuint Unknown = std::numeric_limits<GLuint>::max();
+
+	struct TextureBinding {
+		GLenum target{ GL_NONE };
+		GLuint texture{ Unknown };
+	};
+
+	void ActivateUnit(GLuint unit);
+
+	GLuint mProgram{ Unknown };
+	GLuint mVertexArray{ Unknown };
+	GLuint mActiveUnit{ Unknown };
+	std::vector<TextureBinding> mTextures;
+	std::vector<GLuint> mSamplers;
+	bonobo::material_id mMaterial{ bonobo::invalid_material_id };
+	Stats mStats;
+};
+
+//! \brief A list of draws collected over a frame, sorted before being
+//!        issued so that draws sharing state end up next to each other.
+//!
+//! Each draw is described by a compact packet made of a 64-bit sort key
+//! and the index of its parameters, so that sorting only moves 16 bytes
+//! per draw. Keys are laid out as, from the most significant bits:
+//! pass (4 bits), program (12 bits), material (16 bits), vertex array
+//! (12 bits) and depth (20 bits). Draws are therefore grouped by pass,
+//! then by program, material and vertex array, the most to the least
+//! expensive state to change, and drawn front to back within a group.
+//! Names larger than their field only get grouped less well.
+//!
+//! Packets are sorted with a least-significant-digit radix sort, one byte
+//! at a time, skipping the bytes all keys share.
+class RenderQueue
+{
+public:
+	//! \brief A draw, as sorted by the queue.
+	struct Packet {
+		std::uint64_t key;
+		std::uint32_t index; //!< Index of the draw parameters, for whoever submitted the packet
+	};
+
+	//! \brief Assemble a sort key.
+	//!
+	//! @param [in] pass the pass the draw belongs to, drawn in increasing
+	//!             order; only the lowest 4 bits are used
+	//! @param [in] program OpenGL shader program used by the draw
+	//! @param [in] material ID of the material used by the draw
+	//! @param [in] vertex_array OpenGL vertex array used by the draw
+	//! @param [in] depth normalised depth of the draw, between 0 (near)
+	//!             and 1 (far); values outside are clamped
+	static std::uint64_t MakeKey(std::uint32_t pass, GLuint program, bonobo::material_id material,
+	                             GLuint vertex_array, float depth);
+
+	//! \brief Return the normalised depth of |point|, in model space, for
+	//!        `MakeKey()`.
+	static float GetDepth(glm::mat4 const& model_to_clip, glm::vec3 const& point);
+
+	//! \brief Sort |packets| by increasing key, keeping packets with equal
+	//!        keys in submission order.
+	//!
+	//! @param [in,out] packets the packets to sort
+	//! @param [in,out] scratch memory used while sorting, kept around to
+	//!                 avoid reallocating it on every sort
+	static void SortPackets(std::vector<Packet>& packets, std::vector<Packet>& scratch);
+
+	//! \brief Remove all draws.
+	void Clear();
+
+	//! \brief Add a draw of |node|, see `Node::submit()`.
+	void Submit(std::uint64_t key, Node const& node, glm::mat4 const& view_projection,
+	            glm::mat4 const& world, glm::mat4 const& normal_model_to_world);
+
+	std::size_t GetPacketsNb() const;
+
+	//! \brief Sort the draws, issue them, and clear the queue.
+	//!
+	//! Bindings go through |state|, which is invalidated first; the program
+	//! and vertex array are unbound at the end. The `set_uniforms`
+	//! callbacks of the nodes are called for each draw, and may only set
+	//! uniforms, otherwise |state| gets out of sync.
+	void Flush(GLStateTracker& state = GLStateTracker::GetShared());
+
+private:
+	struct Draw {
+		Node const* node;
+		glm::mat4 view_projection;
+		glm::mat4 world;
+		glm::mat4 normal_model_to_world;
+	};
+
+	std::vector<Packet> mPackets;
+	std::vector<Packet> mScratch;
+	std::vector<Draw> mDraws;
+};
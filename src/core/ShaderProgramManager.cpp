@@ -4,6 +4,7 @@
 
 #include "Log.h"
 #include "opengl.hpp"
+#include "program_reflection.hpp"
 #include "various.hpp"
 
 #include <imgui.h>
@@ -14,6 +15,7 @@ ShaderProgramManager::~ShaderProgramManager()
 {
 	for (auto const& i : program_entries) {
 		if (i.first != 0u) {
+			bonobo::program_reflection::invalidate(i.first);
 			glDeleteProgram(i.first);
 			i.first = 0u;
 		}
@@ -55,8 +57,10 @@ bool ShaderProgramManager::ReloadAllPrograms()
 	bool encountered_failures = false;
 	for (std::size_t i = 0; i < program_entries.size(); ++i) {
 		auto& program = program_entries[i].first;
-		if (program != 0u)
+		if (program != 0u) {
+			bonobo::program_reflection::invalidate(program);
 			glDeleteProgram(program);
+		}
 		program = 0u;
 		ProcessProgram(i);
 		encountered_failures |= program == 0u;
@@ -90,7 +94,7 @@ void ShaderProgramManager::ProcessProgram(std::size_t const program_index)
 
 	for (auto const& i : program_data) {
 		std::string const full_filename = config::shaders_path(i.second);
-		auto const shader_source = utils::slurp_file(full_filename);
+		auto const shader_source = utils::opengl::shader::read_source(full_filename);
 		if (shader_source.empty()) {
 			LogError("Retrieval of shader '%s' failed; see previous message for details.", full_filename.c_str());
 			return;
@@ -107,6 +111,9 @@ void ShaderProgramManager::ProcessProgram(std::size_t const program_index)
 	}
 
 	program = utils::opengl::shader::generate_program(shaders);
+	// The driver may hand out the ID of a program deleted elsewhere.
+	if (program != 0u)
+		bonobo::program_reflection::invalidate(program);
 	utils::opengl::debug::nameObject(GL_PROGRAM, program, program_names[program_index]);
 
 	for (auto& shader : shaders)
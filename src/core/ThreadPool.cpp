@@ -0,0 +1,50 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t threads_nb)
+{
+	if (threads_nb == 0u)
+		threads_nb = std::max(std::thread::hardware_concurrency(), 1u);
+
+	mThreads.reserve(threads_nb);
+	for (std::size_t i = 0u; i < threads_nb; ++i)
+		mThreads.emplace_back(&ThreadPool::Work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mIsStopping = true;
+	}
+	mCondition.notify_all();
+
+	for (auto& thread : mThreads)
+		thread.join();
+}
+
+std::size_t
+ThreadPool::GetThreadsNb() const
+{
+	return mThreads.size();
+}
+
+void
+ThreadPool::Work()
+{
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this](){ return mIsStopping || !mTasks.empty(); });
+			if (mTasks.empty())
+				return;
+
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//! \brief A fixed-size pool of worker threads, consuming tasks from a shared
+//!        first-in first-out queue.
+//!
+//! Tasks must not make any OpenGL call, as the OpenGL context is only
+//! current on the thread which created the window.
+class ThreadPool
+{
+public:
+	//! \brief Start the worker threads.
+	//!
+	//! @param [in] threads_nb how many worker threads to start; if 0, as
+	//!             many threads as there are hardware threads are started.
+	explicit ThreadPool(std::size_t threads_nb = 0u);
+
+	//! \brief Wait for all queued tasks to complete, then stop the worker
+	//!        threads.
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	//! \brief Queue a task for execution on one of the worker threads.
+	//!
+	//! @param [in] task a callable taking no arguments
+	//! @return a future holding the value returned by the task, or the
+	//!         exception thrown by it
+	template<typename Task>
+	std::future<typename std::result_of<Task()>::type> Enqueue(Task&& task);
+
+	//! \brief Return how many worker threads are running.
+	std::size_t GetThreadsNb() const;
+
+private:
+	void Work();
+
+	std::vector<std::thread> mThreads;
+	std::deque<std::function<void()>> mTasks;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mIsStopping{ false };
+};
+
+template<typename Task>
+std::future<typename std::result_of<Task()>::type>
+ThreadPool::Enqueue(Task&& task)
+{
+	using Result = typename std::result_of<Task()>::type;
+
+	// std::function requires copyable callables, which std::packaged_task
+	// is not.
+	auto const packaged_task = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+	auto future = packaged_task->get_future();
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.emplace_back([packaged_task](){ (*packaged_task)(); });
+	}
+	mCondition.notify_one();
+
+	return future;
+}
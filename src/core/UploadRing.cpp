@@ -0,0 +1,273 @@
+#include "UploadRing.hpp"
+
+#include "core/Log.h"
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+	//! \brief Offsets into the ring are kept aligned on this many bytes,
+	//!        which covers any texel or index type.
+	GLsizeiptr const allocation_alignment = 16;
+
+	//! \brief How long to wait on a single fence before giving up, in
+	//!        nanoseconds.
+	GLuint64 const fence_timeout_ns = 1000000000u;
+
+	//! \brief How many times a single allocation may wait on the GPU
+	//!        before giving up, so that callers fall back to client memory
+	//!        rather than stall for long.
+	unsigned int const max_stalls_per_allocation = 4u;
+
+	//! \brief Return whether `glBufferStorage()` can be called, loading it
+	//!        from ARB_buffer_storage on contexts older than OpenGL 4.4.
+	bool loadBufferStorage()
+	{
+		if (GLAD_GL_VERSION_4_4 && glBufferStorage != nullptr)
+			return true;
+
+		GLint extensions_nb = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensions_nb);
+		for (GLint i = 0; i < extensions_nb; ++i) {
+			auto const extension = reinterpret_cast<char const*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+			if (extension == nullptr || std::strcmp(extension, "GL_ARB_buffer_storage") != 0)
+				continue;
+
+			glad_glBufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(glfwGetProcAddress("glBufferStorage"));
+			return glBufferStorage != nullptr;
+		}
+
+		return false;
+	}
+
+	GLsizeiptr alignSize(GLsizeiptr size)
+	{
+		return (size + allocation_alignment - 1) / allocation_alignment * allocation_alignment;
+	}
+}
+
+UploadRing::UploadRing(GLsizeiptr capacity) : mCapacity(alignSize(capacity))
+{
+	if (!loadBufferStorage()) {
+		LogInfo("Buffer storage is not available: uploading from client memory.");
+		return;
+	}
+
+	// The buffer stays mapped for its whole lifetime; coherent mapping
+	// makes writes visible to the GPU without explicit flushes.
+	GLbitfield const flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &mBuffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, mBuffer);
+	glBufferStorage(GL_COPY_READ_BUFFER, mCapacity, nullptr, flags);
+	mData = static_cast<std::uint8_t*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, mCapacity, flags));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0u);
+
+	if (mData == nullptr) {
+		LogWarning("Failed to map a %.3f MiB upload ring: uploading from client memory.",
+		           static_cast<float>(mCapacity) / (1024.0f * 1024.0f));
+		glDeleteBuffers(1, &mBuffer);
+		mBuffer = 0u;
+		return;
+	}
+
+	LogInfo("Uploading through a %.3f MiB persistently-mapped ring.",
+	        static_cast<float>(mCapacity) / (1024.0f * 1024.0f));
+}
+
+UploadRing::~UploadRing()
+{
+	for (auto const& segment : mSegments) {
+		if (segment.fence == nullptr)
+			continue;
+		glClientWaitSync(segment.fence, GL_SYNC_FLUSH_COMMANDS_BIT, fence_timeout_ns);
+		glDeleteSync(segment.fence);
+	}
+
+	// Deleting the buffer also unmaps it.
+	glDeleteBuffers(1, &mBuffer);
+}
+
+bool
+UploadRing::IsSupported() const
+{
+	return mData != nullptr;
+}
+
+GLuint
+UploadRing::GetBuffer() const
+{
+	return mBuffer;
+}
+
+GLsizeiptr
+UploadRing::GetCapacity() const
+{
+	return mCapacity;
+}
+
+UploadRing::Allocation
+UploadRing::TryAllocate(GLsizeiptr size)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto const allocation = AllocateLocked(size);
+	if (allocation.data == nullptr && IsSupported())
+		++mStats.failures_nb;
+	return allocation;
+}
+
+UploadRing::Allocation
+UploadRing::Allocate(GLsizeiptr size)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	ReclaimLocked(false);
+	auto allocation = AllocateLocked(size);
+	for (unsigned int stalls_nb = 0u;
+	     allocation.data == nullptr && stalls_nb < max_stalls_per_allocation && !mHasWaitFailed
+	     && !mSegments.empty() && mSegments.front().state == SegmentState::submitted && alignSize(size) <= mCapacity;
+	     ++stalls_nb) {
+		auto const stall_start_time = std::chrono::high_resolution_clock::now();
+		auto const has_reclaimed = ReclaimLocked(true);
+		auto const stall_end_time = std::chrono::high_resolution_clock::now();
+		++mStats.stalls_nb;
+		mStats.stall_duration_ms += std::chrono::duration<float, std::milli>(stall_end_time - stall_start_time).count();
+
+		// The fence timed out or the wait failed: waiting again would not
+		// fare better.
+		if (!has_reclaimed)
+			break;
+
+		allocation = AllocateLocked(size);
+	}
+
+	if (allocation.data == nullptr && IsSupported())
+		++mStats.failures_nb;
+	return allocation;
+}
+
+void
+UploadRing::Submit(Allocation const& allocation)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto const segment = FindSegmentLocked(allocation);
+	if (segment == nullptr)
+		return;
+
+	segment->state = SegmentState::submitted;
+	segment->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	// Not waiting here: this only reclaims what the GPU already went
+	// through, so that worker threads find space available.
+	ReclaimLocked(false);
+}
+
+void
+UploadRing::Release(Allocation const& allocation)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto const segment = FindSegmentLocked(allocation);
+	if (segment != nullptr)
+		segment->state = SegmentState::released;
+}
+
+UploadRing::Stats
+UploadRing::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	return mStats;
+}
+
+UploadRing::Allocation
+UploadRing::AllocateLocked(GLsizeiptr size)
+{
+	Allocation allocation;
+	auto const aligned_size = alignSize(size);
+	if (!IsSupported() || size <= 0 || aligned_size > mCapacity)
+		return allocation;
+
+	// Free space is the range from the head to the oldest segment still
+	// in use, possibly wrapping around the end of the buffer.
+	GLintptr offset = -1;
+	if (mSegments.empty()) {
+		offset = 0;
+	} else {
+		auto const tail = mSegments.front().offset;
+		if (mHead > tail) {
+			if (mHead + aligned_size <= mCapacity)
+				offset = mHead;
+			else if (aligned_size <= tail)
+				offset = 0;
+		} else if (mHead + aligned_size <= tail) {
+			offset = mHead;
+		}
+	}
+	if (offset < 0)
+		return allocation;
+
+	mSegments.push_back({ offset, aligned_size, SegmentState::writing, nullptr });
+	mHead = offset + aligned_size;
+
+	allocation.data = mData + offset;
+	allocation.offset = offset;
+	allocation.size = size;
+
+	++mStats.allocations_nb;
+	mStats.bytes_allocated += static_cast<std::uint64_t>(size);
+
+	return allocation;
+}
+
+bool
+UploadRing::ReclaimLocked(bool wait)
+{
+	bool has_reclaimed = false;
+	while (!mSegments.empty()) {
+		auto& segment = mSegments.front();
+		if (segment.state == SegmentState::writing)
+			break;
+
+		if (segment.state == SegmentState::submitted) {
+			auto const status = glClientWaitSync(segment.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+			                                     wait ? fence_timeout_ns : 0u);
+			if (status == GL_WAIT_FAILED && !mHasWaitFailed) {
+				// The segment can not be known to be unused anymore, so it
+				// is never reclaimed, and allocations stop waiting.
+				LogWarning("Waiting on an upload ring fence failed: uploading from client memory once the ring is full.");
+				mHasWaitFailed = true;
+			}
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+			glDeleteSync(segment.fence);
+			// Fences complete in order, so the following ones are only
+			// polled.
+			wait = false;
+		}
+
+		mSegments.pop_front();
+		has_reclaimed = true;
+	}
+
+	if (mSegments.empty())
+		mHead = 0;
+
+	return has_reclaimed;
+}
+
+UploadRing::Segment*
+UploadRing::FindSegmentLocked(Allocation const& allocation)
+{
+	if (allocation.data == nullptr)
+		return nullptr;
+
+	for (auto& segment : mSegments)
+		if (segment.offset == allocation.offset)
+			return &segment;
+	return nullptr;
+}
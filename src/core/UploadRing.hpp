@@ -0,0 +1,133 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+//! \brief A ring of staging memory, in a buffer persistently mapped via
+//!        `glBufferStorage()`, through which textures and buffers get
+//!        uploaded.
+//!
+//! Worker threads can reserve part of the ring and write texels straight
+//! into it, leaving the thread owning the OpenGL context to only issue the
+//! copies, sourcing from the ring bound to GL_PIXEL_UNPACK_BUFFER or
+//! GL_COPY_READ_BUFFER, rather than having the driver copy client memory
+//! during `glTexImage2D()` or `glBufferSubData()`.
+//!
+//! Space is reclaimed in the order it was allocated, once the GPU is done
+//! reading from it: each submitted allocation is followed by a fence, which
+//! only gets waited upon when the ring is full.
+//!
+//! Buffer storage is part of OpenGL 4.4 and of the ARB_buffer_storage
+//! extension; without it, `IsSupported()` returns false and callers should
+//! keep uploading from client memory.
+class UploadRing
+{
+public:
+	//! \brief Part of the ring reserved by `TryAllocate()` or `Allocate()`.
+	struct Allocation {
+		std::uint8_t* data{ nullptr }; //!< Where to write, or null if the allocation failed
+		GLintptr offset{ 0 };          //!< Offset of |data| in the buffer of the ring
+		GLsizeiptr size{ 0 };          //!< Size of the allocation, in bytes
+	};
+
+	//! \brief Running totals since the ring was created.
+	struct Stats {
+		std::uint64_t bytes_allocated{ 0u }; //!< Bytes successfully allocated
+		std::uint32_t allocations_nb{ 0u };  //!< Successful allocations
+		std::uint32_t failures_nb{ 0u };     //!< Allocations that did not fit
+		std::uint32_t stalls_nb{ 0u };       //!< Times the GPU had to be waited on to free space
+		float stall_duration_ms{ 0.0f };     //!< Time spent waiting on the GPU
+	};
+
+	//! \brief Create and map the buffer of the ring.
+	//!
+	//! This has to be called from the thread owning the OpenGL context.
+	//!
+	//! @param [in] capacity size of the ring, in bytes
+	explicit UploadRing(GLsizeiptr capacity);
+
+	//! \brief Wait for the GPU to be done with the ring, then delete it.
+	//!
+	//! This has to be called from the thread owning the OpenGL context.
+	~UploadRing();
+
+	UploadRing(UploadRing const&) = delete;
+	UploadRing& operator=(UploadRing const&) = delete;
+
+	//! \brief Return whether the ring could be created; if not, all
+	//!        allocations fail.
+	bool IsSupported() const;
+
+	//! \brief Return the buffer backing the ring.
+	GLuint GetBuffer() const;
+
+	//! \brief Return the size of the ring, in bytes.
+	GLsizeiptr GetCapacity() const;
+
+	//! \brief Reserve part of the ring without waiting for any space to be
+	//!        reclaimed; this can be called from any thread.
+	//!
+	//! @param [in] size in bytes
+	//! @return the allocation, whose data is null if there was not enough
+	//!         space available
+	Allocation TryAllocate(GLsizeiptr size);
+
+	//! \brief Reserve part of the ring, waiting for the GPU to be done with
+	//!        previous allocations if needed.
+	//!
+	//! This has to be called from the thread owning the OpenGL context. It
+	//! still fails if |size| exceeds the capacity, or if the space is held
+	//! by allocations which were not submitted yet. Rather than blocking
+	//! indefinitely, it also fails once a fence did not signal within its
+	//! timeout, after a few waits, or if waiting on a fence ever failed.
+	//!
+	//! @param [in] size in bytes
+	//! @return the allocation, whose data is null on failure
+	Allocation Allocate(GLsizeiptr size);
+
+	//! \brief Mark an allocation as read by the commands issued so far,
+	//!        to be reclaimed once the GPU has executed them.
+	//!
+	//! This has to be called from the thread owning the OpenGL context,
+	//! right after issuing the commands reading from |allocation|.
+	void Submit(Allocation const& allocation);
+
+	//! \brief Give back an allocation which no command reads from; this can
+	//!        be called from any thread.
+	void Release(Allocation const& allocation);
+
+	//! \brief Return the running totals of the ring.
+	Stats GetStats() const;
+
+private:
+	enum class SegmentState : unsigned int {
+		writing = 0u,
+		submitted,
+		released
+	};
+
+	struct Segment {
+		GLintptr offset{ 0 };
+		GLsizeiptr size{ 0 };
+		SegmentState state{ SegmentState::writing };
+		GLsync fence{ nullptr };
+	};
+
+	Allocation AllocateLocked(GLsizeiptr size);
+	//! \brief Drop the oldest segments the GPU is done with, waiting on
+	//!        the first fence if |wait|; return whether any got dropped.
+	bool ReclaimLocked(bool wait);
+	Segment* FindSegmentLocked(Allocation const& allocation);
+
+	GLuint mBuffer{ 0u };
+	std::uint8_t* mData{ nullptr };
+	GLsizeiptr mCapacity{ 0 };
+	GLintptr mHead{ 0 };
+	std::deque<Segment> mSegments;
+	Stats mStats;
+	bool mHasWaitFailed{ false };
+	mutable std::mutex mMutex;
+};
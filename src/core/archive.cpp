@@ -0,0 +1,382 @@
+#include "archive.hpp"
+
+#include "core/Log.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace
+{
+	constexpr std::array<char, 8> archive_magic{ { 'B', 'N', 'B', 'P', 'A', 'C', 'K', '\0' } };
+	constexpr std::uint32_t archive_version = 1u;
+	constexpr std::uint64_t archive_alignment = 16u;
+
+	// Files are only stored compressed if that makes them at least that
+	// much smaller, as decompressing costs a copy that reading from the
+	// mapping does not.
+	constexpr double compression_ratio_threshold = 0.9;
+
+	// LZ4 block format: matches are at least 4 bytes long and at most 64 KiB
+	// away; the last 5 bytes are always literals, and the last match starts
+	// at least 12 bytes before the end.
+	constexpr std::size_t min_match_length = 4u;
+	constexpr std::size_t max_match_offset = 65535u;
+	constexpr std::size_t last_literals_length = 5u;
+	constexpr std::size_t match_safety_distance = 12u;
+	constexpr unsigned int hash_bits = 16u;
+
+	enum entry_flag : std::uint32_t {
+		entry_flag_compressed = 1u << 0
+	};
+
+	struct archive_header {
+		std::array<char, 8> magic;
+		std::uint32_t version;
+		std::uint32_t entries_nb;
+		std::uint64_t records_offset;
+		std::uint64_t paths_offset;
+		std::uint64_t paths_size;
+	};
+
+	struct entry_record {
+		std::uint64_t offset;
+		std::uint64_t stored_size;
+		std::uint64_t size;
+		std::int64_t modification_time;
+		std::uint32_t path_offset; //!< Offset from the start of the paths section
+		std::uint32_t path_length;
+		std::uint32_t flags;
+		std::uint32_t padding;
+	};
+
+	std::uint64_t align(std::uint64_t offset)
+	{
+		return (offset + archive_alignment - 1u) / archive_alignment * archive_alignment;
+	}
+
+	std::uint32_t read32(std::uint8_t const* bytes)
+	{
+		std::uint32_t value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	// Write a length which did not fit in the 4 bits of a token, as a run
+	// of 255 terminated by a smaller byte.
+	void writeLength(std::vector<std::uint8_t>& output, std::size_t length)
+	{
+		for (; length >= 255u; length -= 255u)
+			output.push_back(255u);
+		output.push_back(static_cast<std::uint8_t>(length));
+	}
+
+	bool readLength(std::uint8_t const* source, std::size_t source_size, std::size_t& offset, std::size_t& length)
+	{
+		std::uint8_t byte = 255u;
+		while (byte == 255u) {
+			if (offset >= source_size)
+				return false;
+			byte = source[offset++];
+			length += byte;
+		}
+		return true;
+	}
+
+	void writeSequence(std::vector<std::uint8_t>& output, std::uint8_t const* literals, std::size_t literals_length,
+	                   std::size_t match_offset, std::size_t match_length)
+	{
+		auto const extra_match_length = match_length - min_match_length;
+		output.push_back(static_cast<std::uint8_t>((std::min<std::size_t>(literals_length, 15u) << 4)
+		                                         | std::min<std::size_t>(extra_match_length, 15u)));
+		if (literals_length >= 15u)
+			writeLength(output, literals_length - 15u);
+		output.insert(output.end(), literals, literals + literals_length);
+		output.push_back(static_cast<std::uint8_t>(match_offset & 0xffu));
+		output.push_back(static_cast<std::uint8_t>(match_offset >> 8));
+		if (extra_match_length >= 15u)
+			writeLength(output, extra_match_length - 15u);
+	}
+
+	void writeLastLiterals(std::vector<std::uint8_t>& output, std::uint8_t const* literals, std::size_t literals_length)
+	{
+		output.push_back(static_cast<std::uint8_t>(std::min<std::size_t>(literals_length, 15u) << 4));
+		if (literals_length >= 15u)
+			writeLength(output, literals_length - 15u);
+		output.insert(output.end(), literals, literals + literals_length);
+	}
+}
+
+std::vector<std::uint8_t>
+utils::archive::compress(std::uint8_t const* source, std::size_t size)
+{
+	std::vector<std::uint8_t> output;
+	output.reserve(size + size / 255u + 16u);
+
+	std::size_t anchor = 0u;
+	if (size > match_safety_distance) {
+		// Positions are stored plus one, so that zero means none.
+		std::vector<std::uint32_t> last_positions(std::size_t(1u) << hash_bits, 0u);
+		auto const match_start_limit = size - match_safety_distance;
+		auto const match_end_limit = size - last_literals_length;
+		std::size_t i = 0u;
+		while (i < match_start_limit) {
+			auto const sequence = read32(source + i);
+			auto const hash = (sequence * 2654435761u) >> (32u - hash_bits);
+			auto const candidate = static_cast<std::size_t>(last_positions[hash]);
+			last_positions[hash] = static_cast<std::uint32_t>(i + 1u);
+			if (candidate == 0u || i - (candidate - 1u) > max_match_offset || read32(source + candidate - 1u) != sequence) {
+				++i;
+				continue;
+			}
+
+			auto const match = candidate - 1u;
+			auto match_length = min_match_length;
+			while (i + match_length < match_end_limit && source[match + match_length] == source[i + match_length])
+				++match_length;
+
+			writeSequence(output, source + anchor, i - anchor, i - match, match_length);
+			i += match_length;
+			anchor = i;
+		}
+	}
+	writeLastLiterals(output, source + anchor, size - anchor);
+
+	return output;
+}
+
+bool
+utils::archive::decompress(std::uint8_t const* source, std::size_t source_size, std::uint8_t* destination, std::size_t size)
+{
+	std::size_t input = 0u, output = 0u;
+	while (input < source_size) {
+		auto const token = source[input++];
+
+		std::size_t literals_length = token >> 4;
+		if (literals_length == 15u && !readLength(source, source_size, input, literals_length))
+			return false;
+		if (literals_length > source_size - input || literals_length > size - output)
+			return false;
+		std::memcpy(destination + output, source + input, literals_length);
+		input += literals_length;
+		output += literals_length;
+
+		// The last sequence only has literals.
+		if (input == source_size)
+			break;
+
+		if (source_size - input < 2u)
+			return false;
+		auto const match_offset = static_cast<std::size_t>(source[input]) | (static_cast<std::size_t>(source[input + 1u]) << 8);
+		input += 2u;
+		if (match_offset == 0u || match_offset > output)
+			return false;
+
+		std::size_t match_length = token & 0xfu;
+		if (match_length == 15u && !readLength(source, source_size, input, match_length))
+			return false;
+		match_length += min_match_length;
+		if (match_length > size - output)
+			return false;
+
+		// Matches may overlap what they produce, to repeat short patterns,
+		// so they are copied byte by byte.
+		auto const match = destination + output - match_offset;
+		for (std::size_t i = 0u; i < match_length; ++i)
+			destination[output + i] = match[i];
+		output += match_length;
+	}
+
+	return output == size;
+}
+
+utils::archive::reader::reader(std::string const& path) : _mapping(path)
+{
+	if (!_mapping.is_open())
+		return;
+
+	auto const fail = [this, &path](char const* reason){
+		LogError("Ignoring archive \"%s\": %s.", path.c_str(), reason);
+		_mapping = mapped_file();
+		_entries.clear();
+		_indices.clear();
+	};
+
+	auto const mapping_size = static_cast<std::uint64_t>(_mapping.size());
+	if (mapping_size < sizeof(archive_header)) {
+		fail("file is truncated");
+		return;
+	}
+
+	archive_header header;
+	std::memcpy(&header, _mapping.data(), sizeof(header));
+	if (header.magic != archive_magic || header.version != archive_version) {
+		fail("it was written by a different version");
+		return;
+	}
+	if (header.records_offset + static_cast<std::uint64_t>(header.entries_nb) * sizeof(entry_record) > header.paths_offset
+	 || header.paths_offset + header.paths_size > mapping_size) {
+		fail("file is truncated");
+		return;
+	}
+
+	auto const paths = reinterpret_cast<char const*>(_mapping.data() + header.paths_offset);
+	_entries.reserve(header.entries_nb);
+	for (std::uint32_t i = 0u; i < header.entries_nb; ++i) {
+		entry_record record;
+		std::memcpy(&record, _mapping.data() + header.records_offset + i * sizeof(entry_record), sizeof(record));
+		if (static_cast<std::uint64_t>(record.path_offset) + record.path_length > header.paths_size
+		 || record.offset + record.stored_size > header.records_offset
+		 || ((record.flags & entry_flag_compressed) == 0u && record.stored_size != record.size)) {
+			fail("its index is corrupted");
+			return;
+		}
+
+		entry file;
+		file.path = std::string(paths + record.path_offset, record.path_length);
+		file.offset = record.offset;
+		file.stored_size = record.stored_size;
+		file.size = record.size;
+		file.modification_time = record.modification_time;
+		file.is_compressed = (record.flags & entry_flag_compressed) != 0u;
+		_indices.emplace(file.path, _entries.size());
+		_entries.push_back(std::move(file));
+	}
+
+	LogInfo("Mounted archive \"%s\", with %u files.", path.c_str(), header.entries_nb);
+}
+
+utils::archive::entry const*
+utils::archive::reader::find(std::string const& path) const
+{
+	auto const index = _indices.find(path);
+	return index != _indices.end() ? &_entries[index->second] : nullptr;
+}
+
+bool
+utils::archive::reader::decompress(entry const& file, byte_buffer& content) const
+{
+	content.reset();
+	if (!file.is_compressed)
+		return true;
+	if (file.size > static_cast<std::uint64_t>(std::numeric_limits<std::size_t>::max()))
+		return false;
+
+	content = byte_buffer(static_cast<std::size_t>(file.size));
+	if (!utils::archive::decompress(data(file), static_cast<std::size_t>(file.stored_size), content.data(), content.size())) {
+		LogError("Failed to decompress \"%s\" from its archive.", file.path.c_str());
+		content.reset();
+		return false;
+	}
+	return true;
+}
+
+bool
+utils::archive::write(std::string const& archive_path, std::string const& root, std::vector<std::string> const& paths,
+                      bool allow_compression)
+{
+	// Entries are sorted so that archives of the same files are identical.
+	auto sorted_paths = paths;
+	std::sort(sorted_paths.begin(), sorted_paths.end());
+
+	auto const temporary_path = archive_path + ".tmp";
+	std::vector<entry_record> records;
+	std::string all_paths;
+	std::uint64_t bytes_packed = 0u, bytes_stored = 0u;
+	std::uint32_t compressed_nb = 0u;
+	archive_header header;
+	{
+		std::ofstream file(utils::widen(temporary_path), std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			LogError("Failed to create the archive \"%s\".", temporary_path.c_str());
+			return false;
+		}
+
+		std::uint64_t current_offset = 0u;
+		auto const write = [&file, &current_offset](void const* data, std::uint64_t size){
+			file.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+			current_offset += size;
+		};
+		auto const pad = [&file, &current_offset](){
+			static std::array<char, archive_alignment> const zeroes{};
+			auto const padding = align(current_offset) - current_offset;
+			file.write(zeroes.data(), static_cast<std::streamsize>(padding));
+			current_offset += padding;
+		};
+
+		// The header is rewritten once all offsets are known.
+		std::memset(&header, 0, sizeof(header));
+		write(&header, sizeof(header));
+		pad();
+
+		for (auto const& path : sorted_paths) {
+			auto const full_path = root + "/" + path;
+			utils::mapped_file const source(full_path);
+			if (!source.is_open() && utils::get_file_size(full_path) != 0u) {
+				LogError("Failed to read \"%s\".", full_path.c_str());
+				file.close();
+				utils::remove_file(temporary_path);
+				return false;
+			}
+
+			entry_record record;
+			std::memset(&record, 0, sizeof(record));
+			record.offset = current_offset;
+			record.size = source.size();
+			record.modification_time = utils::get_file_modification_time(full_path);
+			record.path_offset = static_cast<std::uint32_t>(all_paths.size());
+			record.path_length = static_cast<std::uint32_t>(path.size());
+			all_paths += path;
+
+			std::vector<std::uint8_t> compressed;
+			if (allow_compression && source.size() != 0u)
+				compressed = compress(source.data(), source.size());
+			if (!compressed.empty() && static_cast<double>(compressed.size()) <= compression_ratio_threshold * static_cast<double>(source.size())) {
+				record.flags |= entry_flag_compressed;
+				record.stored_size = compressed.size();
+				write(compressed.data(), compressed.size());
+				++compressed_nb;
+			} else {
+				record.stored_size = source.size();
+				write(source.data(), source.size());
+			}
+			pad();
+
+			bytes_packed += record.size;
+			bytes_stored += record.stored_size;
+			records.push_back(record);
+		}
+
+		std::memcpy(header.magic.data(), archive_magic.data(), archive_magic.size());
+		header.version = archive_version;
+		header.entries_nb = static_cast<std::uint32_t>(records.size());
+		header.records_offset = current_offset;
+		write(records.data(), records.size() * sizeof(entry_record));
+		header.paths_offset = current_offset;
+		header.paths_size = all_paths.size();
+		write(all_paths.data(), all_paths.size());
+
+		file.seekp(0);
+		file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+		if (!file.good()) {
+			LogError("Failed to write the archive \"%s\".", temporary_path.c_str());
+			file.close();
+			utils::remove_file(temporary_path);
+			return false;
+		}
+	}
+
+	if (!utils::replace_file(temporary_path, archive_path)) {
+		LogError("Failed to move the archive \"%s\" to \"%s\".", temporary_path.c_str(), archive_path.c_str());
+		utils::remove_file(temporary_path);
+		return false;
+	}
+
+	LogInfo("Packed %zu files (%.3f MiB) into \"%s\", %u of them compressed, using %.3f MiB.",
+	        records.size(), static_cast<float>(bytes_packed) / (1024.0f * 1024.0f), archive_path.c_str(),
+	        compressed_nb, static_cast<float>(bytes_stored) / (1024.0f * 1024.0f));
+	return true;
+}
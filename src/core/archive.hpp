@@ -0,0 +1,114 @@
+#pragma once
+
+#include "core/various.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//! \brief Archive bundling many files into a single one, so that they can
+//!        be deployed together and read from one memory mapping; see
+//!        `utils::mount_archive()`.
+//!
+//! An archive is laid out as follows, with the content of every file
+//! starting on a 16-byte boundary:
+//!
+//!   [header]
+//!   for each file: [content]
+//!   [entry record] × entries_nb
+//!   [paths]
+//!
+//! Each file is stored either as is, so that it can be read straight from
+//! the mapping of the archive, or compressed using the LZ4 block format when
+//! that saves enough space; images already compressed by their own format
+//! are typically stored as is.
+namespace utils
+{
+namespace archive
+{
+	//! \brief A file packed in an archive.
+	struct entry {
+		std::string path;                        //!< Path relative to the root the archive was created from, using '/' as separator
+		std::uint64_t offset{ 0u };              //!< Offset of the stored content from the start of the archive
+		std::uint64_t stored_size{ 0u };         //!< Size of the stored content, in bytes
+		std::uint64_t size{ 0u };                //!< Size of the file, in bytes
+		std::int64_t modification_time{ 0 };     //!< Modification time of the file when it was packed, in seconds since the epoch
+		bool is_compressed{ false };             //!< Whether the content is compressed
+	};
+
+	//! \brief Read-only access to an archive, through a memory mapping.
+	class reader
+	{
+	public:
+		//! \brief Map an archive and read its index.
+		//!
+		//! Use |is_open()| to check whether the archive is valid.
+		//!
+		//! @param [in] path of the archive
+		explicit reader(std::string const& path);
+
+		reader(reader const&) = delete;
+		reader& operator=(reader const&) = delete;
+
+		bool is_open() const noexcept { return _mapping.is_open(); }
+
+		//! \brief Return all files in the archive, sorted by path.
+		std::vector<entry> const& entries() const noexcept { return _entries; }
+
+		//! \brief Return the file at |path|, relative to the root the
+		//!        archive was created from, or null if there is none.
+		entry const* find(std::string const& path) const;
+
+		//! \brief Return the stored content of a file, pointing into the
+		//!        mapping of the archive.
+		std::uint8_t const* data(entry const& file) const noexcept { return _mapping.data() + file.offset; }
+
+		//! \brief Retrieve the content of a file, decompressing it if needed.
+		//!
+		//! @param [in] file one of `entries()`
+		//! @param [out] content the decompressed content, left empty if
+		//!              |file| is not compressed, in which case it can be
+		//!              read from `data()` directly
+		//! @return whether the content could be retrieved
+		bool decompress(entry const& file, byte_buffer& content) const;
+
+	private:
+		mapped_file _mapping;
+		std::vector<entry> _entries;
+		std::unordered_map<std::string, std::size_t> _indices;
+	};
+
+	//! \brief Compress bytes using the LZ4 block format.
+	//!
+	//! Matches are found greedily through a hash table of the last position
+	//! of each 4-byte sequence, favouring speed over ratio.
+	//!
+	//! @param [in] source bytes to compress
+	//! @param [in] size of |source|, in bytes
+	//! @return the compressed bytes
+	std::vector<std::uint8_t> compress(std::uint8_t const* source, std::size_t size);
+
+	//! \brief Decompress bytes compressed by `compress()`.
+	//!
+	//! @param [in] source compressed bytes
+	//! @param [in] source_size of |source|, in bytes
+	//! @param [out] destination where to write the decompressed bytes
+	//! @param [in] size of the decompressed bytes
+	//! @return whether |source| was valid and decompressed to exactly
+	//!         |size| bytes
+	bool decompress(std::uint8_t const* source, std::size_t source_size, std::uint8_t* destination, std::size_t size);
+
+	//! \brief Pack files into a new archive.
+	//!
+	//! @param [in] archive_path where to write the archive; it is replaced
+	//!             atomically if it already exists
+	//! @param [in] root directory the paths are relative to
+	//! @param [in] paths of the files to pack, relative to |root|
+	//! @param [in] allow_compression whether files may be stored compressed
+	//! @return whether the archive was written
+	bool write(std::string const& archive_path, std::string const& root, std::vector<std::string> const& paths,
+	           bool allow_compression);
+}
+}
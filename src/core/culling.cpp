@@ -0,0 +1,178 @@
+#include "culling.hpp"
+
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#	define BONOBO_CULLING_USE_SSE 1
+#	include <xmmintrin.h>
+#else
+#	define BONOBO_CULLING_USE_SSE 0
+#endif
+
+namespace
+{
+	bonobo::culling::statistics culling_statistics;
+}
+
+bonobo::culling::frustum
+bonobo::culling::extractFrustum(glm::mat4 const& to_clip)
+{
+	// A point is inside the clip volume if -w <= x, y, z <= w, each
+	// inequality giving a plane as a combination of the rows of the
+	// matrix; glm stores matrices by columns.
+	auto const row = [&to_clip](int i){
+		return glm::vec4(to_clip[0][i], to_clip[1][i], to_clip[2][i], to_clip[3][i]);
+	};
+	auto const x = row(0), y = row(1), z = row(2), w = row(3);
+
+	frustum view_frustum;
+	view_frustum.planes = { { w + x, w - x, w + y, w - y, w + z, w - z } };
+	for (auto& plane : view_frustum.planes) {
+		auto const length = glm::length(glm::vec3(plane));
+		if (length > 0.0f)
+			plane /= length;
+	}
+
+	return view_frustum;
+}
+
+// A box is outside a plane if even its corner furthest along the plane's
+// normal is behind it: the distance of that corner is the distance of the
+// centre plus the extents projected onto the absolute normal.
+static bool
+isBoxOutside(glm::vec4 const& plane, glm::vec3 const& centre, glm::vec3 const& extent)
+{
+	auto const distance = plane.x * centre.x + plane.y * centre.y + plane.z * centre.z + plane.w;
+	auto const radius = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+	return distance + radius < 0.0f;
+}
+
+bool
+bonobo::culling::isBoxVisible(frustum const& view_frustum, glm::vec3 const& min_corner, glm::vec3 const& max_corner)
+{
+	auto const centre = 0.5f * (min_corner + max_corner);
+	auto const extent = 0.5f * (max_corner - min_corner);
+	for (auto const& plane : view_frustum.planes)
+		if (isBoxOutside(plane, centre, extent))
+			return false;
+
+	return true;
+}
+
+void
+bonobo::culling::clear(box_set& boxes)
+{
+	boxes.centres_x.clear();
+	boxes.centres_y.clear();
+	boxes.centres_z.clear();
+	boxes.extents_x.clear();
+	boxes.extents_y.clear();
+	boxes.extents_z.clear();
+}
+
+void
+bonobo::culling::addBox(box_set& boxes, glm::vec3 const& min_corner, glm::vec3 const& max_corner,
+                        glm::mat4 const& model_to_world)
+{
+	// The half-extents of the enclosing box are those of the original one
+	// scaled by the absolute values of the linear part of the transform.
+	auto const centre = glm::vec3(model_to_world * glm::vec4(0.5f * (min_corner + max_corner), 1.0f));
+	auto const extent = 0.5f * (max_corner - min_corner);
+	glm::vec3 world_extent(0.0f);
+	for (int i = 0; i < 3; ++i)
+		for (int j = 0; j < 3; ++j)
+			world_extent[i] += std::abs(model_to_world[j][i]) * extent[j];
+
+	boxes.centres_x.push_back(centre.x);
+	boxes.centres_y.push_back(centre.y);
+	boxes.centres_z.push_back(centre.z);
+	boxes.extents_x.push_back(world_extent.x);
+	boxes.extents_y.push_back(world_extent.y);
+	boxes.extents_z.push_back(world_extent.z);
+}
+
+void
+bonobo::culling::addBox(box_set& boxes, mesh_data const& mesh, glm::mat4 const& model_to_world)
+{
+	if (mesh.bounds_radius > 0.0f) {
+		addBox(boxes, mesh.bounds_min, mesh.bounds_max, model_to_world);
+		return;
+	}
+
+	// Infinite extents would give NaNs when multiplied by null plane
+	// components, so use the largest finite value instead.
+	auto const extent = std::numeric_limits<float>::max();
+	boxes.centres_x.push_back(0.0f);
+	boxes.centres_y.push_back(0.0f);
+	boxes.centres_z.push_back(0.0f);
+	boxes.extents_x.push_back(extent);
+	boxes.extents_y.push_back(extent);
+	boxes.extents_z.push_back(extent);
+}
+
+std::size_t
+bonobo::culling::cullBoxes(frustum const& view_frustum, box_set const& boxes, std::vector<std::uint8_t>& visibility)
+{
+	auto const boxes_nb = boxes.centres_x.size();
+	visibility.resize(boxes_nb);
+
+	std::size_t visible_nb = 0u;
+	std::size_t i = 0u;
+#if BONOBO_CULLING_USE_SSE
+	// Each plane is tested against four boxes at once; a box is culled as
+	// soon as any plane has it fully outside.
+	__m128 const zero = _mm_setzero_ps();
+	for (; i + 4u <= boxes_nb; i += 4u) {
+		__m128 const centres_x = _mm_loadu_ps(boxes.centres_x.data() + i);
+		__m128 const centres_y = _mm_loadu_ps(boxes.centres_y.data() + i);
+		__m128 const centres_z = _mm_loadu_ps(boxes.centres_z.data() + i);
+		__m128 const extents_x = _mm_loadu_ps(boxes.extents_x.data() + i);
+		__m128 const extents_y = _mm_loadu_ps(boxes.extents_y.data() + i);
+		__m128 const extents_z = _mm_loadu_ps(boxes.extents_z.data() + i);
+
+		__m128 is_outside = zero;
+		for (auto const& plane : view_frustum.planes) {
+			__m128 const distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), centres_x),
+			                                              _mm_mul_ps(_mm_set1_ps(plane.y), centres_y)),
+			                                   _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), centres_z),
+			                                              _mm_set1_ps(plane.w)));
+			__m128 const radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), extents_x),
+			                                            _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), extents_y)),
+			                                 _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), extents_z));
+			is_outside = _mm_or_ps(is_outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		auto const outside_mask = _mm_movemask_ps(is_outside);
+		for (std::size_t j = 0u; j < 4u; ++j) {
+			auto const is_visible = ((outside_mask >> j) & 1) == 0;
+			visibility[i + j] = is_visible ? 1u : 0u;
+			visible_nb += is_visible ? 1u : 0u;
+		}
+	}
+#endif
+
+	for (; i < boxes_nb; ++i) {
+		glm::vec3 const centre(boxes.centres_x[i], boxes.centres_y[i], boxes.centres_z[i]);
+		glm::vec3 const extent(boxes.extents_x[i], boxes.extents_y[i], boxes.extents_z[i]);
+		bool is_visible = true;
+		for (auto const& plane : view_frustum.planes)
+			is_visible = is_visible && !isBoxOutside(plane, centre, extent);
+		visibility[i] = is_visible ? 1u : 0u;
+		visible_nb += is_visible ? 1u : 0u;
+	}
+
+	return visible_nb;
+}
+
+bonobo::culling::statistics&
+bonobo::culling::getStatistics()
+{
+	return culling_statistics;
+}
+
+void
+bonobo::culling::resetStatistics()
+{
+	culling_statistics = statistics();
+}
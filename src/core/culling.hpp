@@ -0,0 +1,91 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \brief View-frustum culling of axis-aligned bounding boxes.
+//!
+//! Frustums are described by the six planes bounding the clip volume, and
+//! can be extracted from any model-to-clip or world-to-clip matrix: boxes
+//! then have to be expressed in the same space as the matrix starts from.
+//! Boxes are tested conservatively: a box is only culled if it lies fully
+//! outside one of the planes, so some boxes near the corners of the
+//! frustum are kept even though they are not visible.
+namespace bonobo
+{
+namespace culling
+{
+	//! \brief Planes bounding a view frustum, as (normal, distance) with
+	//!        normals pointing inside; in order: left, right, bottom, top,
+	//!        near and far.
+	struct frustum {
+		std::array<glm::vec4, 6> planes;
+	};
+
+	//! \brief Axis-aligned boxes, stored as centres and half-extents with
+	//!        one array per component, so that several boxes can be tested
+	//!        at once by `cullBoxes()`.
+	struct box_set {
+		std::vector<float> centres_x, centres_y, centres_z;
+		std::vector<float> extents_x, extents_y, extents_z;
+	};
+
+	//! \brief Extract the frustum of a projection.
+	//!
+	//! @param [in] to_clip matrix transforming into clip space, for example
+	//!             `FPSCamera::GetWorldToClipMatrix()` for world-space
+	//!             boxes, or a model-view-projection one for model-space
+	//!             boxes
+	frustum extractFrustum(glm::mat4 const& to_clip);
+
+	//! \brief Return whether the box between |min_corner| and |max_corner|
+	//!        is at least partly inside |view_frustum|.
+	bool isBoxVisible(frustum const& view_frustum, glm::vec3 const& min_corner, glm::vec3 const& max_corner);
+
+	//! \brief Remove all boxes from |boxes|.
+	void clear(box_set& boxes);
+
+	//! \brief Append a box to |boxes|, transformed by |model_to_world|.
+	//!
+	//! The box added is the axis-aligned box enclosing the transformed one.
+	void addBox(box_set& boxes, glm::vec3 const& min_corner, glm::vec3 const& max_corner,
+	            glm::mat4 const& model_to_world = glm::mat4(1.0f));
+
+	//! \brief Append the bounding box of |mesh| to |boxes|, transformed by
+	//!        |model_to_world|; meshes without bounds get a box which is
+	//!        never culled.
+	void addBox(box_set& boxes, mesh_data const& mesh, glm::mat4 const& model_to_world = glm::mat4(1.0f));
+
+	//! \brief Test all boxes of a set against a frustum.
+	//!
+	//! Boxes are tested four at a time with SSE when available.
+	//!
+	//! @param [in] view_frustum the frustum, in the same space as |boxes|
+	//! @param [in] boxes the boxes to test
+	//! @param [out] visibility 1 for each box at least partly inside the
+	//!              frustum, 0 for the others
+	//! @return how many boxes are visible
+	std::size_t cullBoxes(frustum const& view_frustum, box_set const& boxes, std::vector<std::uint8_t>& visibility);
+
+	//! \brief How many draws were kept or culled since the last call to
+	//!        `resetStatistics()`.
+	struct statistics {
+		std::size_t visible_nb{ 0u };
+		std::size_t culled_nb{ 0u };
+	};
+
+	//! \brief Return the process-wide draw statistics, which `Node` and
+	//!        applications culling their own draws add to.
+	statistics& getStatistics();
+
+	//! \brief Reset the process-wide draw statistics, typically once per
+	//!        frame.
+	void resetStatistics();
+}
+}
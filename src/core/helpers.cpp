@@ -2,20 +2,30 @@
 #include "helpers.hpp"
 
 #include "core/Log.h"
+#include "core/material_table.hpp"
+#include "core/mipmaps.hpp"
 #include "core/opengl.hpp"
+#include "core/program_reflection.hpp"
+#include "core/texture_registry.hpp"
+#include "core/texture_streaming.hpp"
+#include "core/ThreadPool.hpp"
+#include "core/uploads.hpp"
+#include "core/UploadRing.hpp"
 #include "core/various.hpp"
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <imgui.h>
-#include <stb_image.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
-#include <memory>
+#include <cstring>
+#include <future>
+#include <limits>
 
 namespace
 {
@@ -58,6 +68,8 @@ namespace local
 void
 bonobo::init()
 {
+	uploads::init();
+
 	setupBasisData();
 	createDebugTexture();
 
@@ -74,6 +86,10 @@ bonobo::deinit()
 	glDeleteTextures(1, &debug_texture_id);
 	debug_texture_id = 0u;
 
+	texture_registry::clear();
+	texture_streaming::clear();
+	materials::clear();
+
 	glDeleteProgram(basis.shader);
 	glDeleteBuffers(1, &basis.ibo);
 	glDeleteBuffers(1, &basis.vbo);
@@ -81,278 +97,355 @@ bonobo::deinit()
 
 	glDeleteProgram(local::fullscreen_shader);
 	glDeleteVertexArrays(1, &local::display_vao);
+
+	uploads::deinit();
 }
 
-static std::vector<std::uint8_t>
-getTextureData(std::string const& filename, std::uint32_t& width, std::uint32_t& height, bool flip)
+GLenum
+bonobo::getIndexType(std::size_t vertices_nb)
 {
-	auto const channels_nb = 4u;
-	stbi_set_flip_vertically_on_load_thread(flip ? 1 : 0);
-	unsigned char* image_data = stbi_load(filename.c_str(), reinterpret_cast<int*>(&width), reinterpret_cast<int*>(&height), nullptr, channels_nb);
-	if (image_data == nullptr) {
-		LogWarning("Couldn't load or decode image file %s", filename.c_str());
+	return vertices_nb <= static_cast<std::size_t>(std::numeric_limits<GLushort>::max()) + 1u ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
 
-		// Provide a small empty image instead in case of failure.
-		width = 16;
-		height = 16;
-		return std::vector<unsigned char>(width * height * channels_nb);
+std::size_t
+bonobo::getIndexSize(GLenum index_type)
+{
+	switch (index_type) {
+		case GL_UNSIGNED_BYTE:  return sizeof(GLubyte);
+		case GL_UNSIGNED_SHORT: return sizeof(GLushort);
+		case GL_UNSIGNED_INT:   return sizeof(GLuint);
+		default:
+			LogError("Unsupported index type 0x%04x", index_type);
+			return 0u;
 	}
-
-	std::vector<unsigned char> image(width * height * channels_nb);
-	std::memcpy(image.data(), image_data, image.size());
-	stbi_image_free(image_data);
-
-	return image;
 }
 
-std::vector<bonobo::mesh_data>
-bonobo::loadObjects(std::string const& filename)
+GLvoid const*
+bonobo::getIndicesOffset(mesh_data const& mesh)
 {
-	auto const scene_start_time = std::chrono::high_resolution_clock::now();
-
-	std::vector<bonobo::mesh_data> objects;
-
-	auto const end_of_basedir = filename.rfind("/");
-	auto const parent_folder = (end_of_basedir != std::string::npos ? filename.substr(0, end_of_basedir) : ".") + "/";
-	Assimp::Importer importer;
-	auto const assimp_scene = importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_CalcTangentSpace);
-	if (assimp_scene == nullptr || assimp_scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || assimp_scene->mRootNode == nullptr) {
-		LogError("Assimp failed to load \"%s\": %s", filename.c_str(), importer.GetErrorString());
-		return objects;
-	}
+	return reinterpret_cast<GLvoid const*>(static_cast<std::size_t>(mesh.first_index) * getIndexSize(mesh.index_type));
+}
 
-	if (assimp_scene->mNumMeshes == 0u) {
-		LogError("No mesh available; loading \"%s\" must have had issues", filename.c_str());
-		return objects;
+void
+bonobo::packIndices(std::uint32_t const* indices, std::size_t indices_nb, GLenum index_type, void* destination)
+{
+	if (index_type == GL_UNSIGNED_INT) {
+		std::memcpy(destination, indices, indices_nb * sizeof(std::uint32_t));
+		return;
 	}
 
-	LogInfo("┭ Loading \"%s\"…", filename.c_str());
+	assert(index_type == GL_UNSIGNED_SHORT);
+	auto const packed_indices = static_cast<GLushort*>(destination);
+	for (std::size_t i = 0u; i < indices_nb; ++i)
+		packed_indices[i] = static_cast<GLushort>(indices[i]);
+}
 
-	std::vector<bool> are_materials_used(assimp_scene->mNumMaterials, false);
-	for (size_t j = 0; j < assimp_scene->mNumMeshes; ++j) {
-		auto const assimp_object_mesh = assimp_scene->mMeshes[j];
-		auto const material_id = assimp_object_mesh->mMaterialIndex;
-		if (material_id >= assimp_scene->mNumMaterials)
-			LogError("Mesh \"%s\" has a material index of %u, but only %u materials are present.", assimp_object_mesh->mName.C_Str(), material_id, assimp_scene->mNumMaterials);
-		else
-			are_materials_used[material_id] = true;
-	}
+// Size in bytes of one vertex' worth of |attribute|.
+static GLsizei
+getAttributeSize(bonobo::vertex_attribute_description const& attribute)
+{
+	return attribute.components_nb * static_cast<GLsizei>(attribute.type == GL_FLOAT ? sizeof(GLfloat) : sizeof(GLshort));
+}
 
-	auto const materials_start_time = std::chrono::high_resolution_clock::now();
-	std::vector<texture_bindings> materials_bindings(assimp_scene->mNumMaterials);
-	std::vector<material_data> material_constants(assimp_scene->mNumMaterials);
-	uint32_t texture_count = 0u;
-	for (size_t i = 0; i < assimp_scene->mNumMaterials; ++i) {
-		if (!are_materials_used[i])
-			continue;
+// Map a unit vector onto the [-1, 1]² square, by projecting it onto the
+// octahedron |x| + |y| + |z| = 1 and folding the lower half over the upper
+// one.
+static glm::vec2
+encodeOctahedral(glm::vec3 const& vector)
+{
+	auto const l1_norm = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+	if (l1_norm == 0.0f)
+		return glm::vec2(0.0f);
 
-		auto const material_start_time = std::chrono::high_resolution_clock::now();
-		texture_bindings& bindings = materials_bindings[i];
-		material_data& constants = material_constants[i];
-		auto const material = assimp_scene->mMaterials[i];
-
-		auto const process_texture = [&bindings,&material,i,&parent_folder,&texture_count](aiTextureType type, std::string const& type_as_str, std::string const& name){
-			if (material->GetTextureCount(type)) {
-				auto const texture_start_time = std::chrono::high_resolution_clock::now();
-
-				if (material->GetTextureCount(type) > 1)
-					LogWarning("Material \"%s\" has more than one %s texture: discarding all but the first one.", material->GetName().C_Str(), type_as_str.c_str());
-				aiString path;
-				material->GetTexture(type, 0, &path);
-				auto const id = bonobo::loadTexture2D(parent_folder + std::string(path.C_Str()));
-				if (id == 0u) {
-					LogWarning("Failed to load the %s texture for material \"%s\".", type_as_str.c_str(), material->GetName().C_Str());
-					return;
-				}
-				bindings.emplace(name, id);
-				++texture_count;
+	auto const projected = vector / l1_norm;
+	if (projected.z >= 0.0f)
+		return glm::vec2(projected.x, projected.y);
 
-				utils::opengl::debug::nameObject(GL_TEXTURE, id, std::string(material->GetName().C_Str()) + " " + type_as_str);
+	return glm::vec2((1.0f - std::abs(projected.y)) * (projected.x >= 0.0f ? 1.0f : -1.0f),
+	                 (1.0f - std::abs(projected.x)) * (projected.y >= 0.0f ? 1.0f : -1.0f));
+}
 
-				auto const texture_end_time = std::chrono::high_resolution_clock::now();
-				LogTrivia("│ %s Texture \"%s\" loaded in %.3f ms",
-				          bindings.size() == 1 ? "┌" : "├", path.C_Str(),
-				          std::chrono::duration<float, std::milli>(texture_end_time - texture_start_time).count());
-			}
-		};
+bonobo::vertex_layout_description
+bonobo::describeVertexLayout(vertex_layout_options const& options, mesh_streams const& streams)
+{
+	vertex_layout_description description;
+	description.layout = options.layout;
 
-		aiColor3D color;
-
-		material->Get(AI_MATKEY_COLOR_DIFFUSE, color);
-		constants.diffuse = glm::vec3(color.r, color.g, color.b);
-		material->Get(AI_MATKEY_COLOR_SPECULAR, color);
-		constants.specular = glm::vec3(color.r, color.g, color.b);
-		material->Get(AI_MATKEY_COLOR_AMBIENT, color);
-		constants.ambient = glm::vec3(color.r, color.g, color.b);
-		material->Get(AI_MATKEY_COLOR_EMISSIVE, color);
-		constants.emissive = glm::vec3(color.r, color.g, color.b);
-		material->Get(AI_MATKEY_SHININESS, constants.shininess);
-		material->Get(AI_MATKEY_REFRACTI, constants.indexOfRefraction);
-		material->Get(AI_MATKEY_OPACITY, constants.opacity);
-
-		process_texture(aiTextureType_DIFFUSE,  "diffuse",  "diffuse_texture");
-		process_texture(aiTextureType_SPECULAR, "specular", "specular_texture");
-		process_texture(aiTextureType_NORMALS,  "normals",  "normals_texture");
-		process_texture(aiTextureType_OPACITY,  "opacity",  "opacity_texture");
-
-		auto const material_end_time = std::chrono::high_resolution_clock::now();
-		LogTrivia("│ %s Material \"%s\" loaded in %.3f ms",
-		          bindings.empty() ? "╺" : "┕", material->GetName().C_Str(),
-		          std::chrono::duration<float, std::milli>(material_end_time - material_start_time).count());
-	}
-	auto const materials_end_time = std::chrono::high_resolution_clock::now();
-
-	auto const meshes_start_time = std::chrono::high_resolution_clock::now();
-	objects.reserve(assimp_scene->mNumMeshes);
-	for (size_t j = 0; j < assimp_scene->mNumMeshes; ++j) {
-		auto const mesh_start_time = std::chrono::high_resolution_clock::now();
-
-		auto const assimp_object_mesh = assimp_scene->mMeshes[j];
-
-		if (!assimp_object_mesh->HasFaces()) {
-			LogError("Unsupported mesh \"%s\": has no faces", assimp_object_mesh->mName.C_Str());
-			continue;
-		}
-		if ((assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_POINT | aiPrimitiveType_NGONEncodingFlag))    != 0u
-		 && (assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_LINE | aiPrimitiveType_NGONEncodingFlag))     != 0u
-		 && (assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_TRIANGLE | aiPrimitiveType_NGONEncodingFlag)) != 0u) {
-			LogError("Unsupported mesh \"%s\": uses multiple primitive types", assimp_object_mesh->mName.C_Str());
-			continue;
-		}
-		if ((assimp_object_mesh->mPrimitiveTypes & static_cast<uint32_t>(aiPrimitiveType_POLYGON)) == static_cast<uint32_t>(aiPrimitiveType_POLYGON)) {
-			LogError("Unsupported mesh \"%s\": uses polygons", assimp_object_mesh->mName.C_Str());
-			continue;
-		}
-		if (!assimp_object_mesh->HasPositions()) {
-			LogError("Unsupported mesh \"%s\": has no positions", assimp_object_mesh->mName.C_Str());
-			continue;
-		}
+	auto const is_requested = [&options](shader_bindings binding, float const* stream){
+		return stream != nullptr && (binding == shader_bindings::vertices || (options.attributes & vertexAttributeBit(binding)) != 0u);
+	};
+	auto const add_attribute = [&description, &is_requested](shader_bindings binding, float const* stream, GLint components_nb, GLenum type, GLboolean normalised){
+		if (!is_requested(binding, stream))
+			return;
 
-		bonobo::mesh_data object;
-		if (assimp_object_mesh->mName.length != 0)
-		{
-			object.name = std::string(assimp_object_mesh->mName.C_Str());
+		description.attributes.push_back({ binding, components_nb, type, normalised, 0, description.vertex_size });
+		description.vertex_size += getAttributeSize(description.attributes.back());
+	};
+	// Quantised positions use a fourth, unused, component so that following
+	// attributes stay aligned on 4 bytes.
+	if (options.quantise_positions)
+		add_attribute(shader_bindings::vertices, streams.vertices, 4, GL_UNSIGNED_SHORT, GL_TRUE);
+	else
+		add_attribute(shader_bindings::vertices, streams.vertices, 3, GL_FLOAT, GL_FALSE);
+	if (options.quantise_attributes) {
+		add_attribute(shader_bindings::normals,   streams.normals,   2, GL_SHORT,      GL_TRUE);
+		add_attribute(shader_bindings::texcoords, streams.texcoords, 2, GL_HALF_FLOAT, GL_FALSE);
+	} else {
+		add_attribute(shader_bindings::normals,   streams.normals,   3, GL_FLOAT, GL_FALSE);
+		add_attribute(shader_bindings::texcoords, streams.texcoords, glm::clamp(options.texcoords_components_nb, 2, 3), GL_FLOAT, GL_FALSE);
+	}
+	// Tangents are useless without binormals, and vice-versa.
+	if (is_requested(shader_bindings::tangents, streams.tangents)
+	 && is_requested(shader_bindings::binormals, streams.binormals)) {
+		// Binormals are rebuilt from the normals and the sign stored in the
+		// tangents' third component, so normals are required.
+		if (options.quantise_attributes && is_requested(shader_bindings::normals, streams.normals))
+			add_attribute(shader_bindings::tangents, streams.tangents, 4, GL_SHORT, GL_TRUE);
+		else if (!options.quantise_attributes) {
+			add_attribute(shader_bindings::tangents,  streams.tangents,  3, GL_FLOAT, GL_FALSE);
+			add_attribute(shader_bindings::binormals, streams.binormals, 3, GL_FLOAT, GL_FALSE);
 		}
+	}
 
-		glGenVertexArrays(1, &object.vao);
-		assert(object.vao != 0u);
-		glBindVertexArray(object.vao);
-
-		auto const vertices_offset = 0u;
-		auto const vertices_size = static_cast<GLsizeiptr>(assimp_object_mesh->mNumVertices * sizeof(glm::vec3));
-
-		auto const normals_offset = vertices_size;
-		auto const normals_size = assimp_object_mesh->HasNormals() ? vertices_size : 0u;
-
-		auto const texcoords_offset = normals_offset + normals_size;
-		auto const texcoords_size = assimp_object_mesh->HasTextureCoords(0u) ? vertices_size : 0u;
+	auto const vertices_nb = static_cast<GLsizeiptr>(streams.vertices_nb);
+	if (options.layout == vertex_layout_t::interleaved) {
+		if (options.stride != 0 && options.stride < description.vertex_size)
+			LogWarning("Requested vertex stride of %d bytes is smaller than the %d bytes needed by a vertex: ignoring it.", options.stride, description.vertex_size);
+		else if (options.stride != 0)
+			description.vertex_size = options.stride;
+
+		for (auto& attribute : description.attributes)
+			attribute.stride = description.vertex_size;
+	} else {
+		// The offsets computed above are the sizes of all previous
+		// attributes for a single vertex; scale them to all vertices.
+		for (auto& attribute : description.attributes)
+			attribute.offset *= vertices_nb;
+	}
+	description.buffer_size = vertices_nb * description.vertex_size;
 
-		auto const tangents_offset = texcoords_offset + texcoords_size;
-		auto const tangents_size = assimp_object_mesh->HasTangentsAndBitangents() ? vertices_size : 0u;
+	return description;
+}
 
-		auto const binormals_offset = tangents_offset + tangents_size;
-		auto const binormals_size = assimp_object_mesh->HasTangentsAndBitangents() ? vertices_size : 0u;
+void
+bonobo::uploadVertices(vertex_layout_description const& layout, mesh_streams const& streams)
+{
+	glBufferData(GL_ARRAY_BUFFER, layout.buffer_size, nullptr, GL_STATIC_DRAW);
+	bonobo::updateVertices(layout, streams, 0);
+}
 
-		auto const bo_size = static_cast<GLsizeiptr>(vertices_size
-		                                            +normals_size
-		                                            +texcoords_size
-		                                            +tangents_size
-		                                            +binormals_size
-		                                            );
-		glGenBuffers(1, &object.bo);
-		assert(object.bo != 0u);
-		glBindBuffer(GL_ARRAY_BUFFER, object.bo);
-		glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
+void
+bonobo::updateVertices(vertex_layout_description const& layout, mesh_streams const& streams, GLint base_vertex)
+{
+	auto const get_stream = [&streams](shader_bindings binding) -> float const* {
+		switch (binding) {
+			case shader_bindings::vertices:  return streams.vertices;
+			case shader_bindings::normals:   return streams.normals;
+			case shader_bindings::texcoords: return streams.texcoords;
+			case shader_bindings::tangents:  return streams.tangents;
+			case shader_bindings::binormals: return streams.binormals;
+		}
+		return nullptr;
+	};
 
-		glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const*>(assimp_object_mesh->mVertices));
-		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
-		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
+	// Streams always hold 3 floats per vertex, which might be more than
+	// what is stored; missing streams are left as zeroes. The type of an
+	// attribute tells how it is encoded, see `describeVertexLayout()`.
+	auto const encoding = bonobo::getVertexEncoding(layout, streams);
+	auto const pack_attribute = [&streams, &encoding](vertex_attribute_description const& attribute, float const* stream, std::uint8_t* destination, GLsizei stride){
+		if (stream == nullptr)
+			return;
 
-		if (assimp_object_mesh->HasNormals()) {
-			glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const*>(assimp_object_mesh->mNormals));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
+		auto const attribute_size = static_cast<std::size_t>(getAttributeSize(attribute));
+		for (std::uint32_t i = 0u; i < streams.vertices_nb; ++i) {
+			auto const vertex = destination + static_cast<std::size_t>(i) * stride;
+			auto const value = glm::vec3(stream[3u * i + 0u], stream[3u * i + 1u], stream[3u * i + 2u]);
+			std::array<std::uint32_t, 2> packed{ { 0u, 0u } };
+			switch (attribute.type) {
+				case GL_FLOAT:
+					std::memcpy(vertex, stream + 3u * i, attribute_size);
+					continue;
+				case GL_HALF_FLOAT:
+					packed[0] = glm::packHalf2x16(glm::vec2(value.x, value.y));
+					break;
+				case GL_UNSIGNED_SHORT:
+				{
+					auto const normalised = (value - encoding.dequantisation_offset) / encoding.dequantisation_scale;
+					packed[0] = glm::packUnorm2x16(glm::vec2(normalised.x, normalised.y));
+					packed[1] = glm::packUnorm2x16(glm::vec2(normalised.z, 0.0f));
+					break;
+				}
+				case GL_SHORT:
+					packed[0] = glm::packSnorm2x16(encodeOctahedral(value));
+					if (attribute.binding == shader_bindings::tangents) {
+						auto handedness = 1.0f;
+						if (streams.normals != nullptr && streams.binormals != nullptr) {
+							auto const normal = glm::vec3(streams.normals[3u * i + 0u], streams.normals[3u * i + 1u], streams.normals[3u * i + 2u]);
+							auto const binormal = glm::vec3(streams.binormals[3u * i + 0u], streams.binormals[3u * i + 1u], streams.binormals[3u * i + 2u]);
+							handedness = glm::dot(glm::cross(normal, value), binormal) < 0.0f ? -1.0f : 1.0f;
+						}
+						packed[1] = glm::packSnorm2x16(glm::vec2(handedness, 0.0f));
+					}
+					break;
+				default:
+					assert(false);
+			}
+			std::memcpy(vertex, packed.data(), attribute_size);
 		}
+	};
+
+	if (layout.layout == vertex_layout_t::interleaved) {
+		std::vector<std::uint8_t> vertices(static_cast<std::size_t>(streams.vertices_nb) * layout.vertex_size, 0u);
+		for (auto const& attribute : layout.attributes)
+			pack_attribute(attribute, get_stream(attribute.binding), vertices.data() + attribute.offset, attribute.stride);
+		bonobo::uploads::uploadBufferData(GL_ARRAY_BUFFER, static_cast<GLintptr>(base_vertex) * layout.vertex_size,
+		                                static_cast<GLsizeiptr>(vertices.size()), static_cast<GLvoid const*>(vertices.data()));
+		return;
+	}
 
-		if (assimp_object_mesh->HasTextureCoords(0u)) {
-			glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const*>(assimp_object_mesh->mTextureCoords[0u]));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
+	std::vector<std::uint8_t> packed_stream;
+	for (auto const& attribute : layout.attributes) {
+		auto const stream = get_stream(attribute.binding);
+		auto const attribute_size = getAttributeSize(attribute);
+		auto const stream_offset = attribute.offset + static_cast<GLintptr>(base_vertex) * attribute_size;
+		auto const stream_size = static_cast<GLsizeiptr>(streams.vertices_nb) * attribute_size;
+		if (stream != nullptr && attribute.type == GL_FLOAT && attribute.components_nb == 3) {
+			bonobo::uploads::uploadBufferData(GL_ARRAY_BUFFER, stream_offset, stream_size, static_cast<GLvoid const*>(stream));
+			continue;
 		}
 
-		if (assimp_object_mesh->HasTangentsAndBitangents()) {
-			glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const*>(assimp_object_mesh->mTangents));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
+		packed_stream.assign(static_cast<std::size_t>(stream_size), 0u);
+		pack_attribute(attribute, stream, packed_stream.data(), attribute_size);
+		bonobo::uploads::uploadBufferData(GL_ARRAY_BUFFER, stream_offset, stream_size, static_cast<GLvoid const*>(packed_stream.data()));
+	}
+}
 
-			glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const*>(assimp_object_mesh->mBitangents));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
-		}
+bonobo::vertex_encoding
+bonobo::getVertexEncoding(vertex_layout_description const& layout, mesh_streams const& streams)
+{
+	vertex_encoding encoding;
+	for (auto const& attribute : layout.attributes) {
+		if (attribute.binding == shader_bindings::vertices && attribute.type == GL_UNSIGNED_SHORT)
+			encoding.has_quantised_positions = true;
+		if ((attribute.binding == shader_bindings::normals || attribute.binding == shader_bindings::tangents) && attribute.type == GL_SHORT)
+			encoding.has_octahedral_normals = true;
+	}
+	if (!encoding.has_quantised_positions || streams.vertices == nullptr || streams.vertices_nb == 0u)
+		return encoding;
+
+	auto min_corner = glm::vec3(std::numeric_limits<float>::max());
+	auto max_corner = glm::vec3(std::numeric_limits<float>::lowest());
+	for (std::uint32_t i = 0u; i < streams.vertices_nb; ++i) {
+		auto const position = glm::vec3(streams.vertices[3u * i + 0u], streams.vertices[3u * i + 1u], streams.vertices[3u * i + 2u]);
+		min_corner = glm::min(min_corner, position);
+		max_corner = glm::max(max_corner, position);
+	}
+	encoding.dequantisation_offset = min_corner;
+	encoding.dequantisation_scale = max_corner - min_corner;
+	// Flat meshes would otherwise divide by zero when quantising.
+	for (int i = 0; i < 3; ++i)
+		if (encoding.dequantisation_scale[i] <= 0.0f)
+			encoding.dequantisation_scale[i] = 1.0f;
+
+	return encoding;
+}
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0u);
-
-		auto const num_vertices_per_face = assimp_object_mesh->mFaces[0u].mNumIndices;
-		object.indices_nb = assimp_object_mesh->mNumFaces * num_vertices_per_face;
-		auto object_indices = std::make_unique<GLuint[]>(static_cast<size_t>(object.indices_nb));
-		for (size_t i = 0u; i < assimp_object_mesh->mNumFaces; ++i) {
-			auto const& face = assimp_object_mesh->mFaces[i];
-			assert(face.mNumIndices <= 3);
-			object_indices[num_vertices_per_face * i + 0u] = face.mIndices[0u];
-			if (num_vertices_per_face > 1u)
-				object_indices[num_vertices_per_face * i + 1u] = face.mIndices[1u];
-			if (num_vertices_per_face > 2u)
-				object_indices[num_vertices_per_face * i + 2u] = face.mIndices[2u];
-		}
-		glGenBuffers(1, &object.ibo);
-		assert(object.ibo != 0u);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<unsigned int>(object.indices_nb) * sizeof(GL_UNSIGNED_INT), reinterpret_cast<GLvoid const*>(object_indices.get()), GL_STATIC_DRAW);
-		object_indices.reset(nullptr);
+void
+bonobo::computeMeshBounds(mesh_streams const& mesh, mesh_data& object)
+{
+	// The sphere is centred on the box, and the density is the ratio between
+	// the areas the triangles cover in texture space and in model space.
+	if (mesh.vertices == nullptr || mesh.vertices_nb == 0u)
+		return;
 
-		utils::opengl::debug::nameObject(GL_VERTEX_ARRAY, object.vao, object.name + " VAO");
-		utils::opengl::debug::nameObject(GL_BUFFER, object.bo, object.name + " VBO");
-		utils::opengl::debug::nameObject(GL_BUFFER, object.ibo, object.name + " IBO");
+	auto const position = [&mesh](std::uint32_t i){
+		return glm::vec3(mesh.vertices[3u * i], mesh.vertices[3u * i + 1u], mesh.vertices[3u * i + 2u]);
+	};
+	glm::vec3 min_corner = position(0u), max_corner = position(0u);
+	for (std::uint32_t i = 1u; i < mesh.vertices_nb; ++i) {
+		min_corner = glm::min(min_corner, position(i));
+		max_corner = glm::max(max_corner, position(i));
+	}
+	object.bounds_min = min_corner;
+	object.bounds_max = max_corner;
+	object.bounds_centre = 0.5f * (min_corner + max_corner);
+	float squared_radius = 0.0f;
+	for (std::uint32_t i = 0u; i < mesh.vertices_nb; ++i) {
+		auto const offset = position(i) - object.bounds_centre;
+		squared_radius = std::max(squared_radius, glm::dot(offset, offset));
+	}
+	object.bounds_radius = std::sqrt(squared_radius);
 
-		glBindVertexArray(0u);
-		glBindBuffer(GL_ARRAY_BUFFER, 0u);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+	if (mesh.texcoords == nullptr || mesh.drawing_mode != GL_TRIANGLES)
+		return;
 
-		auto const material_id = assimp_object_mesh->mMaterialIndex;
-		if (material_id < materials_bindings.size()) {
-			object.bindings = materials_bindings[material_id];
-			object.material = material_constants[material_id];
-		}
+	auto const texcoords = [&mesh](std::uint32_t i){
+		return glm::vec2(mesh.texcoords[3u * i], mesh.texcoords[3u * i + 1u]);
+	};
+	auto const corners_nb = mesh.indices != nullptr ? mesh.indices_nb : mesh.vertices_nb;
+	double model_area = 0.0, texture_area = 0.0;
+	for (std::uint32_t i = 0u; i + 2u < corners_nb; i += 3u) {
+		auto const a = mesh.indices != nullptr ? mesh.indices[i] : i;
+		auto const b = mesh.indices != nullptr ? mesh.indices[i + 1u] : i + 1u;
+		auto const c = mesh.indices != nullptr ? mesh.indices[i + 2u] : i + 2u;
+		model_area += glm::length(glm::cross(position(b) - position(a), position(c) - position(a)));
+		auto const uv_ab = texcoords(b) - texcoords(a);
+		auto const uv_ac = texcoords(c) - texcoords(a);
+		texture_area += std::abs(uv_ab.x * uv_ac.y - uv_ab.y * uv_ac.x);
+	}
+	if (model_area > 0.0)
+		object.texcoords_density = static_cast<float>(std::sqrt(texture_area / model_area));
+}
 
-		objects.push_back(object);
+void
+bonobo::setVertexEncodingUniforms(GLuint program, vertex_encoding const& encoding)
+{
+	auto const& locations = program_reflection::getLocations(program);
+	glUniform1i(locations.has_quantised_positions, encoding.has_quantised_positions ? 1 : 0);
+	glUniform3fv(locations.vertex_dequantisation_scale, 1, glm::value_ptr(encoding.dequantisation_scale));
+	glUniform3fv(locations.vertex_dequantisation_offset, 1, glm::value_ptr(encoding.dequantisation_offset));
+	glUniform1i(locations.has_octahedral_normals, encoding.has_octahedral_normals ? 1 : 0);
+}
 
-		auto const mesh_end_time = std::chrono::high_resolution_clock::now();
+void
+bonobo::setupVertexAttributes(vertex_layout_description const& layout)
+{
+	for (auto const& attribute : layout.attributes) {
+		glEnableVertexAttribArray(static_cast<unsigned int>(attribute.binding));
+		glVertexAttribPointer(static_cast<unsigned int>(attribute.binding), attribute.components_nb,
+		                      attribute.type, attribute.normalised, attribute.stride,
+		                      reinterpret_cast<GLvoid const*>(attribute.offset));
+	}
+}
 
-		std::string attributes = assimp_object_mesh->HasNormals() ? "normals" : "";
-		if (!attributes.empty())
-		  attributes += " | ";
-		if (assimp_object_mesh->HasTangentsAndBitangents())
-		  attributes += "tangents&bitangents";
-		if (!attributes.empty())
-		  attributes += " | ";
-		if (assimp_object_mesh->HasTextureCoords(0))
-		  attributes += "texture coordinates";
-		LogTrivia("│ %s Mesh \"%s\" loaded with attributes [%s] in %.3f ms",
-		          (assimp_scene->mNumMeshes == 1u) ? "╶" : (j == 0 ? "┌" : (j == assimp_scene->mNumMeshes - 1 ? "└" : "├")),
-		          assimp_object_mesh->mName.C_Str(), attributes.c_str(),
-		          std::chrono::duration<float, std::milli>(mesh_end_time - mesh_start_time).count());
+// Return the size of |width|×|height| texels stored as |format| and
+// |type|, or 0 if the rows might be padded or the format is not one
+// commonly uploaded.
+static std::uint64_t
+getClientTexelsSize(std::uint32_t width, std::uint32_t height, GLenum format, GLenum type)
+{
+	std::uint64_t components_nb = 0u;
+	switch (format) {
+		case GL_RED:  components_nb = 1u; break;
+		case GL_RG:   components_nb = 2u; break;
+		case GL_RGB:  components_nb = 3u; break;
+		case GL_RGBA: components_nb = 4u; break;
+		default:      return 0u;
 	}
-	auto const meshes_end_time = std::chrono::high_resolution_clock::now();
 
-	auto const scene_end_time = std::chrono::high_resolution_clock::now();
-	LogInfo("┕ Scene loaded in %.3f s: %u textures loaded in %.3f s and %zu meshes in %.3f s",
-	        std::chrono::duration<float>(scene_end_time - scene_start_time).count(),
-	        texture_count,
-	        std::chrono::duration<float>(materials_end_time - materials_start_time).count(),
-	        objects.size(),
-	        std::chrono::duration<float>(meshes_end_time - meshes_start_time).count());
+	std::uint64_t component_size = 0u;
+	switch (type) {
+		case GL_UNSIGNED_BYTE:  component_size = 1u; break;
+		case GL_UNSIGNED_SHORT: component_size = 2u; break;
+		case GL_HALF_FLOAT:     component_size = 2u; break;
+		case GL_FLOAT:          component_size = 4u; break;
+		default:                return 0u;
+	}
 
-	return objects;
+	// Rows are aligned on 4 bytes by default, which is not worth
+	// replicating.
+	auto const row_size = width * components_nb * component_size;
+	return row_size % 4u == 0u ? row_size * height : 0u;
 }
 
 GLuint
@@ -364,6 +457,18 @@ bonobo::createTexture(uint32_t width, uint32_t height, GLenum target, GLint inte
 	glBindTexture(target, texture);
 	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	auto const upload_start_time = std::chrono::high_resolution_clock::now();
+	auto const size = data != nullptr ? getClientTexelsSize(width, target == GL_TEXTURE_2D ? height : 1u, format, type) : 0u;
+	auto const upload_ring = bonobo::uploads::getStagingRing();
+	auto const staging = size != 0u && upload_ring != nullptr ? upload_ring->Allocate(static_cast<GLsizeiptr>(size))
+	                                                          : UploadRing::Allocation();
+	if (staging.data != nullptr) {
+		std::memcpy(staging.data, data, static_cast<std::size_t>(size));
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_ring->GetBuffer());
+		data = reinterpret_cast<GLvoid const*>(static_cast<std::uintptr_t>(staging.offset));
+	}
+
 	switch (target) {
 	case GL_TEXTURE_1D:
 		glTexImage1D(target, 0, internal_format, static_cast<GLsizei>(width), 0, format, type, data);
@@ -372,104 +477,463 @@ bonobo::createTexture(uint32_t width, uint32_t height, GLenum target, GLint inte
 		glTexImage2D(target, 0, internal_format, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, format, type, data);
 		break;
 	default:
+		if (staging.data != nullptr) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+			upload_ring->Release(staging);
+		}
 		glDeleteTextures(1, &texture);
 		LogError("Non-handled texture target: %08x.\n", target);
 		return 0u;
 	}
+	if (staging.data != nullptr) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+		upload_ring->Submit(staging);
+	}
+	if (size != 0u)
+		bonobo::uploads::record(staging.data != nullptr, size, upload_start_time);
 	glBindTexture(target, 0u);
 
 	return texture;
 }
 
-GLuint
-bonobo::loadTexture2D(std::string const& filename, bool generate_mipmap)
+void
+bonobo::releaseTexture(GLuint texture)
 {
-	std::uint32_t width, height;
-	auto const data = getTextureData(filename, width, height, true);
-	if (data.empty())
-		return 0u;
+	if (texture_registry::release(texture))
+		texture_streaming::forget(texture);
+}
 
-	GLuint texture = bonobo::createTexture(width, height, GL_TEXTURE_2D, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<GLvoid const*>(data.data()));
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+namespace
+{
+	//! \brief Arrangements of the six faces of a cube map in a single image,
+	//!        recognised from the aspect ratio of the image.
+	enum class cube_map_layout_t : unsigned int {
+		unknown = 0u,
+		horizontal_strip,  //!< 6×1 faces, ordered +X, -X, +Y, -Y, +Z, -Z
+		vertical_strip,    //!< 1×6 faces, in the same order
+		horizontal_cross,  //!< 4×3 faces, with -X, +Z, +X, -Z on the middle row
+		vertical_cross     //!< 3×4 faces, with -X, +Z, +X on the second row and -Z upside down at the bottom
+	};
+
+	//! \brief Position of each face in a layout, in faces from the top-left
+	//!        corner, ordered like GL_TEXTURE_CUBE_MAP_POSITIVE_X + i.
+	struct cube_map_face_position {
+		std::uint32_t column;
+		std::uint32_t row;
+		bool is_upside_down;
+	};
+
+	cube_map_layout_t getCubeMapLayout(std::uint32_t width, std::uint32_t height, std::uint32_t& face_size)
+	{
+		if (width == 6u * height) {
+			face_size = height;
+			return cube_map_layout_t::horizontal_strip;
+		}
+		if (height == 6u * width) {
+			face_size = width;
+			return cube_map_layout_t::vertical_strip;
+		}
+		if (width % 4u == 0u && 3u * width == 4u * height) {
+			face_size = width / 4u;
+			return cube_map_layout_t::horizontal_cross;
+		}
+		if (height % 4u == 0u && 4u * width == 3u * height) {
+			face_size = width / 3u;
+			return cube_map_layout_t::vertical_cross;
+		}
+		face_size = 0u;
+		return cube_map_layout_t::unknown;
+	}
+
+	std::array<cube_map_face_position, 6> getCubeMapFacePositions(cube_map_layout_t layout)
+	{
+		switch (layout) {
+			case cube_map_layout_t::horizontal_strip:
+				return { { { 0u, 0u, false }, { 1u, 0u, false }, { 2u, 0u, false }, { 3u, 0u, false }, { 4u, 0u, false }, { 5u, 0u, false } } };
+			case cube_map_layout_t::vertical_strip:
+				return { { { 0u, 0u, false }, { 0u, 1u, false }, { 0u, 2u, false }, { 0u, 3u, false }, { 0u, 4u, false }, { 0u, 5u, false } } };
+			case cube_map_layout_t::horizontal_cross:
+				return { { { 2u, 1u, false }, { 0u, 1u, false }, { 1u, 0u, false }, { 1u, 2u, false }, { 1u, 1u, false }, { 3u, 1u, false } } };
+			case cube_map_layout_t::vertical_cross:
+				return { { { 2u, 1u, false }, { 0u, 1u, false }, { 1u, 0u, false }, { 1u, 2u, false }, { 1u, 1u, false }, { 1u, 3u, true } } };
+			default:
+				assert(false);
+				return {};
+		}
+	}
+
+	//! \brief Identifier at the start of KTX 1 files.
+	std::array<std::uint8_t, 12> const ktx_identifier{ { 0xABu, 'K', 'T', 'X', ' ', '1', '1', 0xBBu, '\r', '\n', 0x1Au, '\n' } };
+
+	//! \brief Header of KTX 1 files, following the identifier.
+	struct ktx_header {
+		std::uint32_t endianness;
+		std::uint32_t gl_type;
+		std::uint32_t gl_type_size;
+		std::uint32_t gl_format;
+		std::uint32_t gl_internal_format;
+		std::uint32_t gl_base_internal_format;
+		std::uint32_t pixel_width;
+		std::uint32_t pixel_height;
+		std::uint32_t pixel_depth;
+		std::uint32_t array_elements_nb;
+		std::uint32_t faces_nb;
+		std::uint32_t mipmap_levels_nb;
+		std::uint32_t key_value_data_size;
+	};
+
+	//! \brief Return whether immutable storage can be allocated for
+	//!        textures, which is part of OpenGL 4.2.
+	bool isTextureStorageSupported()
+	{
+		return GLAD_GL_VERSION_4_2 && glTexStorage2D != nullptr;
+	}
+}
+
+// Create a cube map with |levels_nb| levels of |face_size|×|face_size|
+// texels, allocating immutable storage for all of them if supported; the
+// cube map is left bound.
+static GLuint
+createCubeMap(GLsizei levels_nb, GLenum internal_format, std::uint32_t face_size, bool& has_storage)
+{
+	GLuint texture = 0u;
+	glGenTextures(1, &texture);
+	assert(texture != 0u);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, levels_nb > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels_nb - 1);
+
+	// Allocating all faces and levels at once spares the driver from
+	// checking the cube map for completeness after each face.
+	has_storage = isTextureStorageSupported();
+	if (has_storage)
+		glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels_nb, internal_format,
+		               static_cast<GLsizei>(face_size), static_cast<GLsizei>(face_size));
+
+	return texture;
+}
+
+// Upload one level of one face of the cube map currently bound; a |type| of
+// 0 denotes a compressed format.
+static void
+uploadCubeMapLevel(GLenum face, GLint level, bool has_storage, GLenum internal_format, GLenum format, GLenum type,
+                   std::uint32_t size, GLsizei data_size, GLvoid const* data)
+{
+	auto const side = static_cast<GLsizei>(size);
+	if (type == 0u && has_storage)
+		glCompressedTexSubImage2D(face, level, 0, 0, side, side, internal_format, data_size, data);
+	else if (type == 0u)
+		glCompressedTexImage2D(face, level, internal_format, side, side, 0, data_size, data);
+	else if (has_storage)
+		glTexSubImage2D(face, level, 0, 0, side, side, format, type, data);
+	else
+		glTexImage2D(face, level, static_cast<GLint>(internal_format), side, side, 0, format, type, data);
+}
+
+// Prepare the mipmap hierarchy of one face, and stage it if possible,
+// without making any OpenGL call.
+static bonobo::texture_registry::decoded_image
+prepareCubeMapFace(utils::byte_buffer texels, std::uint32_t size, bool generate_mipmap, UploadRing* staging)
+{
+	bonobo::texture_registry::decoded_image face;
+	face.width = size;
+	face.height = size;
 	if (generate_mipmap)
-		glGenerateMipmap(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, 0u);
+		face.levels = bonobo::mipmaps::generate(std::move(texels), size, size, bonobo::mipmaps::filter_t::kaiser,
+		                                        bonobo::mipmaps::content_t::colour);
+	else
+		face.levels.push_back({ size, size, std::move(texels) });
+
+	if (staging != nullptr) {
+		face.staging = staging->TryAllocate(static_cast<GLsizeiptr>(bonobo::mipmaps::getSize(face.levels)));
+		if (face.staging.data != nullptr)
+			bonobo::mipmaps::copyTexels(face.levels, face.staging.data);
+	}
+
+	return face;
+}
+
+// Upload six faces prepared by `prepareCubeMapFace()`, ordered like
+// GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, into a new cube map.
+static GLuint
+uploadCubeMap(std::vector<bonobo::texture_registry::decoded_image> const& faces)
+{
+	auto const levels_nb = static_cast<GLsizei>(faces.front().levels.size());
+	bool has_storage = false;
+	auto const texture = createCubeMap(levels_nb, GL_RGBA8, faces.front().width, has_storage);
+
+	auto const upload_ring = bonobo::uploads::getStagingRing();
+	for (std::size_t i = 0u; i < faces.size(); ++i) {
+		auto const upload_start_time = std::chrono::high_resolution_clock::now();
+		auto const& face = faces[i];
+		auto const is_staged = face.staging.data != nullptr;
+		if (is_staged)
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_ring->GetBuffer());
+
+		std::uint64_t offset = 0u;
+		for (std::size_t j = 0u; j < face.levels.size(); ++j) {
+			auto const& level = face.levels[j];
+			auto const level_size = static_cast<std::uint64_t>(level.width) * level.height * level.channels_nb;
+			auto const data = is_staged ? reinterpret_cast<GLvoid const*>(static_cast<std::uintptr_t>(face.staging.offset + offset))
+			                            : reinterpret_cast<GLvoid const*>(level.texels.data());
+			uploadCubeMapLevel(GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<GLenum>(i), static_cast<GLint>(j), has_storage,
+			                   GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, level.width, static_cast<GLsizei>(level_size), data);
+			offset += level_size;
+		}
+
+		if (is_staged) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+			upload_ring->Submit(face.staging);
+		}
+		bonobo::uploads::record(is_staged, offset, upload_start_time);
+	}
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0u);
 
 	return texture;
 }
 
+// Check that six decoded faces can make a cube map, releasing them if not;
+// faces which failed to decode have no texels.
+static bool
+areCubeMapFacesValid(std::vector<bonobo::texture_registry::decoded_image> const& faces, std::array<std::string const*, 6> const& filenames)
+{
+	for (std::size_t i = 0u; i < faces.size(); ++i) {
+		auto const& face = faces[i];
+		if (face.levels.empty() || face.width != faces.front().width || face.height != faces.front().height) {
+			if (!face.levels.empty())
+				LogError("Face \"%s\" is %u×%u texels, while cube map faces have to share dimensions (\"%s\" is %u×%u texels).",
+				         filenames[i]->c_str(), face.width, face.height,
+				         filenames[0]->c_str(), faces.front().width, faces.front().height);
+			for (auto const& face_to_release : faces)
+				bonobo::texture_registry::releaseDecodedImage(face_to_release);
+			return false;
+		}
+	}
+	return true;
+}
+
 GLuint
 bonobo::loadTextureCubeMap(std::string const& posx, std::string const& negx,
                            std::string const& posy, std::string const& negy,
                            std::string const& posz, std::string const& negz,
                            bool generate_mipmap)
 {
-	GLuint texture = 0u;
-	// Create an OpenGL texture object. Similarly to `glGenVertexArrays()`
-	// and `glGenBuffers()` that were used in assignment 2,
-	// `glGenTextures()` can create `n` texture objects at once. Here we
-	// only one texture object that will contain our whole cube map.
-	glGenTextures(1, /*! \todo fill me */nullptr);
-	assert(texture != 0u);
+	auto const start_time = std::chrono::high_resolution_clock::now();
 
-	// Similarly to vertex arrays and buffers, we first need to bind the
-	// texture object in orther to use it. Here we will bind it to the
-	// GL_TEXTURE_CUBE_MAP target to indicate we want a cube map. If you
-	// look at `bonobo::loadTexture2D()` just above, you will see that
-	// GL_TEXTURE_2D is used there, as we want a simple 2D-texture.
-	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	// Each face is decoded, and its mipmap hierarchy generated, on its own
+	// worker thread; only the upload happens on this one.
+	std::array<std::string const*, 6> const filenames{ { &posx, &negx, &posy, &negy, &posz, &negz } };
+	std::vector<std::future<bonobo::texture_registry::decoded_image>> decodings;
+	{
+		ThreadPool decoders(filenames.size());
+		auto const staging = bonobo::uploads::getStagingRing();
+		for (auto const filename : filenames) {
+			decodings.push_back(decoders.Enqueue([filename, generate_mipmap, staging](){
+				auto const decode_start_time = std::chrono::high_resolution_clock::now();
+				bool has_failed = false;
+				std::uint32_t width = 0u, height = 0u;
+				auto texels = bonobo::texture_registry::getTextureData(*filename, width, height, false, &has_failed);
+				if (has_failed || width != height) {
+					if (!has_failed)
+						LogError("Face \"%s\" is %u×%u texels, while cube map faces have to be square.",
+						         filename->c_str(), width, height);
+					return bonobo::texture_registry::decoded_image();
+				}
+				auto face = prepareCubeMapFace(std::move(texels), width, generate_mipmap, staging);
+				face.decode_duration_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - decode_start_time).count();
+				return face;
+			}));
+		}
+	}
 
-	// Set the wrapping properties of the texture; you can have a look on
-	// http://docs.gl to learn more about them
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	std::vector<bonobo::texture_registry::decoded_image> faces;
+	for (auto& decoding : decodings)
+		faces.push_back(decoding.get());
+	if (!areCubeMapFacesValid(faces, filenames))
+		return 0u;
 
-	// Set the minification and magnification properties of the textures;
-	// you can have a look on http://docs.gl to lear more about them, or
-	// attend EDAN35 in the next period ;-)
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	auto const decode_end_time = std::chrono::high_resolution_clock::now();
+	auto const texture = uploadCubeMap(faces);
+	auto const end_time = std::chrono::high_resolution_clock::now();
+	LogTrivia("Cube map \"%s\" and its other faces decoded in %.3f ms and uploaded in %.3f ms",
+	          posx.c_str(),
+	          std::chrono::duration<float, std::milli>(decode_end_time - start_time).count(),
+	          std::chrono::duration<float, std::milli>(end_time - decode_end_time).count());
 
-	// We need to fill in the cube map using the images passed in as
-	// argument. The function `getTextureData()` uses stb to read in the
-	// image files and return a `std::vector<std::uint8_t>` containing all the
-	// texels.
-	std::uint32_t width, height;
-	auto data = getTextureData(negx, width, height, false);
-	if (data.empty()) {
-		glDeleteTextures(1, &texture);
+	return texture;
+}
+
+// Load a cube map from a KTX 1 file, uploading all its faces and levels
+// straight from the memory-mapped file.
+static GLuint
+loadPackedTextureCubeMap(std::string const& filename, bool generate_mipmap)
+{
+	utils::file_view const file(filename);
+	if (!file.is_open()) {
+		LogError("Couldn't open cube map file \"%s\".", filename.c_str());
 		return 0u;
 	}
-	// With all the texels available on the CPU, we now want to push them
-	// to the GPU: this is done using `glTexImage2D()` (among others). You
-	// might have thought that the target used here would be the same as
-	// the one passed to `glBindTexture()` or `glTexParameteri()`, similar
-	// to what is done `bonobo::loadTexture2D()`. However, we want to fill
-	// in a cube map, which has six different faces, so instead we specify
-	// as the target the face we want to fill in. In this case, we will
-	// start by filling the face sitting on the negative side of the
-	// x-axis by specifying GL_TEXTURE_CUBE_MAP_NEGATIVE_X.
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
-	             /* mipmap level, you'll see that in EDAN35 */0,
-	             /* how are the components internally stored */GL_RGBA,
-	             /* the width of the cube map's face */static_cast<GLsizei>(width),
-	             /* the height of the cube map's face */static_cast<GLsizei>(height),
-	             /* must always be 0 */0,
-	             /* the format of the pixel data: which components are available */GL_RGBA,
-	             /* the type of each component */GL_UNSIGNED_BYTE,
-	             /* the pointer to the actual data on the CPU */reinterpret_cast<GLvoid const*>(data.data()));
-
-	//! \todo repeat now the texture filling for the 5 remaining faces
 
-	if (generate_mipmap)
-		// Generate the mipmap hierarchy; wait for EDAN35 to understand
-		// what it does
-		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+	ktx_header header;
+	if (file.size() < ktx_identifier.size() + sizeof(header)
+	 || std::memcmp(file.data(), ktx_identifier.data(), ktx_identifier.size()) != 0) {
+		LogError("\"%s\" is not a KTX file.", filename.c_str());
+		return 0u;
+	}
+	std::memcpy(&header, file.data() + ktx_identifier.size(), sizeof(header));
+	if (header.endianness != 0x04030201u) {
+		LogError("\"%s\" was written with a different endianness.", filename.c_str());
+		return 0u;
+	}
+	if (header.faces_nb != 6u || header.array_elements_nb != 0u || header.pixel_depth > 1u
+	 || header.pixel_width != header.pixel_height || header.pixel_width == 0u) {
+		LogError("\"%s\" does not contain a single cube map with square faces.", filename.c_str());
+		return 0u;
+	}
+
+	// Levels are only generated when the file has none besides the first
+	// one, on the GPU since the texels could be compressed.
+	auto const is_compressed = header.gl_type == 0u;
+	auto const file_levels_nb = std::max(header.mipmap_levels_nb, 1u);
+	auto const generate_on_gpu = generate_mipmap && file_levels_nb == 1u && !is_compressed;
+	auto const levels_nb = generate_on_gpu ? static_cast<GLsizei>(std::floor(std::log2(header.pixel_width))) + 1
+	                                       : static_cast<GLsizei>(generate_mipmap ? file_levels_nb : 1u);
+
+	// Every level starts with its size, followed by each face padded to
+	// 4 bytes.
+	auto const data_offset = ktx_identifier.size() + sizeof(header) + header.key_value_data_size;
+	struct face_level {
+		std::size_t offset;
+		std::uint32_t size;
+	};
+	std::vector<face_level> face_levels;
+	auto offset = data_offset;
+	for (GLsizei level = 0; level < static_cast<GLsizei>(file_levels_nb); ++level) {
+		if (offset + sizeof(std::uint32_t) > file.size())
+			break;
+		std::uint32_t image_size = 0u;
+		std::memcpy(&image_size, file.data() + offset, sizeof(image_size));
+		offset += sizeof(image_size);
+		for (std::uint32_t face = 0u; face < 6u; ++face) {
+			face_levels.push_back({ offset, image_size });
+			offset += (image_size + 3u) & ~3u;
+		}
+	}
+	if (offset > file.size() || face_levels.size() != 6u * file_levels_nb) {
+		LogError("\"%s\" is truncated.", filename.c_str());
+		return 0u;
+	}
 
+	auto const upload_start_time = std::chrono::high_resolution_clock::now();
+
+	// The whole payload is staged at once, since it is laid out contiguously
+	// in the file.
+	auto const payload_size = static_cast<GLsizeiptr>(offset - data_offset);
+	auto const upload_ring = bonobo::uploads::getStagingRing();
+	auto const staging = upload_ring != nullptr ? upload_ring->Allocate(payload_size) : UploadRing::Allocation();
+	if (staging.data != nullptr) {
+		std::memcpy(staging.data, file.data() + data_offset, static_cast<std::size_t>(payload_size));
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_ring->GetBuffer());
+	}
+
+	bool has_storage = false;
+	auto const texture = createCubeMap(levels_nb, header.gl_internal_format, header.pixel_width, has_storage);
+	auto const uploaded_levels_nb = generate_on_gpu ? 1u : static_cast<std::uint32_t>(levels_nb);
+	for (std::uint32_t level = 0u; level < uploaded_levels_nb; ++level) {
+		auto const size = std::max(header.pixel_width >> level, 1u);
+		for (std::uint32_t face = 0u; face < 6u; ++face) {
+			auto const& face_level = face_levels[6u * level + face];
+			auto const data = staging.data != nullptr
+			                ? reinterpret_cast<GLvoid const*>(static_cast<std::uintptr_t>(staging.offset + (face_level.offset - data_offset)))
+			                : reinterpret_cast<GLvoid const*>(file.data() + face_level.offset);
+			uploadCubeMapLevel(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, static_cast<GLint>(level), has_storage,
+			                   header.gl_internal_format, header.gl_format, header.gl_type,
+			                   size, static_cast<GLsizei>(face_level.size), data);
+		}
+	}
+
+	if (staging.data != nullptr) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+		upload_ring->Submit(staging);
+	}
+	if (generate_on_gpu)
+		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, 0u);
+	bonobo::uploads::record(staging.data != nullptr, static_cast<std::uint64_t>(payload_size), upload_start_time);
+
+	return texture;
+}
+
+GLuint
+bonobo::loadTextureCubeMap(std::string const& filename, bool generate_mipmap)
+{
+	auto const start_time = std::chrono::high_resolution_clock::now();
+
+	auto const extension_start = filename.rfind('.');
+	auto extension = extension_start != std::string::npos ? filename.substr(extension_start + 1u) : std::string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c){ return static_cast<char>(std::tolower(c)); });
+	if (extension == "ktx")
+		return loadPackedTextureCubeMap(filename, generate_mipmap);
+
+	bool has_failed = false;
+	std::uint32_t width = 0u, height = 0u;
+	auto const texels = bonobo::texture_registry::getTextureData(filename, width, height, false, &has_failed);
+	if (has_failed)
+		return 0u;
+
+	std::uint32_t face_size = 0u;
+	auto const layout = getCubeMapLayout(width, height, face_size);
+	if (layout == cube_map_layout_t::unknown) {
+		LogError("\"%s\" is %u×%u texels, which does not match a 6×1 or 1×6 strip, nor a 4×3 or 3×4 cross of square faces.",
+		         filename.c_str(), width, height);
+		return 0u;
+	}
+	auto const positions = getCubeMapFacePositions(layout);
+
+	// Faces are extracted from the image, and their mipmap hierarchies
+	// generated, on one worker thread each.
+	auto const channels_nb = 4u;
+	std::vector<std::future<bonobo::texture_registry::decoded_image>> preparations;
+	{
+		ThreadPool workers(positions.size());
+		auto const staging = bonobo::uploads::getStagingRing();
+		auto const image = &texels;
+		for (auto const& position : positions) {
+			preparations.push_back(workers.Enqueue([image, width, face_size, position, generate_mipmap, staging](){
+				auto const row_size = static_cast<std::size_t>(face_size) * channels_nb;
+				utils::byte_buffer face_texels(row_size * face_size);
+				for (std::uint32_t y = 0u; y < face_size; ++y) {
+					auto const source = image->data() + ((static_cast<std::size_t>(position.row) * face_size + y) * width
+					                                     + static_cast<std::size_t>(position.column) * face_size) * channels_nb;
+					if (!position.is_upside_down) {
+						std::memcpy(face_texels.data() + y * row_size, source, row_size);
+						continue;
+					}
+					auto const destination = face_texels.data() + (face_size - 1u - y) * row_size;
+					for (std::uint32_t x = 0u; x < face_size; ++x)
+						std::memcpy(destination + (face_size - 1u - x) * channels_nb, source + x * channels_nb, channels_nb);
+				}
+				return prepareCubeMapFace(std::move(face_texels), face_size, generate_mipmap, staging);
+			}));
+		}
+	}
+
+	std::vector<bonobo::texture_registry::decoded_image> faces;
+	for (auto& preparation : preparations)
+		faces.push_back(preparation.get());
+
+	auto const decode_end_time = std::chrono::high_resolution_clock::now();
+	auto const texture = uploadCubeMap(faces);
+	auto const end_time = std::chrono::high_resolution_clock::now();
+	LogTrivia("Cube map \"%s\" decoded in %.3f ms and uploaded in %.3f ms",
+	          filename.c_str(),
+	          std::chrono::duration<float, std::milli>(decode_end_time - start_time).count(),
+	          std::chrono::duration<float, std::milli>(end_time - decode_end_time).count());
 
 	return texture;
 }
@@ -477,12 +941,12 @@ bonobo::loadTextureCubeMap(std::string const& posx, std::string const& negx,
 GLuint
 bonobo::createProgram(std::string const& vert_shader_source_path, std::string const& frag_shader_source_path)
 {
-	auto const vertex_shader_source = utils::slurp_file(config::shaders_path(vert_shader_source_path));
+	auto const vertex_shader_source = utils::opengl::shader::read_source(config::shaders_path(vert_shader_source_path));
 	GLuint vertex_shader = utils::opengl::shader::generate_shader(GL_VERTEX_SHADER, vertex_shader_source);
 	if (vertex_shader == 0u)
 		return 0u;
 
-	auto const fragment_shader_source = utils::slurp_file(config::shaders_path(frag_shader_source_path));
+	auto const fragment_shader_source = utils::opengl::shader::read_source(config::shaders_path(frag_shader_source_path));
 	GLuint fragment_shader = utils::opengl::shader::generate_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
 	if (fragment_shader == 0u)
 		return 0u;
@@ -5,11 +5,15 @@
 #include <glm/glm.hpp>
 
 #include "core/FPSCamera.h" // As it includes OpenGL headers, import it after glad
+#include "core/various.hpp"
 
+#include <array>
+#include <cstdint>
 #include <functional>
+#include <limits>
+#include <memory>
 #include <string>
 #include <vector>
-#include <unordered_map>
 
 //! \brief Namespace containing a few helpers for the LUGG computer graphics labs.
 namespace bonobo
@@ -24,10 +28,6 @@ namespace bonobo
 		binormals      //!< = 4, value of the binding point for binormals
 	};
 
-	//! \brief Association of a sampler name used in GLSL to a
-	//!        corresponding texture ID.
-	using texture_bindings = std::unordered_map<std::string, GLuint>;
-
 	struct material_data {
 		glm::vec3 diffuse{ 0.0f };
 		glm::vec3 specular{ 0.0f };
@@ -38,19 +38,205 @@ namespace bonobo
 		float opacity{ 1.0f };
 	};
 
+	//! \brief Index of a material in the material table; see
+	//!        `getMaterialTable()`.
+	using material_id = std::uint32_t;
+
+	//! \brief Material ID of meshes without any material.
+	constexpr material_id invalid_material_id = std::numeric_limits<material_id>::max();
+
+	//! \brief How the vertex attributes of a mesh are encoded, so that its
+	//!        vertex shader can decode them; see `vertex_layout_options`.
+	struct vertex_encoding {
+		bool has_quantised_positions{ false };   //!< Positions are normalised to [0, 1] within the bounding box of the mesh
+		glm::vec3 dequantisation_scale{ 1.0f };  //!< Size of the bounding box, if positions are quantised
+		glm::vec3 dequantisation_offset{ 0.0f }; //!< Minimum corner of the bounding box, if positions are quantised
+		bool has_octahedral_normals{ false };    //!< Normals and tangents are octahedral-encoded, and binormals given by the sign stored in the tangents' third component
+	};
+
 	//! \brief Contains the data for a mesh in OpenGL.
 	struct mesh_data {
 		GLuint vao{0u};                          //!< OpenGL name of the Vertex Array Object
 		GLuint bo{0u};                           //!< OpenGL name of the Buffer Object
 		GLuint ibo{0u};                          //!< OpenGL name of the Buffer Object for indices
-		GLsizei vertices_nb{0};                  //!< number of vertices stored in bo
-		GLsizei indices_nb{0};                   //!< number of indices stored in ibo
-		texture_bindings bindings{};             //!< texture bindings for this mesh
-		material_data material{};                //!< constant values for the material of this mesh
+		GLsizei vertices_nb{0};                  //!< number of vertices of this mesh stored in bo
+		GLsizei indices_nb{0};                   //!< number of indices of this mesh stored in ibo
+		GLint base_vertex{0};                    //!< index of the first vertex of this mesh in bo, to add to all indices; see `glDrawElementsBaseVertex()`
+		GLsizei first_index{0};                  //!< index of the first index of this mesh in ibo, in units of `index_type`
+		GLenum index_type{GL_UNSIGNED_INT};      //!< type of the indices stored in ibo, i.e. GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+		vertex_encoding encoding{};              //!< how the attributes stored in bo are encoded
+		glm::vec3 bounds_min{0.0f};              //!< minimum corner of a box bounding the mesh, in model space
+		glm::vec3 bounds_max{0.0f};              //!< maximum corner of that box
+		glm::vec3 bounds_centre{0.0f};           //!< centre of a sphere bounding the mesh, in model space
+		float bounds_radius{0.0f};               //!< radius of that sphere, or 0 if unknown
+		float texcoords_density{0.0f};           //!< average texture-coordinate units per model-space unit, or 0 if the mesh has none; used to select texture levels
+		material_id material{invalid_material_id}; //!< material of this mesh in the material table, see `getMaterialTable()`
 		GLenum drawing_mode{GL_TRIANGLES};       //!< OpenGL drawing mode, i.e. GL_TRIANGLES, GL_LINES, etc.
 		std::string name{"un-named mesh"};       //!< Name of the mesh; used for debugging purposes.
 	};
 
+	//! \brief CPU-side view of the vertex and index streams of a mesh, as
+	//!        retrieved from an object/scene file.
+	//!
+	//! The streams are not owned by this structure: they point either into
+	//! data owned by an importer, or into a `scene_description`.
+	struct mesh_streams {
+		std::string name{"un-named mesh"};                                     //!< Name of the mesh
+		GLenum drawing_mode{GL_TRIANGLES};                                     //!< OpenGL drawing mode
+		std::uint32_t material_index{std::numeric_limits<std::uint32_t>::max()}; //!< Index into `scene_description::materials`
+		std::uint32_t vertices_nb{0u};                                         //!< Number of vertices in each stream
+		std::uint32_t indices_nb{0u};                                          //!< Number of indices
+		float const* vertices{nullptr};                                        //!< 3 floats per vertex
+		float const* normals{nullptr};                                         //!< 3 floats per vertex, if any
+		float const* texcoords{nullptr};                                       //!< 3 floats per vertex, if any
+		float const* tangents{nullptr};                                        //!< 3 floats per vertex, if any
+		float const* binormals{nullptr};                                       //!< 3 floats per vertex, if any
+		std::uint32_t const* indices{nullptr};                                 //!< Indices, if any
+	};
+
+	//! \brief Number of texture slots a material description can reference:
+	//!        diffuse, specular, normals and opacity, in that order.
+	constexpr std::size_t material_texture_slots_nb = 4u;
+
+	//! \brief Texture slots of a material, by role.
+	enum class material_texture_slot_t : unsigned int {
+		diffuse = 0u,
+		specular,
+		normals,
+		opacity
+	};
+
+	//! \brief Name of the GLSL sampler each texture slot is bound to, like
+	//!        "diffuse_texture".
+	constexpr std::array<char const*, material_texture_slots_nb> material_texture_names{ {
+		"diffuse_texture", "specular_texture", "normals_texture", "opacity_texture"
+	} };
+
+	//! \brief Name of the GLSL boolean telling whether each texture slot is
+	//!        used, like "has_diffuse_texture".
+	constexpr std::array<char const*, material_texture_slots_nb> material_texture_presence_names{ {
+		"has_diffuse_texture", "has_specular_texture", "has_normals_texture", "has_opacity_texture"
+	} };
+
+	//! \brief A material shared by all meshes using it; see
+	//!        `createMaterial()`.
+	struct material_entry {
+		std::string name;                                         //!< Name of the material; used for debugging purposes
+		std::uint32_t constants_index{ 0u };                      //!< Index into `material_table::constants`, shared by materials with the same constants
+		std::array<GLuint, material_texture_slots_nb> textures{}; //!< Texture bound to each slot, by `material_texture_slot_t`; 0 if unused
+		std::uint32_t references_nb{ 0u };                        //!< Number of references held on the material; 0 if its ID is free
+	};
+
+	//! \brief All materials, indexed by `material_id`, and their distinct
+	//!        constants.
+	struct material_table {
+		std::vector<material_entry> materials;
+		std::vector<material_data> constants;
+	};
+
+	//! \brief Uniform buffer binding point of the `MaterialConstants`
+	//!        block; see `bindMaterialConstants()`.
+	constexpr GLuint material_constants_binding = 8u;
+
+	//! \brief Layout of the `MaterialConstants` uniform block, following
+	//!        the std140 rules; shaders get the block by including
+	//!        shaders/common/material_constants.glsl, which has to be kept
+	//!        in sync with this structure.
+	struct material_constants_block {
+		glm::vec3 diffuse;
+		float shininess;
+		glm::vec3 specular;
+		float index_of_refraction;
+		glm::vec3 ambient;
+		float opacity;
+		glm::vec3 emissive;
+		float padding;
+	};
+	static_assert(sizeof(material_constants_block) == 64u, "material_constants_block must match its std140 layout.");
+
+	//! \brief CPU-side description of a material, as retrieved from an
+	//!        object/scene file.
+	struct material_description {
+		std::string name;                                                   //!< Name of the material
+		material_data constants{};                                          //!< Constant values of the material
+		std::array<std::string, material_texture_slots_nb> texture_paths{}; //!< Paths relative to the scene file, empty if unused
+	};
+
+	//! \brief CPU-side content of an object/scene file, ready to be
+	//!        uploaded to OpenGL.
+	struct scene_description {
+		std::vector<mesh_streams> meshes;                   //!< All meshes found in the file
+		std::vector<material_description> materials;       //!< All materials found in the file
+		std::vector<std::vector<std::uint8_t>> owned_data; //!< Storage for streams not owned by an importer
+		utils::file_view mapping;                           //!< Storage for streams read from a cache file
+	};
+
+	//! \brief How the vertex attributes of a mesh are arranged in its
+	//!        buffer object.
+	enum class vertex_layout_t : unsigned int {
+		planar = 0u, //!< One tightly-packed region per attribute, one after the other
+		interleaved  //!< All attributes of a vertex next to each other
+	};
+
+	//! \brief Bit representing an attribute in
+	//!        `vertex_layout_options::attributes`.
+	constexpr std::uint32_t vertexAttributeBit(shader_bindings const binding)
+	{
+		return 1u << static_cast<unsigned int>(binding);
+	}
+
+	//! \brief Combination of the bits of all attributes listed in
+	//!        `shader_bindings`.
+	constexpr std::uint32_t all_vertex_attributes = (1u << (static_cast<unsigned int>(shader_bindings::binormals) + 1u)) - 1u;
+
+	//! \brief Requested arrangement of the vertex attributes of a mesh.
+	struct vertex_layout_options {
+		vertex_layout_t layout{ vertex_layout_t::planar }; //!< Whether attributes should be planar or interleaved
+		std::uint32_t attributes{ all_vertex_attributes }; //!< Attributes to keep, as a combination of `vertexAttributeBit()`; positions are always kept
+		GLint texcoords_components_nb{ 3 };                //!< Whether texture coordinates are stored as `vec2` or `vec3`
+		GLsizei stride{ 0 };                               //!< Distance in bytes between two vertices of an interleaved layout; 0 means tightly packed
+		bool quantise_attributes{ false };                 //!< Store normals and tangents octahedral-encoded as 16-bit snorm, a binormal sign rather than binormals, and texture coordinates as 2 half floats
+		bool quantise_positions{ false };                  //!< Store positions as 16-bit unorm within the bounding box of each mesh
+	};
+
+	//! \brief Processing applied to the meshes of an object/scene file
+	//!        when it gets imported.
+	//!
+	//! The result is stored in the scene cache, so the processing is only
+	//! done once per file and set of options. Vertices are welded before
+	//! being reordered; an epsilon of 0 only merges identical values.
+	struct mesh_processing_options {
+		bool optimise_vertex_cache{ false };    //!< Reorder triangles for post-transform vertex cache reuse
+		bool optimise_overdraw{ false };        //!< Sort clusters of triangles to reduce overdraw; implies `optimise_vertex_cache`
+		bool optimise_vertex_fetch{ false };    //!< Renumber vertices in the order they are first used
+		std::uint32_t vertex_cache_size{ 16u }; //!< Number of entries of the post-transform vertex cache to optimise for
+		float overdraw_threshold{ 1.05f };      //!< How much the overdraw pass may degrade the cache miss ratio
+		bool weld_vertices{ false };            //!< Merge vertices whose attributes match within the epsilons below
+		float weld_position_epsilon{ 0.0f };    //!< Largest difference between matching positions, per component
+		float weld_normal_epsilon{ 0.0f };      //!< Largest difference between matching normals, per component
+		float weld_texcoord_epsilon{ 0.0f };    //!< Largest difference between matching texture coordinates, per component
+		float weld_tangent_epsilon{ 0.0f };     //!< Largest difference between matching tangents and binormals, per component
+	};
+
+	//! \brief Where to find an attribute in a buffer object, and how to
+	//!        interpret it; the arguments to `glVertexAttribPointer()`.
+	struct vertex_attribute_description {
+		shader_bindings binding;
+		GLint components_nb;
+		GLenum type;
+		GLboolean normalised;
+		GLsizei stride;
+		GLintptr offset;
+	};
+
+	//! \brief Actual arrangement of the vertex attributes of a mesh.
+	struct vertex_layout_description {
+		vertex_layout_t layout{ vertex_layout_t::planar };   //!< Whether attributes are planar or interleaved
+		std::vector<vertex_attribute_description> attributes; //!< Attributes present in the buffer object
+		GLsizei vertex_size{ 0 };                             //!< Bytes used per vertex, padding included
+		GLsizeiptr buffer_size{ 0 };                          //!< Bytes used by all vertices
+	};
+
 	enum class cull_mode_t : unsigned int {
 		disabled = 0u,
 		back_faces,
@@ -63,18 +249,321 @@ namespace bonobo
 		point
 	};
 
+	//! \brief How a texture should be block-compressed on the GPU, given
+	//!        what its content represents; see `texture_compression.hpp`.
+	enum class texture_compression_t : unsigned int {
+		none = 0u,      //!< Keep all four channels as 8-bit values
+		colour,         //!< BC1, or BC3 if any texel is not fully opaque
+		single_channel, //!< BC4 of the red channel, sampled as (r, r, r, 1)
+		normal_map      //!< BC5 of the red and green channels, with blue sampled as 1; shaders have to reconstruct z
+	};
+
 	//! \brief Allocate some objects needed by some helper functions.
 	void init();
 
 	//! \brief Deallocate objects allocated by the `init()` function.
 	void deinit();
 
-	//! \brief Load objects found in an object/scene file, using assimp.
+	//! \brief Load objects found in an object/scene file, using assimp, or
+	//!        the native loader from `obj_loader.hpp` for ".obj" files; the
+	//!        latter falls back to assimp if it fails.
+	//!
+	//! The processed geometry and materials are stored in a binary cache
+	//! next to the object/scene file (see `scene_cache.hpp`), so that later
+	//! calls on an unmodified file can skip assimp altogether and upload
+	//! straight from a memory mapping of that cache.
+	//!
+	//! All meshes of the file are sub-allocated from a single geometry
+	//! arena: they share the same vertex array, buffer object and index
+	//! buffer object, and have to be drawn using their `base_vertex` and
+	//! `first_index`, for example via `glDrawElementsBaseVertex()`. Indices
+	//! are stored on 16 bits for meshes with few enough vertices; see
+	//! `mesh_data::index_type`.
+	//!
+	//! Textures are obtained through `acquireTexture2D()`, so images shared
+	//! between materials, or with previously loaded scenes, are only loaded
+	//! once.
 	//!
 	//! @param [in] filename of the object/scene file to load.
+	//! @param [in] vertex_layout how to arrange the vertex attributes of
+	//!             each mesh.
+	//! @param [in] processing optimisations to run on each mesh when
+	//!             importing the file.
+	//! @param [in] compress_textures whether to block-compress textures
+	//!             according to the material slot they are used in: BC1/BC3
+	//!             for diffuse and specular, BC5 for normals and BC4 for
+	//!             opacity.
 	//! @return a vector of filled in `mesh_data` structures, one per
 	//!         object found in the input file
-	std::vector<mesh_data> loadObjects(std::string const& filename);
+	std::vector<mesh_data> loadObjects(std::string const& filename,
+	                                   vertex_layout_options const& vertex_layout = vertex_layout_options(),
+	                                   mesh_processing_options const& processing = mesh_processing_options(),
+	                                   bool compress_textures = false);
+
+	//! \brief Release the OpenGL objects created by `loadObjects()`, as
+	//!        well as the references to their textures.
+	//!
+	//! @param [in,out] objects the meshes to release; the vector is emptied.
+	void unloadObjects(std::vector<mesh_data>& objects);
+
+	//! \brief Add a material to the material table.
+	//!
+	//! Its constants are shared with any other material having the same
+	//! ones. IDs of released materials get reused, so that the table stays
+	//! compact.
+	//!
+	//! @param [in] name of the material, for debugging purposes
+	//! @param [in] constants constant values of the material
+	//! @param [in] textures texture for each slot, or 0; the material takes
+	//!             over one reference on each, as obtained from
+	//!             `acquireTexture2D()`, and releases it along with itself
+	//! @return the ID of the new material, holding one reference
+	material_id createMaterial(std::string const& name, material_data const& constants,
+	                           std::array<GLuint, material_texture_slots_nb> const& textures = {});
+
+	//! \brief Take an additional reference on a material.
+	void retainMaterial(material_id id);
+
+	//! \brief Release a reference on a material, releasing its textures
+	//!        and freeing its ID once no reference is left.
+	//!
+	//! @param [in] id of the material; `invalid_material_id` is ignored
+	void releaseMaterial(material_id id);
+
+	//! \brief Replace the texture of a slot of a material, for all meshes
+	//!        using it.
+	//!
+	//! @param [in] id of the material
+	//! @param [in] slot which texture to replace
+	//! @param [in] texture the new texture, or 0 to leave the slot unused;
+	//!             the material takes over one reference on it, and
+	//!             releases the one on the previous texture
+	void setMaterialTexture(material_id id, material_texture_slot_t slot, GLuint texture);
+
+	//! \brief Return the material table, for render loops to look the
+	//!        materials of meshes up by ID.
+	material_table const& getMaterialTable();
+
+	//! \brief Bind the constants of a material to the `MaterialConstants`
+	//!        uniform block, at `material_constants_binding`.
+	//!
+	//! The constants of all materials are kept in a single buffer, uploaded
+	//! again only when materials with new constants were created, so this
+	//! only binds a range of it.
+	//!
+	//! @param [in] id of the material
+	void bindMaterialConstants(material_id id);
+
+	//! \brief Bind constants outside the material table to the
+	//!        `MaterialConstants` uniform block, writing them to the next
+	//!        block of a ring buffer of their own.
+	//!
+	//! @param [in] constants constant values to bind
+	void bindMaterialConstants(material_data const& constants);
+
+	//! \brief Importers that can read an object/scene file.
+	enum class scene_importer_t : unsigned int {
+		assimp = 0u, //!< assimp, with the post-processing flags used by `loadObjects()`
+		native_obj   //!< The parser from `obj_loader.hpp`, for ".obj" files only
+	};
+
+	//! \brief Outcome of `benchmarkSceneImport()`.
+	struct scene_import_stats {
+		bool is_successful{ false };  //!< Whether the file was imported
+		float duration_ms{ 0.0f };    //!< How long the import took, in milliseconds
+		std::size_t meshes_nb{ 0u };   //!< Number of meshes imported
+		std::size_t vertices_nb{ 0u }; //!< Number of vertices, over all meshes
+		std::size_t indices_nb{ 0u };  //!< Number of indices, over all meshes
+	};
+
+	//! \brief Time the import of an object/scene file by a given importer,
+	//!        bypassing the scene cache and any processing.
+	//!
+	//! Nothing is uploaded, and no OpenGL call is made.
+	//!
+	//! @param [in] filename of the object/scene file to import
+	//! @param [in] importer which importer to use
+	//! @return how long the import took, and what it produced
+	scene_import_stats benchmarkSceneImport(std::string const& filename, scene_importer_t importer);
+
+	//! \brief How much uploading `updateObjectsAsync()` may do per call,
+	//!        so that streaming a scene in does not make frames hitch.
+	//!
+	//! At least one mesh or texture is uploaded per call, whatever the
+	//! budget, so that loading always progresses.
+	struct upload_budget {
+		std::uint64_t bytes{ 8u * 1024u * 1024u }; //!< Stop uploading once that many bytes were uploaded
+		float duration_ms{ 2.0f };                 //!< Stop uploading once that much time was spent
+	};
+
+	//! \brief Progress of an object/scene file loaded by
+	//!        `loadObjectsAsync()`.
+	struct async_objects_progress {
+		bool is_geometry_read{ false };         //!< The meshes and materials were imported or read from the cache
+		bool is_complete{ false };              //!< All meshes and textures were uploaded
+		bool has_failed{ false };               //!< The file could not be imported
+		std::size_t meshes_nb{ 0u };            //!< Meshes found in the file
+		std::size_t meshes_uploaded_nb{ 0u };   //!< Meshes uploaded so far, and available for drawing
+		std::size_t textures_nb{ 0u };          //!< Distinct images used by the materials
+		std::size_t textures_decoded_nb{ 0u };  //!< Images decoded so far, including those shared with previously loaded scenes
+		std::size_t textures_uploaded_nb{ 0u }; //!< Images uploaded so far, including those shared with previously loaded scenes
+		std::uint64_t bytes_uploaded{ 0u };     //!< Vertices, indices and texels uploaded so far
+		std::uint32_t frames_nb{ 0u };          //!< Calls to `updateObjectsAsync()` which did some work
+		float elapsed_s{ 0.0f };                //!< Time since the call to `loadObjectsAsync()`, or taken to load if complete
+	};
+
+	//! \brief State of an object/scene file being loaded in the background;
+	//!        see `loadObjectsAsync()`.
+	struct async_objects;
+
+	//! \brief Start loading an object/scene file in the background, and
+	//!        return immediately.
+	//!
+	//! The file is imported, or read from its cache, and its images decoded
+	//! on worker threads. Uploads happen in `updateObjectsAsync()`, which
+	//! has to be called regularly, for example once per frame, from the
+	//! thread owning the OpenGL context. The meshes are then the same as
+	//! returned by `loadObjects()`, except that they become available one
+	//! after the other, and that their textures are bound to the debug
+	//! texture, see `getDebugTextureID()`, until the real ones are
+	//! uploaded.
+	//!
+	//! The meshes, and the references they hold to their textures, are
+	//! owned by the returned object: they get released, from whichever
+	//! thread drops the last reference to it, which therefore has to own the
+	//! OpenGL context.
+	//!
+	//! @param [in] filename of the object/scene file to load.
+	//! @param [in] vertex_layout how to arrange the vertex attributes of
+	//!             each mesh.
+	//! @param [in] processing optimisations to run on each mesh when
+	//!             importing the file.
+	//! @param [in] compress_textures whether to block-compress textures;
+	//!             see `loadObjects()`.
+	//! @return the handle to pass to the other `*ObjectsAsync()` functions
+	std::shared_ptr<async_objects> loadObjectsAsync(std::string const& filename,
+	                                                vertex_layout_options const& vertex_layout = vertex_layout_options(),
+	                                                mesh_processing_options const& processing = mesh_processing_options(),
+	                                                bool compress_textures = false);
+
+	//! \brief Upload what is ready of an object/scene file being loaded by
+	//!        `loadObjectsAsync()`, within |budget|.
+	//!
+	//! Meshes are uploaded first, so that something can be drawn as early
+	//! as possible, then textures in the order they finish decoding.
+	//!
+	//! @param [in,out] objects as returned by `loadObjectsAsync()`
+	//! @param [in] budget how much to upload at most
+	//! @return whether meshes were added or textures replaced, in which
+	//!         case anything derived from `getObjectsAsync()` has to be
+	//!         updated
+	bool updateObjectsAsync(async_objects& objects, upload_budget const& budget = upload_budget());
+
+	//! \brief Return the meshes uploaded so far by `updateObjectsAsync()`.
+	//!
+	//! The reference stays valid as long as |objects| does, but meshes get
+	//! appended to it and their bindings updated.
+	std::vector<mesh_data> const& getObjectsAsync(async_objects const& objects);
+
+	//! \brief Return how far `updateObjectsAsync()` got in loading
+	//!        |objects|.
+	async_objects_progress getObjectsAsyncProgress(async_objects const& objects);
+
+	//! \brief Return the smallest index type, GL_UNSIGNED_SHORT or
+	//!        GL_UNSIGNED_INT, able to address all vertices of a mesh.
+	//!
+	//! @param [in] vertices_nb number of vertices of the mesh
+	GLenum getIndexType(std::size_t vertices_nb);
+
+	//! \brief Return the size, in bytes, of an index of type |index_type|.
+	std::size_t getIndexSize(GLenum index_type);
+
+	//! \brief Return the offset to pass to `glDrawElements()` & co. for
+	//!        drawing |mesh|.
+	GLvoid const* getIndicesOffset(mesh_data const& mesh);
+
+	//! \brief Convert indices to |index_type|.
+	//!
+	//! @param [in] indices the indices to convert
+	//! @param [in] indices_nb the number of indices to convert
+	//! @param [in] index_type as returned by `getIndexType()`
+	//! @param [out] destination receives `indices_nb * getIndexSize(index_type)`
+	//!              bytes
+	void packIndices(std::uint32_t const* indices, std::size_t indices_nb,
+	                 GLenum index_type, void* destination);
+
+	//! \brief Compute where each attribute of a mesh should be stored.
+	//!
+	//! Attributes requested in |options| but missing from |streams| are
+	//! skipped.
+	//!
+	//! @param [in] options the requested arrangement
+	//! @param [in] streams the mesh whose vertices will be stored
+	//! @return the arrangement to pass to `uploadVertices()` and
+	//!         `setupVertexAttributes()`
+	vertex_layout_description describeVertexLayout(vertex_layout_options const& options,
+	                                               mesh_streams const& streams);
+
+	//! \brief Fill the buffer object currently bound to GL_ARRAY_BUFFER with
+	//!        the vertices of a mesh, arranged according to |layout|.
+	//!
+	//! The buffer object is (re)allocated to `layout.buffer_size` bytes.
+	//!
+	//! @param [in] layout as returned by `describeVertexLayout()`
+	//! @param [in] streams the mesh whose vertices to store
+	void uploadVertices(vertex_layout_description const& layout,
+	                    mesh_streams const& streams);
+
+	//! \brief Overwrite part of the buffer object currently bound to
+	//!        GL_ARRAY_BUFFER with the vertices of a mesh, arranged
+	//!        according to |layout|.
+	//!
+	//! This is used for sub-allocating several meshes from a single buffer
+	//! object: attributes of |layout| missing from |streams| are filled
+	//! with zeroes.
+	//!
+	//! @param [in] layout as returned by `describeVertexLayout()` for the
+	//!             whole buffer object
+	//! @param [in] streams the mesh whose vertices to store
+	//! @param [in] base_vertex index, in the buffer object, at which to
+	//!             store the first vertex of |streams|
+	void updateVertices(vertex_layout_description const& layout,
+	                    mesh_streams const& streams,
+	                    GLint base_vertex);
+
+	//! \brief Return how the vertices of a mesh are encoded by
+	//!        `uploadVertices()` or `updateVertices()`.
+	//!
+	//! @param [in] layout as returned by `describeVertexLayout()`
+	//! @param [in] streams the mesh whose vertices are stored
+	vertex_encoding getVertexEncoding(vertex_layout_description const& layout,
+	                                  mesh_streams const& streams);
+
+	//! \brief Compute the bounding box and sphere of a mesh, as well as its
+	//!        texture-coordinates density.
+	//!
+	//! This is done by `loadObjects()`; meshes created by other means should
+	//! call it for their bounds to be used, for example for culling.
+	//!
+	//! @param [in] streams the vertices and indices of the mesh
+	//! @param [out] mesh where to store the bounds and density
+	void computeMeshBounds(mesh_streams const& streams, mesh_data& mesh);
+
+	//! \brief Set the uniforms used by vertex shaders to decode the
+	//!        attributes of a mesh: `has_quantised_positions`,
+	//!        `vertex_dequantisation_scale`, `vertex_dequantisation_offset`
+	//!        and `has_octahedral_normals`.
+	//!
+	//! @param [in] program the program currently in use
+	//! @param [in] encoding as found in `mesh_data::encoding`
+	void setVertexEncodingUniforms(GLuint program, vertex_encoding const& encoding);
+
+	//! \brief Enable and point all attributes of |layout| in the vertex
+	//!        array currently bound, sourcing them from the buffer object
+	//!        currently bound to GL_ARRAY_BUFFER.
+	//!
+	//! @param [in] layout as returned by `describeVertexLayout()`
+	void setupVertexAttributes(vertex_layout_description const& layout);
 
 	//! \brief Creates an OpenGL texture without any content nor parameters.
 	//!
@@ -97,14 +586,170 @@ namespace bonobo
 
 	//! \brief Load an image into an OpenGL 2D-texture.
 	//!
+	//! The mipmap hierarchy is generated on the CPU by `mipmaps::generate()`,
+	//! on all hardware threads, rather than by the driver; colours are
+	//! filtered in linear space, and normals renormalised, if |compression|
+	//! says the image holds some.
+	//!
+	//! Compressed images are cached next to the image, so later loads can
+	//! upload the blocks straight away; they always come with a full mipmap
+	//! hierarchy.
+	//!
 	//! @param [in] filename of the image.
 	//! @param [in] generate_mipmap whether or not to generate a mipmap hierarchy
+	//! @param [in] compression how to block-compress the texture; falls
+	//!             back to `texture_compression_t::none` if the OpenGL
+	//!             implementation does not support it
 	//! @return the name of the OpenGL 2D-texture
 	GLuint loadTexture2D(std::string const& filename,
-	                     bool generate_mipmap = true);
+	                     bool generate_mipmap = true,
+	                     texture_compression_t compression = texture_compression_t::none);
+
+	//! \brief Statistics about the textures shared through the texture
+	//!        registry.
+	struct texture_registry_stats {
+		std::size_t textures_nb{ 0u };      //!< Textures currently registered
+		std::size_t references_nb{ 0u };    //!< References held on them
+		std::uint64_t bytes_allocated{ 0u };    //!< Estimated size of those textures
+		std::uint64_t bytes_uncompressed{ 0u }; //!< Estimated size of those textures, had none of them been block-compressed
+		std::uint64_t bytes_saved{ 0u };        //!< Estimated size of the textures that did not have to be loaded again, since startup
+	};
+
+	//! \brief Load an image into an OpenGL 2D-texture, sharing it with
+	//!        previous callers that loaded the same image.
+	//!
+	//! Textures are registered process-wide, keyed on the canonical path of
+	//! the image and on the load options: acquiring the same image again
+	//! returns the same texture and increases its reference count instead
+	//! of decoding and allocating it anew.
+	//!
+	//! Every call must be matched by a call to `releaseTexture()`; never
+	//! delete the returned texture with `glDeleteTextures()` directly. Like
+	//! any other OpenGL call, this has to be called from the thread owning
+	//! the OpenGL context.
+	//!
+	//! @param [in] filename of the image.
+	//! @param [in] generate_mipmap whether or not to generate a mipmap hierarchy
+	//! @param [in] compression how to block-compress the texture; see
+	//!             `loadTexture2D()`
+	//! @return the name of the OpenGL 2D-texture
+	GLuint acquireTexture2D(std::string const& filename,
+	                        bool generate_mipmap = true,
+	                        texture_compression_t compression = texture_compression_t::none);
+
+	//! \brief Release a reference to a texture obtained through
+	//!        `acquireTexture2D()`, deleting the texture once it is no longer
+	//!        referenced.
+	//!
+	//! @param [in] texture the name of the OpenGL texture to release
+	void releaseTexture(GLuint texture);
+
+	//! \brief Retrieve statistics about the texture registry.
+	texture_registry_stats getTextureRegistryStats();
+
+	//! \brief Statistics about the texture and buffer uploads done by
+	//!        `loadObjects()`, `loadObjectsAsync()`, `loadTexture2D()`,
+	//!        `acquireTexture2D()`, `createTexture()` and
+	//!        `updateVertices()`, since `init()`.
+	//!
+	//! When the OpenGL implementation supports buffer storage, data is
+	//! staged in a persistently-mapped ring, decoded images being written
+	//! there directly by worker threads, and the thread owning the OpenGL
+	//! context only issues copies from it; otherwise, or when the ring is
+	//! full, data is uploaded from client memory. Durations are measured on
+	//! the thread owning the OpenGL context, while issuing the uploads.
+	struct upload_stats {
+		bool is_staging_supported{ false };      //!< Whether uploads go through the staging ring
+		std::uint64_t staging_capacity{ 0u };    //!< Size of the staging ring, in bytes
+		std::uint64_t bytes_staged{ 0u };        //!< Bytes uploaded from the staging ring
+		float staged_duration_ms{ 0.0f };        //!< Time spent uploading those
+		std::uint64_t bytes_direct{ 0u };        //!< Bytes uploaded from client memory
+		float direct_duration_ms{ 0.0f };        //!< Time spent uploading those
+		std::uint32_t staging_failures_nb{ 0u }; //!< Uploads from client memory because the ring was full
+		std::uint32_t stalls_nb{ 0u };           //!< Times the GPU had to be waited on for space in the ring
+		float stall_duration_ms{ 0.0f };         //!< Time spent waiting on the GPU
+	};
+
+	//! \brief Retrieve statistics about uploads.
+	upload_stats getUploadStats();
+
+	//! \brief How textures of objects/scenes get streamed in, level by
+	//!        level, rather than fully uploaded when loaded.
+	//!
+	//! When enabled, `loadObjects()` and `loadObjectsAsync()` only upload
+	//! the smallest levels of each texture, keeping all levels in CPU
+	//! memory. Every frame, `requestTextureLevels()` tells which level each
+	//! drawn mesh needs given its size on screen, and
+	//! `updateTextureStreaming()` uploads finer levels accordingly, evicting
+	//! the levels that went unneeded the longest to stay within the budget.
+	struct texture_streaming_options {
+		bool enabled{ false };                              //!< Whether textures loaded from now on get streamed
+		std::uint64_t budget_bytes{ 256u * 1024u * 1024u }; //!< Size streamed textures may use on the GPU, all levels included
+		std::uint32_t resident_size{ 64u };                 //!< Levels no larger than that many texels, on their largest side, stay resident
+	};
+
+	//! \brief State of the streamed textures.
+	struct texture_streaming_stats {
+		std::size_t textures_nb{ 0u };             //!< Textures currently streamed
+		std::size_t levels_nb{ 0u };               //!< Levels of those textures
+		std::size_t resident_levels_nb{ 0u };      //!< Levels currently on the GPU
+		std::size_t requested_levels_nb{ 0u };     //!< Levels requested during the last frame, resident or not
+		std::uint64_t resident_bytes{ 0u };        //!< Size of the resident levels
+		std::uint64_t full_bytes{ 0u };            //!< Size all levels would use if resident
+		std::uint64_t budget_bytes{ 0u };          //!< Size the resident levels may use
+		std::uint32_t levels_streamed_in_nb{ 0u }; //!< Levels uploaded since `init()`
+		std::uint32_t levels_evicted_nb{ 0u };     //!< Levels evicted since `init()`
+		std::uint64_t bytes_streamed_in{ 0u };     //!< Size of the levels uploaded since `init()`
+		std::uint64_t bytes_evicted{ 0u };         //!< Size of the levels evicted since `init()`
+	};
+
+	//! \brief Change how textures get streamed.
+	//!
+	//! Enabling or disabling streaming only affects objects/scenes loaded
+	//! afterwards, while the budget applies from the next call to
+	//! `updateTextureStreaming()` on.
+	void setTextureStreamingOptions(texture_streaming_options const& options);
+
+	//! \brief Return how textures get streamed.
+	texture_streaming_options getTextureStreamingOptions();
+
+	//! \brief Tell which levels of the textures bound to a mesh are needed
+	//!        to draw it this frame.
+	//!
+	//! The level is estimated from how many texels of each texture cover a
+	//! pixel on screen, given the bounding sphere of the mesh and the
+	//! density of its texture coordinates; bindings which are not streamed
+	//! are ignored.
+	//!
+	//! @param [in] mesh as returned by `loadObjects()` or
+	//!             `getObjectsAsync()`
+	//! @param [in] model_to_clip transform from the model space of |mesh|
+	//!             to clip space, using a perspective projection
+	//! @param [in] viewport_height in pixels
+	void requestTextureLevels(mesh_data const& mesh, glm::mat4 const& model_to_clip, float viewport_height);
+
+	//! \brief Upload the levels requested since the previous call, and evict
+	//!        others if needed to stay within the budget; this has to be
+	//!        called once per frame, after `requestTextureLevels()` was
+	//!        called for each drawn mesh.
+	//!
+	//! Levels are streamed in one at a time per texture, from coarse to
+	//! fine, and evicted the other way round, so that each texture always
+	//! has a complete hierarchy from its finest resident level down.
+	//!
+	//! @param [in] budget how much to upload at most
+	void updateTextureStreaming(upload_budget const& budget = upload_budget());
+
+	//! \brief Retrieve statistics about the streamed textures.
+	texture_streaming_stats getTextureStreamingStats();
 
 	//! \brief Load six images into an OpenGL cubemap-texture.
 	//!
+	//! The faces are decoded, and their mipmap hierarchies generated, in
+	//! parallel on worker threads; they have to be square and share the
+	//! same dimensions. Storage for all faces and levels is allocated at
+	//! once when the OpenGL implementation supports it.
+	//!
 	//! @param [in] posx path to the texture on the left of the cubemap
 	//! @param [in] negx path to the texture on the right of the cubemap
 	//! @param [in] posy path to the texture on the top of the cubemap
@@ -118,6 +763,21 @@ namespace bonobo
                                   std::string const& posz, std::string const& negz,
                                   bool generate_mipmap = true);
 
+	//! \brief Load all six faces of an OpenGL cubemap-texture from a single
+	//!        file.
+	//!
+	//! The file is either a KTX file containing a cube map, whose faces and
+	//! levels are uploaded as stored, or an image with the faces laid out
+	//! as a 6×1 or 1×6 strip ordered +X, -X, +Y, -Y, +Z, -Z, or as a 4×3
+	//! horizontal or 3×4 vertical cross; the layout is deduced from the
+	//! aspect ratio of the image.
+	//!
+	//! @param [in] filename of the KTX file or image
+	//! @param [in] generate_mipmap whether or not to generate a mipmap
+	//!             hierarchy; KTX files with several levels keep theirs
+	//! @return the name of the OpenGL cubemap-texture, or 0 on failure
+	GLuint loadTextureCubeMap(std::string const& filename, bool generate_mipmap = true);
+
 	//! \brief Create an OpenGL program consisting of a vertex and a
 	//!        fragment shader.
 	//!
@@ -0,0 +1,261 @@
+#include "material_table.hpp"
+
+#include "core/opengl.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace
+{
+	//! \brief The material table, with how many materials reference each
+	//!        of its constants, and which material IDs are free.
+	//!
+	//! All constants are also kept in a uniform buffer, one block every
+	//! |constants_stride| bytes, which is uploaded again on the next bind
+	//! after new constants got added; the second buffer holds constants
+	//! bound from outside the table, written one after the other into a
+	//! ring of blocks which gets orphaned whenever it wraps around, so that
+	//! writing never waits on draws still reading earlier blocks.
+	struct {
+		bonobo::material_table table;
+		std::vector<std::uint32_t> constants_references_nb;
+		std::vector<bonobo::material_id> free_ids;
+		GLuint constants_buffer{ 0u };
+		GLintptr constants_stride{ 0 };
+		bool is_constants_buffer_outdated{ false };
+		GLuint loose_constants_buffer{ 0u };
+		GLintptr loose_constants_offset{ 0 };
+	} materials_state;
+}
+
+// The debug texture stands in for textures still being loaded, and does not
+// go through the texture registry.
+static void
+releaseMaterialTexture(GLuint texture)
+{
+	if (texture != 0u && texture != bonobo::getDebugTextureID())
+		bonobo::releaseTexture(texture);
+}
+
+void
+bonobo::materials::clear()
+{
+	materials_state.table.materials.clear();
+	materials_state.table.constants.clear();
+	materials_state.constants_references_nb.clear();
+	materials_state.free_ids.clear();
+	glDeleteBuffers(1, &materials_state.constants_buffer);
+	materials_state.constants_buffer = 0u;
+	materials_state.is_constants_buffer_outdated = false;
+	glDeleteBuffers(1, &materials_state.loose_constants_buffer);
+	materials_state.loose_constants_buffer = 0u;
+	materials_state.loose_constants_offset = 0;
+}
+
+bonobo::material_id
+bonobo::createMaterial(std::string const& name, material_data const& constants,
+                       std::array<GLuint, material_texture_slots_nb> const& textures)
+{
+	// Tables stay small, a few hundred constants at most, so a linear
+	// search is enough to find identical ones.
+	auto const are_equal = [](material_data const& lhs, material_data const& rhs){
+		return lhs.diffuse == rhs.diffuse && lhs.specular == rhs.specular && lhs.ambient == rhs.ambient
+		    && lhs.emissive == rhs.emissive && lhs.shininess == rhs.shininess
+		    && lhs.indexOfRefraction == rhs.indexOfRefraction && lhs.opacity == rhs.opacity;
+	};
+	auto constants_index = std::numeric_limits<std::uint32_t>::max();
+	auto free_constants_index = std::numeric_limits<std::uint32_t>::max();
+	for (std::uint32_t i = 0u; i < materials_state.table.constants.size(); ++i) {
+		if (materials_state.constants_references_nb[i] == 0u) {
+			free_constants_index = std::min(free_constants_index, i);
+		} else if (are_equal(materials_state.table.constants[i], constants)) {
+			constants_index = i;
+			break;
+		}
+	}
+	if (constants_index == std::numeric_limits<std::uint32_t>::max()) {
+		materials_state.is_constants_buffer_outdated = true;
+		if (free_constants_index != std::numeric_limits<std::uint32_t>::max()) {
+			constants_index = free_constants_index;
+			materials_state.table.constants[constants_index] = constants;
+		} else {
+			constants_index = static_cast<std::uint32_t>(materials_state.table.constants.size());
+			materials_state.table.constants.push_back(constants);
+			materials_state.constants_references_nb.push_back(0u);
+		}
+	}
+	++materials_state.constants_references_nb[constants_index];
+
+	material_id id;
+	if (!materials_state.free_ids.empty()) {
+		id = materials_state.free_ids.back();
+		materials_state.free_ids.pop_back();
+	} else {
+		id = static_cast<material_id>(materials_state.table.materials.size());
+		materials_state.table.materials.emplace_back();
+	}
+
+	auto& material = materials_state.table.materials[id];
+	material.name = name;
+	material.constants_index = constants_index;
+	material.textures = textures;
+	material.references_nb = 1u;
+
+	return id;
+}
+
+void
+bonobo::retainMaterial(material_id id)
+{
+	assert(id < materials_state.table.materials.size() && materials_state.table.materials[id].references_nb != 0u);
+	++materials_state.table.materials[id].references_nb;
+}
+
+void
+bonobo::releaseMaterial(material_id id)
+{
+	if (id == invalid_material_id)
+		return;
+
+	assert(id < materials_state.table.materials.size() && materials_state.table.materials[id].references_nb != 0u);
+	auto& material = materials_state.table.materials[id];
+	if (--material.references_nb != 0u)
+		return;
+
+	for (auto& texture : material.textures) {
+		releaseMaterialTexture(texture);
+		texture = 0u;
+	}
+	--materials_state.constants_references_nb[material.constants_index];
+	material.name.clear();
+
+	// Keep handing out the lowest IDs first.
+	materials_state.free_ids.insert(std::upper_bound(materials_state.free_ids.begin(), materials_state.free_ids.end(), id, std::greater<material_id>()), id);
+}
+
+void
+bonobo::setMaterialTexture(material_id id, material_texture_slot_t slot, GLuint texture)
+{
+	assert(id < materials_state.table.materials.size() && materials_state.table.materials[id].references_nb != 0u);
+	auto& current = materials_state.table.materials[id].textures[static_cast<std::size_t>(slot)];
+	releaseMaterialTexture(current);
+	current = texture;
+}
+
+bonobo::material_table const&
+bonobo::getMaterialTable()
+{
+	return materials_state.table;
+}
+
+static bonobo::material_constants_block
+packMaterialConstants(bonobo::material_data const& constants)
+{
+	bonobo::material_constants_block block;
+	block.diffuse = constants.diffuse;
+	block.shininess = constants.shininess;
+	block.specular = constants.specular;
+	block.index_of_refraction = constants.indexOfRefraction;
+	block.ambient = constants.ambient;
+	block.opacity = constants.opacity;
+	block.emissive = constants.emissive;
+	block.padding = 0.0f;
+	return block;
+}
+
+// Blocks are laid out |constants_stride| bytes apart, to satisfy the
+// alignment required by `glBindBufferRange()`.
+static void
+computeMaterialConstantsStride()
+{
+	if (materials_state.constants_stride != 0)
+		return;
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	alignment = std::max(alignment, 1);
+	auto const block_size = static_cast<GLintptr>(sizeof(bonobo::material_constants_block));
+	materials_state.constants_stride = (block_size + alignment - 1) / alignment * alignment;
+}
+
+// Constants only get added while loading scenes, so the whole buffer is
+// uploaded again rather than tracking which blocks changed.
+static void
+uploadMaterialConstants()
+{
+	computeMaterialConstantsStride();
+	if (materials_state.constants_buffer == 0u) {
+		glGenBuffers(1, &materials_state.constants_buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, materials_state.constants_buffer);
+		utils::opengl::debug::nameObject(GL_BUFFER, materials_state.constants_buffer, "Material constants");
+	} else {
+		glBindBuffer(GL_UNIFORM_BUFFER, materials_state.constants_buffer);
+	}
+
+	auto const stride = static_cast<std::size_t>(materials_state.constants_stride);
+	std::vector<std::uint8_t> blocks(materials_state.table.constants.size() * stride, 0u);
+	for (std::size_t i = 0u; i < materials_state.table.constants.size(); ++i) {
+		auto const block = packMaterialConstants(materials_state.table.constants[i]);
+		std::memcpy(blocks.data() + i * stride, &block, sizeof(block));
+	}
+	glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(blocks.size()), blocks.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+
+	materials_state.is_constants_buffer_outdated = false;
+}
+
+void
+bonobo::bindMaterialConstants(material_id id)
+{
+	assert(id < materials_state.table.materials.size() && materials_state.table.materials[id].references_nb != 0u);
+	if (materials_state.is_constants_buffer_outdated || materials_state.constants_buffer == 0u)
+		uploadMaterialConstants();
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, material_constants_binding, materials_state.constants_buffer,
+	                  materials_state.table.materials[id].constants_index * materials_state.constants_stride,
+	                  static_cast<GLsizeiptr>(sizeof(material_constants_block)));
+}
+
+void
+bonobo::bindMaterialConstants(material_data const& constants)
+{
+	constexpr GLintptr loose_constants_blocks_nb = 256;
+	computeMaterialConstantsStride();
+	auto const ring_size = static_cast<GLsizeiptr>(loose_constants_blocks_nb * materials_state.constants_stride);
+	if (materials_state.loose_constants_buffer == 0u) {
+		glGenBuffers(1, &materials_state.loose_constants_buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, materials_state.loose_constants_buffer);
+		glBufferData(GL_UNIFORM_BUFFER, ring_size, nullptr, GL_STREAM_DRAW);
+		utils::opengl::debug::nameObject(GL_BUFFER, materials_state.loose_constants_buffer, "Loose material constants");
+		materials_state.loose_constants_offset = 0;
+	} else {
+		glBindBuffer(GL_UNIFORM_BUFFER, materials_state.loose_constants_buffer);
+	}
+
+	// Blocks handed out earlier may still be read by pending draws: rather
+	// than overwriting them, the storage is orphaned once the ring is full.
+	if (materials_state.loose_constants_offset + materials_state.constants_stride > ring_size) {
+		glBufferData(GL_UNIFORM_BUFFER, ring_size, nullptr, GL_STREAM_DRAW);
+		materials_state.loose_constants_offset = 0;
+	}
+
+	auto const block = packMaterialConstants(constants);
+	auto const offset = materials_state.loose_constants_offset;
+	auto const destination = glMapBufferRange(GL_UNIFORM_BUFFER, offset, sizeof(block),
+	                                          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (destination != nullptr) {
+		std::memcpy(destination, &block, sizeof(block));
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	} else {
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(block), &block);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+	materials_state.loose_constants_offset += materials_state.constants_stride;
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, material_constants_binding, materials_state.loose_constants_buffer,
+	                  offset, static_cast<GLsizeiptr>(sizeof(block)));
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "helpers.hpp"
+
+//! \brief The material table shared by all loaded objects/scenes, and the
+//!        uniform buffers its constants get bound from; the public side is
+//!        `bonobo::createMaterial()` and the functions following it.
+namespace bonobo
+{
+namespace materials
+{
+	//! \brief Empty the material table, and delete the buffers holding its
+	//!        constants; called by `bonobo::deinit()`.
+	void clear();
+}
+}
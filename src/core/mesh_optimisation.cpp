@@ -0,0 +1,475 @@
+#include "mesh_optimisation.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+	// Simulated FIFO cache: a vertex is in the cache if it missed less than
+	// `cache_size` misses ago. Timestamps start past `cache_size` so that
+	// all vertices initially miss.
+	class fifo_cache
+	{
+	public:
+		fifo_cache(std::size_t vertices_nb, std::uint32_t cache_size)
+			: mTimestamps(vertices_nb, 0u), mTime(static_cast<std::size_t>(cache_size) + 1u), mCacheSize(cache_size)
+		{
+		}
+
+		//! \brief Return whether |vertex| missed, and add it to the cache
+		//!        if so.
+		bool Access(std::uint32_t vertex)
+		{
+			if (mTime - mTimestamps[vertex] <= mCacheSize)
+				return false;
+
+			mTimestamps[vertex] = mTime++;
+			return true;
+		}
+
+		//! \brief Evict all vertices from the cache.
+		void Flush()
+		{
+			mTime += static_cast<std::size_t>(mCacheSize) + 1u;
+		}
+
+	private:
+		std::vector<std::size_t> mTimestamps;
+		std::size_t mTime;
+		std::size_t mCacheSize;
+	};
+
+	glm::vec3 getPosition(float const* vertices, std::uint32_t vertex)
+	{
+		return glm::vec3(vertices[3u * vertex + 0u], vertices[3u * vertex + 1u], vertices[3u * vertex + 2u]);
+	}
+
+	// Cell of the welding grid containing a position component; without an
+	// epsilon, each distinct value gets its own cell.
+	std::int64_t getWeldCell(float value, float epsilon)
+	{
+		if (epsilon <= 0.0f) {
+			value += 0.0f; // Map -0 to +0, as they compare equal.
+			std::int32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+		constexpr double cell_limit = static_cast<double>(std::int64_t(1) << 62);
+		return static_cast<std::int64_t>(std::max(-cell_limit, std::min(cell_limit, std::floor(static_cast<double>(value) / epsilon))));
+	}
+
+	std::uint64_t hashWeldCell(std::int64_t x, std::int64_t y, std::int64_t z)
+	{
+		return (static_cast<std::uint64_t>(x) * 73856093u)
+		     ^ (static_cast<std::uint64_t>(y) * 19349663u)
+		     ^ (static_cast<std::uint64_t>(z) * 83492791u);
+	}
+}
+
+bool
+bonobo::mesh_optimisation::weldVertices(mesh_streams& mesh,
+                                        std::vector<std::vector<std::uint8_t>>& owned_data,
+                                        mesh_processing_options const& options,
+                                        vertex_weld_statistics& statistics)
+{
+	if (!options.weld_vertices || mesh.vertices == nullptr || mesh.vertices_nb == 0u)
+		return false;
+
+	struct weld_stream {
+		float const** stream;
+		float epsilon;
+	};
+	auto const streams = std::array<weld_stream, 5>{ {
+		{ &mesh.vertices,  options.weld_position_epsilon },
+		{ &mesh.normals,   options.weld_normal_epsilon   },
+		{ &mesh.texcoords, options.weld_texcoord_epsilon },
+		{ &mesh.tangents,  options.weld_tangent_epsilon  },
+		{ &mesh.binormals, options.weld_tangent_epsilon  }
+	} };
+	std::size_t streams_nb = 0u;
+	for (auto const& stream : streams)
+		if (*stream.stream != nullptr)
+			++streams_nb;
+
+	auto const are_matching = [&streams](std::uint32_t lhs, std::uint32_t rhs){
+		for (auto const& stream : streams) {
+			auto const values = *stream.stream;
+			if (values == nullptr)
+				continue;
+
+			for (std::size_t i = 0u; i < 3u; ++i)
+				if (!(std::abs(values[3u * lhs + i] - values[3u * rhs + i]) <= stream.epsilon))
+					return false;
+		}
+		return true;
+	};
+
+	// Each cell references its first kept vertex, which references the
+	// next kept vertex in the same cell, and so on.
+	constexpr auto no_vertex = std::numeric_limits<std::uint32_t>::max();
+	std::unordered_map<std::uint64_t, std::uint32_t> cell_heads;
+	cell_heads.reserve(mesh.vertices_nb);
+	std::vector<std::uint32_t> kept_vertices;
+	std::vector<std::uint32_t> next_in_cell;
+	std::vector<std::uint32_t> remapping(mesh.vertices_nb);
+
+	auto const epsilon = options.weld_position_epsilon;
+	std::int64_t const search_radius = epsilon > 0.0f ? 1 : 0;
+	for (std::uint32_t vertex = 0u; vertex < mesh.vertices_nb; ++vertex) {
+		auto const x = getWeldCell(mesh.vertices[3u * vertex + 0u], epsilon);
+		auto const y = getWeldCell(mesh.vertices[3u * vertex + 1u], epsilon);
+		auto const z = getWeldCell(mesh.vertices[3u * vertex + 2u], epsilon);
+
+		auto match = no_vertex;
+		for (auto dx = -search_radius; dx <= search_radius && match == no_vertex; ++dx)
+			for (auto dy = -search_radius; dy <= search_radius && match == no_vertex; ++dy)
+				for (auto dz = -search_radius; dz <= search_radius && match == no_vertex; ++dz) {
+					auto const head = cell_heads.find(hashWeldCell(x + dx, y + dy, z + dz));
+					if (head == cell_heads.end())
+						continue;
+
+					for (auto kept = head->second; kept != no_vertex; kept = next_in_cell[kept])
+						if (are_matching(vertex, kept_vertices[kept])) {
+							match = kept;
+							break;
+						}
+				}
+
+		if (match == no_vertex) {
+			match = static_cast<std::uint32_t>(kept_vertices.size());
+			auto& head = cell_heads.emplace(hashWeldCell(x, y, z), no_vertex).first->second;
+			next_in_cell.push_back(head);
+			head = match;
+			kept_vertices.push_back(vertex);
+		}
+		remapping[vertex] = match;
+	}
+
+	auto const indices_nb = mesh.indices != nullptr ? mesh.indices_nb : mesh.vertices_nb;
+	statistics.vertices_nb_before = mesh.vertices_nb;
+	statistics.vertices_nb_after = kept_vertices.size();
+	statistics.bytes_before = static_cast<std::size_t>(mesh.vertices_nb) * streams_nb * 3u * sizeof(float)
+	                        + (mesh.indices != nullptr ? static_cast<std::size_t>(mesh.indices_nb) * sizeof(std::uint32_t) : 0u);
+	statistics.bytes_after = kept_vertices.size() * streams_nb * 3u * sizeof(float)
+	                       + static_cast<std::size_t>(indices_nb) * sizeof(std::uint32_t);
+	if (mesh.indices != nullptr && kept_vertices.size() == mesh.vertices_nb)
+		return true;
+
+	owned_data.emplace_back(static_cast<std::size_t>(indices_nb) * sizeof(std::uint32_t));
+	auto const welded_indices = reinterpret_cast<std::uint32_t*>(owned_data.back().data());
+	for (std::uint32_t i = 0u; i < indices_nb; ++i)
+		welded_indices[i] = remapping[mesh.indices != nullptr ? mesh.indices[i] : i];
+	mesh.indices = welded_indices;
+	mesh.indices_nb = indices_nb;
+
+	for (auto const& stream : streams) {
+		if (*stream.stream == nullptr)
+			continue;
+
+		owned_data.emplace_back(kept_vertices.size() * 3u * sizeof(float));
+		auto const welded_stream = reinterpret_cast<float*>(owned_data.back().data());
+		for (std::size_t i = 0u; i < kept_vertices.size(); ++i)
+			std::memcpy(welded_stream + 3u * i, *stream.stream + 3u * kept_vertices[i], 3u * sizeof(float));
+		*stream.stream = welded_stream;
+	}
+	mesh.vertices_nb = static_cast<std::uint32_t>(kept_vertices.size());
+
+	return true;
+}
+
+bonobo::mesh_optimisation::vertex_cache_statistics
+bonobo::mesh_optimisation::analyseVertexCache(std::vector<std::uint32_t> const& indices,
+                                              std::size_t vertices_nb,
+                                              std::uint32_t cache_size)
+{
+	vertex_cache_statistics statistics;
+	statistics.triangles_nb = indices.size() / 3u;
+
+	fifo_cache cache(vertices_nb, cache_size);
+	std::vector<bool> is_referenced(vertices_nb, false);
+	for (auto const index : indices) {
+		if (cache.Access(index))
+			++statistics.transforms_nb;
+		if (!is_referenced[index]) {
+			is_referenced[index] = true;
+			++statistics.vertices_nb;
+		}
+	}
+
+	if (statistics.triangles_nb != 0u)
+		statistics.acmr = static_cast<float>(statistics.transforms_nb) / static_cast<float>(statistics.triangles_nb);
+	if (statistics.vertices_nb != 0u)
+		statistics.atvr = static_cast<float>(statistics.transforms_nb) / static_cast<float>(statistics.vertices_nb);
+
+	return statistics;
+}
+
+void
+bonobo::mesh_optimisation::optimiseVertexCache(std::vector<std::uint32_t>& indices,
+                                               std::size_t vertices_nb,
+                                               std::uint32_t cache_size,
+                                               std::vector<std::size_t>* clusters)
+{
+	auto const triangles_nb = indices.size() / 3u;
+	if (clusters != nullptr) {
+		clusters->clear();
+		if (triangles_nb != 0u)
+			clusters->push_back(0u);
+	}
+	if (triangles_nb == 0u)
+		return;
+
+	// Number of triangles yet to be emitted using each vertex, and the
+	// triangles adjacent to each vertex, stored contiguously.
+	std::vector<std::uint32_t> live_triangles_nb(vertices_nb, 0u);
+	for (auto const index : indices)
+		++live_triangles_nb[index];
+
+	std::vector<std::size_t> adjacency_offsets(vertices_nb + 1u, 0u);
+	std::partial_sum(live_triangles_nb.begin(), live_triangles_nb.end(), adjacency_offsets.begin() + 1u);
+	std::vector<std::uint32_t> adjacency(indices.size());
+	{
+		auto fill_offsets = adjacency_offsets;
+		for (std::size_t i = 0u; i < indices.size(); ++i)
+			adjacency[fill_offsets[indices[i]]++] = static_cast<std::uint32_t>(i / 3u);
+	}
+
+	std::vector<std::size_t> timestamps(vertices_nb, 0u);
+	auto time = static_cast<std::size_t>(cache_size) + 1u;
+	std::vector<bool> is_emitted(triangles_nb, false);
+	std::vector<std::uint32_t> dead_ends;
+	std::vector<std::uint32_t> candidates;
+	std::vector<std::uint32_t> output;
+	output.reserve(indices.size());
+
+	constexpr auto no_vertex = std::numeric_limits<std::size_t>::max();
+	std::size_t cursor = 0u;
+	auto const skip_dead_end = [&](){
+		while (!dead_ends.empty()) {
+			auto const vertex = dead_ends.back();
+			dead_ends.pop_back();
+			if (live_triangles_nb[vertex] > 0u)
+				return static_cast<std::size_t>(vertex);
+		}
+		for (; cursor < vertices_nb; ++cursor)
+			if (live_triangles_nb[cursor] > 0u)
+				return cursor;
+		return no_vertex;
+	};
+
+	auto fanning_vertex = skip_dead_end();
+	while (fanning_vertex != no_vertex) {
+		// Emit all remaining triangles around the fanning vertex.
+		candidates.clear();
+		for (auto i = adjacency_offsets[fanning_vertex]; i < adjacency_offsets[fanning_vertex + 1u]; ++i) {
+			auto const triangle = adjacency[i];
+			if (is_emitted[triangle])
+				continue;
+
+			for (std::size_t j = 0u; j < 3u; ++j) {
+				auto const vertex = indices[3u * triangle + j];
+				output.push_back(vertex);
+				dead_ends.push_back(vertex);
+				candidates.push_back(vertex);
+				--live_triangles_nb[vertex];
+				if (time - timestamps[vertex] > cache_size)
+					timestamps[vertex] = time++;
+			}
+			is_emitted[triangle] = true;
+		}
+
+		// Continue with the oldest candidate which will still be in the
+		// cache once all its triangles are emitted.
+		auto next_vertex = no_vertex;
+		std::size_t best_priority = 0u;
+		for (auto const vertex : candidates) {
+			if (live_triangles_nb[vertex] == 0u)
+				continue;
+
+			auto const age = time - timestamps[vertex];
+			auto const priority = (age + 2u * live_triangles_nb[vertex] <= cache_size) ? age : 0u;
+			if (next_vertex == no_vertex || priority > best_priority) {
+				next_vertex = vertex;
+				best_priority = priority;
+			}
+		}
+		if (next_vertex == no_vertex) {
+			next_vertex = skip_dead_end();
+			if (next_vertex != no_vertex && clusters != nullptr)
+				clusters->push_back(output.size() / 3u);
+		}
+		fanning_vertex = next_vertex;
+	}
+
+	indices.swap(output);
+}
+
+void
+bonobo::mesh_optimisation::optimiseOverdraw(std::vector<std::uint32_t>& indices,
+                                            float const* vertices,
+                                            std::size_t vertices_nb,
+                                            std::vector<std::size_t> const& clusters,
+                                            std::uint32_t cache_size,
+                                            float threshold)
+{
+	auto const triangles_nb = indices.size() / 3u;
+	if (triangles_nb == 0u || clusters.empty() || vertices == nullptr)
+		return;
+
+	// Split clusters further, as soon as their own ACMR is within
+	// |threshold| of the one of the whole mesh.
+	auto const target_acmr = threshold * analyseVertexCache(indices, vertices_nb, cache_size).acmr;
+	std::vector<std::size_t> cluster_starts;
+	fifo_cache cache(vertices_nb, cache_size);
+	for (std::size_t i = 0u; i < clusters.size(); ++i) {
+		auto const end = (i + 1u < clusters.size()) ? clusters[i + 1u] : triangles_nb;
+		auto start = clusters[i];
+		std::size_t misses_nb = 0u;
+		cache.Flush();
+		cluster_starts.push_back(start);
+		for (auto triangle = start; triangle < end; ++triangle) {
+			for (std::size_t j = 0u; j < 3u; ++j)
+				if (cache.Access(indices[3u * triangle + j]))
+					++misses_nb;
+
+			auto const acmr = static_cast<float>(misses_nb) / static_cast<float>(triangle + 1u - start);
+			if (acmr <= target_acmr && triangle + 1u < end) {
+				start = triangle + 1u;
+				misses_nb = 0u;
+				cache.Flush();
+				cluster_starts.push_back(start);
+			}
+		}
+	}
+
+	// Sort clusters by how much they face away from the centre of the mesh.
+	struct cluster_description {
+		std::size_t start;
+		std::size_t end;
+		glm::vec3 centroid;
+		glm::vec3 normal;
+		float sort_key;
+	};
+	std::vector<cluster_description> sorted_clusters(cluster_starts.size());
+	glm::vec3 mesh_centroid(0.0f);
+	float mesh_area = 0.0f;
+	for (std::size_t i = 0u; i < cluster_starts.size(); ++i) {
+		auto& cluster = sorted_clusters[i];
+		cluster.start = cluster_starts[i];
+		cluster.end = (i + 1u < cluster_starts.size()) ? cluster_starts[i + 1u] : triangles_nb;
+		cluster.centroid = glm::vec3(0.0f);
+		cluster.normal = glm::vec3(0.0f);
+
+		float cluster_area = 0.0f;
+		for (auto triangle = cluster.start; triangle < cluster.end; ++triangle) {
+			auto const a = getPosition(vertices, indices[3u * triangle + 0u]);
+			auto const b = getPosition(vertices, indices[3u * triangle + 1u]);
+			auto const c = getPosition(vertices, indices[3u * triangle + 2u]);
+			auto const normal = glm::cross(b - a, c - a);
+			auto const area = glm::length(normal);
+			cluster.centroid += area * (a + b + c) / 3.0f;
+			cluster.normal += normal;
+			cluster_area += area;
+		}
+		mesh_centroid += cluster.centroid;
+		mesh_area += cluster_area;
+		if (cluster_area > 0.0f)
+			cluster.centroid /= cluster_area;
+	}
+	if (mesh_area > 0.0f)
+		mesh_centroid /= mesh_area;
+
+	for (auto& cluster : sorted_clusters) {
+		auto const normal_length = glm::length(cluster.normal);
+		cluster.sort_key = normal_length > 0.0f ? glm::dot(cluster.centroid - mesh_centroid, cluster.normal) / normal_length : 0.0f;
+	}
+	std::stable_sort(sorted_clusters.begin(), sorted_clusters.end(),
+	                 [](cluster_description const& lhs, cluster_description const& rhs){ return lhs.sort_key > rhs.sort_key; });
+
+	std::vector<std::uint32_t> output;
+	output.reserve(indices.size());
+	for (auto const& cluster : sorted_clusters)
+		output.insert(output.end(), indices.begin() + 3u * cluster.start, indices.begin() + 3u * cluster.end);
+	indices.swap(output);
+}
+
+std::vector<std::uint32_t>
+bonobo::mesh_optimisation::optimiseVertexFetch(std::vector<std::uint32_t>& indices,
+                                               std::size_t vertices_nb)
+{
+	constexpr auto unassigned = std::numeric_limits<std::uint32_t>::max();
+	std::vector<std::uint32_t> remapping(vertices_nb, unassigned);
+
+	std::uint32_t next_index = 0u;
+	for (auto& index : indices) {
+		if (remapping[index] == unassigned)
+			remapping[index] = next_index++;
+		index = remapping[index];
+	}
+	for (auto& new_index : remapping)
+		if (new_index == unassigned)
+			new_index = next_index++;
+
+	return remapping;
+}
+
+bool
+bonobo::mesh_optimisation::optimiseMesh(mesh_streams& mesh,
+                                        std::vector<std::vector<std::uint8_t>>& owned_data,
+                                        mesh_processing_options const& options,
+                                        vertex_cache_statistics& before,
+                                        vertex_cache_statistics& after)
+{
+	if (!options.optimise_vertex_cache && !options.optimise_overdraw && !options.optimise_vertex_fetch)
+		return false;
+	if (mesh.drawing_mode != GL_TRIANGLES || mesh.indices == nullptr
+	    || mesh.indices_nb == 0u || mesh.indices_nb % 3u != 0u)
+		return false;
+
+	std::vector<std::uint32_t> indices(mesh.indices, mesh.indices + mesh.indices_nb);
+	before = analyseVertexCache(indices, mesh.vertices_nb, options.vertex_cache_size);
+
+	if (options.optimise_vertex_cache || options.optimise_overdraw) {
+		std::vector<std::size_t> clusters;
+		optimiseVertexCache(indices, mesh.vertices_nb, options.vertex_cache_size,
+		                    options.optimise_overdraw ? &clusters : nullptr);
+		if (options.optimise_overdraw)
+			optimiseOverdraw(indices, mesh.vertices, mesh.vertices_nb, clusters,
+			                 options.vertex_cache_size, options.overdraw_threshold);
+	}
+
+	std::vector<std::uint32_t> remapping;
+	if (options.optimise_vertex_fetch)
+		remapping = optimiseVertexFetch(indices, mesh.vertices_nb);
+
+	after = analyseVertexCache(indices, mesh.vertices_nb, options.vertex_cache_size);
+
+	owned_data.emplace_back(indices.size() * sizeof(std::uint32_t));
+	std::memcpy(owned_data.back().data(), indices.data(), owned_data.back().size());
+	mesh.indices = reinterpret_cast<std::uint32_t const*>(owned_data.back().data());
+
+	if (remapping.empty())
+		return true;
+
+	auto const streams = std::array<float const**, 5>{ { &mesh.vertices, &mesh.normals, &mesh.texcoords, &mesh.tangents, &mesh.binormals } };
+	for (auto const stream : streams) {
+		if (*stream == nullptr)
+			continue;
+
+		owned_data.emplace_back(static_cast<std::size_t>(mesh.vertices_nb) * 3u * sizeof(float));
+		auto const remapped_stream = reinterpret_cast<float*>(owned_data.back().data());
+		for (std::uint32_t i = 0u; i < mesh.vertices_nb; ++i)
+			std::memcpy(remapped_stream + 3u * remapping[i], *stream + 3u * i, 3u * sizeof(float));
+		*stream = remapped_stream;
+	}
+
+	return true;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \brief Welding and reordering of the vertices and triangles of meshes,
+//!        to make better use of the GPU.
+//!
+//! `weldVertices()` first merges duplicated vertices, which also indexes
+//! meshes that were not. Three reordering passes are then provided, meant to
+//! be run in that order:
+//!   1. `optimiseVertexCache()` reorders triangles so that recently
+//!      transformed vertices are reused from the post-transform vertex
+//!      cache, using the Tipsify algorithm from Sander et al., “Fast
+//!      Triangle Reordering for Vertex Locality and Reduced Overdraw”;
+//!   2. `optimiseOverdraw()` sorts clusters of triangles, as produced by the
+//!      first pass, so that the ones more likely to occlude others are
+//!      drawn first, as described in that same paper;
+//!   3. `optimiseVertexFetch()` renumbers vertices in the order in which
+//!      they are first referenced, for linear accesses to the vertex
+//!      buffer.
+//!
+//! None of the passes change the winding of triangles.
+namespace bonobo
+{
+namespace mesh_optimisation
+{
+	//! \brief Efficiency of the post-transform vertex cache for a given
+	//!        index buffer, as simulated with a FIFO cache.
+	struct vertex_cache_statistics {
+		std::size_t triangles_nb{ 0u };   //!< Number of triangles drawn
+		std::size_t vertices_nb{ 0u };    //!< Number of distinct vertices referenced
+		std::size_t transforms_nb{ 0u };  //!< Number of vertex shader invocations
+		float acmr{ 0.0f };               //!< Average cache miss ratio: transforms per triangle, 0.5 at best and 3 at worst
+		float atvr{ 0.0f };               //!< Average transform to vertex ratio: 1 at best
+	};
+
+	//! \brief Size of a mesh before and after welding its vertices.
+	struct vertex_weld_statistics {
+		std::size_t vertices_nb_before{ 0u }; //!< Number of vertices of the original mesh
+		std::size_t vertices_nb_after{ 0u };  //!< Number of vertices of the welded mesh
+		std::size_t bytes_before{ 0u };       //!< Size of the vertex and index streams of the original mesh
+		std::size_t bytes_after{ 0u };        //!< Size of the vertex and index streams of the welded mesh
+	};
+
+	//! \brief Merge the vertices of a mesh whose attributes all match,
+	//!        within the per-attribute epsilons of |options|.
+	//!
+	//! Vertices are hashed on a grid of their positions, whose cells are
+	//! `weld_position_epsilon` wide, so only neighbouring cells have to be
+	//! searched for matches. The first vertex of each group of matching
+	//! ones is kept as-is.
+	//!
+	//! Meshes without indices get indexed. The welded streams are allocated
+	//! in |owned_data|, and the pointers of |mesh| updated to refer to them.
+	//!
+	//! @param [in,out] mesh the mesh to weld
+	//! @param [in,out] owned_data storage for the welded streams
+	//! @param [in] options the epsilons to use
+	//! @param [out] statistics size of the mesh before and after welding
+	//! @return whether |options| enables welding and the mesh was processed
+	bool weldVertices(mesh_streams& mesh,
+	                  std::vector<std::vector<std::uint8_t>>& owned_data,
+	                  mesh_processing_options const& options,
+	                  vertex_weld_statistics& statistics);
+
+	//! \brief Simulate drawing |indices| through a FIFO post-transform
+	//!        vertex cache.
+	//!
+	//! @param [in] indices three per triangle
+	//! @param [in] vertices_nb number of vertices referenced by |indices|
+	//! @param [in] cache_size number of entries of the simulated cache
+	vertex_cache_statistics analyseVertexCache(std::vector<std::uint32_t> const& indices,
+	                                           std::size_t vertices_nb,
+	                                           std::uint32_t cache_size);
+
+	//! \brief Reorder triangles for post-transform vertex cache reuse.
+	//!
+	//! @param [in,out] indices three per triangle
+	//! @param [in] vertices_nb number of vertices referenced by |indices|
+	//! @param [in] cache_size number of entries of the targeted cache
+	//! @param [out] clusters if not null, receives the index of the first
+	//!              triangle of each cluster, suitable for
+	//!              `optimiseOverdraw()`
+	void optimiseVertexCache(std::vector<std::uint32_t>& indices,
+	                         std::size_t vertices_nb,
+	                         std::uint32_t cache_size,
+	                         std::vector<std::size_t>* clusters = nullptr);
+
+	//! \brief Sort clusters of triangles so that those facing outwards,
+	//!        and therefore more likely to occlude the others, come first.
+	//!
+	//! Clusters are first split further, as long as the vertex cache
+	//! efficiency of the result stays within |threshold| of the current
+	//! one.
+	//!
+	//! @param [in,out] indices three per triangle, as ordered by
+	//!                 `optimiseVertexCache()`
+	//! @param [in] vertices 3 floats per vertex
+	//! @param [in] vertices_nb number of vertices referenced by |indices|
+	//! @param [in] clusters as returned by `optimiseVertexCache()`
+	//! @param [in] cache_size number of entries of the targeted cache
+	//! @param [in] threshold how much the ACMR is allowed to degrade, for
+	//!             example 1.05 for up to 5%
+	void optimiseOverdraw(std::vector<std::uint32_t>& indices,
+	                      float const* vertices,
+	                      std::size_t vertices_nb,
+	                      std::vector<std::size_t> const& clusters,
+	                      std::uint32_t cache_size,
+	                      float threshold);
+
+	//! \brief Renumber vertices in the order in which they are first
+	//!        referenced by |indices|.
+	//!
+	//! Unreferenced vertices are moved after all the referenced ones.
+	//!
+	//! @param [in,out] indices updated to use the new numbering
+	//! @param [in] vertices_nb number of vertices referenced by |indices|
+	//! @return the new index of each vertex
+	std::vector<std::uint32_t> optimiseVertexFetch(std::vector<std::uint32_t>& indices,
+	                                               std::size_t vertices_nb);
+
+	//! \brief Run the reordering passes enabled in |options| on a mesh.
+	//!
+	//! Meshes which are not made of indexed triangles are left untouched.
+	//! The optimised streams are allocated in |owned_data|, and the
+	//! pointers of |mesh| updated to refer to them.
+	//!
+	//! @param [in,out] mesh the mesh to optimise
+	//! @param [in,out] owned_data storage for the optimised streams
+	//! @param [in] options which passes to run
+	//! @param [out] before efficiency of the original index buffer
+	//! @param [out] after efficiency of the optimised index buffer
+	//! @return whether the mesh was optimised
+	bool optimiseMesh(mesh_streams& mesh,
+	                  std::vector<std::vector<std::uint8_t>>& owned_data,
+	                  mesh_processing_options const& options,
+	                  vertex_cache_statistics& before,
+	                  vertex_cache_statistics& after);
+}
+}
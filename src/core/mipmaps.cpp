@@ -0,0 +1,382 @@
+#include "mipmaps.hpp"
+
+#include "core/ThreadPool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <future>
+#include <vector>
+
+namespace
+{
+	constexpr float pi = 3.14159265358979f;
+
+	// Both windowed sincs extend over that many texels of the smaller level
+	// on each side.
+	constexpr float filter_radius = 3.0f;
+	constexpr float kaiser_alpha = 4.0f;
+
+	// Levels smaller than that are filtered on the calling thread, as
+	// queueing their rows would take longer than filtering them.
+	constexpr std::uint64_t parallel_texels_nb_threshold = 128u * 128u;
+
+	float sinc(float x)
+	{
+		if (std::abs(x) < 1.0e-5f)
+			return 1.0f;
+		x *= pi;
+		return std::sin(x) / x;
+	}
+
+	// Zeroth-order modified Bessel function of the first kind, used by the
+	// Kaiser window.
+	float besselI0(float x)
+	{
+		float sum = 1.0f, term = 1.0f;
+		for (int k = 1; k < 16; ++k) {
+			auto const factor = x / (2.0f * static_cast<float>(k));
+			term *= factor * factor;
+			sum += term;
+		}
+		return sum;
+	}
+
+	// |x| is expressed in texels of the smaller level.
+	float evaluateKernel(bonobo::mipmaps::filter_t filter, float x)
+	{
+		if (std::abs(x) >= filter_radius)
+			return 0.0f;
+
+		switch (filter) {
+			case bonobo::mipmaps::filter_t::kaiser:
+			{
+				auto const t = x / filter_radius;
+				return sinc(x) * besselI0(kaiser_alpha * std::sqrt(1.0f - t * t)) / besselI0(kaiser_alpha);
+			}
+			case bonobo::mipmaps::filter_t::lanczos:
+				return sinc(x) * sinc(x / filter_radius);
+			case bonobo::mipmaps::filter_t::box:
+				break;
+		}
+		return 0.0f;
+	}
+
+	//! \brief Which source texels contribute to each destination texel
+	//!        along one dimension, and by how much.
+	struct filter_taps {
+		std::vector<std::uint32_t> firsts;  //!< Per destination texel, index of its first tap
+		std::vector<std::uint32_t> counts;  //!< Per destination texel, number of taps
+		std::vector<std::uint32_t> indices; //!< Source texel of each tap, clamped to the edges
+		std::vector<float> weights;         //!< Weight of each tap, normalised per destination texel
+	};
+
+	filter_taps computeTaps(bonobo::mipmaps::filter_t filter, std::uint32_t source_size, std::uint32_t destination_size)
+	{
+		filter_taps taps;
+		taps.firsts.reserve(destination_size);
+		taps.counts.reserve(destination_size);
+
+		// Odd sizes are not exactly halved, so texel centres do not line
+		// up with every other source texel.
+		auto const scale = static_cast<float>(source_size) / static_cast<float>(destination_size);
+		auto const add_tap = [&taps, source_size](int index, float weight){
+			taps.indices.push_back(static_cast<std::uint32_t>(std::min(std::max(index, 0), static_cast<int>(source_size) - 1)));
+			taps.weights.push_back(weight);
+		};
+		for (std::uint32_t i = 0u; i < destination_size; ++i) {
+			auto const first = static_cast<std::uint32_t>(taps.weights.size());
+			auto const centre = (static_cast<float>(i) + 0.5f) * scale;
+			if (filter == bonobo::mipmaps::filter_t::box) {
+				// Weigh source texels by how much of them the destination
+				// texel covers.
+				auto const low = centre - 0.5f * scale, high = centre + 0.5f * scale;
+				for (auto j = static_cast<int>(std::floor(low)); static_cast<float>(j) < high; ++j) {
+					auto const coverage = std::min(high, static_cast<float>(j + 1)) - std::max(low, static_cast<float>(j));
+					if (coverage > 0.0f)
+						add_tap(j, coverage);
+				}
+			} else {
+				auto const support = filter_radius * scale;
+				for (auto j = static_cast<int>(std::floor(centre - support)); static_cast<float>(j) <= centre + support; ++j) {
+					auto const weight = evaluateKernel(filter, (static_cast<float>(j) + 0.5f - centre) / scale);
+					if (weight != 0.0f)
+						add_tap(j, weight);
+				}
+			}
+
+			float sum = 0.0f;
+			for (auto j = first; j < taps.weights.size(); ++j)
+				sum += taps.weights[j];
+			for (auto j = first; j < taps.weights.size(); ++j)
+				taps.weights[j] /= sum;
+
+			taps.firsts.push_back(first);
+			taps.counts.push_back(static_cast<std::uint32_t>(taps.weights.size()) - first);
+		}
+
+		return taps;
+	}
+
+	float srgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linearToSrgb(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	std::array<float, 256> const& getSrgbToLinearTable()
+	{
+		static auto const table = [](){
+			std::array<float, 256> values;
+			for (std::size_t i = 0u; i < values.size(); ++i)
+				values[i] = srgbToLinear(static_cast<float>(i) / 255.0f);
+			return values;
+		}();
+		return table;
+	}
+
+	// Fine enough for the darkest sRGB values, where the curve is steepest,
+	// to be within a fifth of a unit of the exact conversion.
+	constexpr std::size_t linear_to_srgb_table_size = 16384u;
+
+	std::vector<std::uint8_t> const& getLinearToSrgbTable()
+	{
+		static auto const table = [](){
+			std::vector<std::uint8_t> values(linear_to_srgb_table_size);
+			for (std::size_t i = 0u; i < values.size(); ++i) {
+				auto const linear = static_cast<float>(i) / static_cast<float>(linear_to_srgb_table_size - 1u);
+				values[i] = static_cast<std::uint8_t>(linearToSrgb(linear) * 255.0f + 0.5f);
+			}
+			return values;
+		}();
+		return table;
+	}
+
+	// Run |function| on consecutive ranges of [0, |count|), on the threads of
+	// |pool| if any, and wait for all of them to complete.
+	template<typename Function>
+	void parallelFor(ThreadPool* pool, std::uint32_t count, Function const& function)
+	{
+		if (pool == nullptr || count < 2u) {
+			function(0u, count);
+			return;
+		}
+
+		auto const chunks_nb = std::min(count, static_cast<std::uint32_t>(pool->GetThreadsNb() * 4u));
+		std::vector<std::future<void>> chunks;
+		chunks.reserve(chunks_nb);
+		for (std::uint32_t i = 0u; i < chunks_nb; ++i) {
+			auto const begin = static_cast<std::uint32_t>(static_cast<std::uint64_t>(count) * i / chunks_nb);
+			auto const end = static_cast<std::uint32_t>(static_cast<std::uint64_t>(count) * (i + 1u) / chunks_nb);
+			chunks.push_back(pool->Enqueue([&function, begin, end](){ function(begin, end); }));
+		}
+		for (auto& chunk : chunks)
+			chunk.get();
+	}
+}
+
+char const*
+bonobo::mipmaps::getFilterName(filter_t filter)
+{
+	switch (filter) {
+		case filter_t::box:     return "Box";
+		case filter_t::kaiser:  return "Kaiser";
+		case filter_t::lanczos: return "Lanczos";
+		default:                return "Unknown";
+	}
+}
+
+std::vector<bonobo::mipmaps::level>
+bonobo::mipmaps::generate(utils::byte_buffer texels, std::uint32_t width, std::uint32_t height,
+                          filter_t filter, content_t content, ThreadPool* pool)
+{
+	std::vector<level> levels;
+	levels.reserve(static_cast<std::size_t>(std::log2(std::max(std::max(width, height), 1u))) + 1u);
+	levels.push_back({ width, height, std::move(texels) });
+	if (width == 0u || height == 0u)
+		return levels;
+
+	auto const& srgb_to_linear = getSrgbToLinearTable();
+	auto const& linear_to_srgb = getLinearToSrgbTable();
+	auto const is_colour = content == content_t::colour;
+	auto const is_normal_map = content == content_t::normal_map;
+
+	// Each level is filtered from the floating-point version of the
+	// previous one, so that rounding errors do not accumulate.
+	std::vector<float> source(static_cast<std::size_t>(width) * height * 4u);
+	auto const first_texels = levels.front().texels.data();
+	parallelFor(static_cast<std::uint64_t>(width) * height >= parallel_texels_nb_threshold ? pool : nullptr, height,
+	            [&](std::uint32_t begin, std::uint32_t end){
+		for (auto i = static_cast<std::size_t>(begin) * width * 4u; i < static_cast<std::size_t>(end) * width * 4u; ++i)
+			source[i] = (is_colour && i % 4u != 3u) ? srgb_to_linear[first_texels[i]] : static_cast<float>(first_texels[i]) / 255.0f;
+	});
+
+	std::vector<float> intermediate, destination;
+	while (width > 1u || height > 1u) {
+		auto const next_width = std::max(width / 2u, 1u);
+		auto const next_height = std::max(height / 2u, 1u);
+		auto const level_pool = static_cast<std::uint64_t>(width) * height >= parallel_texels_nb_threshold ? pool : nullptr;
+		auto const horizontal_taps = computeTaps(filter, width, next_width);
+		auto const vertical_taps = computeTaps(filter, height, next_height);
+
+		// Filter the rows first, keeping all of them.
+		intermediate.assign(static_cast<std::size_t>(next_width) * height * 4u, 0.0f);
+		parallelFor(level_pool, height, [&](std::uint32_t begin, std::uint32_t end){
+			for (auto y = begin; y < end; ++y) {
+				auto const source_row = source.data() + static_cast<std::size_t>(y) * width * 4u;
+				auto const intermediate_row = intermediate.data() + static_cast<std::size_t>(y) * next_width * 4u;
+				for (std::uint32_t x = 0u; x < next_width; ++x) {
+					std::array<float, 4> sum{ { 0.0f, 0.0f, 0.0f, 0.0f } };
+					auto const first = horizontal_taps.firsts[x];
+					for (auto t = first; t < first + horizontal_taps.counts[x]; ++t) {
+						auto const texel = source_row + static_cast<std::size_t>(horizontal_taps.indices[t]) * 4u;
+						auto const weight = horizontal_taps.weights[t];
+						for (std::size_t c = 0u; c < 4u; ++c)
+							sum[c] += weight * texel[c];
+					}
+					for (std::size_t c = 0u; c < 4u; ++c)
+						intermediate_row[x * 4u + c] = sum[c];
+				}
+			}
+		});
+
+		// Then the columns, accumulating whole rows at a time.
+		level next{ next_width, next_height, utils::byte_buffer(static_cast<std::size_t>(next_width) * next_height * 4u) };
+		destination.assign(static_cast<std::size_t>(next_width) * next_height * 4u, 0.0f);
+		parallelFor(level_pool, next_height, [&](std::uint32_t begin, std::uint32_t end){
+			auto const row_size = static_cast<std::size_t>(next_width) * 4u;
+			for (auto y = begin; y < end; ++y) {
+				auto const destination_row = destination.data() + y * row_size;
+				auto const first = vertical_taps.firsts[y];
+				for (auto t = first; t < first + vertical_taps.counts[y]; ++t) {
+					auto const intermediate_row = intermediate.data() + vertical_taps.indices[t] * row_size;
+					auto const weight = vertical_taps.weights[t];
+					for (std::size_t i = 0u; i < row_size; ++i)
+						destination_row[i] += weight * intermediate_row[i];
+				}
+
+				// Wider kernels have negative lobes, which can overshoot.
+				for (std::size_t i = 0u; i < row_size; ++i)
+					destination_row[i] = std::min(std::max(destination_row[i], 0.0f), 1.0f);
+
+				if (is_normal_map) {
+					for (std::size_t i = 0u; i < row_size; i += 4u) {
+						auto const x = 2.0f * destination_row[i + 0u] - 1.0f;
+						auto const y = 2.0f * destination_row[i + 1u] - 1.0f;
+						auto const z = 2.0f * destination_row[i + 2u] - 1.0f;
+						auto const length = std::sqrt(x * x + y * y + z * z);
+						auto const normalisation = length > 1.0e-6f ? 0.5f / length : 0.0f;
+						destination_row[i + 0u] = x * normalisation + 0.5f;
+						destination_row[i + 1u] = y * normalisation + 0.5f;
+						destination_row[i + 2u] = length > 1.0e-6f ? z * normalisation + 0.5f : 1.0f;
+					}
+				}
+
+				auto const texels_row = next.texels.data() + y * row_size;
+				for (std::size_t i = 0u; i < row_size; ++i) {
+					if (is_colour && i % 4u != 3u)
+						texels_row[i] = linear_to_srgb[static_cast<std::size_t>(destination_row[i] * static_cast<float>(linear_to_srgb_table_size - 1u) + 0.5f)];
+					else
+						texels_row[i] = static_cast<std::uint8_t>(destination_row[i] * 255.0f + 0.5f);
+				}
+			}
+		});
+
+		levels.push_back(std::move(next));
+		std::swap(source, destination);
+		width = next_width;
+		height = next_height;
+	}
+
+	return levels;
+}
+
+void
+bonobo::mipmaps::selectChannels(std::vector<level>& levels, std::vector<std::uint32_t> const& channels)
+{
+	for (auto& level : levels) {
+		if (channels.size() == level.channels_nb) {
+			bool is_identity = true;
+			for (std::uint32_t c = 0u; c < channels.size(); ++c)
+				is_identity = is_identity && channels[c] == c;
+			if (is_identity)
+				continue;
+		}
+
+		auto const texels_nb = static_cast<std::size_t>(level.width) * level.height;
+		utils::byte_buffer texels(texels_nb * channels.size());
+		for (std::size_t i = 0u; i < texels_nb; ++i)
+			for (std::size_t c = 0u; c < channels.size(); ++c)
+				texels[i * channels.size() + c] = level.texels[i * level.channels_nb + channels[c]];
+		level.texels = std::move(texels);
+		level.channels_nb = static_cast<std::uint32_t>(channels.size());
+	}
+}
+
+std::uint64_t
+bonobo::mipmaps::getSize(std::vector<level> const& levels)
+{
+	std::uint64_t size = 0u;
+	for (auto const& level : levels)
+		size += static_cast<std::uint64_t>(level.width) * level.height * level.channels_nb;
+	return size;
+}
+
+void
+bonobo::mipmaps::copyTexels(std::vector<level>& levels, std::uint8_t* destination)
+{
+	for (auto& level : levels) {
+		std::memcpy(destination, level.texels.data(), level.texels.size());
+		destination += level.texels.size();
+		level.texels.reset();
+	}
+}
+
+namespace
+{
+	void texImage(GLenum target, GLint index, bonobo::mipmaps::level const& level, std::uint8_t const* texels)
+	{
+		static std::array<GLenum, 4> const internal_formats{ { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 } };
+		static std::array<GLenum, 4> const formats{ { GL_RED, GL_RG, GL_RGB, GL_RGBA } };
+		auto const format_index = std::min(std::max(level.channels_nb, 1u), 4u) - 1u;
+
+		glTexImage2D(target, index, static_cast<GLint>(internal_formats[format_index]),
+		             static_cast<GLsizei>(level.width), static_cast<GLsizei>(level.height), 0,
+		             formats[format_index], GL_UNSIGNED_BYTE, texels);
+	}
+}
+
+void
+bonobo::mipmaps::upload(GLenum target, std::vector<level> const& levels, std::uint8_t const* staged_texels)
+{
+	if (levels.empty())
+		return;
+
+	// Rows of fewer than 4 channels are not necessarily 4-byte aligned.
+	GLint unpack_alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (std::size_t i = 0u; i < levels.size(); ++i) {
+		auto const& level = levels[i];
+		texImage(target, static_cast<GLint>(i), level, staged_texels != nullptr ? staged_texels : level.texels.data());
+		if (staged_texels != nullptr)
+			staged_texels += static_cast<std::size_t>(level.width) * level.height * level.channels_nb;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+}
+
+void
+bonobo::mipmaps::uploadLevel(GLenum target, GLint index, level const& level, std::uint8_t const* staged_texels)
+{
+	GLint unpack_alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	texImage(target, index, level, staged_texels != nullptr ? staged_texels : level.texels.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+}
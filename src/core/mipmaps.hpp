@@ -0,0 +1,117 @@
+#pragma once
+
+#include "core/various.hpp"
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+//! \brief CPU generation of mipmap hierarchies, as a replacement for
+//!        `glGenerateMipmap()`.
+//!
+//! Which filter the driver uses, and how long it takes, is up to each
+//! implementation, and it blocks the thread owning the OpenGL context. Here
+//! each level is instead computed from the previous one, on worker threads
+//! if given a thread pool, using a separable filter: a 2×2 box, or a wider
+//! Kaiser-windowed sinc or Lanczos kernel which keeps smaller levels sharper
+//! while limiting aliasing.
+//!
+//! Filtering happens on floats, with each row of RGBA texels stored
+//! contiguously so that the inner loops get vectorised by the compiler.
+//! Colours are filtered in linear space rather than on their sRGB encoding,
+//! which would darken smaller levels, and normals are renormalised after
+//! filtering.
+namespace bonobo
+{
+namespace mipmaps
+{
+	//! \brief Filter used to compute a level from the previous one.
+	enum class filter_t : unsigned int {
+		box = 0u, //!< Average of 2×2 texels, like most drivers do
+		kaiser,   //!< Kaiser-windowed sinc, over 3 texels of the smaller level on each side
+		lanczos   //!< Lanczos-windowed sinc, over 3 texels of the smaller level on each side
+	};
+
+	//! \brief What the texels of an image represent, which decides how
+	//!        they get filtered.
+	enum class content_t : unsigned int {
+		linear = 0u, //!< Values filtered as they are stored
+		colour,      //!< sRGB-encoded colours, filtered in linear space; alpha is linear
+		normal_map   //!< Normals remapped from [-1, 1] to [0, 1] in RGB, renormalised after filtering; alpha is linear
+	};
+
+	//! \brief One level of a mipmap hierarchy.
+	struct level {
+		std::uint32_t width{ 0u };         //!< Width in texels
+		std::uint32_t height{ 0u };        //!< Height in texels
+		utils::byte_buffer texels;         //!< 8-bit texels, rows from bottom to top
+		std::uint32_t channels_nb{ 4u };   //!< Number of bytes per texel; see `selectChannels()`
+	};
+
+	//! \brief Return the name of a filter, like "Kaiser".
+	char const* getFilterName(filter_t filter);
+
+	//! \brief Compute the full mipmap hierarchy of an RGBA8 image.
+	//!
+	//! @param [in] texels of the image, 4 bytes per texel; they become the
+	//!             first level
+	//! @param [in] width of the image, in texels
+	//! @param [in] height of the image, in texels
+	//! @param [in] filter how to compute each level from the previous one
+	//! @param [in] content what the texels represent
+	//! @param [in] pool if not null, rows are filtered on its threads rather
+	//!             than on the calling one, which must then not be one of
+	//!             them
+	//! @return all levels, from |texels| to the 1×1 one
+	std::vector<level> generate(utils::byte_buffer texels, std::uint32_t width, std::uint32_t height,
+	                            filter_t filter, content_t content, ThreadPool* pool = nullptr);
+
+	//! \brief Only keep some of the channels of each level, once all levels
+	//!        were generated.
+	//!
+	//! @param [in,out] levels as returned by `generate()`
+	//! @param [in] channels indices of the channels to keep, in the order
+	//!             they should be stored; for example { 0, 3 } to keep red
+	//!             and alpha
+	void selectChannels(std::vector<level>& levels, std::vector<std::uint32_t> const& channels);
+
+	//! \brief Return the size of all levels, in bytes.
+	std::uint64_t getSize(std::vector<level> const& levels);
+
+	//! \brief Move the texels of all levels, one after the other, to
+	//!        |destination|, typically staging memory; the levels only keep
+	//!        their dimensions.
+	//!
+	//! @param [in,out] levels as returned by `generate()`
+	//! @param [out] destination at least `getSize(levels)` bytes
+	void copyTexels(std::vector<level>& levels, std::uint8_t* destination);
+
+	//! \brief Upload levels to the texture currently bound, using
+	//!        `glTexImage2D()` with GL_R8, GL_RG8, GL_RGB8 or GL_RGBA8
+	//!        depending on their number of channels.
+	//!
+	//! The caller is responsible for setting GL_TEXTURE_MAX_LEVEL on the
+	//! texture, if not all levels down to 1×1 are uploaded.
+	//!
+	//! @param [in] target GL_TEXTURE_2D, or a cube map face
+	//! @param [in] levels as returned by `generate()`
+	//! @param [in] staged_texels if not null, where `copyTexels()` moved
+	//!             the texels to; an offset into the buffer bound to
+	//!             GL_PIXEL_UNPACK_BUFFER if any
+	void upload(GLenum target, std::vector<level> const& levels, std::uint8_t const* staged_texels = nullptr);
+
+	//! \brief Upload a single level to the texture currently bound, like
+	//!        `upload()` does.
+	//!
+	//! @param [in] target GL_TEXTURE_2D, or a cube map face
+	//! @param [in] index of the level in its hierarchy
+	//! @param [in] level as returned by `generate()`
+	//! @param [in] staged_texels if not null, where the texels of |level|
+	//!             were copied to; an offset into the buffer bound to
+	//!             GL_PIXEL_UNPACK_BUFFER if any
+	void uploadLevel(GLenum target, GLint index, level const& level, std::uint8_t const* staged_texels = nullptr);
+}
+}
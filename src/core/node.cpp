@@ -1,8 +1,11 @@
 #include "node.hpp"
 #include "helpers.hpp"
+#include "RenderQueue.hpp"
 
+#include "core/culling.hpp"
 #include "core/Log.h"
 #include "core/opengl.hpp"
+#include "core/program_reflection.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -20,52 +23,147 @@ Node::render(glm::mat4 const& view_projection, glm::mat4 const& world, GLuint pr
 	if (_vao == 0u || program == 0u)
 		return;
 
-	utils::opengl::debug::beginDebugGroup(_name);
+	render(view_projection, world, glm::transpose(glm::inverse(world)), program, set_uniforms);
+}
 
-	glUseProgram(program);
+void
+Node::render(glm::mat4 const& view_projection, glm::mat4 const& world, glm::mat4 const& normal_model_to_world) const
+{
+	if (_program != nullptr && _vao != 0u && *_program != 0u)
+		render(view_projection, world, normal_model_to_world, *_program, _set_uniforms);
+}
 
-	auto const normal_model_to_world = glm::transpose(glm::inverse(world));
+void
+Node::render(glm::mat4 const& view_projection, glm::mat4 const& world, glm::mat4 const& normal_model_to_world,
+             GLuint program, std::function<void (GLuint)> const& set_uniforms) const
+{
+	if (!is_visible(view_projection, world))
+		return;
 
-	set_uniforms(program);
+	// Nothing is known of the bindings left by whatever was drawn before.
+	auto& state = GLStateTracker::GetShared();
+	state.Invalidate();
+	draw(view_projection, world, normal_model_to_world, program, set_uniforms, state);
+	state.RestoreDefaults();
+}
 
-	glUniformMatrix4fv(glGetUniformLocation(program, "vertex_model_to_world"), 1, GL_FALSE, glm::value_ptr(world));
-	glUniformMatrix4fv(glGetUniformLocation(program, "normal_model_to_world"), 1, GL_FALSE, glm::value_ptr(normal_model_to_world));
-	glUniformMatrix4fv(glGetUniformLocation(program, "vertex_world_to_clip"), 1, GL_FALSE, glm::value_ptr(view_projection));
+void
+Node::submit(RenderQueue& queue, glm::mat4 const& view_projection, glm::mat4 const& world,
+             glm::mat4 const& normal_model_to_world, std::uint32_t pass) const
+{
+	if (_program == nullptr || _vao == 0u || *_program == 0u || !is_visible(view_projection, world))
+		return;
 
-	for (size_t i = 0u; i < _textures.size(); ++i) {
-		auto const& texture = _textures[i];
-		glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
-		glBindTexture(std::get<2>(texture), std::get<1>(texture));
-		glUniform1i(glGetUniformLocation(program, std::get<0>(texture).c_str()), static_cast<GLint>(i));
+	auto const depth = RenderQueue::GetDepth(view_projection * world, 0.5f * (_bounds_min + _bounds_max));
+	queue.Submit(RenderQueue::MakeKey(pass, *_program, _material, _vao, depth),
+	             *this, view_projection, world, normal_model_to_world);
+}
 
-		std::string texture_presence_var_name = "has_" + std::get<0>(texture);
-		glUniform1i(glGetUniformLocation(program, texture_presence_var_name.c_str()), 1);
+bool
+Node::is_visible(glm::mat4 const& view_projection, glm::mat4 const& world) const
+{
+	// The bounds are tested in model space, against the frustum of the
+	// model-to-clip transform, which saves transforming the box.
+	if (_has_bounds && _is_culling_enabled) {
+		auto const view_frustum = bonobo::culling::extractFrustum(view_projection * world);
+		if (!bonobo::culling::isBoxVisible(view_frustum, _bounds_min - _bounds_margin, _bounds_max + _bounds_margin)) {
+			++bonobo::culling::getStatistics().culled_nb;
+			return false;
+		}
 	}
+	++bonobo::culling::getStatistics().visible_nb;
 
-	glUniform3fv(glGetUniformLocation(program, "diffuse_colour"), 1, glm::value_ptr(_constants.diffuse));
-	glUniform3fv(glGetUniformLocation(program, "specular_colour"), 1, glm::value_ptr(_constants.specular));
-	glUniform3fv(glGetUniformLocation(program, "ambient_colour"), 1, glm::value_ptr(_constants.ambient));
-	glUniform3fv(glGetUniformLocation(program, "emissive_colour"), 1, glm::value_ptr(_constants.emissive));
-	glUniform1f(glGetUniformLocation(program, "shininess_value"), _constants.shininess);
-	glUniform1f(glGetUniformLocation(program, "index_of_refraction_value"), _constants.indexOfRefraction);
-	glUniform1f(glGetUniformLocation(program, "opacity_value"), _constants.opacity);
+	return true;
+}
 
-	glBindVertexArray(_vao);
-	if (_has_indices)
-		glDrawElements(_drawing_mode, _indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
-	else
-		glDrawArrays(_drawing_mode, 0, _vertices_nb);
-	glBindVertexArray(0u);
+void
+Node::draw(glm::mat4 const& view_projection, glm::mat4 const& world, glm::mat4 const& normal_model_to_world,
+           GLStateTracker& state) const
+{
+	draw(view_projection, world, normal_model_to_world, *_program, _set_uniforms, state);
+}
 
-	for (auto const& texture : _textures) {
-		glBindTexture(std::get<2>(texture), 0);
-		glUniform1i(glGetUniformLocation(program, std::get<0>(texture).c_str()), 0);
+void
+Node::draw(glm::mat4 const& view_projection, glm::mat4 const& world, glm::mat4 const& normal_model_to_world,
+           GLuint program, std::function<void (GLuint)> const& set_uniforms, GLStateTracker& state) const
+{
+	utils::opengl::debug::beginDebugGroup(_name);
 
-		std::string texture_presence_var_name = "has_" + std::get<0>(texture);
-		glUniform1i(glGetUniformLocation(program, texture_presence_var_name.c_str()), 0);
+	state.UseProgram(program);
+
+	set_uniforms(program);
+
+	// Locations are looked up once per program, rather than on every draw.
+	auto const& locations = bonobo::program_reflection::getLocations(program);
+	if (_texture_locations_program != program || _texture_locations_generation != bonobo::program_reflection::getGeneration()) {
+		_texture_locations.clear();
+		for (auto const& texture : _textures)
+			_texture_locations.emplace_back(bonobo::program_reflection::getUniformLocation(program, texture.name),
+			                                bonobo::program_reflection::getUniformLocation(program, "has_" + texture.name));
+		_texture_locations_program = program;
+		_texture_locations_generation = bonobo::program_reflection::getGeneration();
+	}
+
+	glUniformMatrix4fv(locations.vertex_model_to_world, 1, GL_FALSE, glm::value_ptr(world));
+	glUniformMatrix4fv(locations.normal_model_to_world, 1, GL_FALSE, glm::value_ptr(normal_model_to_world));
+	glUniformMatrix4fv(locations.vertex_world_to_clip, 1, GL_FALSE, glm::value_ptr(view_projection));
+
+	// The textures of the material come first, in slot order, followed by
+	// those added to the node. The presence flags of all material slots
+	// are set, so that none is left over from the previous node drawn.
+	auto const& material_table = bonobo::getMaterialTable();
+	auto const material = _material < material_table.materials.size() ? &material_table.materials[_material] : nullptr;
+	GLenum unit = 0u;
+	for (std::size_t i = 0u; i < bonobo::material_texture_slots_nb; ++i) {
+		auto const texture = material != nullptr ? material->textures[i] : 0u;
+		if (locations.material_texture_presences[i] != -1)
+			glUniform1i(locations.material_texture_presences[i], texture != 0u ? 1 : 0);
+		if (texture == 0u)
+			continue;
+
+		state.BindTexture(unit, GL_TEXTURE_2D, texture);
+		glUniform1i(locations.material_textures[i], static_cast<GLint>(unit));
+		++unit;
+	}
+	for (std::size_t i = 0u; i < _textures.size(); ++i) {
+		state.BindTexture(unit, _textures[i].type, _textures[i].id);
+		glUniform1i(_texture_locations[i].first, static_cast<GLint>(unit));
+		glUniform1i(_texture_locations[i].second, 1);
+		++unit;
 	}
 
-	glUseProgram(0u);
+	if (locations.material_constants_block != GL_INVALID_INDEX) {
+		if (material != nullptr && !_has_own_constants)
+			state.BindMaterialConstants(_material);
+		else
+			state.BindMaterialConstants(_constants);
+	} else {
+		auto const& constants = (material != nullptr && !_has_own_constants) ? material_table.constants[material->constants_index] : _constants;
+		glUniform3fv(locations.diffuse_colour, 1, glm::value_ptr(constants.diffuse));
+		glUniform3fv(locations.specular_colour, 1, glm::value_ptr(constants.specular));
+		glUniform3fv(locations.ambient_colour, 1, glm::value_ptr(constants.ambient));
+		glUniform3fv(locations.emissive_colour, 1, glm::value_ptr(constants.emissive));
+		glUniform1f(locations.shininess_value, constants.shininess);
+		glUniform1f(locations.index_of_refraction_value, constants.indexOfRefraction);
+		glUniform1f(locations.opacity_value, constants.opacity);
+	}
+	bonobo::setVertexEncodingUniforms(program, _vertex_encoding);
+
+	state.BindVertexArray(_vao);
+	if (_has_indices)
+		glDrawElementsBaseVertex(_drawing_mode, _indices_nb, _index_type,
+		                         reinterpret_cast<GLvoid const*>(static_cast<std::size_t>(_first_index) * bonobo::getIndexSize(_index_type)),
+		                         _base_vertex);
+	else
+		glDrawArrays(_drawing_mode, _base_vertex, _vertices_nb);
+	state.CountDrawCall();
+
+	// Textures, the vertex array and the program are left bound, for the
+	// next node to skip binding them again if it uses the same ones; only
+	// the presence flags of the node's own textures need clearing, since
+	// other nodes may not set them.
+	for (auto const& texture_locations : _texture_locations)
+		glUniform1i(texture_locations.second, 0);
 
 	utils::opengl::debug::endDebugGroup();
 }
@@ -76,22 +174,44 @@ Node::set_geometry(bonobo::mesh_data const& shape)
 	_vao = shape.vao;
 	_vertices_nb = static_cast<GLsizei>(shape.vertices_nb);
 	_indices_nb = static_cast<GLsizei>(shape.indices_nb);
+	_base_vertex = shape.base_vertex;
+	_first_index = shape.first_index;
+	_index_type = shape.index_type;
 	_drawing_mode = shape.drawing_mode;
 	_has_indices = shape.ibo != 0u;
+	_vertex_encoding = shape.encoding;
+	_bounds_min = shape.bounds_min;
+	_bounds_max = shape.bounds_max;
+	_has_bounds = shape.bounds_radius > 0.0f;
 	_name = std::string("Render ") + shape.name;
 
-	if (!shape.bindings.empty()) {
-		for (auto const& binding : shape.bindings)
-			add_texture(binding.first, binding.second, GL_TEXTURE_2D);
-	}
+	set_material(shape.material);
+}
+
+void
+Node::set_culling_enabled(bool enabled)
+{
+	_is_culling_enabled = enabled;
+}
 
-	_constants = shape.material;
+void
+Node::set_bounds_margin(glm::vec3 const& margin)
+{
+	_bounds_margin = margin;
+}
+
+void
+Node::set_material(bonobo::material_id material)
+{
+	_material = material;
+	_has_own_constants = false;
 }
 
 void
 Node::set_material_constants(bonobo::material_data const& constants)
 {
 	_constants = constants;
+	_has_own_constants = true;
 }
 
 void
@@ -144,7 +264,8 @@ Node::add_texture(std::string const& name, GLuint tex_id, GLenum type)
 		return;
 	}
 
-	_textures.emplace_back(name, tex_id, type);
+	_textures.push_back({ name, tex_id, type });
+	_texture_locations_program = 0u;
 }
 
 void
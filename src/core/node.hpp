@@ -7,17 +7,25 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <functional>
 #include <string>
-#include <tuple>
+#include <utility>
 #include <vector>
 
+class GLStateTracker;
+class RenderQueue;
+
 //! \brief Represents a node of a scene graph
 class Node
 {
 public:
 	//! \brief Render this node.
 	//!
+	//! Nodes whose geometry has bounds, see `bonobo::computeMeshBounds()`,
+	//! are skipped when those lie outside the view frustum; this applies
+	//! to all overloads, and is accounted in `bonobo::culling::getStatistics()`.
+	//!
 	//! @param [in] view_projection Matrix transforming from world-space to clip-space
 	//! @param [in] parent_transform Matrix transforming from parent-space to
 	//!             world-space
@@ -36,15 +44,51 @@ public:
 	//! @param [in] program OpenGL shader program to use
 	//! @param [in] set_uniforms function that will take as argument an
 	//!             OpenGL shader program, and will setup that program's
-	//!             uniforms
+	//!             uniforms; it must not change any other state, such as
+	//!             the program in use or texture bindings, as those are
+	//!             tracked by `GLStateTracker`
 	void render(glm::mat4 const& view_projection, glm::mat4 const& world,
 	            GLuint program,
 	            std::function<void (GLuint)> const& set_uniforms = [](GLuint /*programID*/){}) const;
 
-	//! \brief Set the geometry of this node.
+	//! \brief Render this node with world and normal matrices computed
+	//!        beforehand, for example by `FlatSceneGraph`, using the
+	//!        program set via |set_program()|.
+	//!
+	//! As with the previous overload, the internal transform of this node
+	//! is **not** used.
+	//!
+	//! @param [in] view_projection Matrix transforming from world-space to clip-space
+	//! @param [in] world Matrix transforming from model-space to
+	//!             world-space
+	//! @param [in] normal_model_to_world Matrix transforming normals from
+	//!             model-space to world-space
+	void render(glm::mat4 const& view_projection, glm::mat4 const& world,
+	            glm::mat4 const& normal_model_to_world) const;
+
+	//! \brief Add a draw of this node to |queue|, using the program set
+	//!        via |set_program()|, rather than drawing it right away.
+	//!
+	//! The node is culled as by |render()|, and sorted by pass, then by
+	//! program, material and vertex array, and by depth last; see
+	//! `RenderQueue`. The node has to outlive the next flush of |queue|.
+	//!
+	//! @param [in] queue the queue to add the draw to
+	//! @param [in] view_projection Matrix transforming from world-space to clip-space
+	//! @param [in] world Matrix transforming from model-space to
+	//!             world-space
+	//! @param [in] normal_model_to_world Matrix transforming normals from
+	//!             model-space to world-space
+	//! @param [in] pass the pass the draw belongs to; lower passes are
+	//!             drawn first
+	void submit(RenderQueue& queue, glm::mat4 const& view_projection,
+	            glm::mat4 const& world, glm::mat4 const& normal_model_to_world,
+	            std::uint32_t pass = 0u) const;
+
+	//! \brief Set the geometry of this node, along with its material.
 	//!
-	//! It will overwrite any constants provided by an earlier call to
-	//! |set_material_constants()|.
+	//! It will overwrite any material set, or constants provided, by an
+	//! earlier call to |set_material()| or |set_material_constants()|.
 	//!
 	//! A node without any geometry will not render itself, but its
 	//! children will be rendered if they have any geometry.
@@ -52,9 +96,45 @@ public:
 	//! @param [in] shape OpenGL data to use as geometry
 	void set_geometry(bonobo::mesh_data const& shape);
 
+	//! \brief Enable or disable the frustum culling of this node, which is
+	//!        enabled by default.
+	//!
+	//! Culling tests the bounds of the geometry set via |set_geometry()|,
+	//! so a node whose vertex shader moves vertices outside of those, like
+	//! a water surface displaced by waves, can get culled while still in
+	//! view: either disable culling for it, or widen its bounds with
+	//! |set_bounds_margin()|.
+	//!
+	//! @param [in] enabled whether to skip the node when out of view
+	void set_culling_enabled(bool enabled);
+
+	//! \brief Widen the bounds tested by the frustum culling of this node.
+	//!
+	//! @param [in] margin how far, in model space, vertices may move
+	//!             outside of the bounds of the geometry along each axis,
+	//!             in both directions
+	void set_bounds_margin(glm::vec3 const& margin);
+
+	//! \brief Set the material of this node, from the material table.
+	//!
+	//! Its textures are bound to the samplers named after their slot, see
+	//! `bonobo::material_texture_names`, before any texture added via
+	//! |add_texture()|, and its constants are used unless overridden by
+	//! |set_material_constants()|. The node does not hold a reference on
+	//! the material.
+	//!
+	//! @param [in] material ID of the material, or
+	//!             `bonobo::invalid_material_id` for none
+	void set_material(bonobo::material_id material);
+
 	//! \brief Set the material constants of this node.
 	//!
-	//! It will overwrite any constants provided by the geometry.
+	//! It will overwrite any constants provided by the geometry or the
+	//! material.
+	//!
+	//! Programs declaring the `MaterialConstants` uniform block, see
+	//! `bonobo::material_constants_block`, receive the constants through
+	//! it; others through the individual `diffuse_colour`, etc. uniforms.
 	//!
 	//! A node without any geometry will not render itself, but its
 	//! children will be rendered if they have any geometry.
@@ -81,7 +161,9 @@ public:
 	//!             use; the pointer should not be null.
 	//! @param [in] set_uniforms function that will take as argument an
 	//!             OpenGL shader program, and will setup that program's
-	//!             uniforms
+	//!             uniforms; it must not change any other state, such as
+	//!             the program in use or texture bindings, as those are
+	//!             tracked by `GLStateTracker`
 	void set_program(GLuint const* const program,
 	                 std::function<void (GLuint)> const& set_uniforms = [](GLuint /*programID*/){});
 
@@ -131,20 +213,62 @@ public:
 	TRSTransformf& get_transform();
 
 private:
+	friend class RenderQueue;
+
+	void render(glm::mat4 const& view_projection, glm::mat4 const& world,
+	            glm::mat4 const& normal_model_to_world, GLuint program,
+	            std::function<void (GLuint)> const& set_uniforms) const;
+
+	//! \brief Return whether the bounds of this node are at least partly
+	//!        in view, updating the culling statistics.
+	bool is_visible(glm::mat4 const& view_projection, glm::mat4 const& world) const;
+
+	//! \brief Issue the draw, binding state through |state| and leaving it
+	//!        bound afterwards.
+	void draw(glm::mat4 const& view_projection, glm::mat4 const& world,
+	          glm::mat4 const& normal_model_to_world, GLStateTracker& state) const;
+	void draw(glm::mat4 const& view_projection, glm::mat4 const& world,
+	          glm::mat4 const& normal_model_to_world, GLuint program,
+	          std::function<void (GLuint)> const& set_uniforms,
+	          GLStateTracker& state) const;
+
 	// Geometry data
 	GLuint _vao{ 0u };
 	GLsizei _vertices_nb{ 0u };
 	GLsizei _indices_nb{ 0u };
+	GLint _base_vertex{ 0 };
+	GLsizei _first_index{ 0 };
+	GLenum _index_type{ GL_UNSIGNED_INT };
 	GLenum _drawing_mode{ GL_TRIANGLES };
 	bool _has_indices{ false };
+	bonobo::vertex_encoding _vertex_encoding;
+	glm::vec3 _bounds_min{ 0.0f };
+	glm::vec3 _bounds_max{ 0.0f };
+	glm::vec3 _bounds_margin{ 0.0f };
+	bool _has_bounds{ false };
+	bool _is_culling_enabled{ true };
 
 	// Program data
 	GLuint const* _program{ nullptr };
 	std::function<void (GLuint)> _set_uniforms;
 
 	// Material data
-	std::vector<std::tuple<std::string, GLuint, GLenum>> _textures;
+	struct texture_binding {
+		std::string name;
+		GLuint id;
+		GLenum type;
+	};
+	std::vector<texture_binding> _textures;
+
+	// Locations of the sampler and presence flag of each texture, for the
+	// program last rendered with, so that their names are only looked up
+	// again when the program changes or gets reloaded.
+	mutable std::vector<std::pair<GLint, GLint>> _texture_locations;
+	mutable GLuint _texture_locations_program{ 0u };
+	mutable std::uint32_t _texture_locations_generation{ 0u };
+	bonobo::material_id _material{ bonobo::invalid_material_id };
 	bonobo::material_data _constants;
+	bool _has_own_constants{ false };
 
 	// Transformation data
 	TRSTransformf _transform;
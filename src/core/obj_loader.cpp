@@ -0,0 +1,819 @@
+#include "obj_loader.hpp"
+
+#include "core/Log.h"
+#include "core/ThreadPool.hpp"
+#include "core/various.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// Chunks are made small enough for each thread to get several of them,
+	// as some parts of a file are denser in faces than others, but large
+	// enough for the per-chunk overhead to remain negligible.
+	constexpr std::size_t chunks_per_thread_nb = 4u;
+	constexpr std::size_t min_chunk_size = 256u * 1024u;
+
+	enum corner_flags : std::uint8_t {
+		corner_flag_has_texcoord    = 1u << 0,
+		corner_flag_has_normal      = 1u << 1,
+		corner_flag_local_position  = 1u << 2, //!< The index is relative to the start of the chunk.
+		corner_flag_local_texcoord  = 1u << 3,
+		corner_flag_local_normal    = 1u << 4
+	};
+
+	//! \brief One corner of a triangle, as indices into the positions,
+	//!        texture coordinates and normals of the file.
+	//!
+	//! While parsing, an index given relative to the current end of the
+	//! attribute list is stored relative to the start of the chunk instead,
+	//! as the number of attributes in previous chunks is not known yet. Once
+	//! resolved, all indices are absolute and absent ones are -1.
+	struct corner {
+		std::int32_t position{ -1 };
+		std::int32_t texcoord{ -1 };
+		std::int32_t normal{ -1 };
+		std::uint8_t flags{ 0u };
+	};
+
+	struct corner_hash {
+		std::size_t operator()(corner const& value) const noexcept
+		{
+			auto hash = static_cast<std::uint64_t>(static_cast<std::uint32_t>(value.position));
+			hash = hash * 0x9e3779b97f4a7c15u ^ static_cast<std::uint32_t>(value.texcoord);
+			hash = hash * 0x9e3779b97f4a7c15u ^ static_cast<std::uint32_t>(value.normal);
+			return static_cast<std::size_t>(hash ^ (hash >> 29));
+		}
+	};
+
+	struct corner_equal {
+		bool operator()(corner const& lhs, corner const& rhs) const noexcept
+		{
+			return lhs.position == rhs.position && lhs.texcoord == rhs.texcoord && lhs.normal == rhs.normal;
+		}
+	};
+
+	//! \brief A change of object, group or material, taking effect from
+	//!        the corner at |first_corner| in its chunk.
+	struct state_change {
+		std::uint32_t first_corner;
+		bool is_material;
+		std::string name;
+	};
+
+	//! \brief A range of whole lines of the file, and what was parsed from
+	//!        them.
+	struct chunk {
+		char const* begin{ nullptr };
+		char const* end{ nullptr };
+		std::vector<float> positions;      //!< 3 floats per position
+		std::vector<float> texcoords;      //!< 3 floats per texture coordinate
+		std::vector<float> normals;        //!< 3 floats per normal
+		std::vector<corner> corners;       //!< 3 corners per triangle
+		std::vector<state_change> changes;
+		std::vector<std::string> material_libraries;
+		std::size_t skipped_primitives_nb{ 0u };
+		std::string error;                 //!< Why parsing failed, empty on success
+		std::size_t positions_offset{ 0u };
+		std::size_t texcoords_offset{ 0u };
+		std::size_t normals_offset{ 0u };
+	};
+
+	//! \brief Range of corners of a chunk.
+	struct segment {
+		std::size_t chunk_index;
+		std::uint32_t begin;
+		std::uint32_t end;
+	};
+
+	//! \brief Consecutive faces sharing the same object or group name and
+	//!        material, which become one mesh.
+	struct face_run {
+		std::string name;
+		std::string material;
+		std::vector<segment> segments;
+	};
+
+	//! \brief Streams of a mesh, before they are handed over to the
+	//!        scene description.
+	struct assembled_mesh {
+		std::uint32_t vertices_nb{ 0u };
+		std::uint32_t indices_nb{ 0u };
+		std::vector<std::uint8_t> vertices;
+		std::vector<std::uint8_t> normals;
+		std::vector<std::uint8_t> texcoords;
+		std::vector<std::uint8_t> tangents;
+		std::vector<std::uint8_t> binormals;
+		std::vector<std::uint8_t> indices;
+	};
+
+	// Powers of ten which are exactly representable as doubles.
+	constexpr std::array<double, 23> exact_powers_of_ten{ {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	} };
+
+	bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	bool isDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	void skipBlanks(char const*& current, char const* end)
+	{
+		while (current != end && isBlank(*current))
+			++current;
+	}
+
+	char const* findTokenEnd(char const* current, char const* end)
+	{
+		while (current != end && !isBlank(*current))
+			++current;
+		return current;
+	}
+
+	bool isKeyword(char const* begin, char const* end, char const* keyword)
+	{
+		auto const length = std::strlen(keyword);
+		return static_cast<std::size_t>(end - begin) == length && std::memcmp(begin, keyword, length) == 0;
+	}
+
+	// Return the rest of the line, without surrounding blanks.
+	std::string readRestOfLine(char const* current, char const* end)
+	{
+		skipBlanks(current, end);
+		while (end != current && isBlank(*(end - 1)))
+			--end;
+		return std::string(current, end);
+	}
+
+	// Parse a decimal number, with an optional sign, fractional part and
+	// exponent. Up to 19 significant digits are kept, which is more than a
+	// float can represent.
+	bool parseFloat(char const*& current, char const* end, float& value)
+	{
+		auto position = current;
+		bool is_negative = false;
+		if (position != end && (*position == '-' || *position == '+')) {
+			is_negative = *position == '-';
+			++position;
+		}
+
+		std::uint64_t mantissa = 0u;
+		int significant_digits_nb = 0;
+		int exponent = 0;
+		bool has_digits = false;
+		for (; position != end && isDigit(*position); ++position) {
+			has_digits = true;
+			if (significant_digits_nb < 19) {
+				mantissa = mantissa * 10u + static_cast<std::uint64_t>(*position - '0');
+				significant_digits_nb += mantissa != 0u ? 1 : 0;
+			} else {
+				++exponent;
+			}
+		}
+		if (position != end && *position == '.') {
+			for (++position; position != end && isDigit(*position); ++position) {
+				has_digits = true;
+				if (significant_digits_nb < 19) {
+					mantissa = mantissa * 10u + static_cast<std::uint64_t>(*position - '0');
+					significant_digits_nb += mantissa != 0u ? 1 : 0;
+					--exponent;
+				}
+			}
+		}
+		if (!has_digits)
+			return false;
+
+		if (position != end && (*position == 'e' || *position == 'E')) {
+			auto exponent_position = position + 1;
+			bool is_exponent_negative = false;
+			if (exponent_position != end && (*exponent_position == '-' || *exponent_position == '+')) {
+				is_exponent_negative = *exponent_position == '-';
+				++exponent_position;
+			}
+			if (exponent_position != end && isDigit(*exponent_position)) {
+				int explicit_exponent = 0;
+				for (; exponent_position != end && isDigit(*exponent_position); ++exponent_position)
+					explicit_exponent = std::min(explicit_exponent * 10 + (*exponent_position - '0'), 10000);
+				exponent += is_exponent_negative ? -explicit_exponent : explicit_exponent;
+				position = exponent_position;
+			}
+		}
+
+		auto result = static_cast<double>(mantissa);
+		if (mantissa != 0u && exponent != 0) {
+			auto const exponent_magnitude = static_cast<std::size_t>(std::abs(exponent));
+			if (exponent_magnitude < exact_powers_of_ten.size())
+				result = exponent < 0 ? result / exact_powers_of_ten[exponent_magnitude]
+				                      : result * exact_powers_of_ten[exponent_magnitude];
+			else
+				result *= std::pow(10.0, static_cast<double>(exponent));
+		}
+
+		value = static_cast<float>(is_negative ? -result : result);
+		current = position;
+		return true;
+	}
+
+	bool parseInteger(char const*& current, char const* end, std::int64_t& value)
+	{
+		auto position = current;
+		bool is_negative = false;
+		if (position != end && (*position == '-' || *position == '+')) {
+			is_negative = *position == '-';
+			++position;
+		}
+		if (position == end || !isDigit(*position))
+			return false;
+
+		std::int64_t result = 0;
+		for (; position != end && isDigit(*position); ++position)
+			result = std::min<std::int64_t>(result * 10 + (*position - '0'), std::numeric_limits<std::int32_t>::max());
+
+		value = is_negative ? -result : result;
+		current = position;
+		return true;
+	}
+
+	// Parse up to |max_count| floats, stopping at the first token which is
+	// not a number; return how many were parsed.
+	std::size_t parseFloats(char const*& current, char const* end, float* values, std::size_t max_count)
+	{
+		std::size_t count = 0u;
+		for (; count < max_count; ++count) {
+			skipBlanks(current, end);
+			auto position = current;
+			if (!parseFloat(position, end, values[count]) || (position != end && !isBlank(*position)))
+				break;
+			current = position;
+		}
+		return count;
+	}
+
+	// Convert a 1-based OBJ index, or a negative one relative to the end of
+	// the attributes parsed so far, to the representation of `corner`.
+	bool storeIndex(std::int64_t index, std::size_t local_count, std::int32_t& stored, std::uint8_t& flags, std::uint8_t local_flag)
+	{
+		if (index > 0) {
+			stored = static_cast<std::int32_t>(index - 1);
+			return true;
+		}
+		if (index < 0) {
+			stored = static_cast<std::int32_t>(static_cast<std::int64_t>(local_count) + index);
+			flags |= local_flag;
+			return true;
+		}
+		return false;
+	}
+
+	bool parseCorner(char const*& current, char const* end, chunk& destination, corner& result)
+	{
+		std::int64_t index = 0;
+		if (!parseInteger(current, end, index)
+		    || !storeIndex(index, destination.positions.size() / 3u, result.position, result.flags, corner_flag_local_position))
+			return false;
+		if (current == end || *current != '/')
+			return true;
+
+		++current;
+		if (current != end && *current != '/' && !isBlank(*current)) {
+			if (!parseInteger(current, end, index)
+			    || !storeIndex(index, destination.texcoords.size() / 3u, result.texcoord, result.flags, corner_flag_local_texcoord))
+				return false;
+			result.flags |= corner_flag_has_texcoord;
+		}
+		if (current == end || *current != '/')
+			return true;
+
+		++current;
+		if (!parseInteger(current, end, index)
+		    || !storeIndex(index, destination.normals.size() / 3u, result.normal, result.flags, corner_flag_local_normal))
+			return false;
+		result.flags |= corner_flag_has_normal;
+		return true;
+	}
+
+	void parseChunk(chunk& destination)
+	{
+		std::vector<corner> polygon;
+		auto current = destination.begin;
+		while (current != destination.end) {
+			auto line_end = static_cast<char const*>(std::memchr(current, '\n', static_cast<std::size_t>(destination.end - current)));
+			if (line_end == nullptr)
+				line_end = destination.end;
+			auto const next_line = line_end != destination.end ? line_end + 1 : line_end;
+			auto const line_begin = current;
+
+			skipBlanks(current, line_end);
+			auto const keyword_end = findTokenEnd(current, line_end);
+			auto const keyword = current;
+			current = keyword_end;
+
+			bool is_valid = true;
+			if (isKeyword(keyword, keyword_end, "v")) {
+				float values[3] = { 0.0f, 0.0f, 0.0f };
+				is_valid = parseFloats(current, line_end, values, 3u) == 3u;
+				destination.positions.insert(destination.positions.end(), values, values + 3);
+			} else if (isKeyword(keyword, keyword_end, "vt")) {
+				float values[3] = { 0.0f, 0.0f, 0.0f };
+				is_valid = parseFloats(current, line_end, values, 3u) >= 1u;
+				destination.texcoords.insert(destination.texcoords.end(), values, values + 3);
+			} else if (isKeyword(keyword, keyword_end, "vn")) {
+				float values[3] = { 0.0f, 0.0f, 0.0f };
+				is_valid = parseFloats(current, line_end, values, 3u) == 3u;
+				destination.normals.insert(destination.normals.end(), values, values + 3);
+			} else if (isKeyword(keyword, keyword_end, "f")) {
+				polygon.clear();
+				for (skipBlanks(current, line_end); current != line_end && is_valid; skipBlanks(current, line_end)) {
+					corner value;
+					is_valid = parseCorner(current, line_end, destination, value)
+					        && (current == line_end || isBlank(*current));
+					polygon.push_back(value);
+				}
+				if (is_valid && polygon.size() < 3u) {
+					++destination.skipped_primitives_nb;
+				} else if (is_valid) {
+					// Triangulate as a fan, which is exact for the convex
+					// polygons found in practice.
+					for (std::size_t i = 1u; i + 1u < polygon.size(); ++i) {
+						destination.corners.push_back(polygon[0]);
+						destination.corners.push_back(polygon[i]);
+						destination.corners.push_back(polygon[i + 1u]);
+					}
+				}
+			} else if (isKeyword(keyword, keyword_end, "o") || isKeyword(keyword, keyword_end, "g")) {
+				destination.changes.push_back({ static_cast<std::uint32_t>(destination.corners.size()), false, readRestOfLine(current, line_end) });
+			} else if (isKeyword(keyword, keyword_end, "usemtl")) {
+				destination.changes.push_back({ static_cast<std::uint32_t>(destination.corners.size()), true, readRestOfLine(current, line_end) });
+			} else if (isKeyword(keyword, keyword_end, "mtllib")) {
+				destination.material_libraries.push_back(readRestOfLine(current, line_end));
+			} else if (isKeyword(keyword, keyword_end, "l") || isKeyword(keyword, keyword_end, "p")) {
+				++destination.skipped_primitives_nb;
+			}
+
+			if (!is_valid) {
+				destination.error = "invalid line \"" + readRestOfLine(line_begin, std::min(line_end, line_begin + 80)) + "\"";
+				return;
+			}
+			current = next_line;
+		}
+	}
+
+	// Turn the indices of |source| into absolute ones, and copy its
+	// attributes to their final location.
+	void resolveChunk(chunk& source, std::size_t positions_nb, std::size_t texcoords_nb, std::size_t normals_nb,
+	                  std::vector<float>& positions, std::vector<float>& texcoords, std::vector<float>& normals)
+	{
+		std::copy(source.positions.begin(), source.positions.end(), positions.begin() + static_cast<std::ptrdiff_t>(source.positions_offset * 3u));
+		std::copy(source.texcoords.begin(), source.texcoords.end(), texcoords.begin() + static_cast<std::ptrdiff_t>(source.texcoords_offset * 3u));
+		std::copy(source.normals.begin(), source.normals.end(), normals.begin() + static_cast<std::ptrdiff_t>(source.normals_offset * 3u));
+
+		auto const resolve = [](std::int32_t& index, bool is_local, std::size_t offset, std::size_t count){
+			auto const absolute = static_cast<std::int64_t>(index) + (is_local ? static_cast<std::int64_t>(offset) : 0);
+			index = static_cast<std::int32_t>(absolute);
+			return absolute >= 0 && absolute < static_cast<std::int64_t>(count);
+		};
+		for (auto& value : source.corners) {
+			bool is_valid = resolve(value.position, (value.flags & corner_flag_local_position) != 0u, source.positions_offset, positions_nb);
+			if ((value.flags & corner_flag_has_texcoord) != 0u)
+				is_valid &= resolve(value.texcoord, (value.flags & corner_flag_local_texcoord) != 0u, source.texcoords_offset, texcoords_nb);
+			else
+				value.texcoord = -1;
+			if ((value.flags & corner_flag_has_normal) != 0u)
+				is_valid &= resolve(value.normal, (value.flags & corner_flag_local_normal) != 0u, source.normals_offset, normals_nb);
+			else
+				value.normal = -1;
+
+			if (!is_valid) {
+				source.error = "face referencing a missing vertex attribute";
+				return;
+			}
+		}
+	}
+
+	// Compute per-vertex tangents and binormals by accumulating those of the
+	// faces around each vertex, then making them orthogonal to its normal,
+	// like assimp's aiProcess_CalcTangentSpace.
+	void computeTangents(assembled_mesh& mesh)
+	{
+		auto const positions = reinterpret_cast<glm::vec3 const*>(mesh.vertices.data());
+		auto const normals = reinterpret_cast<glm::vec3 const*>(mesh.normals.data());
+		auto const texcoords = reinterpret_cast<glm::vec3 const*>(mesh.texcoords.data());
+		auto const indices = reinterpret_cast<std::uint32_t const*>(mesh.indices.data());
+
+		std::vector<glm::vec3> face_tangents(mesh.vertices_nb, glm::vec3(0.0f));
+		std::vector<glm::vec3> face_binormals(mesh.vertices_nb, glm::vec3(0.0f));
+		for (std::uint32_t i = 0u; i + 2u < mesh.indices_nb; i += 3u) {
+			auto const i0 = indices[i], i1 = indices[i + 1u], i2 = indices[i + 2u];
+			auto const edge1 = positions[i1] - positions[i0];
+			auto const edge2 = positions[i2] - positions[i0];
+			auto const delta_uv1 = texcoords[i1] - texcoords[i0];
+			auto const delta_uv2 = texcoords[i2] - texcoords[i0];
+			auto const determinant = delta_uv1.x * delta_uv2.y - delta_uv2.x * delta_uv1.y;
+			if (std::abs(determinant) < 1e-12f)
+				continue;
+
+			// Each face contributes a unit vector, so that faces with tiny
+			// texture-coordinate areas do not dominate.
+			auto const tangent = (edge1 * delta_uv2.y - edge2 * delta_uv1.y) / determinant;
+			auto const binormal = (edge2 * delta_uv1.x - edge1 * delta_uv2.x) / determinant;
+			auto const tangent_length = glm::length(tangent);
+			auto const binormal_length = glm::length(binormal);
+			if (!(tangent_length > 0.0f) || !(binormal_length > 0.0f) || !std::isfinite(tangent_length) || !std::isfinite(binormal_length))
+				continue;
+			for (auto const index : { i0, i1, i2 }) {
+				face_tangents[index] += tangent / tangent_length;
+				face_binormals[index] += binormal / binormal_length;
+			}
+		}
+
+		mesh.tangents.resize(mesh.vertices.size());
+		mesh.binormals.resize(mesh.vertices.size());
+		auto const tangents = reinterpret_cast<glm::vec3*>(mesh.tangents.data());
+		auto const binormals = reinterpret_cast<glm::vec3*>(mesh.binormals.data());
+		for (std::uint32_t i = 0u; i < mesh.vertices_nb; ++i) {
+			auto const normal = normals[i];
+			auto tangent = face_tangents[i] - normal * glm::dot(normal, face_tangents[i]);
+			if (glm::dot(tangent, tangent) < 1e-12f) {
+				auto const axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+				tangent = glm::cross(normal, axis);
+			}
+			tangent = glm::normalize(tangent);
+
+			auto binormal = face_binormals[i] - normal * glm::dot(normal, face_binormals[i]);
+			if (glm::dot(binormal, binormal) < 1e-12f)
+				binormal = glm::cross(normal, tangent);
+			binormal = glm::normalize(binormal);
+
+			tangents[i] = tangent;
+			binormals[i] = binormal;
+		}
+	}
+
+	// Merge the corners of |run| sharing the same attribute indices into
+	// vertices, and gather their attributes.
+	void assembleMesh(face_run const& run, std::vector<chunk> const& chunks, std::vector<float> const& positions,
+	                  std::vector<float> const& texcoords, std::vector<float> const& normals, assembled_mesh& mesh)
+	{
+		std::size_t corners_nb = 0u;
+		for (auto const& range : run.segments)
+			corners_nb += range.end - range.begin;
+
+		std::unordered_map<corner, std::uint32_t, corner_hash, corner_equal> vertex_indices;
+		vertex_indices.reserve(corners_nb);
+		std::vector<corner> vertices;
+		mesh.indices.resize(corners_nb * sizeof(std::uint32_t));
+		auto const indices = reinterpret_cast<std::uint32_t*>(mesh.indices.data());
+		bool has_texcoords = false;
+		bool has_normals = false;
+		std::size_t index = 0u;
+		for (auto const& range : run.segments) {
+			auto const& corners = chunks[range.chunk_index].corners;
+			for (auto i = range.begin; i < range.end; ++i) {
+				auto const& value = corners[i];
+				auto const insertion = vertex_indices.emplace(value, static_cast<std::uint32_t>(vertices.size()));
+				if (insertion.second) {
+					vertices.push_back(value);
+					has_texcoords |= value.texcoord >= 0;
+					has_normals |= value.normal >= 0;
+				}
+				indices[index++] = insertion.first->second;
+			}
+		}
+		mesh.vertices_nb = static_cast<std::uint32_t>(vertices.size());
+		mesh.indices_nb = static_cast<std::uint32_t>(corners_nb);
+
+		// Like assimp, corners lacking an attribute other corners of the
+		// mesh have get zeros.
+		auto const gather = [&vertices](std::vector<float> const& source, std::int32_t corner::* member, std::vector<std::uint8_t>& destination){
+			destination.resize(vertices.size() * 3u * sizeof(float));
+			auto const values = reinterpret_cast<float*>(destination.data());
+			for (std::size_t i = 0u; i < vertices.size(); ++i) {
+				auto const source_index = vertices[i].*member;
+				for (std::size_t j = 0u; j < 3u; ++j)
+					values[3u * i + j] = source_index >= 0 ? source[3u * static_cast<std::size_t>(source_index) + j] : 0.0f;
+			}
+		};
+		gather(positions, &corner::position, mesh.vertices);
+		if (has_texcoords)
+			gather(texcoords, &corner::texcoord, mesh.texcoords);
+		if (has_normals)
+			gather(normals, &corner::normal, mesh.normals);
+		if (has_texcoords && has_normals)
+			computeTangents(mesh);
+	}
+
+	// Skip the options preceding the path of a texture map, and return that
+	// path.
+	std::string parseTexturePath(char const* current, char const* end)
+	{
+		static std::array<std::pair<char const*, std::size_t>, 10> const options_arguments_nb{ {
+			{ "-blendu", 1u }, { "-blendv", 1u }, { "-boost", 1u }, { "-bm", 1u }, { "-cc", 1u },
+			{ "-clamp", 1u }, { "-imfchan", 1u }, { "-mm", 2u }, { "-texres", 1u }, { "-type", 1u }
+		} };
+
+		for (skipBlanks(current, end); current != end && *current == '-'; skipBlanks(current, end)) {
+			auto const option_end = findTokenEnd(current, end);
+			auto const option = current;
+			current = option_end;
+
+			// -o, -s and -t take one to three numbers.
+			if (isKeyword(option, option_end, "-o") || isKeyword(option, option_end, "-s") || isKeyword(option, option_end, "-t")) {
+				float values[3];
+				parseFloats(current, end, values, 3u);
+				continue;
+			}
+			for (auto const& option_arguments_nb : options_arguments_nb) {
+				if (!isKeyword(option, option_end, option_arguments_nb.first))
+					continue;
+				for (std::size_t i = 0u; i < option_arguments_nb.second; ++i) {
+					skipBlanks(current, end);
+					current = findTokenEnd(current, end);
+				}
+				break;
+			}
+		}
+
+		return readRestOfLine(current, end);
+	}
+
+	bonobo::material_description makeMaterial(std::string const& name)
+	{
+		// Same defaults as assimp's OBJ importer.
+		bonobo::material_description material;
+		material.name = name;
+		material.constants.diffuse = glm::vec3(0.6f);
+		return material;
+	}
+
+	void parseMaterialLibrary(std::string const& path, std::vector<bonobo::material_description>& materials)
+	{
+		utils::file_view file(path);
+		if (!file.is_open()) {
+			LogWarning("Failed to open material library \"%s\"", path.c_str());
+			return;
+		}
+
+		auto const read_colour = [](char const* current, char const* end, glm::vec3& colour){
+			float values[3];
+			auto const count = parseFloats(current, end, values, 3u);
+			if (count == 0u)
+				return;
+			colour = count == 3u ? glm::vec3(values[0], values[1], values[2]) : glm::vec3(values[0]);
+		};
+		auto const read_float = [](char const* current, char const* end, float& value){
+			parseFloats(current, end, &value, 1u);
+		};
+
+		bonobo::material_description* material = nullptr;
+		auto current = reinterpret_cast<char const*>(file.data());
+		auto const end = current + file.size();
+		while (current != end) {
+			auto line_end = static_cast<char const*>(std::memchr(current, '\n', static_cast<std::size_t>(end - current)));
+			if (line_end == nullptr)
+				line_end = end;
+			auto const next_line = line_end != end ? line_end + 1 : line_end;
+
+			skipBlanks(current, line_end);
+			auto const keyword_end = findTokenEnd(current, line_end);
+			auto const keyword = current;
+			current = keyword_end;
+
+			if (isKeyword(keyword, keyword_end, "newmtl")) {
+				materials.push_back(makeMaterial(readRestOfLine(current, line_end)));
+				material = &materials.back();
+			} else if (material == nullptr) {
+				// Nothing applies before the first material.
+			} else if (isKeyword(keyword, keyword_end, "Kd")) {
+				read_colour(current, line_end, material->constants.diffuse);
+			} else if (isKeyword(keyword, keyword_end, "Ks")) {
+				read_colour(current, line_end, material->constants.specular);
+			} else if (isKeyword(keyword, keyword_end, "Ka")) {
+				read_colour(current, line_end, material->constants.ambient);
+			} else if (isKeyword(keyword, keyword_end, "Ke")) {
+				read_colour(current, line_end, material->constants.emissive);
+			} else if (isKeyword(keyword, keyword_end, "Ns")) {
+				read_float(current, line_end, material->constants.shininess);
+			} else if (isKeyword(keyword, keyword_end, "Ni")) {
+				read_float(current, line_end, material->constants.indexOfRefraction);
+			} else if (isKeyword(keyword, keyword_end, "d")) {
+				read_float(current, line_end, material->constants.opacity);
+			} else if (isKeyword(keyword, keyword_end, "Tr")) {
+				float transparency = 1.0f - material->constants.opacity;
+				read_float(current, line_end, transparency);
+				material->constants.opacity = 1.0f - transparency;
+			} else if (isKeyword(keyword, keyword_end, "map_Kd")) {
+				material->texture_paths[0] = parseTexturePath(current, line_end);
+			} else if (isKeyword(keyword, keyword_end, "map_Ks")) {
+				material->texture_paths[1] = parseTexturePath(current, line_end);
+			} else if (isKeyword(keyword, keyword_end, "norm") || isKeyword(keyword, keyword_end, "map_Kn")) {
+				// Like assimp, "bump" and "map_bump" are height maps rather
+				// than normal maps, and are not used.
+				material->texture_paths[2] = parseTexturePath(current, line_end);
+			} else if (isKeyword(keyword, keyword_end, "map_d")) {
+				material->texture_paths[3] = parseTexturePath(current, line_end);
+			}
+
+			current = next_line;
+		}
+	}
+
+	// Run |function| on each index in [0, |count|), on the threads of
+	// |pool| if there is one, and wait for all of them to complete.
+	template<typename Function>
+	void forEachIndex(ThreadPool* pool, std::size_t count, Function const& function)
+	{
+		if (pool == nullptr) {
+			for (std::size_t i = 0u; i < count; ++i)
+				function(i);
+			return;
+		}
+
+		std::vector<std::future<void>> futures;
+		futures.reserve(count);
+		for (std::size_t i = 0u; i < count; ++i)
+			futures.push_back(pool->Enqueue([&function, i](){ function(i); }));
+		for (auto& future : futures)
+			future.get();
+	}
+}
+
+bool
+bonobo::obj_loader::isSupported(std::string const& filename)
+{
+	if (filename.size() < 4u)
+		return false;
+
+	auto extension = filename.substr(filename.size() - 4u);
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+	               [](char c){ return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+	return extension == ".obj";
+}
+
+bool
+bonobo::obj_loader::load(std::string const& filename, scene_description& scene, ThreadPool* pool)
+{
+	utils::file_view file(filename);
+	if (!file.is_open()) {
+		LogError("Failed to open \"%s\"", filename.c_str());
+		return false;
+	}
+
+	// Split the file into chunks ending on line boundaries.
+	std::vector<chunk> chunks;
+	auto const file_begin = reinterpret_cast<char const*>(file.data());
+	auto const file_end = file_begin + file.size();
+	auto const target_chunks_nb = pool != nullptr ? pool->GetThreadsNb() * chunks_per_thread_nb : 1u;
+	auto const chunk_size = std::max(file.size() / target_chunks_nb, min_chunk_size);
+	for (auto begin = file_begin; begin != file_end;) {
+		auto end = begin + std::min(chunk_size, static_cast<std::size_t>(file_end - begin));
+		if (end != file_end) {
+			auto const line_end = static_cast<char const*>(std::memchr(end, '\n', static_cast<std::size_t>(file_end - end)));
+			end = line_end != nullptr ? line_end + 1 : file_end;
+		}
+		chunks.emplace_back();
+		chunks.back().begin = begin;
+		chunks.back().end = end;
+		begin = end;
+	}
+
+	forEachIndex(pool, chunks.size(), [&chunks](std::size_t i){ parseChunk(chunks[i]); });
+
+	// Place the attributes of each chunk after those of the previous ones.
+	std::size_t positions_nb = 0u, texcoords_nb = 0u, normals_nb = 0u, skipped_primitives_nb = 0u;
+	for (auto& current : chunks) {
+		if (!current.error.empty()) {
+			LogError("Failed to parse \"%s\": %s", filename.c_str(), current.error.c_str());
+			return false;
+		}
+		current.positions_offset = positions_nb;
+		current.texcoords_offset = texcoords_nb;
+		current.normals_offset = normals_nb;
+		positions_nb += current.positions.size() / 3u;
+		texcoords_nb += current.texcoords.size() / 3u;
+		normals_nb += current.normals.size() / 3u;
+		skipped_primitives_nb += current.skipped_primitives_nb;
+	}
+	if (positions_nb > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max())) {
+		LogError("Failed to parse \"%s\": too many vertices", filename.c_str());
+		return false;
+	}
+	if (skipped_primitives_nb != 0u)
+		LogWarning("Skipped %zu points and lines in \"%s\", which are not supported.", skipped_primitives_nb, filename.c_str());
+
+	std::vector<float> positions(positions_nb * 3u), texcoords(texcoords_nb * 3u), normals(normals_nb * 3u);
+	forEachIndex(pool, chunks.size(), [&](std::size_t i){
+		resolveChunk(chunks[i], positions_nb, texcoords_nb, normals_nb, positions, texcoords, normals);
+	});
+	for (auto const& current : chunks) {
+		if (!current.error.empty()) {
+			LogError("Failed to parse \"%s\": %s", filename.c_str(), current.error.c_str());
+			return false;
+		}
+	}
+
+	// Follow the object, group and material changes across chunks, to
+	// group faces into meshes.
+	std::vector<face_run> runs;
+	std::string name, material;
+	auto const add_segment = [&runs, &name, &material](std::size_t chunk_index, std::uint32_t begin, std::uint32_t end){
+		if (begin == end)
+			return;
+		if (runs.empty() || runs.back().name != name || runs.back().material != material)
+			runs.push_back({ name, material, {} });
+		runs.back().segments.push_back({ chunk_index, begin, end });
+	};
+	for (std::size_t i = 0u; i < chunks.size(); ++i) {
+		std::uint32_t begin = 0u;
+		for (auto const& change : chunks[i].changes) {
+			add_segment(i, begin, change.first_corner);
+			begin = change.first_corner;
+			(change.is_material ? material : name) = change.name;
+		}
+		add_segment(i, begin, static_cast<std::uint32_t>(chunks[i].corners.size()));
+	}
+
+	auto const end_of_basedir = filename.rfind('/');
+	auto const parent_folder = (end_of_basedir != std::string::npos ? filename.substr(0, end_of_basedir) : ".") + "/";
+	std::unordered_set<std::string> parsed_libraries;
+	for (auto const& current : chunks)
+		for (auto const& library : current.material_libraries)
+			if (parsed_libraries.insert(library).second)
+				parseMaterialLibrary(parent_folder + library, scene.materials);
+
+	std::unordered_map<std::string, std::uint32_t> material_indices;
+	for (std::size_t i = 0u; i < scene.materials.size(); ++i)
+		material_indices.emplace(scene.materials[i].name, static_cast<std::uint32_t>(i));
+
+	std::vector<assembled_mesh> meshes(runs.size());
+	forEachIndex(pool, runs.size(), [&](std::size_t i){
+		assembleMesh(runs[i], chunks, positions, texcoords, normals, meshes[i]);
+	});
+
+	auto default_material_index = std::numeric_limits<std::uint32_t>::max();
+	std::unordered_set<std::string> unknown_materials;
+	scene.meshes.reserve(runs.size());
+	for (std::size_t i = 0u; i < runs.size(); ++i) {
+		auto& assembled = meshes[i];
+		bonobo::mesh_streams mesh;
+		if (!runs[i].name.empty())
+			mesh.name = runs[i].name;
+
+		auto const material_index = material_indices.find(runs[i].material);
+		if (material_index != material_indices.end()) {
+			mesh.material_index = material_index->second;
+		} else {
+			if (!runs[i].material.empty() && unknown_materials.insert(runs[i].material).second)
+				LogWarning("Unknown material \"%s\" used by mesh \"%s\": using a default one instead.", runs[i].material.c_str(), mesh.name.c_str());
+			if (default_material_index == std::numeric_limits<std::uint32_t>::max()) {
+				default_material_index = static_cast<std::uint32_t>(scene.materials.size());
+				scene.materials.push_back(makeMaterial("DefaultMaterial"));
+			}
+			mesh.material_index = default_material_index;
+		}
+
+		auto const take = [&scene](std::vector<std::uint8_t>& stream) -> float const* {
+			if (stream.empty())
+				return nullptr;
+			scene.owned_data.push_back(std::move(stream));
+			return reinterpret_cast<float const*>(scene.owned_data.back().data());
+		};
+		mesh.vertices_nb = assembled.vertices_nb;
+		mesh.vertices = take(assembled.vertices);
+		mesh.normals = take(assembled.normals);
+		mesh.texcoords = take(assembled.texcoords);
+		mesh.tangents = take(assembled.tangents);
+		mesh.binormals = take(assembled.binormals);
+		mesh.indices_nb = assembled.indices_nb;
+		scene.owned_data.push_back(std::move(assembled.indices));
+		mesh.indices = reinterpret_cast<std::uint32_t const*>(scene.owned_data.back().data());
+
+		scene.meshes.push_back(mesh);
+	}
+
+	if (scene.meshes.empty()) {
+		LogError("No mesh available; loading \"%s\" must have had issues", filename.c_str());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <string>
+
+class ThreadPool;
+
+//! \brief Native loader for Wavefront OBJ files and their MTL material
+//!        libraries, used by `bonobo::loadObjects()` instead of assimp for
+//!        files with an ".obj" extension.
+//!
+//! The file is read through a `utils::file_view` and split into chunks of
+//! whole lines, which are parsed concurrently: each chunk gathers its own
+//! positions, texture coordinates, normals and triangulated faces, with
+//! relative (negative) indices kept relative to the chunk. Once all chunks
+//! are parsed, their attributes are concatenated and their indices resolved
+//! in parallel, and each mesh is then assembled on its own thread.
+//!
+//! The output matches what assimp produces with the flags used by
+//! `loadObjects()`: one mesh per run of faces sharing an object or group
+//! name and a material, triangulated, with tangents and binormals computed
+//! when normals and texture coordinates are present, and materials mapped
+//! onto the same texture slots. Unlike assimp, vertices sharing the same
+//! position, texture coordinates and normal indices are merged, so meshes
+//! come out indexed.
+//!
+//! Numbers are parsed by hand rather than via `std::strtod()`, which is
+//! slower and depends on the current locale for the decimal separator.
+//! Lines and points are skipped, and free-form geometry is not supported.
+namespace bonobo
+{
+namespace obj_loader
+{
+	//! \brief Return whether |filename| has an ".obj" extension, in any
+	//!        case.
+	bool isSupported(std::string const& filename);
+
+	//! \brief Parse an OBJ file and the material libraries it references.
+	//!
+	//! @param [in] filename of the OBJ file
+	//! @param [out] scene receives the meshes and materials; all streams are
+	//!              stored in `scene_description::owned_data`
+	//! @param [in] pool if not null, chunks and meshes are processed on its
+	//!             threads rather than on the calling one, which must then
+	//!             not be one of them
+	//! @return whether the file could be read and all its indices are valid
+	bool load(std::string const& filename, scene_description& scene, ThreadPool* pool = nullptr);
+}
+}
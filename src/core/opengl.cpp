@@ -7,6 +7,7 @@
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <string>
 
 
 namespace utils
@@ -164,6 +165,79 @@ opengl_error_callback( GLenum source, GLenum type, GLuint id, GLenum severity
 namespace shader
 {
 
+// Included files can include others, but not indefinitely.
+static std::size_t const max_include_depth = 16u;
+
+static bool
+expand_includes(std::string const& path, std::size_t depth, std::string& expanded)
+{
+	auto const source = utils::slurp_file(path);
+	if (source.empty())
+		return false;
+
+	auto const directory_end = path.find_last_of("/\\");
+	auto const directory = directory_end != std::string::npos ? path.substr(0u, directory_end + 1u) : std::string();
+
+	std::size_t line_start = 0u;
+	std::size_t line_number = 1u;
+	while (line_start < source.size()) {
+		auto line_end = source.find('\n', line_start);
+		line_end = line_end != std::string::npos ? line_end + 1u : source.size();
+
+		auto const directive_start = source.find_first_not_of(" \t", line_start);
+		auto const is_include = directive_start < line_end
+		                     && source.compare(directive_start, 8u, "#include") == 0;
+		if (!is_include) {
+			expanded.append(source, line_start, line_end - line_start);
+			if (line_end == source.size() && source.back() != '\n')
+				expanded += '\n';
+		} else {
+			auto const name_start = source.find('"', directive_start);
+			auto const name_end = name_start < line_end ? source.find('"', name_start + 1u) : std::string::npos;
+			if (name_end >= line_end) {
+				LogError("Malformed #include on line %zu of \"%s\".", line_number, path.c_str());
+				return false;
+			}
+			if (depth == max_include_depth) {
+				LogError("Too many nested #include on line %zu of \"%s\".", line_number, path.c_str());
+				return false;
+			}
+
+			// Resolve leading "../" here, as files packed into archives
+			// are looked up by their exact path.
+			auto included_directory = directory;
+			auto included_name = source.substr(name_start + 1u, name_end - name_start - 1u);
+			while (included_name.compare(0u, 3u, "../") == 0 && included_directory.size() > 1u) {
+				auto const parent_end = included_directory.find_last_of("/\\", included_directory.size() - 2u);
+				included_directory = parent_end != std::string::npos ? included_directory.substr(0u, parent_end + 1u) : std::string();
+				included_name = included_name.substr(3u);
+			}
+			auto const included_path = included_directory + included_name;
+			expanded += "#line 1\n";
+			if (!expand_includes(included_path, depth + 1u, expanded)) {
+				LogError("Failed to include \"%s\" on line %zu of \"%s\".", included_path.c_str(), line_number, path.c_str());
+				return false;
+			}
+			expanded += "#line " + std::to_string(line_number + 1u) + "\n";
+		}
+
+		line_start = line_end;
+		++line_number;
+	}
+
+	return true;
+}
+
+std::string
+read_source(std::string const& path)
+{
+	std::string source;
+	if (!expand_includes(path, 0u, source))
+		return std::string("");
+
+	return source;
+}
+
 bool
 source_and_build_shader(GLuint id, std::string const& source)
 {
@@ -66,6 +66,20 @@ opengl_error_callback( GLenum source, GLenum type, GLuint id
 namespace shader
 {
 
+//! \brief Read the source of a shader, replacing each line of the form
+//!        `#include "file"` by the content of that file, itself read the
+//!        same way.
+//!
+//! Included files are looked up relative to the file including them, and
+//! `#line` directives keep the line numbers of compilation errors
+//! matching the including file; errors within included files are
+//! reported with the line number they have in that file.
+//!
+//! \param [in] path of the shader source
+//! \return the expanded source, or an empty string if any of the files
+//!         could not be read
+std::string read_source(std::string const& path);
+
 bool source_and_build_shader(GLuint id, std::string const& source);
 GLuint generate_shader(GLenum type, std::string const& source);
 bool link_program(GLuint id);
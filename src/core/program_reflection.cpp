@@ -0,0 +1,82 @@
+#include "program_reflection.hpp"
+
+#include <unordered_map>
+
+namespace
+{
+	struct program_entry {
+		bonobo::program_reflection::locations common;
+		std::unordered_map<std::string, GLint> uniforms;
+	};
+
+	std::unordered_map<GLuint, program_entry> programs;
+	std::uint32_t generation = 0u;
+
+	void queryLocations(GLuint program, bonobo::program_reflection::locations& locations)
+	{
+		locations.vertex_model_to_world = glGetUniformLocation(program, "vertex_model_to_world");
+		locations.normal_model_to_world = glGetUniformLocation(program, "normal_model_to_world");
+		locations.vertex_world_to_clip = glGetUniformLocation(program, "vertex_world_to_clip");
+		for (std::size_t i = 0u; i < bonobo::material_texture_slots_nb; ++i) {
+			locations.material_textures[i] = glGetUniformLocation(program, bonobo::material_texture_names[i]);
+			locations.material_texture_presences[i] = glGetUniformLocation(program, bonobo::material_texture_presence_names[i]);
+		}
+		locations.diffuse_colour = glGetUniformLocation(program, "diffuse_colour");
+		locations.specular_colour = glGetUniformLocation(program, "specular_colour");
+		locations.ambient_colour = glGetUniformLocation(program, "ambient_colour");
+		locations.emissive_colour = glGetUniformLocation(program, "emissive_colour");
+		locations.shininess_value = glGetUniformLocation(program, "shininess_value");
+		locations.index_of_refraction_value = glGetUniformLocation(program, "index_of_refraction_value");
+		locations.opacity_value = glGetUniformLocation(program, "opacity_value");
+		locations.has_quantised_positions = glGetUniformLocation(program, "has_quantised_positions");
+		locations.vertex_dequantisation_scale = glGetUniformLocation(program, "vertex_dequantisation_scale");
+		locations.vertex_dequantisation_offset = glGetUniformLocation(program, "vertex_dequantisation_offset");
+		locations.has_octahedral_normals = glGetUniformLocation(program, "has_octahedral_normals");
+
+		locations.material_constants_block = glGetUniformBlockIndex(program, "MaterialConstants");
+		if (locations.material_constants_block != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, locations.material_constants_block, bonobo::material_constants_binding);
+	}
+
+	program_entry& getEntry(GLuint program)
+	{
+		auto it = programs.find(program);
+		if (it == programs.end()) {
+			it = programs.emplace(program, program_entry()).first;
+			queryLocations(program, it->second.common);
+		}
+		return it->second;
+	}
+}
+
+bonobo::program_reflection::locations const&
+bonobo::program_reflection::getLocations(GLuint program)
+{
+	return getEntry(program).common;
+}
+
+GLint
+bonobo::program_reflection::getUniformLocation(GLuint program, std::string const& name)
+{
+	auto& uniforms = getEntry(program).uniforms;
+	auto const it = uniforms.find(name);
+	if (it != uniforms.end())
+		return it->second;
+
+	auto const location = glGetUniformLocation(program, name.c_str());
+	uniforms.emplace(name, location);
+	return location;
+}
+
+void
+bonobo::program_reflection::invalidate(GLuint program)
+{
+	programs.erase(program);
+	++generation;
+}
+
+std::uint32_t
+bonobo::program_reflection::getGeneration()
+{
+	return generation;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+//! \brief Cache of the uniform locations of shader programs, so that code
+//!        drawing many objects does not query the driver, nor hash uniform
+//!        names, on every draw call.
+//!
+//! Entries are created on first use of a program, and must be invalidated
+//! when the program gets deleted or relinked, as its ID could then be
+//! reused for a different program; `ShaderProgramManager` does so for the
+//! programs it manages.
+namespace bonobo
+{
+namespace program_reflection
+{
+	//! \brief Locations of the uniforms set by `Node::render()` and
+	//!        `setVertexEncodingUniforms()`, -1 for those the program does
+	//!        not use.
+	struct locations {
+		GLint vertex_model_to_world{ -1 };
+		GLint normal_model_to_world{ -1 };
+		GLint vertex_world_to_clip{ -1 };
+		std::array<GLint, material_texture_slots_nb> material_textures{ { -1, -1, -1, -1 } };          //!< Samplers of each material texture slot, see `material_texture_names`
+		std::array<GLint, material_texture_slots_nb> material_texture_presences{ { -1, -1, -1, -1 } }; //!< Presence flags of each slot, see `material_texture_presence_names`
+		GLint diffuse_colour{ -1 };
+		GLint specular_colour{ -1 };
+		GLint ambient_colour{ -1 };
+		GLint emissive_colour{ -1 };
+		GLint shininess_value{ -1 };
+		GLint index_of_refraction_value{ -1 };
+		GLint opacity_value{ -1 };
+		GLuint material_constants_block{ GL_INVALID_INDEX }; //!< Index of the `MaterialConstants` block, already bound to `material_constants_binding`
+		GLint has_quantised_positions{ -1 };
+		GLint vertex_dequantisation_scale{ -1 };
+		GLint vertex_dequantisation_offset{ -1 };
+		GLint has_octahedral_normals{ -1 };
+	};
+
+	//! \brief Return the locations of the common uniforms of |program|,
+	//!        querying them on first use.
+	//!
+	//! The reference stays valid until the program is invalidated.
+	locations const& getLocations(GLuint program);
+
+	//! \brief Return the location of any uniform of |program|, querying it
+	//!        on first use.
+	GLint getUniformLocation(GLuint program, std::string const& name);
+
+	//! \brief Forget all locations cached for |program|.
+	void invalidate(GLuint program);
+
+	//! \brief Return a counter incremented by every invalidation, so that
+	//!        callers caching locations themselves can tell when to query
+	//!        them again.
+	std::uint32_t getGeneration();
+}
+}
@@ -0,0 +1,371 @@
+#include "scene_cache.hpp"
+
+#include "core/Log.h"
+#include "core/various.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+	// The cache file is laid out as follows, with every mesh stream starting
+	// on a `cache_alignment` boundary:
+	//
+	//   [cache_header]
+	//   [cache_mesh_record] × meshes_nb
+	//   [cache_material_record] × materials_nb
+	//   [strings]
+	//   for each mesh: [vertices][normals][texcoords][tangents][binormals][indices]
+	//
+	// Absent attributes take no space; the presence of each attribute is
+	// recorded in `cache_mesh_record::attributes`.
+	constexpr std::array<char, 8> cache_magic{ { 'B', 'N', 'B', 'S', 'C', 'E', 'N', 'E' } };
+	constexpr std::uint32_t cache_version = 2u;
+	constexpr std::uint64_t cache_alignment = 16u;
+
+	enum cache_attribute : std::uint32_t {
+		cache_attribute_normals   = 1u << 0,
+		cache_attribute_texcoords = 1u << 1,
+		cache_attribute_tangents  = 1u << 2 //!< Tangents and binormals are always stored together.
+	};
+
+	struct cache_string {
+		std::uint32_t offset; //!< Offset from the start of the strings section
+		std::uint32_t length;
+	};
+
+	struct cache_header {
+		std::array<char, 8> magic;
+		std::uint32_t version;
+		std::uint32_t import_flags;
+		std::int64_t source_modification_time;
+		std::uint64_t source_size;
+		std::uint64_t processing_key;
+		std::uint64_t strings_offset;
+		std::uint64_t strings_size;
+		cache_string source_path;
+		std::uint32_t meshes_nb;
+		std::uint32_t materials_nb;
+		float import_duration_ms;
+		std::uint32_t padding;
+	};
+
+	struct cache_mesh_record {
+		cache_string name;
+		std::uint32_t drawing_mode;
+		std::uint32_t material_index;
+		std::uint32_t vertices_nb;
+		std::uint32_t indices_nb;
+		std::uint32_t attributes;
+		std::uint32_t padding;
+		std::uint64_t data_offset;
+	};
+
+	struct cache_material_record {
+		std::array<float, 3> diffuse;
+		std::array<float, 3> specular;
+		std::array<float, 3> ambient;
+		std::array<float, 3> emissive;
+		float shininess;
+		float index_of_refraction;
+		float opacity;
+		cache_string name;
+		std::array<cache_string, bonobo::material_texture_slots_nb> texture_paths;
+	};
+
+	static_assert(std::is_trivially_copyable<cache_header>::value, "The cache header is written as raw bytes.");
+	static_assert(std::is_trivially_copyable<cache_mesh_record>::value, "Mesh records are written as raw bytes.");
+	static_assert(std::is_trivially_copyable<cache_material_record>::value, "Material records are written as raw bytes.");
+
+	std::uint64_t align(std::uint64_t const value)
+	{
+		return (value + cache_alignment - 1u) & ~(cache_alignment - 1u);
+	}
+
+	std::uint64_t getStreamSize(std::uint32_t const vertices_nb)
+	{
+		return align(static_cast<std::uint64_t>(vertices_nb) * 3u * sizeof(float));
+	}
+
+	std::uint64_t getMeshDataSize(cache_mesh_record const& record)
+	{
+		std::uint64_t streams_nb = 1u;
+		if (record.attributes & cache_attribute_normals)
+			++streams_nb;
+		if (record.attributes & cache_attribute_texcoords)
+			++streams_nb;
+		if (record.attributes & cache_attribute_tangents)
+			streams_nb += 2u;
+
+		return streams_nb * getStreamSize(record.vertices_nb)
+		     + align(static_cast<std::uint64_t>(record.indices_nb) * sizeof(std::uint32_t));
+	}
+
+	std::string readString(bonobo::scene_description const& scene, cache_header const& header, cache_string const& string)
+	{
+		return std::string(reinterpret_cast<char const*>(scene.mapping.data() + header.strings_offset + string.offset), string.length);
+	}
+
+	bool isStringValid(cache_header const& header, cache_string const& string)
+	{
+		return static_cast<std::uint64_t>(string.offset) + string.length <= header.strings_size;
+	}
+}
+
+std::string
+bonobo::scene_cache::getCachePath(std::string const& filename)
+{
+	return filename + ".bonobo_cache";
+}
+
+bool
+bonobo::scene_cache::load(std::string const& filename, unsigned int import_flags,
+                          std::uint64_t processing_key, scene_description& scene, float& import_duration_ms)
+{
+	auto const cache_path = getCachePath(filename);
+	scene.mapping = utils::file_view(cache_path);
+	if (!scene.mapping.is_open())
+		return false;
+
+	auto const discard = [&scene, &cache_path](char const* reason){
+		LogInfo("│ Ignoring cache \"%s\": %s.", cache_path.c_str(), reason);
+		scene.mapping = utils::file_view();
+		scene.meshes.clear();
+		scene.materials.clear();
+		return false;
+	};
+
+	auto const mapping_size = static_cast<std::uint64_t>(scene.mapping.size());
+	if (mapping_size < sizeof(cache_header))
+		return discard("file is truncated");
+
+	cache_header header;
+	std::memcpy(&header, scene.mapping.data(), sizeof(header));
+	if (header.magic != cache_magic || header.version != cache_version)
+		return discard("it was written by a different version");
+	if (header.import_flags != import_flags)
+		return discard("it was imported with different post-processing flags");
+	if (header.processing_key != processing_key)
+		return discard("its meshes were processed with different options");
+
+	auto const records_end = sizeof(cache_header)
+	                       + static_cast<std::uint64_t>(header.meshes_nb) * sizeof(cache_mesh_record)
+	                       + static_cast<std::uint64_t>(header.materials_nb) * sizeof(cache_material_record);
+	if (records_end > header.strings_offset || header.strings_offset + header.strings_size > mapping_size)
+		return discard("file is truncated");
+
+	if (!isStringValid(header, header.source_path) || readString(scene, header, header.source_path) != filename)
+		return discard("it was created for a different file");
+	if (header.source_modification_time != utils::get_file_modification_time(filename)
+	 || header.source_size != utils::get_file_size(filename))
+		return discard("the source file has been modified since");
+
+	auto const mesh_records = reinterpret_cast<cache_mesh_record const*>(scene.mapping.data() + sizeof(cache_header));
+	auto const material_records = reinterpret_cast<cache_material_record const*>(mesh_records + header.meshes_nb);
+
+	scene.materials.resize(header.materials_nb);
+	for (std::uint32_t i = 0u; i < header.materials_nb; ++i) {
+		auto const& record = material_records[i];
+		auto& material = scene.materials[i];
+
+		if (!isStringValid(header, record.name))
+			return discard("a material record is corrupted");
+		material.name = readString(scene, header, record.name);
+		material.constants.diffuse = glm::vec3(record.diffuse[0], record.diffuse[1], record.diffuse[2]);
+		material.constants.specular = glm::vec3(record.specular[0], record.specular[1], record.specular[2]);
+		material.constants.ambient = glm::vec3(record.ambient[0], record.ambient[1], record.ambient[2]);
+		material.constants.emissive = glm::vec3(record.emissive[0], record.emissive[1], record.emissive[2]);
+		material.constants.shininess = record.shininess;
+		material.constants.indexOfRefraction = record.index_of_refraction;
+		material.constants.opacity = record.opacity;
+		for (std::size_t j = 0u; j < material_texture_slots_nb; ++j) {
+			if (!isStringValid(header, record.texture_paths[j]))
+				return discard("a material record is corrupted");
+			material.texture_paths[j] = readString(scene, header, record.texture_paths[j]);
+		}
+	}
+
+	scene.meshes.resize(header.meshes_nb);
+	for (std::uint32_t i = 0u; i < header.meshes_nb; ++i) {
+		auto const& record = mesh_records[i];
+		auto& mesh = scene.meshes[i];
+
+		if (!isStringValid(header, record.name)
+		 || record.data_offset % cache_alignment != 0u
+		 || record.data_offset + getMeshDataSize(record) > mapping_size
+		 || (record.material_index >= header.materials_nb && record.material_index != std::numeric_limits<std::uint32_t>::max()))
+			return discard("a mesh record is corrupted");
+
+		mesh.name = readString(scene, header, record.name);
+		mesh.drawing_mode = static_cast<GLenum>(record.drawing_mode);
+		mesh.material_index = record.material_index;
+		mesh.vertices_nb = record.vertices_nb;
+		mesh.indices_nb = record.indices_nb;
+
+		auto const stream_size = getStreamSize(record.vertices_nb);
+		auto current_offset = record.data_offset;
+		auto const next_stream = [&scene, &current_offset, stream_size](){
+			auto const stream = reinterpret_cast<float const*>(scene.mapping.data() + current_offset);
+			current_offset += stream_size;
+			return stream;
+		};
+
+		mesh.vertices = next_stream();
+		if (record.attributes & cache_attribute_normals)
+			mesh.normals = next_stream();
+		if (record.attributes & cache_attribute_texcoords)
+			mesh.texcoords = next_stream();
+		if (record.attributes & cache_attribute_tangents) {
+			mesh.tangents = next_stream();
+			mesh.binormals = next_stream();
+		}
+		if (record.indices_nb != 0u)
+			mesh.indices = reinterpret_cast<std::uint32_t const*>(scene.mapping.data() + current_offset);
+	}
+
+	import_duration_ms = header.import_duration_ms;
+	return true;
+}
+
+bool
+bonobo::scene_cache::store(std::string const& filename, unsigned int import_flags,
+                           std::uint64_t processing_key, scene_description const& scene, float import_duration_ms)
+{
+	std::string strings;
+	auto const add_string = [&strings](std::string const& string){
+		cache_string const result{ static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(string.size()) };
+		strings += string;
+		return result;
+	};
+
+	cache_header header;
+	header.magic = cache_magic;
+	header.version = cache_version;
+	header.import_flags = import_flags;
+	header.source_modification_time = utils::get_file_modification_time(filename);
+	header.source_size = utils::get_file_size(filename);
+	header.processing_key = processing_key;
+	header.source_path = add_string(filename);
+	header.meshes_nb = static_cast<std::uint32_t>(scene.meshes.size());
+	header.materials_nb = static_cast<std::uint32_t>(scene.materials.size());
+	header.import_duration_ms = import_duration_ms;
+	header.padding = 0u;
+
+	std::vector<cache_material_record> material_records(scene.materials.size());
+	for (std::size_t i = 0u; i < scene.materials.size(); ++i) {
+		auto const& material = scene.materials[i];
+		auto& record = material_records[i];
+
+		record.diffuse = { { material.constants.diffuse.x, material.constants.diffuse.y, material.constants.diffuse.z } };
+		record.specular = { { material.constants.specular.x, material.constants.specular.y, material.constants.specular.z } };
+		record.ambient = { { material.constants.ambient.x, material.constants.ambient.y, material.constants.ambient.z } };
+		record.emissive = { { material.constants.emissive.x, material.constants.emissive.y, material.constants.emissive.z } };
+		record.shininess = material.constants.shininess;
+		record.index_of_refraction = material.constants.indexOfRefraction;
+		record.opacity = material.constants.opacity;
+		record.name = add_string(material.name);
+		for (std::size_t j = 0u; j < material_texture_slots_nb; ++j)
+			record.texture_paths[j] = add_string(material.texture_paths[j]);
+	}
+
+	std::vector<cache_mesh_record> mesh_records(scene.meshes.size());
+	for (std::size_t i = 0u; i < scene.meshes.size(); ++i) {
+		auto const& mesh = scene.meshes[i];
+		auto& record = mesh_records[i];
+
+		record.name = add_string(mesh.name);
+		record.drawing_mode = static_cast<std::uint32_t>(mesh.drawing_mode);
+		record.material_index = mesh.material_index;
+		record.vertices_nb = mesh.vertices_nb;
+		record.indices_nb = mesh.indices != nullptr ? mesh.indices_nb : 0u;
+		record.attributes = (mesh.normals != nullptr ? cache_attribute_normals : 0u)
+		                  | (mesh.texcoords != nullptr ? cache_attribute_texcoords : 0u)
+		                  | (mesh.tangents != nullptr && mesh.binormals != nullptr ? cache_attribute_tangents : 0u);
+		record.padding = 0u;
+	}
+
+	header.strings_offset = sizeof(cache_header)
+	                      + mesh_records.size() * sizeof(cache_mesh_record)
+	                      + material_records.size() * sizeof(cache_material_record);
+	header.strings_size = strings.size();
+
+	auto data_offset = align(header.strings_offset + header.strings_size);
+	for (auto& record : mesh_records) {
+		record.data_offset = data_offset;
+		data_offset += getMeshDataSize(record);
+	}
+
+	auto const cache_path = getCachePath(filename);
+	auto const temporary_path = cache_path + ".tmp";
+	{
+		std::ofstream file(utils::widen(temporary_path), std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			LogWarning("Failed to create the cache file \"%s\".", temporary_path.c_str());
+			return false;
+		}
+
+		std::uint64_t current_offset = 0u;
+		auto const write = [&file, &current_offset](void const* data, std::uint64_t size){
+			file.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+			current_offset += size;
+		};
+		auto const pad = [&file, &current_offset](){
+			static std::array<char, cache_alignment> const zeroes{};
+			auto const padding = align(current_offset) - current_offset;
+			file.write(zeroes.data(), static_cast<std::streamsize>(padding));
+			current_offset += padding;
+		};
+
+		write(&header, sizeof(header));
+		write(mesh_records.data(), mesh_records.size() * sizeof(cache_mesh_record));
+		write(material_records.data(), material_records.size() * sizeof(cache_material_record));
+		write(strings.data(), strings.size());
+		pad();
+
+		for (std::size_t i = 0u; i < scene.meshes.size(); ++i) {
+			auto const& mesh = scene.meshes[i];
+			auto const& record = mesh_records[i];
+			auto const stream_size = static_cast<std::uint64_t>(mesh.vertices_nb) * 3u * sizeof(float);
+
+			write(mesh.vertices, stream_size);
+			pad();
+			if (record.attributes & cache_attribute_normals) {
+				write(mesh.normals, stream_size);
+				pad();
+			}
+			if (record.attributes & cache_attribute_texcoords) {
+				write(mesh.texcoords, stream_size);
+				pad();
+			}
+			if (record.attributes & cache_attribute_tangents) {
+				write(mesh.tangents, stream_size);
+				pad();
+				write(mesh.binormals, stream_size);
+				pad();
+			}
+			write(mesh.indices, static_cast<std::uint64_t>(record.indices_nb) * sizeof(std::uint32_t));
+			pad();
+		}
+
+		if (!file.good()) {
+			LogWarning("Failed to write the cache file \"%s\".", temporary_path.c_str());
+			file.close();
+			utils::remove_file(temporary_path);
+			return false;
+		}
+	}
+
+	if (!utils::replace_file(temporary_path, cache_path)) {
+		LogWarning("Failed to move the cache file \"%s\" to \"%s\".", temporary_path.c_str(), cache_path.c_str());
+		utils::remove_file(temporary_path);
+		return false;
+	}
+
+	return true;
+}
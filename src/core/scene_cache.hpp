@@ -0,0 +1,63 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <cstdint>
+#include <string>
+
+//! \brief On-disk cache of the geometry and materials processed by
+//!        `bonobo::loadObjects()`.
+//!
+//! A cache file is written next to the object/scene file it was created
+//! from, and is keyed on the path, modification time and size of that file,
+//! as well as on the assimp post-processing flags used during the import and
+//! on the processing applied afterwards by bonobo (see
+//! `mesh_processing_options`).
+//! If any of those differ, the cache is considered stale and gets rewritten
+//! on the next import.
+//!
+//! All streams are stored in a flat, planar layout so that they can be
+//! uploaded to OpenGL directly from a memory mapping of the cache file.
+//!
+//! Note that only the modification of the object/scene file itself is
+//! tracked: editing an external material library (like a .mtl file) will
+//! not invalidate the cache, and the cache file has to be deleted manually.
+namespace bonobo
+{
+namespace scene_cache
+{
+	//! \brief Return the path of the cache file associated to a scene file.
+	std::string getCachePath(std::string const& filename);
+
+	//! \brief Retrieve a scene from its cache file, if it is up-to-date.
+	//!
+	//! @param [in] filename of the object/scene file that was cached
+	//! @param [in] import_flags assimp post-processing flags to match
+	//! @param [in] processing_key key of the bonobo processing to match
+	//! @param [out] scene will reference the memory-mapped content of the
+	//!              cache file on success
+	//! @param [out] import_duration_ms how long the import which created the
+	//!              cache took, in milliseconds
+	//! @return whether a valid and up-to-date cache was found
+	bool load(std::string const& filename, unsigned int import_flags,
+	          std::uint64_t processing_key, scene_description& scene, float& import_duration_ms);
+
+	//! \brief Write a scene to its cache file.
+	//!
+	//! The cache is first written to a temporary file which then replaces
+	//! the previous cache, so that an interrupted write can not leave a
+	//! partial cache behind.
+	//!
+	//! @param [in] filename of the object/scene file being cached
+	//! @param [in] import_flags assimp post-processing flags used during
+	//!             the import
+	//! @param [in] processing_key key of the bonobo processing applied
+	//!             after the import
+	//! @param [in] scene the imported scene to write
+	//! @param [in] import_duration_ms how long the import took, in
+	//!             milliseconds
+	//! @return whether the cache file was successfully written
+	bool store(std::string const& filename, unsigned int import_flags,
+	           std::uint64_t processing_key, scene_description const& scene, float import_duration_ms);
+}
+}
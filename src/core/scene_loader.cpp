@@ -0,0 +1,1197 @@
+#include "scene_loader.hpp"
+
+#include "core/Log.h"
+#include "core/mesh_optimisation.hpp"
+#include "core/mipmaps.hpp"
+#include "core/obj_loader.hpp"
+#include "core/opengl.hpp"
+#include "core/scene_cache.hpp"
+#include "core/texture_compression.hpp"
+#include "core/texture_registry.hpp"
+#include "core/texture_streaming.hpp"
+#include "core/ThreadPool.hpp"
+#include "core/uploads.hpp"
+#include "core/various.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+
+namespace local
+{
+	static unsigned int const assimp_import_flags = aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_CalcTangentSpace;
+	//! \brief Recorded in scene caches in place of assimp's flags, for
+	//!        scenes read by `bonobo::obj_loader`; assimp is never run
+	//!        without any post-processing, so both can not be confused.
+	static unsigned int const native_obj_import_flags = 0u;
+
+	struct material_texture_slot {
+		aiTextureType assimp_type;
+		char const* type_as_str;
+		bonobo::texture_compression_t compression;     //!< Used when loading objects with compressed textures
+		bonobo::mipmaps::content_t content;            //!< How to filter the mipmap hierarchy
+		bonobo::texture_registry::channels_t channels; //!< Which channels the shaders read
+	};
+	//! \brief Order in which textures are stored in
+	//!        `bonobo::material_description::texture_paths`.
+	static std::array<material_texture_slot, bonobo::material_texture_slots_nb> const material_texture_slots{ {
+		{ aiTextureType_DIFFUSE,  "diffuse",  bonobo::texture_compression_t::colour,         bonobo::mipmaps::content_t::colour,     bonobo::texture_registry::channels_t::rgba },
+		{ aiTextureType_SPECULAR, "specular", bonobo::texture_compression_t::colour,         bonobo::mipmaps::content_t::colour,     bonobo::texture_registry::channels_t::rgb  },
+		{ aiTextureType_NORMALS,  "normals",  bonobo::texture_compression_t::normal_map,     bonobo::mipmaps::content_t::normal_map, bonobo::texture_registry::channels_t::rgb  },
+		{ aiTextureType_OPACITY,  "opacity",  bonobo::texture_compression_t::single_channel, bonobo::mipmaps::content_t::linear,     bonobo::texture_registry::channels_t::r    }
+	} };
+}
+
+namespace
+{
+	//! \brief Stream over a `utils::file_view`, so that assimp reads object
+	//!        files and their material libraries from mounted archives too.
+	class file_view_stream : public Assimp::IOStream
+	{
+	public:
+		explicit file_view_stream(utils::file_view file) : _file(std::move(file)) {}
+
+		size_t Read(void* buffer, size_t size, size_t count) override
+		{
+			if (size == 0u)
+				return 0u;
+			count = std::min(count, (_file.size() - _position) / size);
+			std::memcpy(buffer, _file.data() + _position, size * count);
+			_position += size * count;
+			return count;
+		}
+
+		size_t Write(void const* /*buffer*/, size_t /*size*/, size_t /*count*/) override
+		{
+			return 0u;
+		}
+
+		aiReturn Seek(size_t offset, aiOrigin origin) override
+		{
+			std::size_t base = 0u;
+			if (origin == aiOrigin_CUR)
+				base = _position;
+			else if (origin == aiOrigin_END)
+				base = _file.size();
+			if (offset > _file.size() - base)
+				return aiReturn_FAILURE;
+			_position = base + offset;
+			return aiReturn_SUCCESS;
+		}
+
+		size_t Tell() const override { return _position; }
+		size_t FileSize() const override { return _file.size(); }
+		void Flush() override {}
+
+	private:
+		utils::file_view _file;
+		std::size_t _position{ 0u };
+	};
+
+	//! \brief Read-only file system for assimp, going through the archives
+	//!        mounted by `utils::mount_archive()`.
+	class file_view_system : public Assimp::IOSystem
+	{
+	public:
+		bool Exists(char const* path) const override
+		{
+			return utils::file_exists(path);
+		}
+
+		char getOsSeparator() const override
+		{
+			return '/';
+		}
+
+		Assimp::IOStream* Open(char const* path, char const* mode) override
+		{
+			if (std::strchr(mode, 'w') != nullptr || std::strchr(mode, 'a') != nullptr)
+				return nullptr;
+
+			utils::file_view file(path);
+			return file.is_open() ? new file_view_stream(std::move(file)) : nullptr;
+		}
+
+		void Close(Assimp::IOStream* stream) override
+		{
+			delete stream;
+		}
+	};
+}
+
+static bool
+importScene(Assimp::Importer& importer, std::string const& filename, bonobo::scene_description& scene)
+{
+	// The importer takes ownership of the file system.
+	importer.SetIOHandler(new file_view_system());
+	auto const assimp_scene = importer.ReadFile(filename, local::assimp_import_flags);
+	if (assimp_scene == nullptr || assimp_scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || assimp_scene->mRootNode == nullptr) {
+		LogError("Assimp failed to load \"%s\": %s", filename.c_str(), importer.GetErrorString());
+		return false;
+	}
+
+	if (assimp_scene->mNumMeshes == 0u) {
+		LogError("No mesh available; loading \"%s\" must have had issues", filename.c_str());
+		return false;
+	}
+
+	scene.materials.resize(assimp_scene->mNumMaterials);
+	for (size_t i = 0; i < assimp_scene->mNumMaterials; ++i) {
+		auto const material = assimp_scene->mMaterials[i];
+		auto& description = scene.materials[i];
+		auto& constants = description.constants;
+
+		description.name = std::string(material->GetName().C_Str());
+
+		aiColor3D color;
+
+		material->Get(AI_MATKEY_COLOR_DIFFUSE, color);
+		constants.diffuse = glm::vec3(color.r, color.g, color.b);
+		material->Get(AI_MATKEY_COLOR_SPECULAR, color);
+		constants.specular = glm::vec3(color.r, color.g, color.b);
+		material->Get(AI_MATKEY_COLOR_AMBIENT, color);
+		constants.ambient = glm::vec3(color.r, color.g, color.b);
+		material->Get(AI_MATKEY_COLOR_EMISSIVE, color);
+		constants.emissive = glm::vec3(color.r, color.g, color.b);
+		material->Get(AI_MATKEY_SHININESS, constants.shininess);
+		material->Get(AI_MATKEY_REFRACTI, constants.indexOfRefraction);
+		material->Get(AI_MATKEY_OPACITY, constants.opacity);
+
+		for (size_t j = 0; j < local::material_texture_slots.size(); ++j) {
+			auto const& slot = local::material_texture_slots[j];
+			if (material->GetTextureCount(slot.assimp_type) == 0u)
+				continue;
+
+			if (material->GetTextureCount(slot.assimp_type) > 1)
+				LogWarning("Material \"%s\" has more than one %s texture: discarding all but the first one.", description.name.c_str(), slot.type_as_str);
+			aiString path;
+			material->GetTexture(slot.assimp_type, 0, &path);
+			description.texture_paths[j] = std::string(path.C_Str());
+		}
+	}
+
+	scene.meshes.reserve(assimp_scene->mNumMeshes);
+	for (size_t j = 0; j < assimp_scene->mNumMeshes; ++j) {
+		auto const assimp_object_mesh = assimp_scene->mMeshes[j];
+
+		if (!assimp_object_mesh->HasFaces()) {
+			LogError("Unsupported mesh \"%s\": has no faces", assimp_object_mesh->mName.C_Str());
+			continue;
+		}
+		if ((assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_POINT | aiPrimitiveType_NGONEncodingFlag))    != 0u
+		 && (assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_LINE | aiPrimitiveType_NGONEncodingFlag))     != 0u
+		 && (assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_TRIANGLE | aiPrimitiveType_NGONEncodingFlag)) != 0u) {
+			LogError("Unsupported mesh \"%s\": uses multiple primitive types", assimp_object_mesh->mName.C_Str());
+			continue;
+		}
+		if ((assimp_object_mesh->mPrimitiveTypes & static_cast<uint32_t>(aiPrimitiveType_POLYGON)) == static_cast<uint32_t>(aiPrimitiveType_POLYGON)) {
+			LogError("Unsupported mesh \"%s\": uses polygons", assimp_object_mesh->mName.C_Str());
+			continue;
+		}
+		if (!assimp_object_mesh->HasPositions()) {
+			LogError("Unsupported mesh \"%s\": has no positions", assimp_object_mesh->mName.C_Str());
+			continue;
+		}
+
+		bonobo::mesh_streams mesh;
+		if (assimp_object_mesh->mName.length != 0)
+		{
+			mesh.name = std::string(assimp_object_mesh->mName.C_Str());
+		}
+
+		auto const material_id = assimp_object_mesh->mMaterialIndex;
+		if (material_id >= assimp_scene->mNumMaterials)
+			LogError("Mesh \"%s\" has a material index of %u, but only %u materials are present.", assimp_object_mesh->mName.C_Str(), material_id, assimp_scene->mNumMaterials);
+		else
+			mesh.material_index = material_id;
+
+		// aiVector3D is a tightly-packed triplet of floats, so assimp's
+		// arrays can be referenced as-is.
+		mesh.vertices_nb = assimp_object_mesh->mNumVertices;
+		mesh.vertices = reinterpret_cast<float const*>(assimp_object_mesh->mVertices);
+		if (assimp_object_mesh->HasNormals())
+			mesh.normals = reinterpret_cast<float const*>(assimp_object_mesh->mNormals);
+		if (assimp_object_mesh->HasTextureCoords(0u))
+			mesh.texcoords = reinterpret_cast<float const*>(assimp_object_mesh->mTextureCoords[0u]);
+		if (assimp_object_mesh->HasTangentsAndBitangents()) {
+			mesh.tangents = reinterpret_cast<float const*>(assimp_object_mesh->mTangents);
+			mesh.binormals = reinterpret_cast<float const*>(assimp_object_mesh->mBitangents);
+		}
+
+		auto const num_vertices_per_face = assimp_object_mesh->mFaces[0u].mNumIndices;
+		mesh.indices_nb = assimp_object_mesh->mNumFaces * num_vertices_per_face;
+		scene.owned_data.emplace_back(static_cast<size_t>(mesh.indices_nb) * sizeof(std::uint32_t));
+		auto const object_indices = reinterpret_cast<std::uint32_t*>(scene.owned_data.back().data());
+		for (size_t i = 0u; i < assimp_object_mesh->mNumFaces; ++i) {
+			auto const& face = assimp_object_mesh->mFaces[i];
+			assert(face.mNumIndices <= 3);
+			object_indices[num_vertices_per_face * i + 0u] = face.mIndices[0u];
+			if (num_vertices_per_face > 1u)
+				object_indices[num_vertices_per_face * i + 1u] = face.mIndices[1u];
+			if (num_vertices_per_face > 2u)
+				object_indices[num_vertices_per_face * i + 2u] = face.mIndices[2u];
+		}
+		mesh.indices = object_indices;
+
+		scene.meshes.push_back(mesh);
+	}
+
+	return true;
+}
+
+// Hash the options affecting the content of processed meshes, using FNV-1a,
+// to detect scene caches created with different options.
+static std::uint64_t
+getProcessingKey(bonobo::mesh_processing_options const& options)
+{
+	std::uint64_t key = 0xcbf29ce484222325u;
+	auto const hash = [&key](void const* value, std::size_t size){
+		auto const bytes = static_cast<std::uint8_t const*>(value);
+		for (std::size_t i = 0u; i < size; ++i)
+			key = (key ^ bytes[i]) * 0x100000001b3u;
+	};
+
+	bool const optimise_vertex_cache = options.optimise_vertex_cache || options.optimise_overdraw;
+	hash(&optimise_vertex_cache, sizeof(optimise_vertex_cache));
+	hash(&options.optimise_overdraw, sizeof(options.optimise_overdraw));
+	hash(&options.optimise_vertex_fetch, sizeof(options.optimise_vertex_fetch));
+	if (optimise_vertex_cache)
+		hash(&options.vertex_cache_size, sizeof(options.vertex_cache_size));
+	if (options.optimise_overdraw)
+		hash(&options.overdraw_threshold, sizeof(options.overdraw_threshold));
+	if (options.weld_vertices) {
+		hash(&options.weld_vertices, sizeof(options.weld_vertices));
+		hash(&options.weld_position_epsilon, sizeof(options.weld_position_epsilon));
+		hash(&options.weld_normal_epsilon, sizeof(options.weld_normal_epsilon));
+		hash(&options.weld_texcoord_epsilon, sizeof(options.weld_texcoord_epsilon));
+		hash(&options.weld_tangent_epsilon, sizeof(options.weld_tangent_epsilon));
+	}
+
+	return key;
+}
+
+// Run the processing enabled in |options| on all meshes of |scene|, and log
+// its effect.
+static void
+processMeshes(bonobo::scene_description& scene, bonobo::mesh_processing_options const& options)
+{
+	if (options.weld_vertices) {
+		auto const weld_start_time = std::chrono::high_resolution_clock::now();
+
+		bonobo::mesh_optimisation::vertex_weld_statistics total;
+		for (auto& mesh : scene.meshes) {
+			bonobo::mesh_optimisation::vertex_weld_statistics statistics;
+			if (!bonobo::mesh_optimisation::weldVertices(mesh, scene.owned_data, options, statistics))
+				continue;
+
+			total.vertices_nb_before += statistics.vertices_nb_before;
+			total.vertices_nb_after += statistics.vertices_nb_after;
+			total.bytes_before += statistics.bytes_before;
+			total.bytes_after += statistics.bytes_after;
+		}
+
+		auto const weld_end_time = std::chrono::high_resolution_clock::now();
+		LogInfo("│ Welded vertices in %.3f ms: %zu → %zu vertices, %.3f → %.3f MiB",
+		        std::chrono::duration<float, std::milli>(weld_end_time - weld_start_time).count(),
+		        total.vertices_nb_before, total.vertices_nb_after,
+		        static_cast<float>(total.bytes_before) / (1024.0f * 1024.0f),
+		        static_cast<float>(total.bytes_after) / (1024.0f * 1024.0f));
+	}
+
+	if (!options.optimise_vertex_cache && !options.optimise_overdraw && !options.optimise_vertex_fetch)
+		return;
+
+	auto const start_time = std::chrono::high_resolution_clock::now();
+
+	using vertex_cache_statistics = bonobo::mesh_optimisation::vertex_cache_statistics;
+	auto const accumulate = [](vertex_cache_statistics& total, vertex_cache_statistics const& statistics){
+		total.triangles_nb += statistics.triangles_nb;
+		total.vertices_nb += statistics.vertices_nb;
+		total.transforms_nb += statistics.transforms_nb;
+	};
+
+	vertex_cache_statistics total_before, total_after;
+	std::size_t optimised_meshes_nb = 0u;
+	for (auto& mesh : scene.meshes) {
+		vertex_cache_statistics before, after;
+		if (!bonobo::mesh_optimisation::optimiseMesh(mesh, scene.owned_data, options, before, after))
+			continue;
+
+		++optimised_meshes_nb;
+		accumulate(total_before, before);
+		accumulate(total_after, after);
+		LogTrivia("│ │ Mesh \"%s\": ACMR %.3f → %.3f, ATVR %.3f → %.3f",
+		          mesh.name.c_str(), before.acmr, after.acmr, before.atvr, after.atvr);
+	}
+
+	auto const end_time = std::chrono::high_resolution_clock::now();
+
+	auto const get_ratio = [](std::size_t numerator, std::size_t denominator){
+		return denominator != 0u ? static_cast<float>(numerator) / static_cast<float>(denominator) : 0.0f;
+	};
+	LogInfo("│ Optimised %zu meshes for a %u-entry vertex cache in %.3f ms: ACMR %.3f → %.3f, ATVR %.3f → %.3f",
+	        optimised_meshes_nb, options.vertex_cache_size,
+	        std::chrono::duration<float, std::milli>(end_time - start_time).count(),
+	        get_ratio(total_before.transforms_nb, total_before.triangles_nb),
+	        get_ratio(total_after.transforms_nb, total_after.triangles_nb),
+	        get_ratio(total_before.transforms_nb, total_before.vertices_nb),
+	        get_ratio(total_after.transforms_nb, total_after.vertices_nb));
+}
+
+namespace
+{
+	//! \brief An image referenced by the materials of a scene, which is
+	//!        only loaded once even if used by several materials.
+	struct texture_job {
+		bonobo::texture_registry::key key;
+		std::string path;
+		std::future<bonobo::texture_registry::decoded_image> decoding;
+		GLuint id{ 0u };
+		bool was_registered{ false };
+		GLenum internal_format{ 0u };
+		std::uint64_t bytes{ 0u };
+		bool was_compressed{ false };
+		bool was_cached{ false };
+		float decode_duration_ms{ 0.0f };
+		float upload_duration_ms{ 0.0f };
+	};
+
+	//! \brief Use of a `texture_job` by a texture slot of a material.
+	struct texture_use {
+		std::size_t material_index;
+		std::size_t slot_index;
+		std::size_t job_index;
+		bool is_first_use;
+	};
+
+	//! \brief Vertex array, buffer object and index buffer object shared by
+	//!        all meshes of a scene, and where the next mesh goes in them.
+	struct geometry_arena {
+		bonobo::vertex_layout_description layout;
+		GLuint vao{ 0u };
+		GLuint bo{ 0u };
+		GLuint ibo{ 0u };
+		std::uint32_t vertices_nb{ 0u };
+		std::uint32_t indices_nb{ 0u };
+		std::uint32_t short_indices_nb{ 0u };
+		GLsizeiptr indices_size{ 0 };
+		GLint base_vertex{ 0 };
+		GLsizeiptr indices_offset{ 0 };
+	};
+}
+
+bool
+bonobo::scene_loader::readScene(Assimp::Importer& importer, std::string const& filename,
+                                 mesh_processing_options const& processing, scene_description& scene)
+{
+	auto const start_time = std::chrono::high_resolution_clock::now();
+
+	float import_duration_ms = 0.0f;
+	auto const processing_key = getProcessingKey(processing);
+	auto import_flags = bonobo::obj_loader::isSupported(filename) ? local::native_obj_import_flags : local::assimp_import_flags;
+	bool is_cached = bonobo::scene_cache::load(filename, import_flags, processing_key, scene, import_duration_ms);
+	// Files the native loader failed on were cached after falling back to
+	// assimp, under its flags.
+	if (!is_cached && import_flags == local::native_obj_import_flags) {
+		is_cached = bonobo::scene_cache::load(filename, local::assimp_import_flags, processing_key, scene, import_duration_ms);
+	}
+	if (is_cached) {
+		auto const end_time = std::chrono::high_resolution_clock::now();
+		LogTrivia("│ Geometry retrieved from cache \"%s\" in %.3f ms (vs. %.3f ms when imported)",
+		          bonobo::scene_cache::getCachePath(filename).c_str(),
+		          std::chrono::duration<float, std::milli>(end_time - start_time).count(),
+		          import_duration_ms);
+		return true;
+	}
+
+	bool is_imported = false;
+	if (import_flags == local::native_obj_import_flags) {
+		// This may run on a worker thread of the caller, so the parser gets
+		// its own threads.
+		ThreadPool parsers;
+		is_imported = bonobo::obj_loader::load(filename, scene, &parsers);
+		if (!is_imported) {
+			LogWarning("Falling back to assimp for \"%s\"", filename.c_str());
+			scene = bonobo::scene_description();
+			import_flags = local::assimp_import_flags;
+		}
+	}
+	if (!is_imported && !importScene(importer, filename, scene))
+		return false;
+	auto const import_end_time = std::chrono::high_resolution_clock::now();
+	import_duration_ms = std::chrono::duration<float, std::milli>(import_end_time - start_time).count();
+
+	// Processed meshes are written to the cache, so the processing only
+	// runs when importing.
+	processMeshes(scene, processing);
+	auto const processing_end_time = std::chrono::high_resolution_clock::now();
+	auto const processing_duration_ms = std::chrono::duration<float, std::milli>(processing_end_time - import_end_time).count();
+
+	bool const is_stored = bonobo::scene_cache::store(filename, import_flags, processing_key, scene,
+	                                          import_duration_ms + processing_duration_ms);
+	LogTrivia("│ Geometry imported via %s in %.3f ms%s%s%s",
+	          import_flags == local::native_obj_import_flags ? "the native OBJ loader" : "assimp",
+	          import_duration_ms,
+	          is_stored ? "; cached to \"" : "",
+	          is_stored ? bonobo::scene_cache::getCachePath(filename).c_str() : "",
+	          is_stored ? "\"" : "");
+
+	return true;
+}
+
+// List the images used by the materials of |scene| which are referenced by
+// at least one mesh, and return which materials are. Images already present
+// in the texture registry get a reference taken on them, and do not need to
+// be loaded. With |compress_textures|, each image is compressed according
+// to the slot it is used in, if supported.
+static std::vector<bool>
+collectTextureJobs(bonobo::scene_description const& scene, std::string const& parent_folder, bool compress_textures,
+                   std::vector<texture_job>& jobs, std::vector<texture_use>& uses)
+{
+	std::vector<bool> are_materials_used(scene.materials.size(), false);
+	for (auto const& mesh : scene.meshes) {
+		if (mesh.material_index < scene.materials.size())
+			are_materials_used[mesh.material_index] = true;
+	}
+
+	std::map<bonobo::texture_registry::key, std::size_t> job_indices;
+	for (size_t i = 0; i < scene.materials.size(); ++i) {
+		if (!are_materials_used[i])
+			continue;
+
+		for (size_t j = 0; j < local::material_texture_slots.size(); ++j) {
+			auto const& path = scene.materials[i].texture_paths[j];
+			if (path.empty())
+				continue;
+
+			auto compression = compress_textures ? local::material_texture_slots[j].compression : bonobo::texture_compression_t::none;
+			if (!bonobo::texture_compression::isSupported(compression))
+				compression = bonobo::texture_compression_t::none;
+
+			auto key = bonobo::texture_registry::makeKey(parent_folder + path, true, true, local::material_texture_slots[j].channels,
+			                                          compression, local::material_texture_slots[j].content,
+			                                          bonobo::getTextureStreamingOptions().enabled);
+			auto const job_index = job_indices.find(key);
+			if (job_index != job_indices.end()) {
+				uses.push_back({ i, j, job_index->second, false });
+				continue;
+			}
+
+			texture_job job;
+			job.key = key;
+			job.path = path;
+			job.id = bonobo::texture_registry::acquire(key);
+			job.was_registered = job.id != 0u;
+			job_indices.emplace(std::move(key), jobs.size());
+			uses.push_back({ i, j, jobs.size(), true });
+			jobs.push_back(std::move(job));
+		}
+	}
+
+	return are_materials_used;
+}
+
+// Upload the decoded image of |job| and add it to the texture registry;
+// streamed textures only get their smallest levels uploaded.
+static void
+uploadTextureJob(texture_job& job, bonobo::texture_registry::decoded_image image)
+{
+	job.decode_duration_ms = image.decode_duration_ms;
+
+	auto const upload_start_time = std::chrono::high_resolution_clock::now();
+	if (job.key.is_streamed && bonobo::texture_streaming::isStreamable(image)) {
+		job.was_compressed = image.compressed.format != 0u;
+		job.was_cached = image.is_cached;
+		job.internal_format = job.was_compressed ? image.compressed.format
+		                                         : bonobo::texture_registry::getUncompressedInternalFormat(image.levels.front().channels_nb);
+		job.id = bonobo::texture_streaming::createTexture(job.key, std::move(image), job.bytes);
+	} else {
+		job.id = bonobo::texture_registry::uploadDecodedImage(image, true);
+		if (job.id == 0u)
+			return;
+		if (image.compressed.format != 0u) {
+			job.internal_format = image.compressed.format;
+			job.bytes = bonobo::texture_compression::getSize(image.compressed);
+			job.was_compressed = true;
+			job.was_cached = image.is_cached;
+			bonobo::texture_registry::add(job.key, job.id, job.bytes, bonobo::texture_compression::getUncompressedSize(image.compressed));
+		} else {
+			job.internal_format = bonobo::texture_registry::getUncompressedInternalFormat(image.levels.front().channels_nb);
+			job.bytes = bonobo::mipmaps::getSize(image.levels);
+			bonobo::texture_registry::add(job.key, job.id, job.bytes, job.bytes);
+		}
+	}
+
+	auto const upload_end_time = std::chrono::high_resolution_clock::now();
+	job.upload_duration_ms = std::chrono::duration<float, std::milli>(upload_end_time - upload_start_time).count();
+}
+
+// All meshes are sub-allocated from a single geometry arena, so that they
+// can be drawn without switching vertex arrays. The arena holds every
+// attribute found in any of the meshes.
+//
+// Indices are relative to the base vertex of each mesh, so each mesh uses
+// the smallest index type it can; each range of indices is aligned on the
+// size of its type.
+static GLsizeiptr
+alignIndices(GLsizeiptr offset, std::size_t index_size)
+{
+	return static_cast<GLsizeiptr>((static_cast<std::size_t>(offset) + index_size - 1u) / index_size * index_size);
+}
+
+// Allocate a geometry arena large enough for all meshes of |scene|, without
+// filling it. The vertex array is left bound, as well as the buffer object
+// to GL_ARRAY_BUFFER.
+static geometry_arena
+createGeometryArena(bonobo::scene_description const& scene, bonobo::vertex_layout_options const& vertex_layout,
+                    std::string const& name)
+{
+	geometry_arena arena;
+	bonobo::mesh_streams arena_streams;
+	for (auto const& mesh : scene.meshes) {
+		arena_streams.vertices_nb += mesh.vertices_nb;
+		if (mesh.indices != nullptr) {
+			auto const index_type = bonobo::getIndexType(mesh.vertices_nb);
+			auto const index_size = bonobo::getIndexSize(index_type);
+			arena.indices_size = alignIndices(arena.indices_size, index_size)
+			                   + static_cast<GLsizeiptr>(mesh.indices_nb * index_size);
+			arena.indices_nb += mesh.indices_nb;
+			if (index_type == GL_UNSIGNED_SHORT)
+				arena.short_indices_nb += mesh.indices_nb;
+		}
+		if (arena_streams.vertices == nullptr)  arena_streams.vertices  = mesh.vertices;
+		if (arena_streams.normals == nullptr)   arena_streams.normals   = mesh.normals;
+		if (arena_streams.texcoords == nullptr) arena_streams.texcoords = mesh.texcoords;
+		if (arena_streams.tangents == nullptr || arena_streams.binormals == nullptr) {
+			arena_streams.tangents  = mesh.tangents;
+			arena_streams.binormals = mesh.binormals;
+		}
+	}
+	arena.vertices_nb = arena_streams.vertices_nb;
+	arena.layout = bonobo::describeVertexLayout(vertex_layout, arena_streams);
+
+	glGenVertexArrays(1, &arena.vao);
+	assert(arena.vao != 0u);
+	glBindVertexArray(arena.vao);
+
+	glGenBuffers(1, &arena.bo);
+	assert(arena.bo != 0u);
+	glBindBuffer(GL_ARRAY_BUFFER, arena.bo);
+	glBufferData(GL_ARRAY_BUFFER, arena.layout.buffer_size, nullptr, GL_STATIC_DRAW);
+	bonobo::setupVertexAttributes(arena.layout);
+
+	glGenBuffers(1, &arena.ibo);
+	assert(arena.ibo != 0u);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, arena.indices_size, nullptr, GL_STATIC_DRAW);
+
+	utils::opengl::debug::nameObject(GL_VERTEX_ARRAY, arena.vao, name + " VAO");
+	utils::opengl::debug::nameObject(GL_BUFFER, arena.bo, name + " VBO");
+	utils::opengl::debug::nameObject(GL_BUFFER, arena.ibo, name + " IBO");
+
+	return arena;
+}
+
+// Store |mesh| after the meshes previously appended to |arena|; its vertex
+// array has to be bound, as well as its buffer object to GL_ARRAY_BUFFER.
+// Textures and material constants are left for the caller to fill in.
+static bonobo::mesh_data
+appendToGeometryArena(geometry_arena& arena, bonobo::mesh_streams const& mesh, std::vector<std::uint8_t>& packed_indices)
+{
+	bonobo::mesh_data object;
+	object.name = mesh.name;
+	object.drawing_mode = mesh.drawing_mode;
+	object.vao = arena.vao;
+	object.bo = arena.bo;
+	object.ibo = mesh.indices != nullptr ? arena.ibo : 0u;
+	object.vertices_nb = static_cast<GLsizei>(mesh.vertices_nb);
+	object.indices_nb = mesh.indices != nullptr ? static_cast<GLsizei>(mesh.indices_nb) : 0;
+	object.base_vertex = arena.base_vertex;
+	object.encoding = bonobo::getVertexEncoding(arena.layout, mesh);
+	bonobo::computeMeshBounds(mesh, object);
+
+	bonobo::updateVertices(arena.layout, mesh, arena.base_vertex);
+	if (mesh.indices != nullptr) {
+		object.index_type = bonobo::getIndexType(mesh.vertices_nb);
+		auto const index_size = bonobo::getIndexSize(object.index_type);
+		arena.indices_offset = alignIndices(arena.indices_offset, index_size);
+		object.first_index = static_cast<GLsizei>(static_cast<std::size_t>(arena.indices_offset) / index_size);
+
+		packed_indices.resize(mesh.indices_nb * index_size);
+		bonobo::packIndices(mesh.indices, mesh.indices_nb, object.index_type, packed_indices.data());
+		bonobo::uploads::uploadBufferData(GL_ELEMENT_ARRAY_BUFFER, arena.indices_offset,
+		                                static_cast<GLsizeiptr>(packed_indices.size()), reinterpret_cast<GLvoid const*>(packed_indices.data()));
+		arena.indices_offset += static_cast<GLsizeiptr>(packed_indices.size());
+	}
+	arena.base_vertex += object.vertices_nb;
+
+	return object;
+}
+
+static void
+logGeometryArena(geometry_arena const& arena)
+{
+	LogTrivia("│ Geometry arena: %u vertices (%s, %d bytes per vertex) and %u indices (%u on 16 bits), using %.3f MiB",
+	          arena.vertices_nb,
+	          arena.layout.layout == bonobo::vertex_layout_t::interleaved ? "interleaved" : "planar", arena.layout.vertex_size,
+	          arena.indices_nb, arena.short_indices_nb,
+	          static_cast<float>(arena.layout.buffer_size + arena.indices_size) / (1024.0f * 1024.0f));
+}
+
+// Log the uploads done since |start| was retrieved.
+static void
+logUploadStats(bonobo::upload_stats const& start)
+{
+	auto const end = bonobo::getUploadStats();
+	auto const bytes_staged = end.bytes_staged - start.bytes_staged;
+	auto const bytes_direct = end.bytes_direct - start.bytes_direct;
+	LogTrivia("│ Uploads: %.3f MiB from the staging ring at %.1f MB/s (%u did not fit), %.3f MiB from client memory at %.1f MB/s; waited %.3f ms on the GPU %u times",
+	          static_cast<float>(bytes_staged) / (1024.0f * 1024.0f),
+	          bonobo::uploads::getThroughput(bytes_staged, end.staged_duration_ms - start.staged_duration_ms),
+	          end.staging_failures_nb - start.staging_failures_nb,
+	          static_cast<float>(bytes_direct) / (1024.0f * 1024.0f),
+	          bonobo::uploads::getThroughput(bytes_direct, end.direct_duration_ms - start.direct_duration_ms),
+	          end.stall_duration_ms - start.stall_duration_ms, end.stalls_nb - start.stalls_nb);
+}
+
+std::vector<bonobo::mesh_data>
+bonobo::loadObjects(std::string const& filename, vertex_layout_options const& vertex_layout,
+                    mesh_processing_options const& processing, bool compress_textures)
+{
+	auto const scene_start_time = std::chrono::high_resolution_clock::now();
+	auto const upload_stats_at_start = getUploadStats();
+
+	std::vector<bonobo::mesh_data> objects;
+
+	auto const end_of_basedir = filename.rfind("/");
+	auto const parent_folder = (end_of_basedir != std::string::npos ? filename.substr(0, end_of_basedir) : ".") + "/";
+
+	LogInfo("┭ Loading \"%s\"…", filename.c_str());
+
+	// The importer owns the geometry referenced by `scene` after an import,
+	// so it has to outlive the upload to the GPU.
+	Assimp::Importer importer;
+	bonobo::scene_description scene;
+	if (!scene_loader::readScene(importer, filename, processing, scene))
+		return objects;
+
+	// Images are decoded concurrently on worker threads, while this thread,
+	// which owns the OpenGL context, uploads them in turn once decoded.
+	// Each image is only loaded once, even if used by several materials, and
+	// images already present in the texture registry are not loaded at all.
+	auto const materials_start_time = std::chrono::high_resolution_clock::now();
+	auto const registry_bytes_saved_at_start = bonobo::getTextureRegistryStats().bytes_saved;
+	std::vector<texture_job> texture_jobs;
+	std::vector<texture_use> texture_uses;
+	auto const are_materials_used = collectTextureJobs(scene, parent_folder, compress_textures, texture_jobs, texture_uses);
+
+	std::size_t decoding_threads_nb = 0u;
+	std::vector<texture_job*> pending_jobs;
+	for (auto& job : texture_jobs)
+		if (!job.was_registered)
+			pending_jobs.push_back(&job);
+	if (!pending_jobs.empty()) {
+		ThreadPool decoders(std::min<std::size_t>(std::max(std::thread::hardware_concurrency(), 1u), pending_jobs.size()));
+		decoding_threads_nb = decoders.GetThreadsNb();
+		// Images are already spread over the workers, so each one is
+		// filtered and compressed on the worker decoding it.
+		for (auto job : pending_jobs) {
+			auto const texture_path = parent_folder + job->path;
+			auto const key = job->key;
+			auto const staging = bonobo::texture_registry::getDecodingStaging(key);
+			job->decoding = decoders.Enqueue([texture_path, key, staging](){ return bonobo::texture_registry::decodeImage(texture_path, key, nullptr, staging); });
+		}
+
+		// Images are uploaded in submission order, blocking on each until
+		// it is decoded; later ones keep decoding in the meantime.
+		for (auto job : pending_jobs)
+			uploadTextureJob(*job, job->decoding.get());
+	}
+
+	std::vector<std::array<GLuint, bonobo::material_texture_slots_nb>> materials_textures(scene.materials.size());
+	uint32_t texture_count = 0u;
+	uint32_t shared_texture_count = 0u;
+	std::uint64_t compression_bytes_saved = 0u;
+	std::uint64_t texture_bytes = 0u;
+	for (auto const& job : texture_jobs) {
+		if (job.id == 0u || job.was_registered)
+			continue;
+		auto const& entry = bonobo::texture_registry::get(job.key);
+		compression_bytes_saved += entry.uncompressed_bytes - entry.bytes;
+		texture_bytes += entry.bytes;
+	}
+	for (auto const& use : texture_uses) {
+		auto const& job = texture_jobs[use.job_index];
+		auto const& slot = local::material_texture_slots[use.slot_index];
+		auto const& material = scene.materials[use.material_index];
+		if (job.id == 0u) {
+			LogWarning("Failed to load the %s texture for material \"%s\".", slot.type_as_str, material.name.c_str());
+			continue;
+		}
+
+		// Each use holds its own reference; the one for the first use was
+		// taken when loading the texture or finding it in the registry.
+		if (!use.is_first_use)
+			bonobo::texture_registry::acquire(job.key);
+		if (!use.is_first_use || job.was_registered)
+			++shared_texture_count;
+		else
+			utils::opengl::debug::nameObject(GL_TEXTURE, job.id, material.name + " " + slot.type_as_str);
+
+		materials_textures[use.material_index][use.slot_index] = job.id;
+		++texture_count;
+	}
+
+	// Report per material rather than in completion order, so that the
+	// textures of a material are grouped together.
+	for (size_t i = 0; i < scene.materials.size(); ++i) {
+		if (!are_materials_used[i])
+			continue;
+
+		float material_decode_duration_ms = 0.0f;
+		float material_upload_duration_ms = 0.0f;
+		bool is_first_texture = true;
+		for (auto const& use : texture_uses) {
+			auto const& job = texture_jobs[use.job_index];
+			if (use.material_index != i || job.id == 0u)
+				continue;
+
+			if (!use.is_first_use || job.was_registered) {
+				LogTrivia("│ %s Texture \"%s\" shared with a previously loaded one",
+				          is_first_texture ? "┌" : "├", job.path.c_str());
+			} else {
+				LogTrivia("│ %s Texture \"%s\" %s as %s in %.3f ms and uploaded in %.3f ms, using %.3f MiB",
+				          is_first_texture ? "┌" : "├", job.path.c_str(),
+				          job.was_cached ? "retrieved from cache" : (job.was_compressed ? "decoded and compressed" : "decoded"),
+				          bonobo::texture_registry::getInternalFormatName(job.internal_format),
+				          job.decode_duration_ms, job.upload_duration_ms,
+				          static_cast<float>(job.bytes) / (1024.0f * 1024.0f));
+				material_decode_duration_ms += job.decode_duration_ms;
+				material_upload_duration_ms += job.upload_duration_ms;
+			}
+			is_first_texture = false;
+		}
+
+		auto const& textures = materials_textures[i];
+		LogTrivia("│ %s Material \"%s\" loaded: textures decoded in %.3f ms and uploaded in %.3f ms",
+		          std::all_of(textures.begin(), textures.end(), [](GLuint texture){ return texture == 0u; }) ? "╺" : "┕",
+		          scene.materials[i].name.c_str(),
+		          material_decode_duration_ms, material_upload_duration_ms);
+	}
+	auto const registry_bytes_saved = bonobo::getTextureRegistryStats().bytes_saved - registry_bytes_saved_at_start;
+
+	// The materials take over the references held on their textures.
+	std::vector<bonobo::material_id> material_ids(scene.materials.size(), bonobo::invalid_material_id);
+	for (size_t i = 0; i < scene.materials.size(); ++i)
+		if (are_materials_used[i])
+			material_ids[i] = bonobo::createMaterial(scene.materials[i].name, scene.materials[i].constants, materials_textures[i]);
+	auto const materials_end_time = std::chrono::high_resolution_clock::now();
+
+	auto const meshes_start_time = std::chrono::high_resolution_clock::now();
+
+	auto arena = createGeometryArena(scene, vertex_layout,
+	                                 filename.substr(end_of_basedir != std::string::npos ? end_of_basedir + 1u : 0u));
+
+	std::vector<std::uint8_t> packed_indices;
+	objects.reserve(scene.meshes.size());
+	for (size_t j = 0; j < scene.meshes.size(); ++j) {
+		auto const mesh_start_time = std::chrono::high_resolution_clock::now();
+
+		auto const& mesh = scene.meshes[j];
+
+		auto object = appendToGeometryArena(arena, mesh, packed_indices);
+		if (mesh.material_index < material_ids.size()) {
+			// Each mesh holds its own reference, so that it can be
+			// released independently by `unloadObjects()`.
+			object.material = material_ids[mesh.material_index];
+			bonobo::retainMaterial(object.material);
+		}
+
+		objects.push_back(object);
+
+		auto const mesh_end_time = std::chrono::high_resolution_clock::now();
+
+		auto const has_attribute = [&arena](bonobo::shader_bindings binding, float const* stream){
+			return stream != nullptr
+			    && std::any_of(arena.layout.attributes.begin(), arena.layout.attributes.end(),
+			                   [binding](bonobo::vertex_attribute_description const& attribute){ return attribute.binding == binding; });
+		};
+		std::string attributes = has_attribute(bonobo::shader_bindings::normals, mesh.normals) ? "normals" : "";
+		if (!attributes.empty())
+		  attributes += " | ";
+		if (has_attribute(bonobo::shader_bindings::tangents, mesh.tangents))
+		  attributes += "tangents&bitangents";
+		if (!attributes.empty())
+		  attributes += " | ";
+		if (has_attribute(bonobo::shader_bindings::texcoords, mesh.texcoords))
+		  attributes += "texture coordinates";
+		LogTrivia("│ %s Mesh \"%s\" loaded with attributes [%s] in %.3f ms",
+		          (scene.meshes.size() == 1u) ? "╶" : (j == 0 ? "┌" : (j == scene.meshes.size() - 1 ? "└" : "├")),
+		          mesh.name.c_str(), attributes.c_str(),
+		          std::chrono::duration<float, std::milli>(mesh_end_time - mesh_start_time).count());
+	}
+	glBindVertexArray(0u);
+	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+
+	logGeometryArena(arena);
+	auto const meshes_end_time = std::chrono::high_resolution_clock::now();
+
+	// The meshes now hold their own references to the materials.
+	for (auto const id : material_ids)
+		bonobo::releaseMaterial(id);
+
+	logUploadStats(upload_stats_at_start);
+	auto const scene_end_time = std::chrono::high_resolution_clock::now();
+	LogInfo("┕ Scene loaded in %.3f s: %u textures loaded in %.3f s (decoded on %zu threads; using %.3f MiB; %u shared, saving %.3f MiB; compression saving %.3f MiB) and %zu meshes in %.3f s",
+	        std::chrono::duration<float>(scene_end_time - scene_start_time).count(),
+	        texture_count,
+	        std::chrono::duration<float>(materials_end_time - materials_start_time).count(),
+	        decoding_threads_nb,
+	        static_cast<float>(texture_bytes) / (1024.0f * 1024.0f),
+	        shared_texture_count,
+	        static_cast<float>(registry_bytes_saved) / (1024.0f * 1024.0f),
+	        static_cast<float>(compression_bytes_saved) / (1024.0f * 1024.0f),
+	        objects.size(),
+	        std::chrono::duration<float>(meshes_end_time - meshes_start_time).count());
+
+	return objects;
+}
+
+void
+bonobo::unloadObjects(std::vector<mesh_data>& objects)
+{
+	// Meshes coming from the same file share their vertex array and buffer
+	// objects.
+	std::unordered_set<GLuint> vertex_arrays, buffers;
+	for (auto& object : objects) {
+		bonobo::releaseMaterial(object.material);
+
+		vertex_arrays.insert(object.vao);
+		buffers.insert(object.bo);
+		buffers.insert(object.ibo);
+	}
+	for (auto const vertex_array : vertex_arrays)
+		glDeleteVertexArrays(1, &vertex_array);
+	for (auto const buffer : buffers)
+		glDeleteBuffers(1, &buffer);
+	objects.clear();
+}
+
+bonobo::scene_import_stats
+bonobo::benchmarkSceneImport(std::string const& filename, scene_importer_t importer)
+{
+	scene_import_stats stats;
+
+	// The streams may point into data owned by assimp, so they are counted
+	// before the importer goes away.
+	{
+		bonobo::scene_description scene;
+		Assimp::Importer assimp_importer;
+		auto const start_time = std::chrono::high_resolution_clock::now();
+		if (importer == scene_importer_t::native_obj) {
+			ThreadPool parsers;
+			stats.is_successful = bonobo::obj_loader::load(filename, scene, &parsers);
+		} else {
+			stats.is_successful = importScene(assimp_importer, filename, scene);
+		}
+		auto const end_time = std::chrono::high_resolution_clock::now();
+		stats.duration_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+
+		stats.meshes_nb = scene.meshes.size();
+		for (auto const& mesh : scene.meshes) {
+			stats.vertices_nb += mesh.vertices_nb;
+			stats.indices_nb += mesh.indices_nb;
+		}
+	}
+
+	return stats;
+}
+
+struct bonobo::async_objects {
+	~async_objects();
+
+	std::string filename;
+	std::string parent_folder;
+	vertex_layout_options vertex_layout;
+	bool compress_textures{ false };
+	std::chrono::high_resolution_clock::time_point start_time;
+	std::chrono::high_resolution_clock::time_point end_time;
+	std::uint32_t frames_nb{ 0u };
+	std::uint64_t bytes_uploaded{ 0u };
+	upload_stats upload_stats_at_start;
+
+	// The importer owns the geometry referenced by `scene` after an import,
+	// so it has to outlive the upload to the GPU.
+	Assimp::Importer importer;
+	scene_description scene;
+	std::future<bool> reading;
+	bool is_geometry_read{ false };
+	bool is_complete{ false };
+	bool has_failed{ false };
+
+	geometry_arena arena;
+	std::vector<mesh_data> meshes;
+	std::vector<std::uint8_t> packed_indices;
+
+	// Each job holds one reference to its texture, and each material one
+	// per texture other than the placeholder. The meshes share the
+	// references held on the materials here.
+	std::vector<texture_job> texture_jobs;
+	std::vector<texture_use> texture_uses;
+	std::vector<material_id> material_ids;
+
+	// Set when the objects get destroyed, so that queued jobs return
+	// without doing any work rather than delaying the destruction.
+	std::atomic<bool> is_cancelled{ false };
+
+	// Declared last, so that the workers are stopped before anything they
+	// might still access gets destroyed.
+	std::unique_ptr<ThreadPool> workers;
+};
+
+bonobo::async_objects::~async_objects()
+{
+	// Images decoded but not uploaded yet still hold staging memory.
+	is_cancelled = true;
+	workers.reset();
+	for (auto& job : texture_jobs)
+		if (job.decoding.valid())
+			bonobo::texture_registry::releaseDecodedImage(job.decoding.get());
+
+	for (auto const id : material_ids)
+		bonobo::releaseMaterial(id);
+	for (auto const& job : texture_jobs)
+		if (job.id != 0u)
+			bonobo::releaseTexture(job.id);
+
+	glDeleteVertexArrays(1, &arena.vao);
+	glDeleteBuffers(1, &arena.bo);
+	glDeleteBuffers(1, &arena.ibo);
+}
+
+std::shared_ptr<bonobo::async_objects>
+bonobo::loadObjectsAsync(std::string const& filename, vertex_layout_options const& vertex_layout,
+                         mesh_processing_options const& processing, bool compress_textures)
+{
+	auto objects = std::make_shared<async_objects>();
+	objects->filename = filename;
+	auto const end_of_basedir = filename.rfind("/");
+	objects->parent_folder = (end_of_basedir != std::string::npos ? filename.substr(0, end_of_basedir) : ".") + "/";
+	objects->vertex_layout = vertex_layout;
+	objects->compress_textures = compress_textures;
+	objects->start_time = std::chrono::high_resolution_clock::now();
+	objects->upload_stats_at_start = getUploadStats();
+
+	LogInfo("┭ Streaming \"%s\"…", filename.c_str());
+
+	// The same workers read the geometry then decode the images; the
+	// geometry is needed to know which images to decode.
+	objects->workers = std::make_unique<ThreadPool>();
+	auto const raw_objects = objects.get();
+	objects->reading = objects->workers->Enqueue([raw_objects, filename, processing](){
+		if (raw_objects->is_cancelled)
+			return false;
+		return scene_loader::readScene(raw_objects->importer, filename, processing, raw_objects->scene);
+	});
+
+	return objects;
+}
+
+bool
+bonobo::updateObjectsAsync(async_objects& objects, upload_budget const& budget)
+{
+	if (objects.is_complete || objects.has_failed)
+		return false;
+
+	auto const start_time = std::chrono::high_resolution_clock::now();
+
+	if (!objects.is_geometry_read) {
+		if (objects.reading.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+		if (!objects.reading.get()) {
+			objects.has_failed = true;
+			objects.end_time = start_time;
+			LogError("┕ Failed to stream \"%s\"", objects.filename.c_str());
+			return false;
+		}
+		objects.is_geometry_read = true;
+
+		auto const are_materials_used = collectTextureJobs(objects.scene, objects.parent_folder, objects.compress_textures,
+		                                                   objects.texture_jobs, objects.texture_uses);
+
+		// Textures still being decoded are replaced by the debug texture,
+		// so that meshes can be drawn right away.
+		objects.material_ids.resize(objects.scene.materials.size(), invalid_material_id);
+		for (std::size_t i = 0u; i < objects.scene.materials.size(); ++i) {
+			if (!are_materials_used[i])
+				continue;
+
+			std::array<GLuint, material_texture_slots_nb> textures{};
+			for (auto const& use : objects.texture_uses) {
+				if (use.material_index != i)
+					continue;
+
+				auto const& job = objects.texture_jobs[use.job_index];
+				if (job.id != 0u) {
+					textures[use.slot_index] = job.id;
+					bonobo::texture_registry::retain(job.id);
+				} else {
+					textures[use.slot_index] = getDebugTextureID();
+				}
+			}
+			objects.material_ids[i] = createMaterial(objects.scene.materials[i].name, objects.scene.materials[i].constants, textures);
+		}
+		for (auto& job : objects.texture_jobs) {
+			if (job.was_registered)
+				continue;
+
+			auto const texture_path = objects.parent_folder + job.path;
+			auto const key = job.key;
+			auto const staging = bonobo::texture_registry::getDecodingStaging(key);
+			auto const is_cancelled = &objects.is_cancelled;
+			job.decoding = objects.workers->Enqueue([texture_path, key, staging, is_cancelled](){
+				if (*is_cancelled)
+					return bonobo::texture_registry::decoded_image();
+				return bonobo::texture_registry::decodeImage(texture_path, key, nullptr, staging);
+			});
+		}
+
+		auto const end_of_basedir = objects.filename.rfind("/");
+		objects.arena = createGeometryArena(objects.scene, objects.vertex_layout,
+		                                    objects.filename.substr(end_of_basedir != std::string::npos ? end_of_basedir + 1u : 0u));
+		glBindVertexArray(0u);
+		glBindBuffer(GL_ARRAY_BUFFER, 0u);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+		logGeometryArena(objects.arena);
+		objects.meshes.reserve(objects.scene.meshes.size());
+	}
+
+	std::uint64_t bytes_uploaded = 0u;
+	bool has_changed = false;
+	auto const is_budget_exhausted = [&](){
+		auto const elapsed_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+		return has_changed && (bytes_uploaded >= budget.bytes || elapsed_ms >= budget.duration_ms);
+	};
+
+	if (objects.meshes.size() < objects.scene.meshes.size()) {
+		glBindVertexArray(objects.arena.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, objects.arena.bo);
+		while (objects.meshes.size() < objects.scene.meshes.size() && !is_budget_exhausted()) {
+			auto const& mesh = objects.scene.meshes[objects.meshes.size()];
+			auto object = appendToGeometryArena(objects.arena, mesh, objects.packed_indices);
+			if (mesh.material_index < objects.material_ids.size())
+				object.material = objects.material_ids[mesh.material_index];
+
+			bytes_uploaded += static_cast<std::uint64_t>(mesh.vertices_nb) * objects.arena.layout.vertex_size
+			                + objects.packed_indices.size();
+			objects.meshes.push_back(object);
+			has_changed = true;
+		}
+		glBindVertexArray(0u);
+		glBindBuffer(GL_ARRAY_BUFFER, 0u);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+	}
+
+	bool are_textures_pending = false;
+	for (std::size_t i = 0u; i < objects.texture_jobs.size(); ++i) {
+		auto& job = objects.texture_jobs[i];
+		if (!job.decoding.valid())
+			continue;
+		if (is_budget_exhausted() || job.decoding.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			are_textures_pending = true;
+			continue;
+		}
+
+		uploadTextureJob(job, job.decoding.get());
+		bytes_uploaded += job.bytes;
+		has_changed = true;
+
+		for (auto const& use : objects.texture_uses) {
+			if (use.job_index != i)
+				continue;
+
+			auto const& slot = local::material_texture_slots[use.slot_index];
+			auto const& material = objects.scene.materials[use.material_index];
+			if (job.id == 0u)
+				LogWarning("Failed to load the %s texture for material \"%s\".", slot.type_as_str, material.name.c_str());
+			else if (use.is_first_use)
+				utils::opengl::debug::nameObject(GL_TEXTURE, job.id, material.name + " " + slot.type_as_str);
+
+			// All meshes using the material see the new texture.
+			if (job.id != 0u)
+				bonobo::texture_registry::retain(job.id);
+			setMaterialTexture(objects.material_ids[use.material_index],
+			                   static_cast<material_texture_slot_t>(use.slot_index), job.id);
+		}
+	}
+
+	if (has_changed) {
+		++objects.frames_nb;
+		objects.bytes_uploaded += bytes_uploaded;
+	}
+
+	if (!are_textures_pending && objects.meshes.size() == objects.scene.meshes.size()) {
+		objects.is_complete = true;
+		objects.end_time = std::chrono::high_resolution_clock::now();
+		std::uint64_t texture_bytes = 0u;
+		for (auto const& job : objects.texture_jobs)
+			texture_bytes += job.bytes;
+		logUploadStats(objects.upload_stats_at_start);
+		LogInfo("┕ Scene streamed in %.3f s over %u frames: %zu textures using %.3f MiB and %zu meshes, %.3f MiB uploaded",
+		        std::chrono::duration<float>(objects.end_time - objects.start_time).count(),
+		        objects.frames_nb, objects.texture_jobs.size(),
+		        static_cast<float>(texture_bytes) / (1024.0f * 1024.0f), objects.meshes.size(),
+		        static_cast<float>(objects.bytes_uploaded) / (1024.0f * 1024.0f));
+	}
+
+	return has_changed;
+}
+
+std::vector<bonobo::mesh_data> const&
+bonobo::getObjectsAsync(async_objects const& objects)
+{
+	return objects.meshes;
+}
+
+bonobo::async_objects_progress
+bonobo::getObjectsAsyncProgress(async_objects const& objects)
+{
+	async_objects_progress progress;
+	progress.is_geometry_read = objects.is_geometry_read;
+	progress.is_complete = objects.is_complete;
+	progress.has_failed = objects.has_failed;
+	// The scene is written by a worker thread until it is read.
+	progress.meshes_nb = objects.is_geometry_read ? objects.scene.meshes.size() : 0u;
+	progress.meshes_uploaded_nb = objects.meshes.size();
+	progress.textures_nb = objects.texture_jobs.size();
+	for (auto const& job : objects.texture_jobs) {
+		if (!job.decoding.valid()) {
+			++progress.textures_decoded_nb;
+			++progress.textures_uploaded_nb;
+		} else if (job.decoding.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			++progress.textures_decoded_nb;
+		}
+	}
+	progress.bytes_uploaded = objects.bytes_uploaded;
+	progress.frames_nb = objects.frames_nb;
+	auto const end_time = (objects.is_complete || objects.has_failed) ? objects.end_time : std::chrono::high_resolution_clock::now();
+	progress.elapsed_s = std::chrono::duration<float>(end_time - objects.start_time).count();
+
+	return progress;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <string>
+
+namespace Assimp
+{
+	class Importer;
+}
+
+//! \brief Loading of objects/scenes, either all at once or streamed over
+//!        several frames; the public side is `bonobo::loadObjects()` and
+//!        the functions following it.
+//!
+//! The geometry is read from the scene cache when up-to-date, and
+//! otherwise imported, by the native OBJ loader or assimp, then processed
+//! and cached. Meshes get sub-allocated from a single geometry arena, and
+//! their images are decoded on worker threads and shared through the
+//! texture registry.
+namespace bonobo
+{
+namespace scene_loader
+{
+	//! \brief Retrieve the meshes and materials of a file, either from its
+	//!        scene cache or by importing it and processing its meshes; the
+	//!        latter case refreshes the cache.
+	//!
+	//! This makes no OpenGL call, so that it can be run from a worker
+	//! thread.
+	//!
+	//! @param [in] importer owns the geometry referenced by |scene| when
+	//!             imported through assimp, so it has to outlive |scene|
+	//! @param [in] filename of the object/scene
+	//! @param [in] processing to run on the meshes when importing them
+	//! @param [out] scene the meshes and materials read
+	//! @return whether the file could be read
+	bool readScene(Assimp::Importer& importer, std::string const& filename,
+	               mesh_processing_options const& processing, scene_description& scene);
+}
+}
@@ -0,0 +1,486 @@
+#include "texture_compression.hpp"
+
+#include "core/Log.h"
+#include "core/mipmaps.hpp"
+#include "core/ThreadPool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <future>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// From the EXT_texture_compression_s3tc extension, which GLAD was not
+	// generated with.
+	constexpr GLenum compressed_rgb_s3tc_dxt1 = 0x83F0;
+	constexpr GLenum compressed_rgba_s3tc_dxt5 = 0x83F3;
+
+	using texel = std::array<std::uint8_t, 4>;
+	using block_texels = std::array<texel, 16>;
+
+	std::size_t getBlockSize(GLenum format)
+	{
+		return (format == compressed_rgb_s3tc_dxt1 || format == GL_COMPRESSED_RED_RGTC1) ? 8u : 16u;
+	}
+
+	void writeUint16(std::uint8_t* destination, std::uint32_t value)
+	{
+		destination[0] = static_cast<std::uint8_t>(value & 0xffu);
+		destination[1] = static_cast<std::uint8_t>((value >> 8) & 0xffu);
+	}
+
+	std::uint32_t toRGB565(int r, int g, int b)
+	{
+		return static_cast<std::uint32_t>(((r * 31 + 127) / 255) << 11
+		                                | ((g * 63 + 127) / 255) << 5
+		                                | ((b * 31 + 127) / 255));
+	}
+
+	std::array<int, 3> fromRGB565(std::uint32_t colour)
+	{
+		auto const r = static_cast<int>((colour >> 11) & 0x1fu);
+		auto const g = static_cast<int>((colour >> 5) & 0x3fu);
+		auto const b = static_cast<int>(colour & 0x1fu);
+		return { { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) } };
+	}
+
+	// Encode the RGB channels of a block as BC1, always in its four-colour
+	// mode so that the result is also valid as the colour part of BC3.
+	void encodeBC1(block_texels const& texels, std::uint8_t* destination)
+	{
+		std::array<int, 3> min_colour{ { 255, 255, 255 } }, max_colour{ { 0, 0, 0 } };
+		for (auto const& texel : texels)
+			for (std::size_t c = 0u; c < 3u; ++c) {
+				min_colour[c] = std::min(min_colour[c], static_cast<int>(texel[c]));
+				max_colour[c] = std::max(max_colour[c], static_cast<int>(texel[c]));
+			}
+
+		// The bounding box has four diagonals; pick the one along which the
+		// colours vary, by checking how the other channels correlate with
+		// the one covering the largest range.
+		std::size_t main_channel = 0u;
+		for (std::size_t c = 1u; c < 3u; ++c)
+			if (max_colour[c] - min_colour[c] > max_colour[main_channel] - min_colour[main_channel])
+				main_channel = c;
+		for (std::size_t c = 0u; c < 3u; ++c) {
+			if (c == main_channel)
+				continue;
+
+			int covariance = 0;
+			for (auto const& texel : texels)
+				covariance += (2 * texel[main_channel] - min_colour[main_channel] - max_colour[main_channel])
+				            * (2 * texel[c] - min_colour[c] - max_colour[c]);
+			if (covariance < 0)
+				std::swap(min_colour[c], max_colour[c]);
+		}
+
+		// Inset the bounding box slightly, as the extremes are rarely worth
+		// spending an endpoint on.
+		for (std::size_t c = 0u; c < 3u; ++c) {
+			auto const inset = (max_colour[c] - min_colour[c]) / 16;
+			max_colour[c] -= inset;
+			min_colour[c] += inset;
+		}
+
+		auto colour0 = toRGB565(max_colour[0], max_colour[1], max_colour[2]);
+		auto colour1 = toRGB565(min_colour[0], min_colour[1], min_colour[2]);
+		if (colour0 < colour1)
+			std::swap(colour0, colour1);
+		writeUint16(destination + 0, colour0);
+		writeUint16(destination + 2, colour1);
+
+		// With equal endpoints the block would be in three-colour mode, but
+		// all texels then use the first endpoint anyway.
+		std::uint32_t indices = 0u;
+		if (colour0 != colour1) {
+			auto const endpoint0 = fromRGB565(colour0);
+			auto const endpoint1 = fromRGB565(colour1);
+			std::array<std::array<int, 3>, 4> palette;
+			for (std::size_t c = 0u; c < 3u; ++c) {
+				palette[0][c] = endpoint0[c];
+				palette[1][c] = endpoint1[c];
+				palette[2][c] = (2 * endpoint0[c] + endpoint1[c]) / 3;
+				palette[3][c] = (endpoint0[c] + 2 * endpoint1[c]) / 3;
+			}
+
+			for (std::size_t i = 0u; i < texels.size(); ++i) {
+				std::uint32_t best_index = 0u;
+				int best_distance = std::numeric_limits<int>::max();
+				for (std::uint32_t j = 0u; j < 4u; ++j) {
+					int distance = 0;
+					for (std::size_t c = 0u; c < 3u; ++c) {
+						auto const difference = static_cast<int>(texels[i][c]) - palette[j][c];
+						distance += difference * difference;
+					}
+					if (distance < best_distance) {
+						best_distance = distance;
+						best_index = j;
+					}
+				}
+				indices |= best_index << (2u * i);
+			}
+		}
+		for (std::size_t i = 0u; i < 4u; ++i)
+			destination[4u + i] = static_cast<std::uint8_t>((indices >> (8u * i)) & 0xffu);
+	}
+
+	// Encode one channel of a block as BC4, in its eight-value mode.
+	void encodeBC4(block_texels const& texels, std::size_t channel, std::uint8_t* destination)
+	{
+		int min_value = 255, max_value = 0;
+		for (auto const& texel : texels) {
+			min_value = std::min(min_value, static_cast<int>(texel[channel]));
+			max_value = std::max(max_value, static_cast<int>(texel[channel]));
+		}
+		destination[0] = static_cast<std::uint8_t>(max_value);
+		destination[1] = static_cast<std::uint8_t>(min_value);
+
+		// Codes 0 and 1 are the endpoints, and 2 to 7 the values in between,
+		// from the first endpoint to the second.
+		std::uint64_t indices = 0u;
+		if (max_value != min_value) {
+			auto const range = max_value - min_value;
+			for (std::size_t i = 0u; i < texels.size(); ++i) {
+				auto const rank = static_cast<std::uint64_t>(((max_value - texels[i][channel]) * 7 + range / 2) / range);
+				auto const code = rank == 0u ? 0u : (rank == 7u ? 1u : rank + 1u);
+				indices |= code << (3u * i);
+			}
+		}
+		for (std::size_t i = 0u; i < 6u; ++i)
+			destination[2u + i] = static_cast<std::uint8_t>((indices >> (8u * i)) & 0xffu);
+	}
+
+	// Gather a block of texels, repeating the last row and column for
+	// blocks overlapping the edges of the image.
+	block_texels fetchBlock(std::uint8_t const* pixels, std::uint32_t width, std::uint32_t height,
+	                        std::uint32_t block_x, std::uint32_t block_y)
+	{
+		block_texels texels;
+		for (std::uint32_t y = 0u; y < 4u; ++y)
+			for (std::uint32_t x = 0u; x < 4u; ++x) {
+				auto const source_x = std::min(block_x * 4u + x, width - 1u);
+				auto const source_y = std::min(block_y * 4u + y, height - 1u);
+				std::memcpy(texels[y * 4u + x].data(), pixels + (static_cast<std::size_t>(source_y) * width + source_x) * 4u, 4u);
+			}
+		return texels;
+	}
+
+	void encodeBlockRows(std::uint8_t const* pixels, std::uint32_t width, std::uint32_t height, GLenum format,
+	                     std::uint32_t first_row, std::uint32_t last_row, std::uint8_t* destination)
+	{
+		auto const blocks_per_row = (width + 3u) / 4u;
+		auto const block_size = getBlockSize(format);
+		for (std::uint32_t block_y = first_row; block_y < last_row; ++block_y)
+			for (std::uint32_t block_x = 0u; block_x < blocks_per_row; ++block_x) {
+				auto const texels = fetchBlock(pixels, width, height, block_x, block_y);
+				auto const block = destination + (static_cast<std::size_t>(block_y) * blocks_per_row + block_x) * block_size;
+				switch (format) {
+					case compressed_rgb_s3tc_dxt1:
+						encodeBC1(texels, block);
+						break;
+					case compressed_rgba_s3tc_dxt5:
+						encodeBC4(texels, 3u, block);
+						encodeBC1(texels, block + 8u);
+						break;
+					case GL_COMPRESSED_RED_RGTC1:
+						encodeBC4(texels, 0u, block);
+						break;
+					case GL_COMPRESSED_RG_RGTC2:
+						encodeBC4(texels, 0u, block);
+						encodeBC4(texels, 1u, block + 8u);
+						break;
+				}
+			}
+	}
+
+	// The cache file is laid out as follows, with the blocks starting on a
+	// `cache_alignment` boundary:
+	//
+	//   [cache_header]
+	//   [source path]
+	//   [cache_level_record] × levels_nb
+	//   [blocks of all levels]
+	constexpr std::array<char, 8> cache_magic{ { 'B', 'N', 'B', 'S', 'T', 'E', 'X', 'C' } };
+	constexpr std::uint32_t cache_version = 2u;
+	constexpr std::uint64_t cache_alignment = 16u;
+
+	struct cache_header {
+		std::array<char, 8> magic;
+		std::uint32_t version;
+		std::uint32_t format;
+		std::int64_t source_modification_time;
+		std::uint64_t source_size;
+		std::uint32_t source_path_length;
+		std::uint32_t levels_nb;
+		std::uint32_t compression;
+		std::uint32_t flip;
+		std::uint64_t data_offset;
+	};
+
+	struct cache_level_record {
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint64_t offset;
+		std::uint64_t size;
+	};
+
+	static_assert(std::is_trivially_copyable<cache_header>::value, "The cache header is written as raw bytes.");
+	static_assert(std::is_trivially_copyable<cache_level_record>::value, "Level records are written as raw bytes.");
+
+	std::uint64_t align(std::uint64_t const value)
+	{
+		return (value + cache_alignment - 1u) & ~(cache_alignment - 1u);
+	}
+}
+
+bool
+bonobo::texture_compression::isSupported(texture_compression_t compression)
+{
+	if (compression != texture_compression_t::colour)
+		return compression != texture_compression_t::none;
+
+	static auto const is_s3tc_supported = [](){
+		GLint formats_nb = 0;
+		glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &formats_nb);
+		std::vector<GLint> formats(static_cast<std::size_t>(std::max(formats_nb, 0)));
+		if (!formats.empty())
+			glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+		auto const is_supported = [&formats](GLenum format){
+			return std::find(formats.begin(), formats.end(), static_cast<GLint>(format)) != formats.end();
+		};
+		return is_supported(compressed_rgb_s3tc_dxt1) && is_supported(compressed_rgba_s3tc_dxt5);
+	}();
+	return is_s3tc_supported;
+}
+
+char const*
+bonobo::texture_compression::getFormatName(GLenum format)
+{
+	switch (format) {
+		case compressed_rgb_s3tc_dxt1:  return "BC1";
+		case compressed_rgba_s3tc_dxt5: return "BC3";
+		case GL_COMPRESSED_RED_RGTC1:   return "BC4";
+		case GL_COMPRESSED_RG_RGTC2:    return "BC5";
+		default:                        return "uncompressed";
+	}
+}
+
+bonobo::texture_compression::compressed_image
+bonobo::texture_compression::compressImage(utils::byte_buffer pixels, std::uint32_t width, std::uint32_t height,
+                                           texture_compression_t compression, ThreadPool* pool)
+{
+	compressed_image image;
+	if (pixels.empty() || width == 0u || height == 0u)
+		return image;
+
+	switch (compression) {
+		case texture_compression_t::colour:
+		{
+			bool is_opaque = true;
+			for (std::size_t i = 0u; i < static_cast<std::size_t>(width) * height && is_opaque; ++i)
+				is_opaque = pixels[i * 4u + 3u] == 255u;
+			image.format = is_opaque ? compressed_rgb_s3tc_dxt1 : compressed_rgba_s3tc_dxt5;
+			break;
+		}
+		case texture_compression_t::single_channel:
+			image.format = GL_COMPRESSED_RED_RGTC1;
+			break;
+		case texture_compression_t::normal_map:
+			image.format = GL_COMPRESSED_RG_RGTC2;
+			break;
+		case texture_compression_t::none:
+			return image;
+	}
+
+	// Normal maps only keep x and y, but still need to be renormalised
+	// as a whole when filtered.
+	auto const content = compression == texture_compression_t::colour     ? mipmaps::content_t::colour
+	                   : compression == texture_compression_t::normal_map ? mipmaps::content_t::normal_map
+	                   : mipmaps::content_t::linear;
+	auto const levels = mipmaps::generate(std::move(pixels), width, height, mipmaps::filter_t::kaiser, content, pool);
+
+	// Lay out all levels first, so that they can be encoded in place.
+	auto const block_size = getBlockSize(image.format);
+	std::uint64_t data_size = 0u;
+	for (auto const& source_level : levels) {
+		compressed_level level;
+		level.width = source_level.width;
+		level.height = source_level.height;
+		level.offset = data_size;
+		level.size = static_cast<std::uint64_t>((level.width + 3u) / 4u) * ((level.height + 3u) / 4u) * block_size;
+		image.levels.push_back(level);
+		data_size += level.size;
+	}
+	image.owned_data.resize(static_cast<std::size_t>(data_size));
+	image.data = image.owned_data.data();
+
+	// Rows of blocks of all levels are split in chunks encoded
+	// concurrently.
+	std::vector<std::future<void>> encodings;
+	for (std::size_t i = 0u; i < image.levels.size(); ++i) {
+		auto const& level = image.levels[i];
+		auto const level_data = levels[i].texels.data();
+		auto const destination = image.owned_data.data() + level.offset;
+		auto const block_rows_nb = (level.height + 3u) / 4u;
+		auto const chunk_rows_nb = pool != nullptr ? std::max(block_rows_nb / static_cast<std::uint32_t>(pool->GetThreadsNb() * 4u), 1u) : block_rows_nb;
+		for (std::uint32_t first_row = 0u; first_row < block_rows_nb; first_row += chunk_rows_nb) {
+			auto const last_row = std::min(first_row + chunk_rows_nb, block_rows_nb);
+			auto const level_width = level.width, level_height = level.height;
+			auto const format = image.format;
+			auto const encode = [=](){
+				encodeBlockRows(level_data, level_width, level_height, format, first_row, last_row, destination);
+			};
+			if (pool != nullptr)
+				encodings.push_back(pool->Enqueue(encode));
+			else
+				encode();
+		}
+	}
+	for (auto& encoding : encodings)
+		encoding.get();
+
+	return image;
+}
+
+std::uint64_t
+bonobo::texture_compression::getSize(compressed_image const& image)
+{
+	std::uint64_t size = 0u;
+	for (auto const& level : image.levels)
+		size += level.size;
+	return size;
+}
+
+std::uint64_t
+bonobo::texture_compression::getUncompressedSize(compressed_image const& image)
+{
+	std::uint64_t size = 0u;
+	for (auto const& level : image.levels)
+		size += static_cast<std::uint64_t>(level.width) * level.height * 4u;
+	return size;
+}
+
+std::string
+bonobo::texture_compression::getCachePath(std::string const& filename)
+{
+	return filename + ".bonobo_bc";
+}
+
+bool
+bonobo::texture_compression::load(std::string const& filename, bool flip, texture_compression_t compression,
+                                  compressed_image& image)
+{
+	auto const cache_path = getCachePath(filename);
+	image.mapping = utils::file_view(cache_path);
+	if (!image.mapping.is_open())
+		return false;
+
+	auto const discard = [&image, &cache_path](char const* reason){
+		LogInfo("Ignoring texture cache \"%s\": %s.", cache_path.c_str(), reason);
+		image = compressed_image();
+		return false;
+	};
+
+	auto const mapping_size = static_cast<std::uint64_t>(image.mapping.size());
+	if (mapping_size < sizeof(cache_header))
+		return discard("file is truncated");
+
+	cache_header header;
+	std::memcpy(&header, image.mapping.data(), sizeof(header));
+	if (header.magic != cache_magic || header.version != cache_version)
+		return discard("it was written by a different version");
+	if (header.compression != static_cast<std::uint32_t>(compression) || header.flip != (flip ? 1u : 0u))
+		return discard("it was compressed with different options");
+
+	auto const records_offset = sizeof(cache_header) + static_cast<std::uint64_t>(header.source_path_length);
+	auto const records_end = records_offset + static_cast<std::uint64_t>(header.levels_nb) * sizeof(cache_level_record);
+	if (records_end > header.data_offset || header.data_offset > mapping_size || header.data_offset % cache_alignment != 0u)
+		return discard("file is truncated");
+
+	auto const source_path = std::string(reinterpret_cast<char const*>(image.mapping.data() + sizeof(cache_header)), header.source_path_length);
+	if (source_path != filename)
+		return discard("it was created for a different file");
+	if (header.source_modification_time != utils::get_file_modification_time(filename)
+	 || header.source_size != utils::get_file_size(filename))
+		return discard("the source image has been modified since");
+
+	image.levels.resize(header.levels_nb);
+	for (std::uint32_t i = 0u; i < header.levels_nb; ++i) {
+		cache_level_record record;
+		std::memcpy(&record, image.mapping.data() + records_offset + i * sizeof(cache_level_record), sizeof(record));
+		if (record.offset + record.size > mapping_size - header.data_offset)
+			return discard("a level record is corrupted");
+
+		image.levels[i].width = record.width;
+		image.levels[i].height = record.height;
+		image.levels[i].offset = record.offset;
+		image.levels[i].size = record.size;
+	}
+	image.format = static_cast<GLenum>(header.format);
+	image.data = image.mapping.data() + header.data_offset;
+
+	return true;
+}
+
+bool
+bonobo::texture_compression::store(std::string const& filename, bool flip, texture_compression_t compression,
+                                   compressed_image const& image)
+{
+	cache_header header;
+	header.magic = cache_magic;
+	header.version = cache_version;
+	header.format = static_cast<std::uint32_t>(image.format);
+	header.source_modification_time = utils::get_file_modification_time(filename);
+	header.source_size = utils::get_file_size(filename);
+	header.source_path_length = static_cast<std::uint32_t>(filename.size());
+	header.levels_nb = static_cast<std::uint32_t>(image.levels.size());
+	header.compression = static_cast<std::uint32_t>(compression);
+	header.flip = flip ? 1u : 0u;
+	header.data_offset = align(sizeof(cache_header) + filename.size() + image.levels.size() * sizeof(cache_level_record));
+
+	std::vector<cache_level_record> level_records;
+	level_records.reserve(image.levels.size());
+	for (auto const& level : image.levels)
+		level_records.push_back({ level.width, level.height, level.offset, level.size });
+
+	auto const cache_path = getCachePath(filename);
+	auto const temporary_path = cache_path + ".tmp";
+	{
+		std::ofstream file(utils::widen(temporary_path), std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			LogWarning("Failed to create the texture cache file \"%s\".", temporary_path.c_str());
+			return false;
+		}
+
+		static std::array<char, cache_alignment> const zeroes{};
+		auto const padding = header.data_offset - (sizeof(cache_header) + filename.size() + level_records.size() * sizeof(cache_level_record));
+		file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		file.write(filename.data(), static_cast<std::streamsize>(filename.size()));
+		file.write(reinterpret_cast<char const*>(level_records.data()), static_cast<std::streamsize>(level_records.size() * sizeof(cache_level_record)));
+		file.write(zeroes.data(), static_cast<std::streamsize>(padding));
+		file.write(reinterpret_cast<char const*>(image.data), static_cast<std::streamsize>(getSize(image)));
+
+		if (!file.good()) {
+			LogWarning("Failed to write the texture cache file \"%s\".", temporary_path.c_str());
+			file.close();
+			utils::remove_file(temporary_path);
+			return false;
+		}
+	}
+
+	if (!utils::replace_file(temporary_path, cache_path)) {
+		LogWarning("Failed to move the texture cache file \"%s\" to \"%s\".", temporary_path.c_str(), cache_path.c_str());
+		utils::remove_file(temporary_path);
+		return false;
+	}
+
+	return true;
+}
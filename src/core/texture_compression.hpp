@@ -0,0 +1,104 @@
+#pragma once
+
+#include "helpers.hpp"
+#include "core/various.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+//! \brief CPU encoders for the BC1, BC3, BC4 and BC5 block-compressed
+//!        formats, and an on-disk cache of their results.
+//!
+//! Each block of 4×4 texels is encoded independently, by fitting the
+//! endpoints to the bounding box of the block's values, as described by
+//! J.M.P. van Waveren in “Real-Time DXT Compression”, then picking the
+//! closest palette entry for each texel. This is fast rather than optimal,
+//! which matters since it runs when a texture is first loaded.
+//!
+//! Compressed images are written, with their full mip chain, to a cache file
+//! next to the source image, keyed like the scene cache on the path,
+//! modification time and size of that image, and on the requested
+//! compression; later loads upload the cached blocks directly.
+namespace bonobo
+{
+namespace texture_compression
+{
+	//! \brief One level of the mip chain of a `compressed_image`.
+	struct compressed_level {
+		std::uint32_t width{ 0u };  //!< Width in texels
+		std::uint32_t height{ 0u }; //!< Height in texels
+		std::uint64_t offset{ 0u }; //!< Offset of the first block from `compressed_image::data`
+		std::uint64_t size{ 0u };   //!< Size of all blocks of the level, in bytes
+	};
+
+	//! \brief A block-compressed image and its full mip chain.
+	struct compressed_image {
+		GLenum format{ 0u };                  //!< OpenGL internal format, or 0 if the image could not be compressed
+		std::vector<compressed_level> levels; //!< From the largest to the 1×1 level
+		std::uint8_t const* data{ nullptr };  //!< Blocks of all levels, pointing into one of the storages below
+		std::vector<std::uint8_t> owned_data; //!< Storage for freshly compressed blocks
+		utils::file_view mapping;             //!< Storage for blocks read from a cache file
+	};
+
+	//! \brief Return whether the OpenGL implementation can sample the
+	//!        format(s) |compression| results in.
+	//!
+	//! BC4 and BC5 are part of OpenGL 3.0, but BC1 and BC3 come from the
+	//! widespread S3TC extension. This has to be called from the thread
+	//! owning the OpenGL context.
+	bool isSupported(texture_compression_t compression);
+
+	//! \brief Return a short name for a compressed format, like "BC1".
+	char const* getFormatName(GLenum format);
+
+	//! \brief Compress an RGBA8 image and its mip chain, generated by
+	//!        `mipmaps::generate()` with a Kaiser filter.
+	//!
+	//! @param [in] pixels 4 bytes per texel, rows from bottom to top; they
+	//!             become the first level of the mip chain
+	//! @param [in] width of the image, in texels
+	//! @param [in] height of the image, in texels
+	//! @param [in] compression which format(s) to use; must not be `none`
+	//! @param [in] pool if not null, levels are generated and blocks
+	//!             encoded on its threads rather than on the calling one,
+	//!             which must then not be one of them
+	compressed_image compressImage(utils::byte_buffer pixels, std::uint32_t width, std::uint32_t height,
+	                               texture_compression_t compression, ThreadPool* pool = nullptr);
+
+	//! \brief Return the size of all levels of |image|, in bytes.
+	std::uint64_t getSize(compressed_image const& image);
+
+	//! \brief Return the size |image| would have if stored as RGBA8, with
+	//!        the same levels, in bytes.
+	std::uint64_t getUncompressedSize(compressed_image const& image);
+
+	//! \brief Return the path of the cache file associated to an image.
+	std::string getCachePath(std::string const& filename);
+
+	//! \brief Retrieve a compressed image from its cache file, if it is
+	//!        up-to-date.
+	//!
+	//! @param [in] filename of the image that was compressed
+	//! @param [in] flip whether the image was flipped vertically
+	//! @param [in] compression the compression to match
+	//! @param [out] image will reference the memory-mapped content of the
+	//!              cache file on success
+	//! @return whether a valid and up-to-date cache was found
+	bool load(std::string const& filename, bool flip, texture_compression_t compression,
+	          compressed_image& image);
+
+	//! \brief Write a compressed image to its cache file.
+	//!
+	//! @param [in] filename of the image that was compressed
+	//! @param [in] flip whether the image was flipped vertically
+	//! @param [in] compression the compression that was used
+	//! @param [in] image the result of `compressImage()`
+	//! @return whether the cache file was successfully written
+	bool store(std::string const& filename, bool flip, texture_compression_t compression,
+	           compressed_image const& image);
+}
+}
@@ -0,0 +1,481 @@
+#include "texture_registry.hpp"
+
+#include "core/Log.h"
+#include "core/ThreadPool.hpp"
+#include "core/uploads.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+namespace
+{
+	struct {
+		std::map<bonobo::texture_registry::key, bonobo::texture_registry::entry> entries;
+		std::unordered_map<GLuint, bonobo::texture_registry::key> keys;
+		std::uint64_t bytes_saved{ 0u };
+	} registry;
+
+	//! \brief Threads generating mipmaps and compressing the textures
+	//!        loaded one at a time, created on first use and shared by all
+	//!        those loads, rather than started for each of them.
+	std::unique_ptr<ThreadPool> workers;
+}
+
+//! \brief Pick which channels of a decoded RGBA8 image to store, given
+//!        which ones are read and what the image actually contains.
+//!
+//! Texels are only dropped when that can not change what shaders sample,
+//! using the swizzles set by `setChannelsSwizzle()`: grey images keep a
+//! single channel, and opaque ones no alpha.
+//!
+//! @param [in] texels RGBA8 texels of the image
+//! @param [in] source_channels_nb number of channels in the image file
+//! @param [in] channels which channels shaders read
+//! @return the indices of the channels to keep, for
+//!         `mipmaps::selectChannels()`
+static std::vector<std::uint32_t>
+selectStoredChannels(utils::byte_buffer const& texels, std::uint32_t source_channels_nb,
+                     bonobo::texture_registry::channels_t channels)
+{
+	if (channels == bonobo::texture_registry::channels_t::r)
+		return { 0u };
+
+	// stb expands grey images to (g, g, g, 255) and grey-alpha ones to
+	// (g, g, g, a).
+	bool is_grey = source_channels_nb <= 2u;
+	bool is_opaque = source_channels_nb == 1u || source_channels_nb == 3u || channels == bonobo::texture_registry::channels_t::rgb;
+	if (!is_grey || !is_opaque) {
+		bool could_be_grey = !is_grey;
+		bool could_be_opaque = !is_opaque;
+		for (std::size_t i = 0u; i < texels.size() && (could_be_grey || could_be_opaque); i += 4u) {
+			could_be_grey = could_be_grey && texels[i] == texels[i + 1u] && texels[i] == texels[i + 2u];
+			could_be_opaque = could_be_opaque && texels[i + 3u] == 255u;
+		}
+		is_grey = is_grey || could_be_grey;
+		is_opaque = is_opaque || could_be_opaque;
+	}
+
+	if (is_grey)
+		return is_opaque ? std::vector<std::uint32_t>{ 0u } : std::vector<std::uint32_t>{ 0u, 3u };
+	return is_opaque ? std::vector<std::uint32_t>{ 0u, 1u, 2u } : std::vector<std::uint32_t>{ 0u, 1u, 2u, 3u };
+}
+
+//! \brief Guess what the texels of an image represent from how it should
+//!        be compressed, for filtering its mipmap hierarchy.
+static bonobo::mipmaps::content_t
+getMipmapContent(bonobo::texture_compression_t compression)
+{
+	switch (compression) {
+		case bonobo::texture_compression_t::colour:     return bonobo::mipmaps::content_t::colour;
+		case bonobo::texture_compression_t::normal_map: return bonobo::mipmaps::content_t::normal_map;
+		default:                                        return bonobo::mipmaps::content_t::linear;
+	}
+}
+
+//! \brief Return the size of an RGBA8 texture, and of its mipmap hierarchy
+//!        if any.
+static std::uint64_t
+getUncompressedTextureSize(std::uint32_t width, std::uint32_t height, bool generate_mipmap)
+{
+	auto const bytes_per_texel = 4u;
+	std::uint64_t bytes = 0u;
+	for (;;) {
+		bytes += static_cast<std::uint64_t>(width) * height * bytes_per_texel;
+		if (!generate_mipmap || (width == 1u && height == 1u))
+			break;
+		width = std::max(width / 2u, 1u);
+		height = std::max(height / 2u, 1u);
+	}
+	return bytes;
+}
+
+static GLuint
+uploadTexture2D(std::vector<bonobo::mipmaps::level> const& levels, std::uint8_t const* staged_texels)
+{
+	GLuint texture = 0u;
+	glGenTextures(1, &texture);
+	assert(texture != 0u);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	// All levels were generated beforehand, rather than via
+	// `glGenerateMipmap()`, so that it did not block this thread.
+	bonobo::mipmaps::upload(GL_TEXTURE_2D, levels, staged_texels);
+	bonobo::texture_registry::setChannelsSwizzle(GL_TEXTURE_2D, levels.front().channels_nb);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size() - 1u));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels.size() > 1u ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0u);
+
+	return texture;
+}
+
+static GLuint
+uploadCompressedTexture2D(bonobo::texture_compression::compressed_image const& image, bool generate_mipmap,
+                          std::uint8_t const* staged_blocks)
+{
+	if (image.levels.empty())
+		return 0u;
+
+	GLuint texture = 0u;
+	glGenTextures(1, &texture);
+	assert(texture != 0u);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	// The mipmap hierarchy was generated when compressing, as
+	// `glGenerateMipmap()` cannot be used on compressed formats.
+	auto const levels_nb = generate_mipmap ? image.levels.size() : 1u;
+	auto const blocks = staged_blocks != nullptr ? staged_blocks : image.data;
+	for (std::size_t i = 0u; i < levels_nb; ++i) {
+		auto const& level = image.levels[i];
+		glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), image.format,
+		                       static_cast<GLsizei>(level.width), static_cast<GLsizei>(level.height), 0,
+		                       static_cast<GLsizei>(level.size), blocks + level.offset);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels_nb - 1u));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	bonobo::texture_registry::setCompressedSwizzle(GL_TEXTURE_2D, image.format);
+	glBindTexture(GL_TEXTURE_2D, 0u);
+
+	return texture;
+}
+
+// Load an image into a texture, generating its mipmap hierarchy and
+// compressing it on the shared workers if needed, and compute how much
+// memory the texture uses.
+static GLuint
+loadTexture2D(std::string const& filename, bonobo::texture_registry::key const& key,
+              std::uint64_t& bytes, std::uint64_t& uncompressed_bytes)
+{
+	ThreadPool* pool = nullptr;
+	if (key.generate_mipmap || key.compression != bonobo::texture_compression_t::none) {
+		if (workers == nullptr)
+			workers = std::make_unique<ThreadPool>();
+		pool = workers.get();
+	}
+	auto const image = bonobo::texture_registry::decodeImage(filename, key, pool, bonobo::uploads::getStagingRing());
+
+	if (image.compressed.format != 0u) {
+		bytes = key.generate_mipmap ? bonobo::texture_compression::getSize(image.compressed)
+		                            : image.compressed.levels.front().size;
+		uncompressed_bytes = getUncompressedTextureSize(image.width, image.height, key.generate_mipmap);
+	} else {
+		bytes = bonobo::mipmaps::getSize(image.levels);
+		uncompressed_bytes = bytes;
+	}
+	return bonobo::texture_registry::uploadDecodedImage(image, key.generate_mipmap);
+}
+
+bonobo::texture_registry::key
+bonobo::texture_registry::makeKey(std::string const& filename, bool flip, bool generate_mipmap, channels_t channels,
+                                  texture_compression_t compression, mipmaps::content_t content, bool is_streamed)
+{
+	return { utils::get_canonical_path(filename), flip, generate_mipmap, channels, compression, content, is_streamed };
+}
+
+GLuint
+bonobo::texture_registry::acquire(key const& key)
+{
+	auto const entry = registry.entries.find(key);
+	if (entry == registry.entries.end())
+		return 0u;
+
+	++entry->second.references_nb;
+	registry.bytes_saved += entry->second.bytes;
+	return entry->second.id;
+}
+
+void
+bonobo::texture_registry::retain(GLuint id)
+{
+	auto const key = registry.keys.find(id);
+	assert(key != registry.keys.end());
+	++registry.entries.at(key->second).references_nb;
+}
+
+bonobo::texture_registry::entry&
+bonobo::texture_registry::add(key const& key, GLuint id, std::uint64_t bytes, std::uint64_t uncompressed_bytes)
+{
+	registry.keys.emplace(id, key);
+	return registry.entries.emplace(key, entry{ id, 1u, bytes, uncompressed_bytes }).first->second;
+}
+
+bonobo::texture_registry::entry const&
+bonobo::texture_registry::get(key const& key)
+{
+	return registry.entries.at(key);
+}
+
+bool
+bonobo::texture_registry::release(GLuint id)
+{
+	auto const key = registry.keys.find(id);
+	if (key == registry.keys.end()) {
+		LogWarning("Texture %u was not acquired through the texture registry.", id);
+		return false;
+	}
+
+	auto const entry = registry.entries.find(key->second);
+	assert(entry != registry.entries.end());
+	if (--entry->second.references_nb != 0u)
+		return false;
+
+	glDeleteTextures(1, &id);
+	registry.entries.erase(entry);
+	registry.keys.erase(key);
+	return true;
+}
+
+void
+bonobo::texture_registry::clear()
+{
+	if (registry.bytes_saved != 0u)
+		LogTrivia("Sharing textures saved %.3f MiB over the whole run.",
+		          static_cast<float>(registry.bytes_saved) / (1024.0f * 1024.0f));
+	for (auto const& entry : registry.entries)
+		glDeleteTextures(1, &entry.second.id);
+	registry.entries.clear();
+	registry.keys.clear();
+	workers.reset();
+}
+
+utils::byte_buffer
+bonobo::texture_registry::getTextureData(std::string const& filename, std::uint32_t& width, std::uint32_t& height, bool flip,
+                                         bool* has_failed, std::uint32_t* source_channels_nb)
+{
+	auto const channels_nb = 4u;
+	int file_channels_nb = static_cast<int>(channels_nb);
+	stbi_set_flip_vertically_on_load_thread(flip ? 1 : 0);
+	unsigned char* image_data = nullptr;
+	utils::file_view const file(filename);
+	if (file.is_open() && file.size() <= static_cast<std::size_t>(std::numeric_limits<int>::max()))
+		image_data = stbi_load_from_memory(file.data(), static_cast<int>(file.size()),
+		                                   reinterpret_cast<int*>(&width), reinterpret_cast<int*>(&height), &file_channels_nb, channels_nb);
+	else
+		image_data = stbi_load(filename.c_str(), reinterpret_cast<int*>(&width), reinterpret_cast<int*>(&height), &file_channels_nb, channels_nb);
+	if (source_channels_nb != nullptr)
+		*source_channels_nb = image_data != nullptr ? static_cast<std::uint32_t>(file_channels_nb) : channels_nb;
+	if (has_failed != nullptr)
+		*has_failed = image_data == nullptr;
+	if (image_data == nullptr) {
+		LogWarning("Couldn't load or decode image file %s", filename.c_str());
+
+		// Provide a small empty image instead in case of failure.
+		width = 16;
+		height = 16;
+		utils::byte_buffer placeholder(width * height * channels_nb);
+		std::memset(placeholder.data(), 0, placeholder.size());
+		return placeholder;
+	}
+
+	return utils::byte_buffer(image_data, static_cast<std::size_t>(width) * height * channels_nb, stbi_image_free);
+}
+
+bonobo::texture_registry::decoded_image
+bonobo::texture_registry::decodeImage(std::string const& filename, key const& key, ThreadPool* pool,
+                                      UploadRing* staging)
+{
+	auto const decode_start_time = std::chrono::high_resolution_clock::now();
+
+	decoded_image image;
+	if (key.compression != texture_compression_t::none
+	 && texture_compression::load(filename, key.flip, key.compression, image.compressed)) {
+		image.is_cached = true;
+		image.width = image.compressed.levels.front().width;
+		image.height = image.compressed.levels.front().height;
+	} else {
+		bool has_failed = false;
+		std::uint32_t source_channels_nb = 4u;
+		auto texels = getTextureData(filename, image.width, image.height, key.flip, &has_failed, &source_channels_nb);
+		auto const stored_channels = selectStoredChannels(texels, source_channels_nb, key.channels);
+		if (key.compression != texture_compression_t::none && !has_failed) {
+			image.compressed = texture_compression::compressImage(std::move(texels), image.width, image.height,
+			                                                      key.compression, pool);
+			texture_compression::store(filename, key.flip, key.compression, image.compressed);
+		} else if (key.generate_mipmap && !has_failed) {
+			// Wider filters than the box most drivers use keep smaller
+			// levels sharp, for a cost that is negligible next to decoding.
+			image.levels = mipmaps::generate(std::move(texels), image.width, image.height,
+			                                 mipmaps::filter_t::kaiser, key.content, pool);
+		} else {
+			image.levels.push_back({ image.width, image.height, std::move(texels) });
+		}
+		mipmaps::selectChannels(image.levels, stored_channels);
+	}
+
+	// Writing to staging memory here, rather than having the driver copy
+	// from client memory during the upload, moves that copy off the thread
+	// owning the OpenGL context.
+	if (staging != nullptr) {
+		auto const size = image.compressed.format != 0u ? texture_compression::getSize(image.compressed)
+		                                                : mipmaps::getSize(image.levels);
+		image.staging = staging->TryAllocate(static_cast<GLsizeiptr>(size));
+		if (image.staging.data != nullptr && image.compressed.format != 0u) {
+			std::memcpy(image.staging.data, image.compressed.data, static_cast<std::size_t>(size));
+			image.compressed.data = nullptr;
+			std::vector<std::uint8_t>().swap(image.compressed.owned_data);
+			image.compressed.mapping = utils::file_view();
+		} else if (image.staging.data != nullptr) {
+			mipmaps::copyTexels(image.levels, image.staging.data);
+		}
+	}
+
+	auto const decode_end_time = std::chrono::high_resolution_clock::now();
+	image.decode_duration_ms = std::chrono::duration<float, std::milli>(decode_end_time - decode_start_time).count();
+
+	return image;
+}
+
+GLuint
+bonobo::texture_registry::uploadDecodedImage(decoded_image const& image, bool generate_mipmap)
+{
+	auto const upload_start_time = std::chrono::high_resolution_clock::now();
+
+	auto const upload_ring = uploads::getStagingRing();
+	auto const is_staged = image.staging.data != nullptr;
+	std::uint8_t const* staged_data = nullptr;
+	if (is_staged) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_ring->GetBuffer());
+		staged_data = reinterpret_cast<std::uint8_t const*>(static_cast<std::uintptr_t>(image.staging.offset));
+	}
+
+	GLuint texture = 0u;
+	std::uint64_t bytes = 0u;
+	if (image.compressed.format != 0u) {
+		texture = uploadCompressedTexture2D(image.compressed, generate_mipmap, staged_data);
+		bytes = generate_mipmap ? texture_compression::getSize(image.compressed)
+		                        : image.compressed.levels.front().size;
+	} else if (!image.levels.empty()) {
+		texture = uploadTexture2D(image.levels, staged_data);
+		bytes = mipmaps::getSize(image.levels);
+	}
+
+	if (is_staged) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+		upload_ring->Submit(image.staging);
+	}
+	uploads::record(is_staged, bytes, upload_start_time);
+
+	return texture;
+}
+
+void
+bonobo::texture_registry::releaseDecodedImage(decoded_image const& image)
+{
+	auto const upload_ring = uploads::getStagingRing();
+	if (image.staging.data != nullptr && upload_ring != nullptr)
+		upload_ring->Release(image.staging);
+}
+
+UploadRing*
+bonobo::texture_registry::getDecodingStaging(key const& key)
+{
+	return key.is_streamed ? nullptr : uploads::getStagingRing();
+}
+
+void
+bonobo::texture_registry::setChannelsSwizzle(GLenum target, std::uint32_t channels_nb)
+{
+	if (channels_nb == 1u) {
+		GLint const swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	} else if (channels_nb == 2u) {
+		GLint const swizzle[] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+		glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+}
+
+void
+bonobo::texture_registry::setCompressedSwizzle(GLenum target, GLenum format)
+{
+	if (format == GL_COMPRESSED_RED_RGTC1) {
+		GLint const swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	} else if (format == GL_COMPRESSED_RG_RGTC2) {
+		GLint const swizzle[] = { GL_RED, GL_GREEN, GL_ONE, GL_ONE };
+		glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+}
+
+GLenum
+bonobo::texture_registry::getUncompressedInternalFormat(std::uint32_t channels_nb)
+{
+	switch (channels_nb) {
+		case 1u:  return GL_R8;
+		case 2u:  return GL_RG8;
+		case 3u:  return GL_RGB8;
+		default:  return GL_RGBA8;
+	}
+}
+
+char const*
+bonobo::texture_registry::getInternalFormatName(GLenum internal_format)
+{
+	switch (internal_format) {
+		case GL_R8:    return "R8";
+		case GL_RG8:   return "RG8";
+		case GL_RGB8:  return "RGB8";
+		case GL_RGBA8: return "RGBA8";
+		default:       return texture_compression::getFormatName(internal_format);
+	}
+}
+
+GLuint
+bonobo::loadTexture2D(std::string const& filename, bool generate_mipmap, texture_compression_t compression)
+{
+	if (!texture_compression::isSupported(compression))
+		compression = texture_compression_t::none;
+
+	auto const key = texture_registry::makeKey(filename, true, generate_mipmap, texture_registry::channels_t::rgba,
+	                                           compression, getMipmapContent(compression));
+	std::uint64_t bytes = 0u, uncompressed_bytes = 0u;
+	return ::loadTexture2D(filename, key, bytes, uncompressed_bytes);
+}
+
+GLuint
+bonobo::acquireTexture2D(std::string const& filename, bool generate_mipmap, texture_compression_t compression)
+{
+	if (!texture_compression::isSupported(compression))
+		compression = texture_compression_t::none;
+
+	auto const key = texture_registry::makeKey(filename, true, generate_mipmap, texture_registry::channels_t::rgba,
+	                                           compression, getMipmapContent(compression));
+	auto const shared_texture = texture_registry::acquire(key);
+	if (shared_texture != 0u) {
+		auto const& entry = texture_registry::get(key);
+		LogTrivia("Texture \"%s\" shared (%u references), saving %.3f MiB",
+		          filename.c_str(), entry.references_nb,
+		          static_cast<float>(entry.bytes) / (1024.0f * 1024.0f));
+		return shared_texture;
+	}
+
+	std::uint64_t bytes = 0u, uncompressed_bytes = 0u;
+	auto const texture = ::loadTexture2D(filename, key, bytes, uncompressed_bytes);
+	if (texture != 0u)
+		texture_registry::add(key, texture, bytes, uncompressed_bytes);
+
+	return texture;
+}
+
+bonobo::texture_registry_stats
+bonobo::getTextureRegistryStats()
+{
+	texture_registry_stats stats;
+	stats.textures_nb = registry.entries.size();
+	for (auto const& entry : registry.entries) {
+		stats.references_nb += entry.second.references_nb;
+		stats.bytes_allocated += entry.second.bytes;
+		stats.bytes_uncompressed += entry.second.uncompressed_bytes;
+	}
+	stats.bytes_saved = registry.bytes_saved;
+
+	return stats;
+}
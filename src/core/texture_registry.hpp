@@ -0,0 +1,175 @@
+#pragma once
+
+#include "helpers.hpp"
+#include "core/mipmaps.hpp"
+#include "core/texture_compression.hpp"
+#include "core/UploadRing.hpp"
+#include "core/various.hpp"
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+class ThreadPool;
+
+//! \brief Registry of the 2D textures loaded from image files, so that an
+//!        image loaded several times with the same options is only stored
+//!        once on the GPU, and how those images get decoded and uploaded.
+//!
+//! Textures are shared through `bonobo::acquireTexture2D()` and by the
+//! scene loaders, and counted; `bonobo::releaseTexture()` deletes them
+//! once their last reference is gone.
+//!
+//! Decoding makes no OpenGL call, so that it can run on worker threads,
+//! and can move the texels straight into the staging ring; uploading then
+//! has to happen on the thread owning the OpenGL context.
+namespace bonobo
+{
+namespace texture_registry
+{
+	//! \brief Which channels of a texture shaders read, so that the others
+	//!        need not be stored.
+	enum class channels_t : unsigned int {
+		rgba = 0u, //!< All channels; alpha is dropped if fully opaque
+		rgb,       //!< Red, green and blue
+		r          //!< Only red
+	};
+
+	//! \brief How an image was loaded; textures are only shared between
+	//!        loads using the same key.
+	struct key {
+		std::string canonical_path;
+		bool flip;
+		bool generate_mipmap;
+		channels_t channels;
+		texture_compression_t compression;
+		mipmaps::content_t content;
+		bool is_streamed;
+
+		bool operator<(key const& other) const
+		{
+			return std::tie(canonical_path, flip, generate_mipmap, channels, compression, content, is_streamed)
+			     < std::tie(other.canonical_path, other.flip, other.generate_mipmap, other.channels, other.compression, other.content, other.is_streamed);
+		}
+	};
+
+	struct entry {
+		GLuint id;
+		std::uint32_t references_nb;
+		std::uint64_t bytes;              //!< Size of the texture on the GPU
+		std::uint64_t uncompressed_bytes; //!< Size the texture would have if it was not block-compressed
+	};
+
+	//! \brief An image decoded by `decodeImage()`, waiting to be uploaded.
+	struct decoded_image {
+		std::vector<mipmaps::level> levels;              //!< RGBA8 texels of all levels, if not compressed
+		texture_compression::compressed_image compressed; //!< Blocks of all levels, if compressed
+		bool is_cached{ false };                         //!< The blocks were read from the texture cache
+		UploadRing::Allocation staging;                  //!< Where the texels or blocks were moved to, if staged
+		std::uint32_t width{ 0u };
+		std::uint32_t height{ 0u };
+		float decode_duration_ms{ 0.0f };
+	};
+
+	key makeKey(std::string const& filename, bool flip, bool generate_mipmap, channels_t channels,
+	            texture_compression_t compression, mipmaps::content_t content, bool is_streamed = false);
+
+	//! \brief Return the registered texture matching |key| after taking a
+	//!        reference on it, or 0 if there is none.
+	GLuint acquire(key const& key);
+
+	//! \brief Take an additional reference on an already registered texture.
+	void retain(GLuint id);
+
+	//! \brief Add a freshly loaded texture to the registry, with a single
+	//!        reference on it.
+	//!
+	//! @param [in] bytes size of the texture on the GPU
+	//! @param [in] uncompressed_bytes size the texture would have if it was
+	//!             not block-compressed
+	//! @return the entry of the texture, which stays valid until the
+	//!         texture is deleted
+	entry& add(key const& key, GLuint id, std::uint64_t bytes, std::uint64_t uncompressed_bytes);
+
+	//! \brief Return the entry of a registered texture.
+	entry const& get(key const& key);
+
+	//! \brief Drop a reference on a registered texture, deleting it if that
+	//!        was the last one.
+	//!
+	//! @return whether the texture got deleted
+	bool release(GLuint id);
+
+	//! \brief Delete all registered textures, and stop the threads used to
+	//!        load them; called by `bonobo::deinit()`.
+	void clear();
+
+	//! \brief Decode an image into RGBA8 texels, reading the file through a
+	//!        memory mapping; the texels are returned in the buffer stb
+	//!        allocated, without copying them.
+	//!
+	//! Images which could not be decoded are replaced by an empty 16×16
+	//! one, and |has_failed| set if given.
+	utils::byte_buffer getTextureData(std::string const& filename, std::uint32_t& width, std::uint32_t& height, bool flip,
+	                                  bool* has_failed = nullptr, std::uint32_t* source_channels_nb = nullptr);
+
+	//! \brief Decode an image file, and prepare its mipmap hierarchy,
+	//!        without making any OpenGL call so that it can be run from a
+	//!        worker thread.
+	//!
+	//! Compressed images are retrieved from the texture cache when
+	//! up-to-date, and otherwise compressed, on |pool| if given, then
+	//! cached. Images which could not be decoded are replaced by an
+	//! uncompressed placeholder without mipmaps, and not cached.
+	//!
+	//! @param [in] filename of the image
+	//! @param [in] key how to load the image
+	//! @param [in] pool if not null, where to generate the mipmap hierarchy
+	//!             and compress it
+	//! @param [in] staging if not null, where to move the texels or blocks
+	//!             to, if there is space left; the allocation has to be
+	//!             submitted or released afterwards
+	decoded_image decodeImage(std::string const& filename, key const& key, ThreadPool* pool = nullptr,
+	                          UploadRing* staging = nullptr);
+
+	//! \brief Upload a decoded image into a new texture, from the staging
+	//!        ring if it was staged there, in which case the staging memory
+	//!        gets reclaimed once the GPU is done copying from it.
+	GLuint uploadDecodedImage(decoded_image const& image, bool generate_mipmap);
+
+	//! \brief Give back the staging memory of an image which will not be
+	//!        uploaded.
+	void releaseDecodedImage(decoded_image const& image);
+
+	//! \brief Return where to stage images loaded with |key| while
+	//!        decoding them, if anywhere.
+	//!
+	//! Images of streamed textures stay in CPU memory, and only some of
+	//! their levels get uploaded, so staging them all would only waste the
+	//! ring.
+	UploadRing* getDecodingStaging(key const& key);
+
+	//! \brief Make a texture storing fewer than four channels sample like
+	//!        the RGBA8 image it came from.
+	//!
+	//! Textures with three channels already sample alpha as one.
+	void setChannelsSwizzle(GLenum target, std::uint32_t channels_nb);
+
+	//! \brief Keep shaders sampling RGBA from a block-compressed texture:
+	//!        single-channel textures are broadcast to all colour channels,
+	//!        and normal maps get a constant z, which shaders should
+	//!        reconstruct from x and y.
+	void setCompressedSwizzle(GLenum target, GLenum format);
+
+	//! \brief Return the internal format `mipmaps::upload()` uses for
+	//!        levels with |channels_nb| channels.
+	GLenum getUncompressedInternalFormat(std::uint32_t channels_nb);
+
+	//! \brief Return a short name for the internal format of a texture,
+	//!        like "RGB8" or "BC1".
+	char const* getInternalFormatName(GLenum internal_format);
+}
+}
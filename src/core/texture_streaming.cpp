@@ -0,0 +1,382 @@
+#include "texture_streaming.hpp"
+
+#include "core/mipmaps.hpp"
+#include "core/texture_compression.hpp"
+#include "core/uploads.hpp"
+#include "core/UploadRing.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	//! \brief CPU copy of all levels of a streamed texture, and which of
+	//!        them are resident on the GPU.
+	//!
+	//! Resident levels always go from |resident_level| to the 1×1 one, the
+	//! texture's GL_TEXTURE_BASE_LEVEL being set to |resident_level|.
+	struct streamed_texture {
+		std::vector<bonobo::mipmaps::level> levels;               //!< Texels of all levels, if not compressed
+		bonobo::texture_compression::compressed_image compressed; //!< Blocks of all levels, if compressed
+		std::vector<std::uint64_t> level_sizes;                   //!< Size of each level on the GPU
+		std::vector<std::uint64_t> level_uncompressed_sizes;      //!< Size of each level, had it not been block-compressed
+		std::vector<std::uint64_t> last_needed_frames;            //!< Last frame each level was requested in, or 0
+		std::uint32_t size{ 0u };                                 //!< Largest side of the first level, in texels
+		std::uint32_t resident_level{ 0u };                       //!< Finest level on the GPU
+		std::uint32_t pinned_level{ 0u };                         //!< Finest of the levels which are never evicted
+		std::uint32_t requested_level{ 0u };                      //!< Finest level requested during the current frame
+		bonobo::texture_registry::entry* entry{ nullptr };        //!< Where the size of the texture is accounted
+	};
+
+	struct {
+		bonobo::texture_streaming_options options;
+		std::unordered_map<GLuint, streamed_texture> textures;
+		std::uint64_t frame{ 1u };
+		std::uint64_t resident_bytes{ 0u };
+		std::size_t requested_levels_nb{ 0u };
+		std::uint32_t levels_streamed_in_nb{ 0u };
+		std::uint32_t levels_evicted_nb{ 0u };
+		std::uint64_t bytes_streamed_in{ 0u };
+		std::uint64_t bytes_evicted{ 0u };
+	} streaming;
+}
+
+// Upload level |index| of a streamed texture, bound to GL_TEXTURE_2D, from
+// the upload ring if there is space in it.
+static void
+uploadStreamedLevel(streamed_texture const& texture, std::uint32_t index)
+{
+	auto const upload_start_time = std::chrono::high_resolution_clock::now();
+
+	auto const is_compressed = texture.compressed.format != 0u;
+	auto const size = texture.level_sizes[index];
+	std::uint8_t const* data = is_compressed ? texture.compressed.data + texture.compressed.levels[index].offset
+	                                         : texture.levels[index].texels.data();
+	auto const upload_ring = bonobo::uploads::getStagingRing();
+	auto const staging = upload_ring != nullptr ? upload_ring->Allocate(static_cast<GLsizeiptr>(size)) : UploadRing::Allocation();
+	if (staging.data != nullptr) {
+		std::memcpy(staging.data, data, static_cast<std::size_t>(size));
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_ring->GetBuffer());
+		data = reinterpret_cast<std::uint8_t const*>(static_cast<std::uintptr_t>(staging.offset));
+	}
+
+	if (is_compressed) {
+		auto const& level = texture.compressed.levels[index];
+		glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(index), texture.compressed.format,
+		                       static_cast<GLsizei>(level.width), static_cast<GLsizei>(level.height), 0,
+		                       static_cast<GLsizei>(level.size), data);
+	} else {
+		bonobo::mipmaps::uploadLevel(GL_TEXTURE_2D, static_cast<GLint>(index), texture.levels[index], data);
+	}
+
+	if (staging.data != nullptr) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+		upload_ring->Submit(staging);
+	}
+	bonobo::uploads::record(staging.data != nullptr, size, upload_start_time);
+}
+
+// Upload the level right above the finest resident one of a streamed
+// texture bound to GL_TEXTURE_2D, and start sampling from it.
+static void
+streamInLevel(streamed_texture& texture)
+{
+	auto const index = texture.resident_level - 1u;
+	uploadStreamedLevel(texture, index);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(index));
+	texture.resident_level = index;
+
+	texture.entry->bytes += texture.level_sizes[index];
+	texture.entry->uncompressed_bytes += texture.level_uncompressed_sizes[index];
+	streaming.resident_bytes += texture.level_sizes[index];
+	streaming.bytes_streamed_in += texture.level_sizes[index];
+	++streaming.levels_streamed_in_nb;
+}
+
+// Stop sampling from the finest resident level of a streamed texture bound
+// to GL_TEXTURE_2D, and free it.
+static void
+evictLevel(streamed_texture& texture)
+{
+	auto const index = texture.resident_level;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(index + 1u));
+	texture.resident_level = index + 1u;
+
+	// Respecifying the level as empty releases its storage.
+	if (texture.compressed.format != 0u) {
+		glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(index), texture.compressed.format, 0, 0, 0, 0, nullptr);
+	} else {
+		bonobo::mipmaps::level empty_level;
+		empty_level.channels_nb = texture.levels[index].channels_nb;
+		bonobo::mipmaps::uploadLevel(GL_TEXTURE_2D, static_cast<GLint>(index), empty_level);
+	}
+
+	texture.entry->bytes -= texture.level_sizes[index];
+	texture.entry->uncompressed_bytes -= texture.level_uncompressed_sizes[index];
+	streaming.resident_bytes -= texture.level_sizes[index];
+	streaming.bytes_evicted += texture.level_sizes[index];
+	++streaming.levels_evicted_nb;
+}
+
+// Create a texture from a decoded image, only uploading the levels which
+// always stay resident; all levels are moved to |texture|, for finer ones
+// to be streamed in later.
+static GLuint
+createStreamedTexture(bonobo::texture_registry::decoded_image image, streamed_texture& texture)
+{
+	texture.levels = std::move(image.levels);
+	texture.compressed = std::move(image.compressed);
+	texture.size = std::max(image.width, image.height);
+
+	auto const is_compressed = texture.compressed.format != 0u;
+	auto const levels_nb = static_cast<std::uint32_t>(is_compressed ? texture.compressed.levels.size() : texture.levels.size());
+	texture.pinned_level = levels_nb - 1u;
+	for (std::uint32_t i = 0u; i < levels_nb; ++i) {
+		auto const width = is_compressed ? texture.compressed.levels[i].width : texture.levels[i].width;
+		auto const height = is_compressed ? texture.compressed.levels[i].height : texture.levels[i].height;
+		auto const uncompressed_size = static_cast<std::uint64_t>(width) * height * 4u;
+		texture.level_sizes.push_back(is_compressed ? texture.compressed.levels[i].size
+		                                            : static_cast<std::uint64_t>(width) * height * texture.levels[i].channels_nb);
+		texture.level_uncompressed_sizes.push_back(is_compressed ? uncompressed_size : texture.level_sizes.back());
+		if (std::max(width, height) <= streaming.options.resident_size)
+			texture.pinned_level = std::min(texture.pinned_level, i);
+	}
+	texture.resident_level = texture.pinned_level;
+	texture.requested_level = levels_nb;
+	texture.last_needed_frames.assign(levels_nb, 0u);
+
+	GLuint id = 0u;
+	glGenTextures(1, &id);
+	assert(id != 0u);
+	glBindTexture(GL_TEXTURE_2D, id);
+	for (auto i = texture.pinned_level; i < levels_nb; ++i)
+		uploadStreamedLevel(texture, i);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(texture.pinned_level));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels_nb - 1u));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (is_compressed)
+		bonobo::texture_registry::setCompressedSwizzle(GL_TEXTURE_2D, texture.compressed.format);
+	else
+		bonobo::texture_registry::setChannelsSwizzle(GL_TEXTURE_2D, texture.levels.front().channels_nb);
+	glBindTexture(GL_TEXTURE_2D, 0u);
+
+	return id;
+}
+
+bool
+bonobo::texture_streaming::isStreamable(texture_registry::decoded_image const& image)
+{
+	auto const levels_nb = image.compressed.format != 0u ? image.compressed.levels.size() : image.levels.size();
+	return levels_nb > 1u && std::max(image.width, image.height) > streaming.options.resident_size;
+}
+
+GLuint
+bonobo::texture_streaming::createTexture(texture_registry::key const& key, texture_registry::decoded_image image,
+                                         std::uint64_t& bytes)
+{
+	streamed_texture texture;
+	auto const id = createStreamedTexture(std::move(image), texture);
+	bytes = 0u;
+	std::uint64_t uncompressed_bytes = 0u;
+	for (auto i = texture.resident_level; i < texture.level_sizes.size(); ++i) {
+		bytes += texture.level_sizes[i];
+		uncompressed_bytes += texture.level_uncompressed_sizes[i];
+	}
+	texture.entry = &texture_registry::add(key, id, bytes, uncompressed_bytes);
+	streaming.resident_bytes += bytes;
+	streaming.textures.emplace(id, std::move(texture));
+
+	return id;
+}
+
+void
+bonobo::texture_streaming::forget(GLuint id)
+{
+	auto const streamed = streaming.textures.find(id);
+	if (streamed == streaming.textures.end())
+		return;
+
+	auto const& level_sizes = streamed->second.level_sizes;
+	for (auto i = streamed->second.resident_level; i < level_sizes.size(); ++i)
+		streaming.resident_bytes -= level_sizes[i];
+	streaming.textures.erase(streamed);
+}
+
+void
+bonobo::texture_streaming::clear()
+{
+	streaming.textures.clear();
+	streaming.resident_bytes = 0u;
+}
+
+void
+bonobo::setTextureStreamingOptions(texture_streaming_options const& options)
+{
+	streaming.options = options;
+}
+
+bonobo::texture_streaming_options
+bonobo::getTextureStreamingOptions()
+{
+	return streaming.options;
+}
+
+void
+bonobo::requestTextureLevels(mesh_data const& mesh, glm::mat4 const& model_to_clip, float viewport_height)
+{
+	if (streaming.textures.empty())
+		return;
+
+	// The w coordinate in clip space is the distance along the view
+	// direction, so the nearest point of the bounding sphere is that of its
+	// centre minus its radius, scaled like the model transform scales it.
+	auto const centre = model_to_clip * glm::vec4(mesh.bounds_centre, 1.0f);
+	auto const depth_scale = glm::length(glm::vec3(model_to_clip[0][3], model_to_clip[1][3], model_to_clip[2][3]));
+	auto const distance = centre.w - mesh.bounds_radius * depth_scale;
+
+	// How many pixels a model-space unit covers at that distance, from the
+	// vertical scale of the projection.
+	auto const height_scale = glm::length(glm::vec3(model_to_clip[0][1], model_to_clip[1][1], model_to_clip[2][1]));
+	auto const pixels_per_unit = distance > 0.0f ? height_scale * 0.5f * viewport_height / distance
+	                                             : std::numeric_limits<float>::infinity();
+
+	auto const& table = bonobo::getMaterialTable();
+	if (mesh.material >= table.materials.size())
+		return;
+
+	for (auto const texture_id : table.materials[mesh.material].textures) {
+		auto const streamed = streaming.textures.find(texture_id);
+		if (streamed == streaming.textures.end())
+			continue;
+
+		auto& texture = streamed->second;
+		auto const levels_nb = static_cast<std::uint32_t>(texture.level_sizes.size());
+		std::uint32_t level = levels_nb - 1u;
+		if (mesh.texcoords_density > 0.0f) {
+			auto const texels_per_pixel = static_cast<float>(texture.size) * mesh.texcoords_density / pixels_per_unit;
+			level = texels_per_pixel > 1.0f ? static_cast<std::uint32_t>(std::log2(texels_per_pixel)) : 0u;
+			level = std::min(level, levels_nb - 1u);
+		}
+		if (level >= texture.requested_level)
+			continue;
+
+		texture.requested_level = level;
+		for (auto i = level; i < levels_nb; ++i)
+			texture.last_needed_frames[i] = streaming.frame;
+	}
+}
+
+void
+bonobo::updateTextureStreaming(upload_budget const& budget)
+{
+	auto const start_time = std::chrono::high_resolution_clock::now();
+	auto const frame = streaming.frame++;
+
+	// Evict the level, among the finest resident ones, which went unneeded
+	// the longest; levels needed this frame are only evicted when
+	// |even_if_needed|.
+	auto const evictLeastRecentlyNeeded = [frame](streamed_texture const* spared, bool even_if_needed){
+		std::pair<GLuint const, streamed_texture>* victim = nullptr;
+		std::uint64_t victim_frame = std::numeric_limits<std::uint64_t>::max();
+		for (auto& streamed : streaming.textures) {
+			auto const& texture = streamed.second;
+			if (&texture == spared || texture.resident_level >= texture.pinned_level)
+				continue;
+			auto const last_needed_frame = texture.last_needed_frames[texture.resident_level];
+			if ((last_needed_frame == frame && !even_if_needed) || last_needed_frame >= victim_frame)
+				continue;
+			victim = &streamed;
+			victim_frame = last_needed_frame;
+		}
+		if (victim == nullptr)
+			return false;
+
+		glBindTexture(GL_TEXTURE_2D, victim->first);
+		evictLevel(victim->second);
+		return true;
+	};
+
+	// Lowering the budget takes effect right away.
+	while (streaming.resident_bytes > streaming.options.budget_bytes
+	       && evictLeastRecentlyNeeded(nullptr, true))
+		continue;
+
+	// Textures missing the most levels go first, each getting one level at
+	// a time, so that all textures sharpen progressively.
+	std::vector<std::pair<GLuint const, streamed_texture>*> wanting;
+	streaming.requested_levels_nb = 0u;
+	for (auto& streamed : streaming.textures) {
+		auto const& texture = streamed.second;
+		auto const levels_nb = static_cast<std::uint32_t>(texture.level_sizes.size());
+		if (texture.requested_level < levels_nb)
+			streaming.requested_levels_nb += levels_nb - texture.requested_level;
+		if (texture.requested_level < texture.resident_level)
+			wanting.push_back(&streamed);
+	}
+
+	std::uint64_t bytes_uploaded = 0u;
+	bool has_uploaded = false;
+	while (!wanting.empty()) {
+		auto const elapsed_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+		if (has_uploaded && (bytes_uploaded >= budget.bytes || elapsed_ms >= budget.duration_ms))
+			break;
+
+		auto const most_wanting = std::max_element(wanting.begin(), wanting.end(), [](auto const* lhs, auto const* rhs){
+			return lhs->second.resident_level - lhs->second.requested_level
+			     < rhs->second.resident_level - rhs->second.requested_level;
+		});
+		auto& streamed = **most_wanting;
+		auto& texture = streamed.second;
+		auto const size = texture.level_sizes[texture.resident_level - 1u];
+
+		bool fits = true;
+		while (fits && streaming.resident_bytes + size > streaming.options.budget_bytes)
+			fits = evictLeastRecentlyNeeded(&texture, false);
+		if (!fits) {
+			wanting.erase(most_wanting);
+			continue;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, streamed.first);
+		streamInLevel(texture);
+		bytes_uploaded += size;
+		has_uploaded = true;
+		if (texture.resident_level <= texture.requested_level)
+			wanting.erase(most_wanting);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0u);
+
+	for (auto& streamed : streaming.textures)
+		streamed.second.requested_level = static_cast<std::uint32_t>(streamed.second.level_sizes.size());
+}
+
+bonobo::texture_streaming_stats
+bonobo::getTextureStreamingStats()
+{
+	texture_streaming_stats stats;
+	stats.textures_nb = streaming.textures.size();
+	for (auto const& streamed : streaming.textures) {
+		auto const& texture = streamed.second;
+		stats.levels_nb += texture.level_sizes.size();
+		stats.resident_levels_nb += texture.level_sizes.size() - texture.resident_level;
+		for (auto const size : texture.level_sizes)
+			stats.full_bytes += size;
+	}
+	stats.requested_levels_nb = streaming.requested_levels_nb;
+	stats.resident_bytes = streaming.resident_bytes;
+	stats.budget_bytes = streaming.options.budget_bytes;
+	stats.levels_streamed_in_nb = streaming.levels_streamed_in_nb;
+	stats.levels_evicted_nb = streaming.levels_evicted_nb;
+	stats.bytes_streamed_in = streaming.bytes_streamed_in;
+	stats.bytes_evicted = streaming.bytes_evicted;
+
+	return stats;
+}
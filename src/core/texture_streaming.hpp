@@ -0,0 +1,45 @@
+#pragma once
+
+#include "helpers.hpp"
+#include "core/texture_registry.hpp"
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+//! \brief Textures of objects/scenes whose finer levels get uploaded only
+//!        once drawn meshes need them, and evicted again when over budget;
+//!        the public side is `bonobo::setTextureStreamingOptions()` and the
+//!        functions following it.
+//!
+//! Streamed textures are registered like any other, and this module only
+//! keeps track of their levels and of the bytes they use.
+namespace bonobo
+{
+namespace texture_streaming
+{
+	//! \brief Return whether an image has levels large enough to be worth
+	//!        streaming.
+	bool isStreamable(texture_registry::decoded_image const& image);
+
+	//! \brief Create a texture from a decoded image, only uploading the
+	//!        levels which always stay resident, and add it to the texture
+	//!        registry; finer levels are kept in CPU memory, to be streamed
+	//!        in later.
+	//!
+	//! @param [in] key how the image was loaded
+	//! @param [in] image as returned by `texture_registry::decodeImage()`,
+	//!             which was not staged
+	//! @param [out] bytes size of the resident levels
+	//! @return the texture, with a single reference on it
+	GLuint createTexture(texture_registry::key const& key, texture_registry::decoded_image image, std::uint64_t& bytes);
+
+	//! \brief Stop streaming a texture which just got deleted; textures
+	//!        which were not streamed are ignored.
+	void forget(GLuint id);
+
+	//! \brief Stop streaming all textures; called by `bonobo::deinit()`,
+	//!        once the registry deleted them.
+	void clear();
+}
+}
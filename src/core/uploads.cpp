@@ -0,0 +1,108 @@
+#include "uploads.hpp"
+
+#include "core/Log.h"
+#include "core/UploadRing.hpp"
+
+#include <cstring>
+#include <memory>
+
+namespace
+{
+	//! \brief Staging memory for uploads, if supported; created by
+	//!        `bonobo::uploads::init()`.
+	std::unique_ptr<UploadRing> upload_ring;
+	//! \brief Size of |upload_ring|; large enough for a few uncompressed
+	//!        2048×2048 textures with their mipmaps.
+	GLsizeiptr const upload_ring_capacity = 64 * 1024 * 1024;
+
+	struct {
+		std::uint64_t bytes_staged;
+		float staged_duration_ms;
+		std::uint64_t bytes_direct;
+		float direct_duration_ms;
+	} upload_totals;
+}
+
+void
+bonobo::uploads::init()
+{
+	upload_ring = std::make_unique<UploadRing>(upload_ring_capacity);
+}
+
+void
+bonobo::uploads::deinit()
+{
+	auto const stats = bonobo::getUploadStats();
+	if (stats.bytes_staged != 0u || stats.bytes_direct != 0u)
+		LogTrivia("Uploaded %.3f MiB from the staging ring at %.1f MB/s and %.3f MiB from client memory at %.1f MB/s over the whole run; waited %.3f ms on the GPU %u times.",
+		          static_cast<float>(stats.bytes_staged) / (1024.0f * 1024.0f),
+		          getThroughput(stats.bytes_staged, stats.staged_duration_ms),
+		          static_cast<float>(stats.bytes_direct) / (1024.0f * 1024.0f),
+		          getThroughput(stats.bytes_direct, stats.direct_duration_ms),
+		          stats.stall_duration_ms, stats.stalls_nb);
+	upload_ring.reset();
+}
+
+UploadRing*
+bonobo::uploads::getStagingRing()
+{
+	return upload_ring.get();
+}
+
+void
+bonobo::uploads::record(bool is_staged, std::uint64_t bytes, std::chrono::high_resolution_clock::time_point start_time)
+{
+	auto const duration_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+	if (is_staged) {
+		upload_totals.bytes_staged += bytes;
+		upload_totals.staged_duration_ms += duration_ms;
+	} else {
+		upload_totals.bytes_direct += bytes;
+		upload_totals.direct_duration_ms += duration_ms;
+	}
+}
+
+float
+bonobo::uploads::getThroughput(std::uint64_t bytes, float duration_ms)
+{
+	return duration_ms > 0.0f ? static_cast<float>(bytes) / (duration_ms * 1000.0f) : 0.0f;
+}
+
+void
+bonobo::uploads::uploadBufferData(GLenum target, GLintptr offset, GLsizeiptr size, void const* data)
+{
+	auto const start_time = std::chrono::high_resolution_clock::now();
+	auto const staging = upload_ring != nullptr ? upload_ring->Allocate(size) : UploadRing::Allocation();
+	if (staging.data == nullptr) {
+		glBufferSubData(target, offset, size, data);
+		record(false, static_cast<std::uint64_t>(size), start_time);
+		return;
+	}
+
+	std::memcpy(staging.data, data, static_cast<std::size_t>(size));
+	glBindBuffer(GL_COPY_READ_BUFFER, upload_ring->GetBuffer());
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, target, staging.offset, offset, size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0u);
+	upload_ring->Submit(staging);
+	record(true, static_cast<std::uint64_t>(size), start_time);
+}
+
+bonobo::upload_stats
+bonobo::getUploadStats()
+{
+	upload_stats stats;
+	if (upload_ring != nullptr && upload_ring->IsSupported()) {
+		auto const ring_stats = upload_ring->GetStats();
+		stats.is_staging_supported = true;
+		stats.staging_capacity = static_cast<std::uint64_t>(upload_ring->GetCapacity());
+		stats.staging_failures_nb = ring_stats.failures_nb;
+		stats.stalls_nb = ring_stats.stalls_nb;
+		stats.stall_duration_ms = ring_stats.stall_duration_ms;
+	}
+	stats.bytes_staged = upload_totals.bytes_staged;
+	stats.staged_duration_ms = upload_totals.staged_duration_ms;
+	stats.bytes_direct = upload_totals.bytes_direct;
+	stats.direct_duration_ms = upload_totals.direct_duration_ms;
+
+	return stats;
+}
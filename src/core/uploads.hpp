@@ -0,0 +1,46 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdint>
+
+class UploadRing;
+
+//! \brief Bookkeeping shared by all code uploading data to OpenGL: the
+//!        staging ring textures and buffers get copied through, and the
+//!        totals reported by `bonobo::getUploadStats()`.
+namespace bonobo
+{
+namespace uploads
+{
+	//! \brief Create the staging ring; called by `bonobo::init()`.
+	void init();
+
+	//! \brief Log the totals over the whole run, then delete the staging
+	//!        ring; called by `bonobo::deinit()`.
+	void deinit();
+
+	//! \brief Return the staging ring, or null outside of `bonobo::init()`
+	//!        and `bonobo::deinit()`.
+	UploadRing* getStagingRing();
+
+	//! \brief Account for an upload issued since |start_time|.
+	//!
+	//! @param [in] is_staged whether the data came from the staging ring,
+	//!             rather than from client memory
+	//! @param [in] bytes size of the uploaded data
+	//! @param [in] start_time when the upload started
+	void record(bool is_staged, std::uint64_t bytes, std::chrono::high_resolution_clock::time_point start_time);
+
+	//! \brief Return a throughput in MB/s.
+	float getThroughput(std::uint64_t bytes, float duration_ms);
+
+	//! \brief Overwrite part of the buffer object bound to |target|,
+	//!        copying from the staging ring if there is space in it, and
+	//!        from client memory otherwise.
+	void uploadBufferData(GLenum target, GLintptr offset, GLsizeiptr size, void const* data);
+}
+}
@@ -1,15 +1,65 @@
 #include "various.hpp"
 
+#include "core/archive.hpp"
 #include "core/Log.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
 #include <fstream>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <sys/stat.h>
+#include <sys/types.h>
 #if defined(_WIN32)
 #include <Windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
+namespace
+{
+	struct mounted_archive {
+		std::string root;
+		std::shared_ptr<utils::archive::reader const> reader;
+	};
+
+	// Files are opened from worker threads, while archives get mounted
+	// from the main one.
+	std::mutex mounted_archives_mutex;
+	std::vector<mounted_archive> mounted_archives;
+
+	// Find the most recently mounted archive containing |path|.
+	utils::archive::entry const* findPackedFile(std::string path, std::shared_ptr<utils::archive::reader const>& reader)
+	{
+		std::replace(path.begin(), path.end(), '\\', '/');
+
+		std::lock_guard<std::mutex> lock(mounted_archives_mutex);
+		for (auto archive = mounted_archives.rbegin(); archive != mounted_archives.rend(); ++archive) {
+			auto relative_path = path;
+			if (path.compare(0u, archive->root.size() + 1u, archive->root + "/") == 0)
+				relative_path = path.substr(archive->root.size() + 1u);
+			else if (path.compare(0u, 2u, "./") == 0)
+				relative_path = path.substr(2u);
+
+			auto const file = archive->reader->find(relative_path);
+			if (file != nullptr) {
+				reader = archive->reader;
+				return file;
+			}
+		}
+		return nullptr;
+	}
+}
+
 #if defined(_WIN32)
 // Implementation based on this article by Giovanni Dicanio:
 // https://docs.microsoft.com/en-us/archive/msdn-magazine/2016/september/c-unicode-encoding-conversions-with-stl-strings-and-win32-apis
@@ -72,19 +122,395 @@ utils::widen(std::string const& utf8)
 std::string
 utils::slurp_file(std::string const& path)
 {
-  std::ifstream file = std::ifstream(utils::widen(path));
+  // Empty files can not be mapped, and have nothing to read anyway.
+  utils::file_view const file(path);
   if (!file.is_open()) {
-    LogError("Failed to open \"%s\"", path.c_str());
+    if (!utils::file_exists(path))
+      LogError("Failed to open \"%s\"", path.c_str());
     return std::string("");
   }
 
-  file.seekg(0, std::ios::end);
-  auto const size = file.tellg();
-  file.seekg(0, std::ios::beg);
+  return std::string(reinterpret_cast<char const*>(file.data()), file.size());
+}
+
+std::int64_t
+utils::get_file_modification_time(std::string const& path)
+{
+#if defined(_WIN32)
+	struct _stat64 file_status;
+	auto const has_status = ::_wstat64(utils::widen(path).c_str(), &file_status) == 0;
+#else
+	struct stat file_status;
+	auto const has_status = ::stat(path.c_str(), &file_status) == 0;
+#endif
+	if (has_status)
+		return static_cast<std::int64_t>(file_status.st_mtime);
+
+	std::shared_ptr<utils::archive::reader const> reader;
+	auto const file = findPackedFile(path, reader);
+	return file != nullptr ? file->modification_time : 0;
+}
+
+std::uint64_t
+utils::get_file_size(std::string const& path)
+{
+#if defined(_WIN32)
+	struct _stat64 file_status;
+	auto const has_status = ::_wstat64(utils::widen(path).c_str(), &file_status) == 0;
+#else
+	struct stat file_status;
+	auto const has_status = ::stat(path.c_str(), &file_status) == 0;
+#endif
+	if (has_status)
+		return static_cast<std::uint64_t>(file_status.st_size);
+
+	std::shared_ptr<utils::archive::reader const> reader;
+	auto const file = findPackedFile(path, reader);
+	return file != nullptr ? file->size : 0u;
+}
+
+bool
+utils::file_exists(std::string const& path)
+{
+#if defined(_WIN32)
+	struct _stat64 file_status;
+	if (::_wstat64(utils::widen(path).c_str(), &file_status) == 0)
+		return true;
+#else
+	struct stat file_status;
+	if (::stat(path.c_str(), &file_status) == 0)
+		return true;
+#endif
+
+	std::shared_ptr<utils::archive::reader const> reader;
+	return findPackedFile(path, reader) != nullptr;
+}
+
+std::vector<std::string>
+utils::list_files(std::string const& directory)
+{
+	std::vector<std::string> files;
+	std::vector<std::string> pending_directories{ std::string() };
+	while (!pending_directories.empty()) {
+		auto const relative_directory = std::move(pending_directories.back());
+		pending_directories.pop_back();
+		auto const prefix = relative_directory.empty() ? std::string() : relative_directory + "/";
+
+#if defined(_WIN32)
+		WIN32_FIND_DATAW find_data;
+		HANDLE const find = ::FindFirstFileW(utils::widen(directory + "/" + prefix + "*").c_str(), &find_data);
+		if (find == INVALID_HANDLE_VALUE)
+			continue;
+		do {
+			auto const name_length = ::WideCharToMultiByte(CP_UTF8, 0, find_data.cFileName, -1, nullptr, 0, nullptr, nullptr);
+			if (name_length <= 1)
+				continue;
+			std::string name(static_cast<size_t>(name_length - 1), '\0');
+			::WideCharToMultiByte(CP_UTF8, 0, find_data.cFileName, -1, &name[0], name_length, nullptr, nullptr);
+			if (name == "." || name == "..")
+				continue;
+
+			if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				pending_directories.push_back(prefix + name);
+			else
+				files.push_back(prefix + name);
+		} while (::FindNextFileW(find, &find_data));
+		::FindClose(find);
+#else
+		DIR* const dir = ::opendir((directory + "/" + prefix).c_str());
+		if (dir == nullptr)
+			continue;
+		while (auto const dir_entry = ::readdir(dir)) {
+			std::string const name(dir_entry->d_name);
+			if (name == "." || name == "..")
+				continue;
+
+			struct stat file_status;
+			if (::stat((directory + "/" + prefix + name).c_str(), &file_status) != 0)
+				continue;
+			if (S_ISDIR(file_status.st_mode))
+				pending_directories.push_back(prefix + name);
+			else if (S_ISREG(file_status.st_mode))
+				files.push_back(prefix + name);
+		}
+		::closedir(dir);
+#endif
+	}
+
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+bool
+utils::replace_file(std::string const& source, std::string const& destination)
+{
+#if defined(_WIN32)
+	return ::MoveFileExW(utils::widen(source).c_str(), utils::widen(destination).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return std::rename(source.c_str(), destination.c_str()) == 0;
+#endif
+}
+
+void
+utils::remove_file(std::string const& path)
+{
+#if defined(_WIN32)
+	::DeleteFileW(utils::widen(path).c_str());
+#else
+	std::remove(path.c_str());
+#endif
+}
+
+std::string
+utils::get_canonical_path(std::string const& path)
+{
+#if defined(_WIN32)
+	auto const wide_path = utils::widen(path);
+	auto const full_path_length = ::GetFullPathNameW(wide_path.c_str(), 0u, nullptr, nullptr);
+	if (full_path_length == 0u)
+		return path;
+
+	std::wstring full_path(full_path_length, L'\0');
+	if (::GetFullPathNameW(wide_path.c_str(), full_path_length, &full_path[0], nullptr) == 0u)
+		return path;
+	full_path.resize(std::wcslen(full_path.c_str()));
+
+	auto const canonical_path_length = ::WideCharToMultiByte(CP_UTF8, 0, full_path.c_str(), static_cast<int>(full_path.size()), nullptr, 0, nullptr, nullptr);
+	if (canonical_path_length == 0)
+		return path;
+
+	std::string canonical_path(static_cast<size_t>(canonical_path_length), '\0');
+	::WideCharToMultiByte(CP_UTF8, 0, full_path.c_str(), static_cast<int>(full_path.size()), &canonical_path[0], canonical_path_length, nullptr, nullptr);
+	return canonical_path;
+#else
+	std::unique_ptr<char, decltype(&std::free)> canonical_path(::realpath(path.c_str(), nullptr), &std::free);
+	return canonical_path != nullptr ? std::string(canonical_path.get()) : path;
+#endif
+}
+
+utils::mapped_file::mapped_file(std::string const& path)
+{
+#if defined(_WIN32)
+	HANDLE const file = ::CreateFileW(utils::widen(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER file_size;
+	if (!::GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		::CloseHandle(file);
+		return;
+	}
+
+	HANDLE const mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		LogError("Failed to create a file mapping for \"%s\"; CreateFileMapping generated the error code %d.", path.c_str(), ::GetLastError());
+		::CloseHandle(file);
+		return;
+	}
+
+	void const* const view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		LogError("Failed to map \"%s\"; MapViewOfFile generated the error code %d.", path.c_str(), ::GetLastError());
+		::CloseHandle(mapping);
+		::CloseHandle(file);
+		return;
+	}
+
+	_file_handle = file;
+	_mapping_handle = mapping;
+	_data = static_cast<std::uint8_t const*>(view);
+	_size = static_cast<std::size_t>(file_size.QuadPart);
+#else
+	int const file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return;
+
+	struct stat file_status;
+	if (::fstat(file, &file_status) != 0 || file_status.st_size == 0) {
+		::close(file);
+		return;
+	}
+
+	void* const view = ::mmap(nullptr, static_cast<std::size_t>(file_status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	// The mapping keeps its own reference to the file.
+	::close(file);
+	if (view == MAP_FAILED) {
+		LogError("Failed to map \"%s\" in memory.", path.c_str());
+		return;
+	}
+
+	_data = static_cast<std::uint8_t const*>(view);
+	_size = static_cast<std::size_t>(file_status.st_size);
+#endif
+}
+
+utils::mapped_file::~mapped_file()
+{
+	release();
+}
+
+utils::mapped_file::mapped_file(mapped_file&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+utils::mapped_file&
+utils::mapped_file::operator=(mapped_file&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	release();
+
+	std::swap(_data, other._data);
+	std::swap(_size, other._size);
+#if defined(_WIN32)
+	std::swap(_file_handle, other._file_handle);
+	std::swap(_mapping_handle, other._mapping_handle);
+#endif
+
+	return *this;
+}
+
+void
+utils::mapped_file::release() noexcept
+{
+	if (_data == nullptr)
+		return;
+
+#if defined(_WIN32)
+	::UnmapViewOfFile(_data);
+	::CloseHandle(static_cast<HANDLE>(_mapping_handle));
+	::CloseHandle(static_cast<HANDLE>(_file_handle));
+	_mapping_handle = nullptr;
+	_file_handle = nullptr;
+#else
+	::munmap(const_cast<std::uint8_t*>(_data), _size);
+#endif
+	_data = nullptr;
+	_size = 0u;
+}
+
+utils::byte_buffer::byte_buffer(std::size_t size)
+{
+	if (size == 0u)
+		return;
+
+	_data = static_cast<std::uint8_t*>(std::malloc(size));
+	if (_data == nullptr)
+		throw std::bad_alloc();
+	_size = size;
+	_release = std::free;
+}
+
+utils::byte_buffer::byte_buffer(std::uint8_t* data, std::size_t size, deleter release) noexcept
+	: _data(data), _size(data != nullptr ? size : 0u), _release(release)
+{
+}
+
+utils::byte_buffer::~byte_buffer()
+{
+	reset();
+}
+
+utils::byte_buffer::byte_buffer(byte_buffer&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+utils::byte_buffer&
+utils::byte_buffer::operator=(byte_buffer&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	reset();
+
+	std::swap(_data, other._data);
+	std::swap(_size, other._size);
+	std::swap(_release, other._release);
+
+	return *this;
+}
+
+void
+utils::byte_buffer::reset() noexcept
+{
+	if (_data != nullptr && _release != nullptr)
+		_release(_data);
+	_data = nullptr;
+	_size = 0u;
+	_release = nullptr;
+}
+
+utils::file_view::file_view(std::string const& path) : _mapping(path)
+{
+	if (_mapping.is_open()) {
+		_data = _mapping.data();
+		_size = _mapping.size();
+		return;
+	}
+
+	std::shared_ptr<archive::reader const> reader;
+	auto const file = findPackedFile(path, reader);
+	if (file == nullptr || file->size > static_cast<std::uint64_t>(std::numeric_limits<std::size_t>::max()))
+		return;
 
-  std::unique_ptr<char[]> content = std::make_unique<char[]>(static_cast<size_t>(size) + 1ll);
-  file.read(content.get(), size);
-  content[static_cast<size_t>(size)] = '\0';
+	if (!file->is_compressed) {
+		_archive = std::move(reader);
+		_data = _archive->data(*file);
+		_size = static_cast<std::size_t>(file->size);
+		return;
+	}
+
+	if (!reader->decompress(*file, _buffer) || _buffer.empty())
+		return;
+	_data = _buffer.data();
+	_size = _buffer.size();
+}
+
+utils::file_view::file_view(file_view&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+utils::file_view&
+utils::file_view::operator=(file_view&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	_mapping = std::move(other._mapping);
+	_archive = std::move(other._archive);
+	_buffer = std::move(other._buffer);
+	_data = other._data;
+	_size = other._size;
+	other._data = nullptr;
+	other._size = 0u;
 
-  return std::string(content.get());
+	return *this;
+}
+
+bool
+utils::mount_archive(std::string const& archive_path, std::string const& root)
+{
+	auto reader = std::make_shared<archive::reader const>(archive_path);
+	if (!reader->is_open())
+		return false;
+
+	auto normalised_root = root;
+	std::replace(normalised_root.begin(), normalised_root.end(), '\\', '/');
+	while (!normalised_root.empty() && normalised_root.back() == '/')
+		normalised_root.pop_back();
+
+	std::lock_guard<std::mutex> lock(mounted_archives_mutex);
+	mounted_archives.push_back({ std::move(normalised_root), std::move(reader) });
+	return true;
+}
+
+void
+utils::unmount_archives()
+{
+	std::lock_guard<std::mutex> lock(mounted_archives_mutex);
+	mounted_archives.clear();
 }
@@ -1,7 +1,11 @@
 #pragma once
 
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 
 namespace utils
@@ -15,6 +19,197 @@ inline char const* widen(char const* utf8) { return utf8; }
 inline std::string const& widen(std::string const& utf8) { return utf8; }
 #endif
 
+namespace archive
+{
+	class reader;
+}
+
+//! \brief Read the whole content of a file, going through `file_view`.
+//!
+//! @param [in] path of the file to read
+//! @return its content, or an empty string if it could not be opened
 std::string slurp_file(std::string const& path);
 
+//! \brief Retrieve the last modification time of a file.
+//!
+//! @param [in] path of the file to query
+//! @return the modification time, in seconds since the epoch, or 0 if the
+//!         file could not be queried
+std::int64_t get_file_modification_time(std::string const& path);
+
+//! \brief Retrieve the size of a file.
+//!
+//! @param [in] path of the file to query
+//! @return the size in bytes, or 0 if the file could not be queried
+std::uint64_t get_file_size(std::string const& path);
+
+//! \brief Check whether a file exists, either as a loose file or packed in
+//!        a mounted archive.
+//!
+//! @param [in] path of the file to query
+bool file_exists(std::string const& path);
+
+//! \brief List all files under a directory, recursively.
+//!
+//! @param [in] directory to list
+//! @return paths of the files relative to |directory|, using '/' as
+//!         separator, or nothing if the directory could not be read
+std::vector<std::string> list_files(std::string const& directory);
+
+//! \brief Atomically replace a file by another one.
+//!
+//! @param [in] source path of the file to move
+//! @param [in] destination path of the file to replace
+//! @return whether the file was replaced
+bool replace_file(std::string const& source, std::string const& destination);
+
+//! \brief Delete a file, ignoring any error.
+//!
+//! @param [in] path of the file to delete
+void remove_file(std::string const& path);
+
+//! \brief Resolve a path into an absolute one, without any `.` or `..`
+//!        component, so that different spellings of the same file compare
+//!        equal.
+//!
+//! On Windows, symbolic links are not resolved.
+//!
+//! @param [in] path of the file to resolve
+//! @return the canonical path, or |path| itself if it could not be resolved
+//!         (for example because the file does not exist)
+std::string get_canonical_path(std::string const& path);
+
+//! \brief Read-only memory mapping of a whole file.
+//!
+//! The mapping is released when the object is destroyed; pointers obtained
+//! through |data()| are only valid for the lifetime of the object.
+class mapped_file
+{
+public:
+	mapped_file() = default;
+
+	//! \brief Map the given file in memory.
+	//!
+	//! Use |is_open()| to check whether the mapping succeeded.
+	//!
+	//! @param [in] path of the file to map
+	explicit mapped_file(std::string const& path);
+	~mapped_file();
+
+	mapped_file(mapped_file const&) = delete;
+	mapped_file& operator=(mapped_file const&) = delete;
+	mapped_file(mapped_file&& other) noexcept;
+	mapped_file& operator=(mapped_file&& other) noexcept;
+
+	bool is_open() const noexcept { return _data != nullptr; }
+	std::uint8_t const* data() const noexcept { return _data; }
+	std::size_t size() const noexcept { return _size; }
+
+private:
+	void release() noexcept;
+
+	std::uint8_t const* _data{ nullptr };
+	std::size_t _size{ 0u };
+#if defined(_WIN32)
+	void* _file_handle{ nullptr };
+	void* _mapping_handle{ nullptr };
+#endif
+};
+
+//! \brief Owning buffer of bytes, which can adopt memory allocated by a
+//!        third-party library along with the function releasing it.
+//!
+//! Unlike `std::vector`, no copy is needed to take over memory returned by
+//! a decoder, and allocating does not zero the bytes.
+class byte_buffer
+{
+public:
+	using deleter = void (*)(void*);
+
+	byte_buffer() = default;
+
+	//! \brief Allocate |size| bytes, left uninitialised.
+	explicit byte_buffer(std::size_t size);
+
+	//! \brief Take ownership of |size| bytes at |data|, to be released by
+	//!        calling |release| on |data|.
+	byte_buffer(std::uint8_t* data, std::size_t size, deleter release) noexcept;
+	~byte_buffer();
+
+	byte_buffer(byte_buffer const&) = delete;
+	byte_buffer& operator=(byte_buffer const&) = delete;
+	byte_buffer(byte_buffer&& other) noexcept;
+	byte_buffer& operator=(byte_buffer&& other) noexcept;
+
+	bool empty() const noexcept { return _size == 0u; }
+	std::uint8_t* data() noexcept { return _data; }
+	std::uint8_t const* data() const noexcept { return _data; }
+	std::size_t size() const noexcept { return _size; }
+	std::uint8_t& operator[](std::size_t i) noexcept { return _data[i]; }
+	std::uint8_t operator[](std::size_t i) const noexcept { return _data[i]; }
+
+	//! \brief Release the bytes, leaving the buffer empty.
+	void reset() noexcept;
+
+private:
+	std::uint8_t* _data{ nullptr };
+	std::size_t _size{ 0u };
+	deleter _release{ nullptr };
+};
+
+//! \brief Read-only view of the whole content of a file, resolved through
+//!        the archives mounted by `mount_archive()`.
+//!
+//! Loose files take precedence, so that they can be edited during
+//! development, and are memory-mapped; otherwise files packed in an archive
+//! are viewed straight in the mapping of the archive, or decompressed if
+//! they were stored compressed. Pointers obtained through |data()| are only
+//! valid for the lifetime of the object.
+class file_view
+{
+public:
+	file_view() = default;
+
+	//! \brief Open the given file.
+	//!
+	//! Use |is_open()| to check whether the file was found.
+	//!
+	//! @param [in] path of the file to open
+	explicit file_view(std::string const& path);
+
+	file_view(file_view const&) = delete;
+	file_view& operator=(file_view const&) = delete;
+	file_view(file_view&& other) noexcept;
+	file_view& operator=(file_view&& other) noexcept;
+
+	bool is_open() const noexcept { return _data != nullptr; }
+	bool is_packed() const noexcept { return _archive != nullptr || !_buffer.empty(); }
+	std::uint8_t const* data() const noexcept { return _data; }
+	std::size_t size() const noexcept { return _size; }
+
+private:
+	mapped_file _mapping;
+	std::shared_ptr<archive::reader const> _archive;
+	byte_buffer _buffer;
+	std::uint8_t const* _data{ nullptr };
+	std::size_t _size{ 0u };
+};
+
+//! \brief Make the files packed in an archive available to `file_view`,
+//!        `slurp_file()`, `file_exists()`, `get_file_size()` and
+//!        `get_file_modification_time()`, as if they were located under
+//!        |root|; see `archive::write()`.
+//!
+//! Paths are looked up relative to |root|, or to the current directory if
+//! they start with "./". Archives mounted last take precedence. This can be
+//! called from any thread.
+//!
+//! @param [in] archive_path path of the archive
+//! @param [in] root directory the archive was created from
+//! @return whether the archive could be mounted
+bool mount_archive(std::string const& archive_path, std::string const& root);
+
+//! \brief Unmount all archives; files already opened from them stay valid.
+void unmount_archives();
+
 } // end of namespace
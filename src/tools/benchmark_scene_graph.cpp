@@ -0,0 +1,57 @@
+// Time updating the transforms of a large generated hierarchy, serially
+// and on thread pools of increasing sizes, without opening any window.
+//
+// Usage: benchmark_scene_graph [nodes_nb] [moving_ratio] [max_threads_nb]
+//
+// Defaults to 100 000 nodes, 1 % of them moving, and up to as many threads
+// as there are hardware threads.
+
+#include "core/FlatSceneGraph.hpp"
+#include "core/Log.h"
+#include "core/ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+
+int main(int argc, char* argv[])
+{
+	Log::Init();
+
+	std::size_t nodes_nb = 100000u;
+	float moving_ratio = 0.01f;
+	std::size_t max_threads_nb = std::max(std::thread::hardware_concurrency(), 1u);
+	unsigned int const repetitions_nb = 8u;
+	if (argc > 1)
+		nodes_nb = static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10));
+	if (argc > 2)
+		moving_ratio = std::strtof(argv[2], nullptr);
+	if (argc > 3)
+		max_threads_nb = std::max(static_cast<std::size_t>(std::strtoull(argv[3], nullptr, 10)), std::size_t(1u));
+	if (nodes_nb == 0u || argc > 4) {
+		LogError("Usage: %s [nodes_nb] [moving_ratio] [max_threads_nb]", argv[0]);
+		Log::Destroy();
+		return EXIT_FAILURE;
+	}
+
+	auto const serial_stats = bonobo::benchmarkSceneGraph(nodes_nb, moving_ratio, repetitions_nb);
+	LogInfo("%zu nodes, %zu of them moving (%zu nodes updated per partial update)",
+	        serial_stats.nodes_nb, serial_stats.moving_nodes_nb, serial_stats.updated_nodes_nb);
+	LogInfo("Node traversal: %8.3f ms", serial_stats.node_traversal_ms);
+	LogInfo("Serial:         %8.3f ms full, %8.3f ms partial",
+	        serial_stats.flat_full_update_ms, serial_stats.flat_partial_update_ms);
+
+	bool are_all_identical = true;
+	for (std::size_t threads_nb = 1u; threads_nb <= max_threads_nb; ++threads_nb) {
+		ThreadPool pool(threads_nb);
+		auto const stats = bonobo::benchmarkSceneGraph(nodes_nb, moving_ratio, repetitions_nb, &pool);
+		LogInfo("%2zu thread(s):   %8.3f ms full, %8.3f ms partial, ×%.2f speed-up on full updates%s",
+		        stats.threads_nb, stats.parallel_full_update_ms, stats.parallel_partial_update_ms,
+		        stats.flat_full_update_ms / std::max(stats.parallel_full_update_ms, 1e-6f),
+		        stats.is_parallel_identical ? "" : ", results DIFFER from the serial update");
+		are_all_identical &= stats.is_parallel_identical;
+	}
+
+	Log::Destroy();
+	return are_all_identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
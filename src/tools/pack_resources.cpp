@@ -0,0 +1,50 @@
+// Bundle directories into a single archive, which the labs mount at
+// startup in place of the loose files; see `utils::mount_archive()`.
+//
+// Usage: pack_resources [--store] <archive> <root> <directory>...
+//
+// Every file under each directory, itself relative to <root>, is packed
+// with its path relative to <root>. With --store, no file is compressed.
+
+#include "core/archive.hpp"
+#include "core/Log.h"
+#include "core/various.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+	Log::Init();
+
+	int first_argument = 1;
+	bool allow_compression = true;
+	if (argc > first_argument && std::strcmp(argv[first_argument], "--store") == 0) {
+		allow_compression = false;
+		++first_argument;
+	}
+	if (argc - first_argument < 3) {
+		LogError("Usage: %s [--store] <archive> <root> <directory>...", argv[0]);
+		Log::Destroy();
+		return EXIT_FAILURE;
+	}
+
+	std::string const archive_path = argv[first_argument];
+	std::string const root = argv[first_argument + 1];
+	std::vector<std::string> paths;
+	for (int i = first_argument + 2; i < argc; ++i) {
+		std::string const directory = argv[i];
+		auto const files = utils::list_files(root + "/" + directory);
+		if (files.empty())
+			LogWarning("No file found under \"%s/%s\".", root.c_str(), directory.c_str());
+		for (auto const& file : files)
+			paths.push_back(directory + "/" + file);
+	}
+
+	auto const has_succeeded = utils::archive::write(archive_path, root, paths, allow_compression);
+
+	Log::Destroy();
+	return has_succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}